@@ -0,0 +1,385 @@
+#include "adc_scheduler.h"
+
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "arena.h"
+#include "halmet_analog.h"
+#include "latency_tracer.h"
+#include "sample_log.h"
+#include "sample_scheduler.h"
+#include "sensesp.h"
+
+namespace halmet {
+
+namespace {
+
+const uint16_t kMux[AdcScheduler::kChannels] = {
+    ADS1X15_REG_CONFIG_MUX_SINGLE_0, ADS1X15_REG_CONFIG_MUX_SINGLE_1,
+    ADS1X15_REG_CONFIG_MUX_SINGLE_2, ADS1X15_REG_CONFIG_MUX_SINGLE_3};
+
+// Single-shot conversion time at the default 128 SPS, with margin for the
+// internal oscillator tolerance
+const unsigned long kConversionMs = 9;
+
+// Event loop latency between a due collect and its call
+const unsigned long kLeadMarginMs = 5;
+
+// Above the event loop, so that the burst samples are taken on time
+const UBaseType_t kBurstTaskPriority = tskIDLE_PRIORITY + 2;
+
+// A burst timer tick later than this means the burst task was starved
+const TickType_t kBurstTimeoutTicks = pdMS_TO_TICKS(20);
+
+}  // namespace
+
+AdcScheduler::AdcScheduler(TwoWire* i2c, adsGain_t gain)
+    : i2c_{i2c}, gain_{gain} {}
+
+int AdcScheduler::add_device(uint8_t address) {
+  if (num_devices_ >= kMaxDevices) {
+    debugE("Too many ADS1115 devices, 0x%02x not added", address);
+    return -1;
+  }
+  // A missing device keeps its index, so that the channel numbers of the
+  // devices after it don't shift.
+  Device& device = devices_[num_devices_];
+  device.address = address;
+  device.ads.setGain(gain_);
+  device.present = device.ads.begin(address, i2c_);
+  if (device.present) {
+    debugD("ADS1115 %d at 0x%02x initialized", num_devices_, address);
+  } else {
+    debugE("No ADS1115 at 0x%02x", address);
+  }
+  return num_devices_++;
+}
+
+sensesp::FloatProducer* AdcScheduler::add_channel(int device, int channel,
+                                                  SlotType type) {
+  if (device < 0 || device >= num_devices_ || !devices_[device].present ||
+      channel < 0 || channel >= kChannels) {
+    // Keep the chain connected to something; it just never emits.
+    debugE("No ADS1115 channel %d on device %d", channel, device);
+    return ArenaNew<sensesp::ObservableValue<float>>();
+  }
+  devices_[device].slots[channel] = type;
+  return &devices_[device].outputs[channel];
+}
+
+sensesp::FloatProducer* AdcScheduler::add_resistance_channel(int device,
+                                                             int channel) {
+  return add_channel(device, channel, SlotType::kResistance);
+}
+
+sensesp::FloatProducer* AdcScheduler::add_voltage_channel(int device,
+                                                          int channel) {
+  return add_channel(device, channel, SlotType::kVoltage);
+}
+
+int AdcScheduler::next_channel(const Device& device, int after) const {
+  // Round robin over the queued channels
+  for (int i = 1; i <= kChannels; i++) {
+    int channel = (after + i + kChannels) % kChannels;
+    if (device.pending[channel]) {
+      return channel;
+    }
+  }
+  return -1;
+}
+
+void AdcScheduler::start(unsigned int read_interval) {
+  set_read_interval(read_interval);
+  start_reporting();
+}
+
+void AdcScheduler::start_on_demand(unsigned int monitor_interval) {
+  SampleScheduler* scheduler = SampleScheduler::get();
+  int monitor = scheduler->add_deadline("ADC monitor", monitor_interval,
+                                        monitor_interval);
+  for (int i = 0; i < num_devices_; i++) {
+    Device& device = devices_[i];
+    device.enabled = 0;
+    for (int channel = 0; channel < kChannels; channel++) {
+      if (device.slots[channel] != SlotType::kDisabled) {
+        device.enabled++;
+      }
+    }
+    // A request may queue behind all the other channels of its device; the
+    // lead grows with the measured rounds
+    device.lead_ms = device.enabled * kConversionMs + kLeadMarginMs;
+    for (int channel = 0; channel < kChannels; channel++) {
+      if (device.slots[channel] == SlotType::kDisabled) {
+        continue;
+      }
+      device.sources[channel] = scheduler->add_source(
+          &device.outputs[channel], device.lead_ms,
+          [this, i, channel]() { request(i, channel); });
+      scheduler->add_input(monitor, &device.outputs[channel]);
+    }
+  }
+  start_reporting();
+}
+
+void AdcScheduler::start_reporting() {
+  report_start_ms_ = millis();
+  sensesp::event_loop()->onRepeat(60000, [this]() {
+    for (int i = 0; i < num_devices_; i++) {
+      debugD("ADS1115 0x%02x: all channels read in %u us max",
+             devices_[i].address, devices_[i].max_round_us);
+    }
+    uint32_t now = millis();
+    debugD("ADC: %.2f conversions/s, collect %u us max on the event loop",
+           conversions_ * 1000.0f / (now - report_start_ms_),
+           max_collect_us_);
+    if (bursts_ > 0) {
+      debugD("ADC: %u bursts at %.0f Hz, %u discarded for jitter, "
+             "%u us max jitter of the others",
+             bursts_, kBurstRate, jittery_bursts_, max_burst_jitter_us_);
+    }
+    conversions_ = 0;
+    bursts_ = 0;
+    jittery_bursts_ = 0;
+    max_burst_jitter_us_ = 0;
+    report_start_ms_ = now;
+  });
+}
+
+void AdcScheduler::set_read_interval(unsigned int read_interval) {
+  if (round_event_ != nullptr) {
+    round_event_->remove(sensesp::event_loop());
+  }
+  round_event_ = sensesp::event_loop()->onRepeat(
+      read_interval, [this]() { this->start_round(); });
+}
+
+void AdcScheduler::start_round() {
+  for (int i = 0; i < num_devices_; i++) {
+    for (int channel = 0; channel < kChannels; channel++) {
+      if (devices_[i].slots[channel] != SlotType::kDisabled) {
+        request(i, channel);
+      }
+    }
+  }
+}
+
+void AdcScheduler::request(int index, int channel) {
+  Device& device = devices_[index];
+  if (!device.present || device.slots[channel] == SlotType::kDisabled) {
+    return;
+  }
+  // A channel already queued is converted once
+  device.pending[channel] = true;
+  if (device.current < 0 && !device.bursting) {
+    device.current = channel;
+    device.round_start_us = micros();
+    start_conversion(index);
+  }
+}
+
+void AdcScheduler::start_conversion(int index) {
+  Device& device = devices_[index];
+  device.pending[device.current] = false;
+  // Timed from before the I2C write that starts the conversion, so that the
+  // collect below is never early
+  device.conversion_start_us = micros();
+  device.ads.startADCReading(kMux[device.current], false);
+  conversions_++;
+  // Collect the result once it is ready instead of polling the device for
+  // it. The event only exists while the device converts, so the event loop
+  // has nothing to wake up for between rounds.
+  sensesp::event_loop()->onDelay(kConversionMs,
+                                 [this, index]() { this->collect(index); });
+}
+
+void AdcScheduler::collect(int index) {
+  int64_t start_us = esp_timer_get_time();
+  Device& device = devices_[index];
+
+  int channel = device.current;
+  int16_t counts = device.ads.getLastConversionResults();
+  uint32_t acquired_us = device.conversion_start_us;
+
+  // Start the next conversion before processing this one, unless a burst
+  // waits for the device
+  if (burst_.device == index && !device.bursting) {
+    device.current = -1;
+    start_burst();
+  } else {
+    device.current = next_channel(device, channel);
+    if (device.current >= 0) {
+      start_conversion(index);
+    } else {
+      uint32_t round_us = micros() - device.round_start_us;
+      if (round_us > device.max_round_us) {
+        device.max_round_us = round_us;
+        update_lead(index);
+      }
+    }
+  }
+
+  if (index == 0) {
+    // Only the first device maps to the recorded A1..A4 inputs
+    SampleRecorder::get()->record(
+        static_cast<SampleSource>(
+            static_cast<int>(SampleSource::kA1Counts) + channel),
+        counts);
+  }
+
+  LatencyTracer::get()->stamp(acquired_us);
+  if (device.slots[channel] == SlotType::kResistance) {
+    device.outputs[channel].set(
+        SenderResistance(counts, device.ads.computeVolts(1)));
+  } else {
+    device.outputs[channel].set(kVoltageDividerScale *
+                                device.ads.computeVolts(counts));
+  }
+
+  uint32_t elapsed_us = esp_timer_get_time() - start_us;
+  max_collect_us_ = std::max(max_collect_us_, elapsed_us);
+}
+
+void AdcScheduler::update_lead(int index) {
+  Device& device = devices_[index];
+  unsigned int lead_ms =
+      std::max<unsigned int>(device.enabled * kConversionMs,
+                             (device.max_round_us + 999) / 1000) +
+      kLeadMarginMs;
+  if (lead_ms <= device.lead_ms) {
+    return;
+  }
+  device.lead_ms = lead_ms;
+  for (int channel = 0; channel < kChannels; channel++) {
+    if (device.sources[channel] >= 0) {
+      SampleScheduler::get()->set_lead(device.sources[channel], lead_ms);
+    }
+  }
+  debugD("ADS1115 0x%02x: sample lead %u ms", device.address, lead_ms);
+}
+
+bool AdcScheduler::capture(int index, int channel, int16_t* buffer,
+                           int size, std::function<void(float)> done) {
+  if (burst_.device >= 0 || index < 0 || index >= num_devices_ ||
+      !devices_[index].present || channel < 0 || channel >= kChannels ||
+      size <= 0) {
+    return false;
+  }
+  burst_.device = index;
+  burst_.channel = channel;
+  burst_.buffer = buffer;
+  burst_.size = size;
+  burst_.done = done;
+  burst_.finished = false;
+  // Otherwise collect() starts it after the current conversion
+  if (devices_[index].current < 0) {
+    start_burst();
+  }
+  return true;
+}
+
+void AdcScheduler::start_burst() {
+  devices_[burst_.device].bursting = true;
+  if (burst_task_ == nullptr) {
+    // On the event loop's core, away from the WiFi stack
+    xTaskCreatePinnedToCore(burst_task, "adc_burst", 3072, this,
+                            kBurstTaskPriority, &burst_task_,
+                            xPortGetCoreID());
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = [](void* arg) {
+      xTaskNotifyGive(static_cast<TaskHandle_t>(arg));
+    };
+    timer_args.arg = burst_task_;
+    timer_args.name = "adc_burst";
+    esp_timer_create(&timer_args, &burst_timer_);
+  }
+  xTaskNotifyGive(burst_task_);
+  unsigned int expected_ms =
+      (burst_.size + 1) * kBurstPeriodUs / 1000 + kLeadMarginMs;
+  sensesp::event_loop()->onDelay(expected_ms, [this]() { poll_burst(); });
+}
+
+void AdcScheduler::poll_burst() {
+  if (!burst_.finished) {
+    sensesp::event_loop()->onDelay(kLeadMarginMs, [this]() { poll_burst(); });
+    return;
+  }
+
+  int index = burst_.device;
+  Device& device = devices_[index];
+  std::function<void(float)> done = burst_.done;
+  float sample_rate = burst_.sample_rate;
+  device.bursting = false;
+  burst_.device = -1;
+
+  bursts_++;
+  if (burst_.max_jitter_us > kMaxBurstJitterUs) {
+    jittery_bursts_++;
+  } else {
+    max_burst_jitter_us_ = std::max(max_burst_jitter_us_,
+                                    burst_.max_jitter_us);
+  }
+
+  // Resume the conversions queued during the burst
+  if (device.current < 0) {
+    device.current = next_channel(device, -1);
+    if (device.current >= 0) {
+      device.round_start_us = micros();
+      start_conversion(index);
+    }
+  }
+  done(sample_rate);
+}
+
+void AdcScheduler::burst_task(void* arg) {
+  AdcScheduler* scheduler = static_cast<AdcScheduler*>(arg);
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    Burst& burst = scheduler->burst_;
+    Adafruit_ADS1115& ads = scheduler->devices_[burst.device].ads;
+
+    uint16_t data_rate = ads.getDataRate();
+    ads.setDataRate(RATE_ADS1115_860SPS);
+    esp_timer_start_periodic(scheduler->burst_timer_, kBurstPeriodUs);
+    int64_t first_us = 0;
+    uint32_t max_jitter_us = 0;
+    bool complete = true;
+    // Each tick reads the conversion started on the tick before it
+    for (int i = 0; i <= burst.size; i++) {
+      if (ulTaskNotifyTake(pdTRUE, kBurstTimeoutTicks) == 0) {
+        complete = false;
+        break;
+      }
+      if (i > 0) {
+        burst.buffer[i - 1] = ads.getLastConversionResults();
+      }
+      if (i == burst.size) {
+        break;
+      }
+      // The conversion samples the input from its start
+      int64_t start_us = esp_timer_get_time();
+      if (i == 0) {
+        first_us = start_us;
+      }
+      int64_t offset_us = start_us - first_us - i * int64_t{kBurstPeriodUs};
+      max_jitter_us = std::max(max_jitter_us, static_cast<uint32_t>(
+                                                  std::abs(offset_us)));
+      ads.startADCReading(kMux[burst.channel], false);
+    }
+    esp_timer_stop(scheduler->burst_timer_);
+    // A tick that fired while stopping must not start the next burst
+    ulTaskNotifyTake(pdTRUE, 0);
+    // The last conversion was read after its time, so it must be complete;
+    // otherwise the device stopped responding.
+    complete = complete && ads.conversionComplete();
+    ads.setDataRate(data_rate);
+
+    burst.max_jitter_us = max_jitter_us;
+    burst.sample_rate =
+        complete && max_jitter_us <= kMaxBurstJitterUs ? kBurstRate : 0;
+    burst.finished = true;
+  }
+}
+
+}  // namespace halmet
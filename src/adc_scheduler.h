@@ -0,0 +1,155 @@
+#ifndef HALMET_SRC_ADC_SCHEDULER_H_
+#define HALMET_SRC_ADC_SCHEDULER_H_
+
+#include <Adafruit_ADS1X15.h>
+#include <ReactESP.h>
+#include <Wire.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <functional>
+
+#include "sensesp/system/observablevalue.h"
+
+namespace halmet {
+
+/**
+ * @brief Non-blocking, interleaved conversions on up to four ADS1115s.
+ *
+ * readADC_SingleEnded() blocks the event loop for a full conversion (about
+ * 8 ms at the default 128 SPS) per channel. The scheduler instead starts a
+ * single-shot conversion on every device, returns, and collects the results
+ * with a delayed event once the conversion time has passed, counted from
+ * before the I2C write that starts it, then starts the next enabled channel
+ * of that device. No event is left when no device converts, so the event
+ * loop doesn't wake up between rounds. The devices convert in parallel,
+ * so the time to read all channels depends on the channels per device, not
+ * on the number of devices.
+ *
+ * Started with start(), each device reads its enabled channels in turn
+ * every read_interval ms. Started with start_on_demand(), a channel is
+ * only converted when a deadline of the SampleScheduler needs its sample,
+ * just before the deadline's transmission. The lead of those samples is the
+ * longest time the device took to read all its queued channels, as a
+ * request may queue behind all the others; until a round was measured, it
+ * is estimated from the conversion time. Only the channels requested
+ * with add_*_channel() are converted either way.
+ *
+ * capture() reads a burst of one channel at a uniform kBurstRate. A
+ * periodic esp_timer wakes a task pinned to the event loop's core every
+ * kBurstPeriodUs. Each wakeup reads the previous single-shot conversion,
+ * which at 860 SPS has finished by then, and starts the next, so samples
+ * are spaced by the timer rather than by the I2C and polling times. The
+ * task blocks between wakeups and never polls. The other conversions of
+ * the device queue until the burst is done. The I2C bus is shared with the
+ * event loop through the Wire lock; a burst whose samples are more than
+ * kMaxBurstJitterUs off the timer grid, e.g. because another device held
+ * the bus, is discarded. Bursts and their jitter are logged every minute.
+ */
+class AdcScheduler {
+ public:
+  static const int kMaxDevices = 4;
+  static const int kChannels = 4;
+  // Per burst sample: a conversion read and a single-shot start at 100 kHz
+  // I2C, and the 1.2 ms conversion at 860 SPS
+  static const uint32_t kBurstPeriodUs = 2500;
+  static constexpr float kBurstRate = 1e6f / kBurstPeriodUs;  // Hz
+  static const uint32_t kMaxBurstJitterUs = kBurstPeriodUs / 10;
+
+  AdcScheduler(TwoWire* i2c, adsGain_t gain);
+
+  /// Add an ADS1115 at the given I2C address and return its device index.
+  /// Devices are indexed in the order they are added, even if they don't
+  /// respond; is_present() tells whether they did.
+  int add_device(uint8_t address);
+  int get_device_count() const { return num_devices_; }
+  bool is_present(int device) const { return devices_[device].present; }
+  Adafruit_ADS1115* get_device(int device) { return &devices_[device].ads; }
+
+  /// Sender resistance (ohms) on a device channel
+  sensesp::FloatProducer* add_resistance_channel(int device, int channel);
+  /// Voltage (V) at the HALMET input terminal of a device channel
+  sensesp::FloatProducer* add_voltage_channel(int device, int channel);
+
+  /// Convert all enabled channels every read_interval ms
+  void start(unsigned int read_interval = 500);
+  void set_read_interval(unsigned int read_interval);
+
+  /// Convert the enabled channels as sources of the SampleScheduler, and
+  /// at least every monitor_interval ms for outputs without a deadline
+  void start_on_demand(unsigned int monitor_interval = 500);
+
+  /// Queue a conversion of a device channel
+  void request(int device, int channel);
+
+  /// Capture size samples of a device channel into buffer. done is called
+  /// on the event loop with the sample rate (kBurstRate), or 0 if the
+  /// device stopped responding or the sample times jittered. Returns false
+  /// if a burst is in progress.
+  bool capture(int device, int channel, int16_t* buffer, int size,
+               std::function<void(float sample_rate)> done);
+
+ protected:
+  enum class SlotType { kDisabled, kResistance, kVoltage };
+
+  struct Device {
+    Adafruit_ADS1115 ads;
+    uint8_t address;
+    bool present = false;
+    SlotType slots[kChannels] = {};
+    sensesp::ObservableValue<float> outputs[kChannels];
+    bool pending[kChannels] = {};
+    int current = -1;  // Channel being converted, or -1 when idle
+    bool bursting = false;
+    unsigned long round_start_us = 0;
+    unsigned long conversion_start_us = 0;
+    uint32_t max_round_us = 0;  // Longest time to read all queued channels
+    int enabled = 0;            // Channels with a slot type
+    // SampleScheduler sources of the channels, or -1 if not on demand
+    int sources[kChannels] = {-1, -1, -1, -1};
+    unsigned int lead_ms = 0;
+  };
+
+  struct Burst {
+    int device = -1;  // -1 when no burst is requested
+    int channel = 0;
+    int16_t* buffer = nullptr;
+    int size = 0;
+    std::function<void(float)> done;
+    volatile bool finished = false;
+    float sample_rate = 0;
+    uint32_t max_jitter_us = 0;  // Largest sample time offset from the grid
+  };
+
+  sensesp::FloatProducer* add_channel(int device, int channel, SlotType type);
+  void start_reporting();
+  void start_round();
+  void start_conversion(int index);
+  void collect(int index);
+  /// Set the lead of the device's sources from its longest round
+  void update_lead(int index);
+  int next_channel(const Device& device, int after) const;
+  void start_burst();
+  void poll_burst();
+  static void burst_task(void* arg);
+
+  TwoWire* i2c_;
+  adsGain_t gain_;
+  Device devices_[kMaxDevices];
+  int num_devices_ = 0;
+  reactesp::RepeatEvent* round_event_ = nullptr;
+  uint32_t max_collect_us_ = 0;
+  Burst burst_;
+  TaskHandle_t burst_task_ = nullptr;
+  esp_timer_handle_t burst_timer_ = nullptr;
+  uint32_t bursts_ = 0;
+  uint32_t jittery_bursts_ = 0;
+  uint32_t max_burst_jitter_us_ = 0;
+  uint32_t conversions_ = 0;
+  uint32_t report_start_ms_ = 0;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_ADC_SCHEDULER_H_
@@ -0,0 +1,166 @@
+#include "alarm_rules.h"
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/signalk/signalk_output.h"
+#include "sensesp/system/lambda_consumer.h"
+
+namespace halmet {
+
+AlarmRule::AlarmRule(Direction direction, float threshold, float hysteresis,
+                     float delay_on, const String& config_path)
+    : sensesp::FileSystemSaveable{config_path},
+      direction_{direction},
+      threshold_{threshold},
+      hysteresis_{hysteresis},
+      delay_on_{delay_on} {
+  load();
+  compile();
+}
+
+void AlarmRule::set_rpm_condition(sensesp::FloatProducer* revolutions,
+                                  float min_rpm, float breakpoint_rpm,
+                                  float threshold_at_breakpoint) {
+  // Set the defaults, then let the saved configuration override them
+  min_rpm_ = min_rpm;
+  breakpoint_rpm_ = breakpoint_rpm;
+  threshold_at_breakpoint_ = threshold_at_breakpoint;
+  has_rpm_condition_ = true;
+  load();
+  compile();
+
+  revolutions->connect_to(ArenaNew<sensesp::LambdaConsumer<float>>(
+      [this](float value) { revolutions_ = value; }));
+}
+
+void AlarmRule::compile() {
+  float thresholds[2] = {
+      threshold_, has_rpm_condition_ ? threshold_at_breakpoint_ : threshold_};
+  for (int i = 0; i < 2; i++) {
+    set_limit_[i] = thresholds[i];
+    clear_limit_[i] = direction_ == Direction::kHigh
+                          ? thresholds[i] - hysteresis_
+                          : thresholds[i] + hysteresis_;
+  }
+  min_revolutions_ = has_rpm_condition_ ? min_rpm_ / 60 : 0;
+  breakpoint_revolutions_ =
+      has_rpm_condition_ ? breakpoint_rpm_ / 60 : INFINITY;
+  delay_on_ms_ = delay_on_ * 1000;
+}
+
+void AlarmRule::set(const float& value) {
+  if (isnan(value)) {
+    return;
+  }
+
+  if (revolutions_ < min_revolutions_) {
+    // Held off, e.g. no oil pressure with the engine stopped
+    active_ = false;
+    pending_ = false;
+  } else {
+    int range = revolutions_ >= breakpoint_revolutions_;
+    bool high = direction_ == Direction::kHigh;
+    bool beyond = high ? value > set_limit_[range] : value < set_limit_[range];
+    bool cleared =
+        high ? value < clear_limit_[range] : value > clear_limit_[range];
+
+    if (active_) {
+      active_ = !cleared;
+    } else if (!beyond) {
+      pending_ = false;
+    } else if (!pending_) {
+      pending_ = true;
+      pending_since_ = millis();
+      active_ = delay_on_ms_ == 0;
+    } else {
+      active_ = millis() - pending_since_ >= delay_on_ms_;
+    }
+    if (active_) {
+      pending_ = false;
+    }
+  }
+
+  this->emit(active_);
+}
+
+bool AlarmRule::from_json(const JsonObject& config) {
+  String expected[] = {"threshold", "hysteresis", "delay_on"};
+  for (auto str : expected) {
+    if (!config[str].is<float>()) {
+      return false;
+    }
+  }
+  threshold_ = config["threshold"];
+  hysteresis_ = config["hysteresis"];
+  delay_on_ = config["delay_on"];
+  if (config["min_rpm"].is<float>()) {
+    min_rpm_ = config["min_rpm"];
+    breakpoint_rpm_ = config["breakpoint_rpm"];
+    threshold_at_breakpoint_ = config["threshold_at_breakpoint"];
+  }
+  compile();
+  return true;
+}
+
+bool AlarmRule::to_json(JsonObject& config) {
+  config["threshold"] = threshold_;
+  config["hysteresis"] = hysteresis_;
+  config["delay_on"] = delay_on_;
+  if (has_rpm_condition_) {
+    config["min_rpm"] = min_rpm_;
+    config["breakpoint_rpm"] = breakpoint_rpm_;
+    config["threshold_at_breakpoint"] = threshold_at_breakpoint_;
+  }
+  return true;
+}
+
+const String ConfigSchema(const AlarmRule& obj) {
+  if (obj.has_rpm_condition()) {
+    return R"###({
+      "type": "object",
+      "properties": {
+        "threshold": { "title": "Threshold", "type": "number", "description": "Alarm threshold below the breakpoint speed, in the input units" },
+        "hysteresis": { "title": "Hysteresis", "type": "number", "description": "Distance back from the threshold at which the alarm clears" },
+        "delay_on": { "title": "Delay on", "type": "number", "description": "Seconds the value must stay beyond the threshold before the alarm raises" },
+        "min_rpm": { "title": "Minimum RPM", "type": "number", "description": "The alarm is held off below this engine speed" },
+        "breakpoint_rpm": { "title": "Breakpoint RPM", "type": "number", "description": "Engine speed from which the second threshold applies" },
+        "threshold_at_breakpoint": { "title": "Threshold at breakpoint", "type": "number", "description": "Alarm threshold at and above the breakpoint speed" }
+      }
+    })###";
+  }
+  return R"###({
+    "type": "object",
+    "properties": {
+      "threshold": { "title": "Threshold", "type": "number", "description": "Alarm threshold, in the input units" },
+      "hysteresis": { "title": "Hysteresis", "type": "number", "description": "Distance back from the threshold at which the alarm clears" },
+      "delay_on": { "title": "Delay on", "type": "number", "description": "Seconds the value must stay beyond the threshold before the alarm raises" }
+    }
+  })###";
+}
+
+AlarmNotification::AlarmNotification(const String& message, const char* state)
+    : message_{message}, state_{state} {}
+
+void AlarmNotification::set(const bool& active) {
+  if (initialized_ && active == active_) {
+    return;
+  }
+  initialized_ = true;
+  active_ = active;
+
+  String json = String("{\"state\":\"") + (active ? state_ : "normal") +
+                "\",\"method\":" +
+                (active ? "[\"visual\",\"sound\"]" : "[]") +
+                ",\"message\":\"" + message_ + "\"}";
+  this->emit(json);
+}
+
+void ConnectAlarmNotification(sensesp::BoolProducer* alarm,
+                              const String& sk_path, const String& message,
+                              const char* state) {
+  auto notification = ArenaNew<AlarmNotification>(message, state);
+  alarm->connect_to(notification);
+  notification->connect_to(ArenaNew<sensesp::SKOutputRawJson>(sk_path));
+}
+
+}  // namespace halmet
@@ -0,0 +1,112 @@
+#ifndef HALMET_SRC_ALARM_RULES_H_
+#define HALMET_SRC_ALARM_RULES_H_
+
+#include <Arduino.h>
+
+#include "config_store.h"
+#include "sensesp/system/saveable.h"
+#include "sensesp/system/valueconsumer.h"
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/**
+ * @brief Threshold alarm on an analog-derived value.
+ *
+ * The alarm raises when the input stays beyond the threshold for delay_on
+ * seconds and clears when it comes back by more than the hysteresis. With
+ * an RPM condition, a second threshold applies at and above a breakpoint
+ * speed (e.g. a higher minimum oil pressure at cruise than at idle), and
+ * the alarm is held off below a minimum speed (e.g. engine stopped).
+ *
+ * The configured limits are compiled into set and clear limits per speed
+ * range whenever the configuration changes, so evaluating a sample is a
+ * couple of comparisons. The state is emitted on every input sample, which
+ * keeps RepeatExpiring inputs such as the 127489 status bits alive.
+ */
+class AlarmRule : public sensesp::FloatConsumer,
+                  public sensesp::ValueProducer<bool>,
+                  public sensesp::FileSystemSaveable {
+ public:
+  enum class Direction { kHigh, kLow };
+
+  AlarmRule(Direction direction, float threshold, float hysteresis,
+            float delay_on, const String& config_path = "");
+
+  /// Make the rule depend on engine speed. Speeds are in rpm; the
+  /// revolutions producer is in r/s, as from ConnectTachoSender.
+  void set_rpm_condition(sensesp::FloatProducer* revolutions, float min_rpm,
+                         float breakpoint_rpm, float threshold_at_breakpoint);
+
+  void set(const float& value) override;
+
+  bool is_active() const { return active_; }
+
+  virtual bool from_json(const JsonObject& config) override;
+  virtual bool to_json(JsonObject& config) override;
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+  bool has_rpm_condition() const { return has_rpm_condition_; }
+
+ protected:
+  void compile();
+
+  Direction direction_;
+  float threshold_;
+  float hysteresis_;
+  float delay_on_;  // s
+  bool has_rpm_condition_ = false;
+  float min_rpm_ = 0;
+  float breakpoint_rpm_ = 0;
+  float threshold_at_breakpoint_ = 0;
+
+  // Compiled limits in input units and r/s, indexed by speed range
+  // (0: below the breakpoint, 1: at or above it)
+  float set_limit_[2];
+  float clear_limit_[2];
+  float min_revolutions_ = 0;
+  float breakpoint_revolutions_ = 0;
+  unsigned long delay_on_ms_ = 0;
+
+  float revolutions_ = 0;
+  bool active_ = false;
+  bool pending_ = false;
+  unsigned long pending_since_ = 0;
+};
+
+const String ConfigSchema(const AlarmRule& obj);
+
+inline bool ConfigRequiresRestart(const AlarmRule& obj) { return false; }
+
+/**
+ * @brief Signal K notification for an alarm state.
+ *
+ * Emits a notification object only when the alarm state changes, for use
+ * with SKOutputRawJson on a notifications.* path.
+ */
+class AlarmNotification : public sensesp::BoolConsumer,
+                          public sensesp::ValueProducer<String> {
+ public:
+  AlarmNotification(const String& message, const char* state = "alarm");
+
+  void set(const bool& active) override;
+
+ protected:
+  String message_;
+  const char* state_;
+  bool initialized_ = false;
+  bool active_ = false;
+};
+
+/// Send the changes of an alarm to Signal K as notifications on sk_path.
+void ConnectAlarmNotification(sensesp::BoolProducer* alarm,
+                              const String& sk_path, const String& message,
+                              const char* state = "alarm");
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_ALARM_RULES_H_
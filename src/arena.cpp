@@ -0,0 +1,61 @@
+#include "arena.h"
+
+#include <esp_heap_caps.h>
+
+#include "sensesp.h"
+
+namespace halmet {
+
+namespace {
+
+alignas(8) uint8_t arena_storage[kArenaSize == 0 ? 8 : kArenaSize];
+
+}  // namespace
+
+Arena* Arena::get() {
+  static Arena arena;
+  return &arena;
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+  size_t start = (offset_ + alignment - 1) & ~(alignment - 1);
+  if (start + size > kArenaSize) {
+    debugE("Arena exhausted: %u bytes requested with %u of %u used. "
+           "Increase HALMET_ARENA_SIZE.",
+           size, offset_, kArenaSize);
+    abort();
+  }
+  // The alignment padding is lost for good, so it counts as used
+  used_ += start - offset_ + size;
+  offset_ = start + size;
+  return arena_storage + start;
+}
+
+void Arena::deallocate(void* ptr, size_t size) {
+  // Graph nodes live until reboot. Anything released early only lowers the
+  // live byte count; the space is not reused.
+  if (contains(ptr)) {
+    used_ -= size;
+  }
+}
+
+bool Arena::contains(const void* ptr) const {
+  const uint8_t* p = static_cast<const uint8_t*>(ptr);
+  return p >= arena_storage && p < arena_storage + kArenaSize;
+}
+
+void Arena::report(const char* label) const {
+  if (kArenaSize > 0) {
+    debugI("%s: arena %u used, %u peak of %u bytes", label, used_, offset_,
+           kArenaSize);
+  }
+  ReportHeap(label);
+}
+
+void ReportHeap(const char* label) {
+  debugI("%s: free heap %u bytes, largest free block %u bytes", label,
+         heap_caps_get_free_size(MALLOC_CAP_8BIT),
+         heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
+}  // namespace halmet
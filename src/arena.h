@@ -0,0 +1,126 @@
+#ifndef HALMET_SRC_ARENA_H_
+#define HALMET_SRC_ARENA_H_
+
+#include <Arduino.h>
+
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace halmet {
+
+// Size of the static region that holds the sensor graph when built with
+// HALMET_ARENA. Override with -D HALMET_ARENA_SIZE=... in platformio.ini.
+#ifndef HALMET_ARENA_SIZE
+#define HALMET_ARENA_SIZE (32 * 1024)
+#endif
+
+static_assert(HALMET_ARENA_SIZE % 8 == 0,
+              "HALMET_ARENA_SIZE must be a multiple of 8");
+static_assert(HALMET_ARENA_SIZE <= 96 * 1024,
+              "HALMET_ARENA_SIZE would leave too little DRAM for WiFi/TLS");
+
+#ifdef HALMET_ARENA
+constexpr size_t kArenaSize = HALMET_ARENA_SIZE;
+#else
+constexpr size_t kArenaSize = 0;
+#endif
+
+/**
+ * @brief Bump allocator over a statically sized region.
+ *
+ * The producer/transform/consumer graph is built once in setup() and never
+ * torn down, so its nodes can be packed back to back without per-block
+ * allocator headers and without interleaving with buffers that are freed
+ * later. Running out of arena space is a configuration error and aborts at
+ * boot with the required size in the log.
+ */
+class Arena {
+ public:
+  static Arena* get();
+
+  void* allocate(size_t size, size_t alignment);
+  void deallocate(void* ptr, size_t size);
+
+  bool contains(const void* ptr) const;
+
+  size_t get_capacity() const { return kArenaSize; }
+  size_t get_used() const { return used_; }
+  size_t get_peak() const { return offset_; }
+
+  /// Log arena usage together with the heap state.
+  void report(const char* label) const;
+
+ private:
+  size_t offset_ = 0;
+  size_t used_ = 0;
+};
+
+/// Log free heap and largest free block, e.g. before and after building the
+/// sensor graph.
+void ReportHeap(const char* label);
+
+/**
+ * @brief Construct a long-lived graph node, in the arena if enabled.
+ *
+ * Only for objects that are never deleted. Objects handed to another owner
+ * that may delete them, such as the SKMetadata of a Signal K output, stay on
+ * the heap.
+ */
+template <typename T, typename... Args>
+T* ArenaNew(Args&&... args) {
+#ifdef HALMET_ARENA
+  void* ptr = Arena::get()->allocate(sizeof(T), alignof(T));
+  return new (ptr) T(std::forward<Args>(args)...);
+#else
+  return new T(std::forward<Args>(args)...);
+#endif
+}
+
+/**
+ * @brief Standard allocator interface for the arena, for allocate_shared.
+ */
+template <typename T>
+struct ArenaAllocator {
+  using value_type = T;
+
+  ArenaAllocator() = default;
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(
+        Arena::get()->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* ptr, size_t n) {
+    Arena::get()->deallocate(ptr, n * sizeof(T));
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) {
+  return false;
+}
+
+/**
+ * @brief Shared pointer to a graph node, with the object and its control
+ * block in the arena if enabled.
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> ArenaMakeShared(Args&&... args) {
+#ifdef HALMET_ARENA
+  return std::allocate_shared<T>(ArenaAllocator<T>(),
+                                 std::forward<Args>(args)...);
+#else
+  return std::make_shared<T>(std::forward<Args>(args)...);
+#endif
+}
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_ARENA_H_
@@ -0,0 +1,225 @@
+#include "boot_timeline.h"
+
+#include <ArduinoJson.h>
+#include <esp_attr.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+
+#include "sensesp.h"
+#include "sensesp/net/http_server.h"
+#include "sensesp/signalk/signalk_output.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp_app.h"
+
+namespace halmet {
+
+namespace {
+
+// "BOOT" in little endian
+const uint32_t kTimelineMagic = 0x544f4f42;
+// Bumped when RtcTimeline or BootRecord change their layout
+const uint32_t kTimelineVersion = 2;
+
+const int kEventCount = static_cast<int>(BootEvent::kCount);
+
+// Event names, used as JSON keys and Signal K path components
+const char* const kEventNames[kEventCount] = {
+    "appReady",      "i2cReady",     "ads1115Ready", "n2kOpen",
+    "displayReady",  "oneWireReady", "analogReady",  "digitalReady",
+    "bmp280Ready",   "setupDone",    "first127488",  "first127489",
+    "first127505",   "firstSKDelta", "stateRestored",
+};
+
+// Setup stages are printed with the time since the previous stage, first
+// outputs with the time since the previous stage before them.
+bool IsStage(int event) {
+  return event < static_cast<int>(BootEvent::kFirst127488) ||
+         event == static_cast<int>(BootEvent::kStateRestored);
+}
+
+struct RtcTimeline {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;  // Number of valid records
+  uint32_t head;   // Index of the current boot's record
+  BootRecord records[BootTimeline::kHistorySize];
+  uint32_t crc;
+};
+
+// Not initialized on reset, so the previous boots survive a reboot.
+RTC_NOINIT_ATTR RtcTimeline rtc_timeline;
+
+uint32_t ComputeCRC() {
+  return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&rtc_timeline),
+                          offsetof(RtcTimeline, crc));
+}
+
+}  // namespace
+
+BootTimeline* BootTimeline::get() {
+  static BootTimeline timeline;
+  return &timeline;
+}
+
+const char* BootTimeline::event_name(BootEvent event) {
+  return kEventNames[static_cast<int>(event)];
+}
+
+void BootTimeline::begin(const char* firmware_version) {
+  if (rtc_timeline.magic != kTimelineMagic || rtc_timeline.crc != ComputeCRC() ||
+      rtc_timeline.version != kTimelineVersion ||
+      rtc_timeline.count > kHistorySize || rtc_timeline.head >= kHistorySize) {
+    // Power-on, corrupted or another layout: start a fresh history
+    memset(&rtc_timeline, 0, sizeof(rtc_timeline));
+    rtc_timeline.magic = kTimelineMagic;
+    rtc_timeline.version = kTimelineVersion;
+  } else {
+    rtc_timeline.head = (rtc_timeline.head + 1) % kHistorySize;
+  }
+  if (rtc_timeline.count < kHistorySize) {
+    rtc_timeline.count++;
+  }
+
+  BootRecord* record = &rtc_timeline.records[rtc_timeline.head];
+  memset(record, 0, sizeof(*record));
+  strncpy(record->firmware_version, firmware_version,
+          sizeof(record->firmware_version) - 1);
+  record->reset_reason = esp_reset_reason();
+  rtc_timeline.crc = ComputeCRC();
+}
+
+void BootTimeline::mark(BootEvent event) {
+  BootRecord* record = &rtc_timeline.records[rtc_timeline.head];
+  uint32_t* event_us = &record->event_us[static_cast<int>(event)];
+  if (*event_us != 0) {
+    return;
+  }
+
+  int64_t now = esp_timer_get_time();
+  *event_us = now < 1 ? 1 : (now > UINT32_MAX ? UINT32_MAX : now);
+  rtc_timeline.crc = ComputeCRC();
+
+  if (!IsStage(static_cast<int>(event)) || event == BootEvent::kSetupDone) {
+    debugI("Boot: %s at %.1f ms", event_name(event), *event_us / 1000.);
+  }
+  if (event == BootEvent::kSetupDone) {
+    print();
+  }
+}
+
+const BootRecord* BootTimeline::current() const {
+  return &rtc_timeline.records[rtc_timeline.head];
+}
+
+const BootRecord* BootTimeline::previous(int age) const {
+  if (age < 1 || age >= static_cast<int>(rtc_timeline.count)) {
+    return nullptr;
+  }
+  int index = (rtc_timeline.head + kHistorySize - age) % kHistorySize;
+  return &rtc_timeline.records[index];
+}
+
+void BootTimeline::print() const {
+  const BootRecord* record = current();
+  const BootRecord* last = previous(1);
+
+  debugI("Boot timeline, firmware %s, reset reason %d",
+         record->firmware_version, record->reset_reason);
+  // In the order the events happened, which isn't the order of BootEvent
+  int order[kEventCount];
+  int count = 0;
+  for (int i = 0; i < kEventCount; i++) {
+    if (record->event_us[i] != 0) {
+      order[count++] = i;
+    }
+  }
+  std::sort(order, order + count, [record](int a, int b) {
+    return record->event_us[a] < record->event_us[b];
+  });
+
+  uint32_t previous_us = 0;
+  for (int n = 0; n < count; n++) {
+    int i = order[n];
+    uint32_t t = record->event_us[i];
+    if (last != nullptr && last->event_us[i] != 0) {
+      debugI("  %-13s %9.1f ms  (+%8.1f ms)  was %9.1f ms (%s)",
+             kEventNames[i], t / 1000., (t - previous_us) / 1000.,
+             last->event_us[i] / 1000., last->firmware_version);
+    } else {
+      debugI("  %-13s %9.1f ms  (+%8.1f ms)", kEventNames[i], t / 1000.,
+             (t - previous_us) / 1000.);
+    }
+    if (IsStage(i)) {
+      previous_us = t;
+    }
+  }
+}
+
+String BootTimeline::to_json() const {
+  JsonDocument doc;
+
+  auto add_record = [](JsonObject obj, const BootRecord* record) {
+    obj["firmware_version"] = record->firmware_version;
+    obj["reset_reason"] = record->reset_reason;
+    JsonObject events = obj["events_ms"].to<JsonObject>();
+    for (int i = 0; i < kEventCount; i++) {
+      if (record->event_us[i] != 0) {
+        events[kEventNames[i]] = record->event_us[i] / 1000.;
+      }
+    }
+  };
+
+  add_record(doc["current"].to<JsonObject>(), current());
+  JsonArray history = doc["previous"].to<JsonArray>();
+  for (int age = 1; previous(age) != nullptr; age++) {
+    add_record(history.add<JsonObject>(), previous(age));
+  }
+
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
+
+void BootTimeline::enable_reporting() {
+  // The first delta sent over the websocket completes the timeline.
+  sensesp::sensesp_app->get_ws_client()
+      ->get_delta_tx_count_producer()
+      .connect_to(new sensesp::LambdaConsumer<int>([this](int count) {
+        if (count > 0) {
+          mark(BootEvent::kFirstSKDelta);
+        }
+      }));
+
+  // Signal K values are only emitted periodically, and only once the event
+  // has happened.
+  static sensesp::SKOutputFloat* sk_outputs[kEventCount];
+  for (int i = 0; i < kEventCount; i++) {
+    char sk_path[60];
+    snprintf(sk_path, sizeof(sk_path), "sensors.halmet.boot.%s",
+             kEventNames[i]);
+    sk_outputs[i] = new sensesp::SKOutputFloat(
+        sk_path, "", new sensesp::SKMetadata("s", kEventNames[i]));
+  }
+  sensesp::event_loop()->onRepeat(10000, [this]() {
+    for (int i = 0; i < kEventCount; i++) {
+      uint32_t t = current()->event_us[i];
+      if (t != 0) {
+        sk_outputs[i]->set(t / 1e6);
+      }
+    }
+  });
+
+  auto handler = std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_GET, "/api/boot_timeline", [this](httpd_req_t* req) {
+        String json = to_json();
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_send(req, json.c_str(), json.length());
+        return ESP_OK;
+      });
+  sensesp::sensesp_app->get_http_server()->add_handler(handler);
+}
+
+}  // namespace halmet
@@ -0,0 +1,86 @@
+#ifndef HALMET_SRC_BOOT_TIMELINE_H_
+#define HALMET_SRC_BOOT_TIMELINE_H_
+
+#include <Arduino.h>
+
+namespace halmet {
+
+/// Boot stages and first outputs. The values index the records kept in RTC
+/// memory across OTA updates: append new events, never reorder them.
+enum class BootEvent : uint8_t {
+  kAppReady = 0,     // SensESPAppBuilder done, networking started
+  kI2CReady,         // TwoWire begin
+  kADS1115Ready,     // ADS1115 begin
+  kN2kOpen,          // NMEA2000 Open, before networking
+  kDisplayReady,     // InitializeSSD1306
+  kOneWireReady,     // 1-Wire discovery and sensor config loads
+  kAnalogReady,      // Analog chains and their config loads
+  kDigitalReady,     // Digital chains, N2K senders and their config loads
+  kBMP280Ready,      // BMP280 begin
+  kSetupDone,        // End of setup()
+  kFirst127488,      // First valid PGN 127488 sent
+  kFirst127489,      // First valid PGN 127489 sent
+  kFirst127505,      // First valid PGN 127505 sent
+  kFirstSKDelta,     // First Signal K delta sent
+  kStateRestored,    // Warm start snapshot restored, if there was one
+  kCount
+};
+
+/// Event slots per record. Events can be appended up to this number without
+/// changing the record layout.
+const int kMaxBootEvents = 24;
+static_assert(static_cast<int>(BootEvent::kCount) <= kMaxBootEvents,
+              "BootRecord has no slot for the new event");
+
+/**
+ * @brief Timestamps of a single boot, in microseconds since power-on or reset.
+ *
+ * A timestamp of zero means the event has not (yet) happened.
+ */
+struct BootRecord {
+  char firmware_version[16];
+  uint32_t reset_reason;
+  uint32_t event_us[kMaxBootEvents];
+};
+
+/**
+ * @brief Boot-phase tracer from power-on to the first valid outputs.
+ *
+ * The current boot and the previous ones are kept in RTC memory, which
+ * survives software and watchdog resets, so timelines of different firmware
+ * versions can be compared after an OTA update. Events a firmware version
+ * doesn't know are left zero in its records. A change of the record layout
+ * bumps its version, which starts a fresh history.
+ */
+class BootTimeline {
+ public:
+  static const int kHistorySize = 4;
+
+  static BootTimeline* get();
+
+  /// Start a new boot record. Call first thing in setup().
+  void begin(const char* firmware_version);
+
+  /// Record an event. Later calls for the same event are ignored.
+  void mark(BootEvent event);
+
+  bool is_marked(BootEvent event) const {
+    return current()->event_us[static_cast<int>(event)] != 0;
+  }
+
+  const BootRecord* current() const;
+  /// Previous boots, most recent first. Returns nullptr if not available.
+  const BootRecord* previous(int age) const;
+
+  void print() const;
+  String to_json() const;
+
+  static const char* event_name(BootEvent event);
+
+  /// Publish the timeline over Signal K and HTTP.
+  void enable_reporting();
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_BOOT_TIMELINE_H_
@@ -0,0 +1,297 @@
+#include "can_gateway.h"
+
+#include <lwip/sockets.h>
+#include <sys/time.h>
+
+#include "sensesp.h"
+
+namespace halmet {
+
+namespace {
+
+const char kHexDigits[] = "0123456789ABCDEF";
+
+// Longest YDRAW line: "hh:mm:ss.sss R 1FFFFFFF" + 8 * " XX" + "\r\n"
+const size_t kMaxLineLength = 23 + 8 * 3 + 2;
+
+// SocketCAN extended frame flag
+const uint32_t kCanEffFlag = 0x80000000;
+
+// Milliseconds since midnight UTC if the clock is set, else since boot
+uint32_t TimeOfDayMs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < 1000000000) {
+    return millis();
+  }
+  return (tv.tv_sec % 86400) * 1000 + tv.tv_usec / 1000;
+}
+
+char* WriteHex(char* out, uint32_t value, int digits) {
+  for (int i = digits - 1; i >= 0; i--) {
+    out[i] = kHexDigits[value & 0xf];
+    value >>= 4;
+  }
+  return out + digits;
+}
+
+char* WriteDecimal(char* out, uint32_t value, int digits) {
+  for (int i = digits - 1; i >= 0; i--) {
+    out[i] = '0' + value % 10;
+    value /= 10;
+  }
+  return out + digits;
+}
+
+}  // namespace
+
+CanGateway::CanGateway(const String& config_path)
+    : sensesp::FileSystemSaveable{config_path} {
+  load();
+}
+
+bool CanGateway::accept(uint32_t id) const {
+  if (num_sources_ > 0) {
+    uint8_t source = id & 0xff;
+    bool found = false;
+    for (int i = 0; i < num_sources_ && !found; i++) {
+      found = sources_[i] == source;
+    }
+    if (!found) {
+      return false;
+    }
+  }
+  if (num_pgns_ > 0) {
+    uint32_t pgn = (id >> 8) & 0x3ffff;
+    if (((pgn >> 8) & 0xff) < 240) {
+      // PDU1: the low byte is the destination address
+      pgn &= 0x3ff00;
+    }
+    for (int i = 0; i < num_pgns_; i++) {
+      if (pgns_[i] == pgn) {
+        return true;
+      }
+    }
+    return false;
+  }
+  return true;
+}
+
+void CanGateway::frame(uint32_t id, uint8_t len, const uint8_t* data,
+                       bool transmitted) {
+  if (ring_ == nullptr) {
+    return;
+  }
+  frames_++;
+  if (!accept(id)) {
+    filtered_++;
+    return;
+  }
+  if (head_ - tail_ >= kRingSize) {
+    dropped_++;
+    return;
+  }
+  Frame& frame = ring_[head_ % kRingSize];
+  frame.time_ms = TimeOfDayMs();
+  frame.id = id & 0x1fffffff;
+  frame.len = std::min<uint8_t>(len, 8);
+  frame.transmitted = transmitted;
+  memcpy(frame.data, data, frame.len);
+  head_++;
+}
+
+size_t CanGateway::format(const Frame& frame, char* buffer) const {
+  if (format_ == Format::kBinary) {
+    uint32_t can_id = frame.id | kCanEffFlag;
+    memcpy(buffer, &can_id, 4);
+    buffer[4] = frame.len;
+    memset(buffer + 5, 0, 11);
+    memcpy(buffer + 8, frame.data, frame.len);
+    return 16;
+  }
+
+  char* out = buffer;
+  uint32_t ms = frame.time_ms % 86400000;
+  out = WriteDecimal(out, ms / 3600000, 2);
+  *out++ = ':';
+  out = WriteDecimal(out, ms / 60000 % 60, 2);
+  *out++ = ':';
+  out = WriteDecimal(out, ms / 1000 % 60, 2);
+  *out++ = '.';
+  out = WriteDecimal(out, ms % 1000, 3);
+  *out++ = ' ';
+  *out++ = frame.transmitted ? 'T' : 'R';
+  *out++ = ' ';
+  out = WriteHex(out, frame.id, 8);
+  for (int i = 0; i < frame.len; i++) {
+    *out++ = ' ';
+    out = WriteHex(out, frame.data[i], 2);
+  }
+  *out++ = '\r';
+  *out++ = '\n';
+  return out - buffer;
+}
+
+void CanGateway::start(PowerManager* power_manager) {
+  if (!enabled_) {
+    return;
+  }
+  // All buffers are allocated once here
+  ring_ = new Frame[kRingSize];
+  buffer_ = new char[kBufferSize];
+
+  if (udp_) {
+    udp_socket_ = new WiFiUDP();
+  } else {
+    server_ = new WiFiServer(port_);
+    server_->begin();
+    server_->setNoDelay(true);
+  }
+
+  power_manager->repeat(5, [this]() { this->drain(); });
+  sensesp::event_loop()->onRepeat(60000, [this]() { this->report(); });
+
+  debugI("CAN gateway: %s port %u, %s format", udp_ ? "UDP" : "TCP", port_,
+         format_ == Format::kBinary ? "binary" : "YDRAW");
+}
+
+void CanGateway::drain() {
+  if (!udp_) {
+    if (server_->hasClient()) {
+      // A new client replaces the old one
+      if (client_.connected()) {
+        client_.stop();
+      }
+      client_ = server_->available();
+      buffer_length_ = 0;
+      buffer_sent_ = 0;
+      tail_ = head_;
+      debugI("CAN gateway client %s connected",
+             client_.remoteIP().toString().c_str());
+    }
+    if (!client_.connected()) {
+      // Nobody listening; don't let the ring fill up
+      tail_ = head_;
+      return;
+    }
+  }
+
+  // Finish sending the previous buffer before formatting more
+  while (flush()) {
+    if (tail_ == head_) {
+      return;
+    }
+    size_t max_length = format_ == Format::kBinary ? 16 : kMaxLineLength;
+    while (tail_ != head_ && buffer_length_ + max_length <= kBufferSize) {
+      buffer_length_ +=
+          format(ring_[tail_ % kRingSize], buffer_ + buffer_length_);
+      tail_++;
+      sent_++;
+    }
+  }
+}
+
+bool CanGateway::flush() {
+  if (buffer_sent_ == buffer_length_) {
+    buffer_length_ = 0;
+    buffer_sent_ = 0;
+    return true;
+  }
+
+  if (udp_) {
+    udp_socket_->beginPacket(udp_host_.c_str(), port_);
+    udp_socket_->write(reinterpret_cast<const uint8_t*>(buffer_),
+                       buffer_length_);
+    udp_socket_->endPacket();
+    buffer_length_ = 0;
+    buffer_sent_ = 0;
+    return true;
+  }
+
+  // Write what the socket takes without blocking; the rest waits for the
+  // next drain.
+  int sent = send(client_.fd(), buffer_ + buffer_sent_,
+                  buffer_length_ - buffer_sent_, MSG_DONTWAIT);
+  if (sent < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      debugW("CAN gateway client disconnected");
+      client_.stop();
+    }
+    return false;
+  }
+  buffer_sent_ += sent;
+  if (buffer_sent_ < buffer_length_) {
+    return false;
+  }
+  buffer_length_ = 0;
+  buffer_sent_ = 0;
+  return true;
+}
+
+void CanGateway::report() {
+  debugD("CAN gateway: %u frames/min, %u filtered, %u sent, %u dropped",
+         frames_, filtered_, sent_, dropped_);
+  frames_ = 0;
+  filtered_ = 0;
+  sent_ = 0;
+  dropped_ = 0;
+}
+
+bool CanGateway::from_json(const JsonObject& config) {
+  if (!config["enabled"].is<bool>()) {
+    return false;
+  }
+  enabled_ = config["enabled"];
+  udp_ = config["protocol"] == "udp";
+  port_ = config["port"] | 1457;
+  udp_host_ = config["udp_host"] | "255.255.255.255";
+  format_ = config["format"] == "binary" ? Format::kBinary : Format::kYdRaw;
+
+  num_pgns_ = 0;
+  for (JsonVariant pgn : config["pgns"].as<JsonArray>()) {
+    if (num_pgns_ < kMaxFilters) {
+      pgns_[num_pgns_++] = pgn.as<uint32_t>();
+    }
+  }
+  num_sources_ = 0;
+  for (JsonVariant source : config["sources"].as<JsonArray>()) {
+    if (num_sources_ < kMaxFilters) {
+      sources_[num_sources_++] = source.as<uint8_t>();
+    }
+  }
+  return true;
+}
+
+bool CanGateway::to_json(JsonObject& config) {
+  config["enabled"] = enabled_;
+  config["protocol"] = udp_ ? "udp" : "tcp";
+  config["port"] = port_;
+  config["udp_host"] = udp_host_;
+  config["format"] = format_ == Format::kBinary ? "binary" : "ydraw";
+  JsonArray pgns = config["pgns"].to<JsonArray>();
+  for (int i = 0; i < num_pgns_; i++) {
+    pgns.add(pgns_[i]);
+  }
+  JsonArray sources = config["sources"].to<JsonArray>();
+  for (int i = 0; i < num_sources_; i++) {
+    sources.add(sources_[i]);
+  }
+  return true;
+}
+
+const String ConfigSchema(const CanGateway& obj) {
+  return R"###({
+    "type": "object",
+    "properties": {
+      "enabled": { "title": "Enabled", "type": "boolean", "description": "Stream all CAN frames to the network" },
+      "protocol": { "title": "Protocol", "type": "string", "enum": ["tcp", "udp"], "description": "TCP server or UDP datagrams" },
+      "port": { "title": "Port", "type": "integer", "description": "TCP server port, or UDP destination port" },
+      "udp_host": { "title": "UDP host", "type": "string", "description": "UDP destination address" },
+      "format": { "title": "Format", "type": "string", "enum": ["ydraw", "binary"], "description": "YDRAW text or SocketCAN binary frames" },
+      "pgns": { "title": "PGN filter", "type": "array", "items": { "type": "integer" }, "description": "Only stream these PGNs. Empty for all." },
+      "sources": { "title": "Source filter", "type": "array", "items": { "type": "integer" }, "description": "Only stream frames from these source addresses. Empty for all." }
+    }
+  })###";
+}
+
+}  // namespace halmet
@@ -0,0 +1,106 @@
+#ifndef HALMET_SRC_CAN_GATEWAY_H_
+#define HALMET_SRC_CAN_GATEWAY_H_
+
+#include <Arduino.h>
+#include <WiFiServer.h>
+#include <WiFiUdp.h>
+
+#include "config_store.h"
+#include "power_manager.h"
+#include "sensesp/system/saveable.h"
+
+namespace halmet {
+
+/**
+ * @brief Stream raw CAN frames over TCP or UDP, like a USB N2K gateway.
+ *
+ * Every frame received or sent by the node is passed to frame() from the
+ * CAN driver, filtered by PGN and source, and copied into a preallocated
+ * ring. The event loop drains the ring every 5 ms, stretched by the power
+ * manager with the engines off, into a preallocated send buffer in one of
+ * two formats:
+ *
+ * - YDRAW text: "hh:mm:ss.sss R 19F51323 01 02 03 04 05 06 07 08\r\n", with
+ *   R for received and T for transmitted frames.
+ * - Binary: Linux SocketCAN struct can_frame, 16 bytes per frame.
+ *
+ * In TCP mode one client is served at a time. The socket is written
+ * without blocking; while the client can't keep up, frames stay in the
+ * ring, and frames that don't fit in the ring are dropped and counted. In
+ * UDP mode the frames are sent as datagrams to the configured host.
+ */
+class CanGateway : public sensesp::FileSystemSaveable {
+ public:
+  enum class Format { kYdRaw, kBinary };
+
+  CanGateway(const String& config_path);
+
+  bool is_enabled() const { return enabled_; }
+
+  /// Queue a frame. Called from the CAN driver on the event loop task.
+  void frame(uint32_t id, uint8_t len, const uint8_t* data, bool transmitted);
+
+  /// Open the socket and start draining the ring
+  void start(PowerManager* power_manager);
+
+  virtual bool from_json(const JsonObject& config) override;
+  virtual bool to_json(JsonObject& config) override;
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+ protected:
+  static const int kRingSize = 256;  // Frames, a power of two
+  static const int kBufferSize = 1400;
+  static const int kMaxFilters = 16;
+
+  struct Frame {
+    uint32_t time_ms;  // Since midnight UTC, or since boot if not set
+    uint32_t id;
+    uint8_t len;
+    bool transmitted;
+    uint8_t data[8];
+  };
+
+  bool accept(uint32_t id) const;
+  size_t format(const Frame& frame, char* buffer) const;
+  void drain();
+  bool flush();
+  void report();
+
+  bool enabled_ = false;
+  bool udp_ = false;
+  uint16_t port_ = 1457;
+  String udp_host_ = "255.255.255.255";
+  Format format_ = Format::kYdRaw;
+  uint32_t pgns_[kMaxFilters];
+  int num_pgns_ = 0;
+  uint8_t sources_[kMaxFilters];
+  int num_sources_ = 0;
+
+  Frame* ring_ = nullptr;
+  uint32_t head_ = 0;  // Next frame to write
+  uint32_t tail_ = 0;  // Next frame to send
+  char* buffer_ = nullptr;
+  size_t buffer_length_ = 0;
+  size_t buffer_sent_ = 0;
+
+  WiFiServer* server_ = nullptr;
+  WiFiClient client_;
+  WiFiUDP* udp_socket_ = nullptr;
+
+  uint32_t frames_ = 0;
+  uint32_t filtered_ = 0;
+  uint32_t sent_ = 0;
+  uint32_t dropped_ = 0;
+};
+
+const String ConfigSchema(const CanGateway& obj);
+
+inline bool ConfigRequiresRestart(const CanGateway& obj) { return true; }
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_CAN_GATEWAY_H_
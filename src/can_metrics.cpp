@@ -0,0 +1,238 @@
+#include "can_metrics.h"
+
+#include <soc/twai_struct.h>
+
+#include "sensesp.h"
+
+namespace halmet {
+
+namespace {
+
+// Controller register bits, as in the SJA1000
+const uint32_t kModeReset = 1 << 0;
+const uint32_t kStatusError = 1 << 6;
+const uint32_t kStatusBusOff = 1 << 7;
+const uint32_t kErrorPassiveCount = 128;
+
+const uint32_t kBitRate = 250000;
+
+// Bits of an extended frame without stuff bits: SOF, arbitration, control,
+// CRC, ACK, EOF and interframe space, plus the data
+uint32_t FrameBits(uint8_t len) {
+  uint32_t bits = 67 + 8 * len;
+  // About one stuff bit per ten bits of the stuffed part on a real bus
+  return bits + (bits - 13) / 10;
+}
+
+// Attached for PGN 0, which the stack hands every message, so that the
+// single SetMsgHandler() slot stays free for the application
+class MessageCounter : public tNMEA2000::tMsgHandler {
+ public:
+  MessageCounter() : tNMEA2000::tMsgHandler(0) {}
+
+  virtual void HandleMsg(const tN2kMsg& msg) override {
+    CanMetrics::get()->message_received(msg.PGN);
+  }
+};
+
+}  // namespace
+
+CanMetrics* CanMetrics::get() {
+  static CanMetrics metrics;
+  return &metrics;
+}
+
+const char* CanMetrics::state_name(CanBusState state) {
+  switch (state) {
+    case CanBusState::kErrorActive:
+      return "active";
+    case CanBusState::kErrorWarning:
+      return "warning";
+    case CanBusState::kErrorPassive:
+      return "passive";
+    case CanBusState::kBusOff:
+      return "busOff";
+  }
+  return "";
+}
+
+void CanMetrics::start(tNMEA2000* nmea2000, PowerManager* power_manager) {
+  nmea2000_ = nmea2000;
+  static MessageCounter message_counter;
+  nmea2000_->AttachMsgHandler(&message_counter);
+  last_rx_ms_ = millis();
+  last_tx_ms_ = millis();
+  sk_output_ = new sensesp::SKOutputRawJson("sensors.halmet.can");
+
+  power_manager->repeat(100, [this]() { poll(); });
+  sensesp::event_loop()->onRepeat(kReportIntervalMs, [this]() { report(); });
+}
+
+void CanMetrics::frame_sent(uint8_t len, uint16_t send_buffer_used) {
+  interval_.frames_sent++;
+  interval_.bits += FrameBits(len);
+  interval_.send_buffer_peak =
+      std::max(interval_.send_buffer_peak, send_buffer_used);
+  last_tx_ms_ = millis();
+}
+
+void CanMetrics::frame_received(uint8_t len) {
+  interval_.frames_received++;
+  interval_.bits += FrameBits(len);
+  receive_backlog_++;
+  last_rx_ms_ = millis();
+}
+
+void CanMetrics::messages_parsed() {
+  interval_.receive_backlog_peak =
+      std::max(interval_.receive_backlog_peak, receive_backlog_);
+  receive_backlog_ = 0;
+}
+
+CanMetrics::PgnCounters* CanMetrics::find_pgn(uint32_t pgn) {
+  // A handful of PGNs, so a linear search beats hashing
+  for (int i = 0; i < num_pgns_; i++) {
+    if (pgns_[i].pgn == pgn) {
+      return &pgns_[i];
+    }
+  }
+  if (num_pgns_ < kMaxPgns) {
+    pgns_[num_pgns_] = {pgn, 0, 0};
+    return &pgns_[num_pgns_++];
+  }
+  return &other_pgns_;
+}
+
+void CanMetrics::message_sent(uint32_t pgn, bool sent) {
+  if (sent) {
+    interval_.messages_sent++;
+    find_pgn(pgn)->sent++;
+  } else {
+    interval_.send_failures++;
+  }
+}
+
+void CanMetrics::message_received(uint32_t pgn) {
+  interval_.messages_received++;
+  find_pgn(pgn)->received++;
+}
+
+void CanMetrics::poll() {
+  uint32_t status = TWAI.status_reg.val;
+  uint32_t tx_errors = TWAI.tx_error_counter_reg.val & 0xff;
+  uint32_t rx_errors = TWAI.rx_error_counter_reg.val & 0xff;
+
+  CanBusState state = CanBusState::kErrorActive;
+  if (status & kStatusBusOff) {
+    state = CanBusState::kBusOff;
+  } else if (tx_errors >= kErrorPassiveCount ||
+             rx_errors >= kErrorPassiveCount) {
+    state = CanBusState::kErrorPassive;
+  } else if (status & kStatusError) {
+    state = CanBusState::kErrorWarning;
+  }
+
+  uint32_t now = millis();
+  if (state != state_) {
+    if (state == CanBusState::kBusOff) {
+      bus_off_count_++;
+      bus_off_ms_ = now;
+      debugW("CAN bus-off (TX errors %u, RX errors %u)", tx_errors,
+             rx_errors);
+    } else if (state == CanBusState::kErrorPassive &&
+               state_ < CanBusState::kErrorPassive) {
+      error_passive_count_++;
+      debugW("CAN error-passive (TX errors %u, RX errors %u)", tx_errors,
+             rx_errors);
+    }
+    if (state == CanBusState::kErrorActive && bus_off_ms_ != 0) {
+      recovery_time_ = (now - bus_off_ms_) / 1000.0f;
+      bus_off_ms_ = 0;
+      debugI("CAN bus recovered after %.1f s", recovery_time_);
+    }
+    state_ = state;
+  }
+
+  // The controller stays in reset mode after a bus-off. Restarting it
+  // starts the recovery, which completes after 128 idle periods on the bus.
+  if (state_ == CanBusState::kBusOff && now - bus_off_ms_ >= kBusOffRestartMs &&
+      now - last_restart_ms_ >= kBusOffRestartMs &&
+      (TWAI.mode_reg.val & kModeReset)) {
+    TWAI.mode_reg.val = TWAI.mode_reg.val & ~kModeReset;
+    restart_count_++;
+    last_restart_ms_ = now;
+    debugW("CAN bus-off for %u ms, restarting the controller",
+           now - bus_off_ms_);
+  }
+}
+
+void CanMetrics::report() {
+  if (nmea2000_->ReadResetAddressChanged()) {
+    address_changes_++;
+  }
+
+  const Counters& c = interval_;
+  float seconds = kReportIntervalMs / 1000.0f;
+  float bus_load = c.bits / (kBitRate * seconds);
+
+  char recovery_time[16];
+  if (isnan(recovery_time_)) {
+    strcpy(recovery_time, "null");
+  } else {
+    snprintf(recovery_time, sizeof(recovery_time), "%.1f", recovery_time_);
+  }
+
+  // {"<pgn>":{"tx":<rate>,"rx":<rate>},...,"other":{...}}
+  char pgn_rates[48 * (kMaxPgns + 1) + 2];
+  int length = snprintf(pgn_rates, sizeof(pgn_rates), "{");
+  for (int i = 0; i <= num_pgns_; i++) {
+    PgnCounters& pgn = i < num_pgns_ ? pgns_[i] : other_pgns_;
+    char key[12];
+    if (i < num_pgns_) {
+      snprintf(key, sizeof(key), "%u", pgn.pgn);
+    } else {
+      strcpy(key, "other");
+    }
+    length += snprintf(pgn_rates + length, sizeof(pgn_rates) - length,
+                       "%s\"%s\":{\"tx\":%.1f,\"rx\":%.1f}",
+                       i > 0 ? "," : "", key, pgn.sent / seconds,
+                       pgn.received / seconds);
+    pgn.sent = 0;
+    pgn.received = 0;
+  }
+  snprintf(pgn_rates + length, sizeof(pgn_rates) - length, "}");
+
+  char json[400 + sizeof(pgn_rates)];
+  snprintf(json, sizeof(json),
+           "{\"txFrameRate\":%.1f,\"rxFrameRate\":%.1f,"
+           "\"txMessageRate\":%.1f,\"rxMessageRate\":%.1f,"
+           "\"sendFailures\":%u,\"framesRejected\":%u,"
+           "\"sendBufferPeak\":%u,\"receiveBacklogPeak\":%u,"
+           "\"busLoad\":%.3f,\"state\":\"%s\",\"errorPassiveCount\":%u,"
+           "\"busOffCount\":%u,\"restartCount\":%u,\"recoveryTime\":%s,"
+           "\"sourceAddress\":%u,\"addressChanges\":%u,\"pgnRates\":%s}",
+           c.frames_sent / seconds, c.frames_received / seconds,
+           c.messages_sent / seconds, c.messages_received / seconds,
+           c.send_failures, c.frames_rejected, c.send_buffer_peak,
+           c.receive_backlog_peak, bus_load, state_name(state_),
+           error_passive_count_, bus_off_count_, restart_count_,
+           recovery_time, nmea2000_->GetN2kSource(), address_changes_,
+           pgn_rates);
+  sk_output_->set(json);
+
+  debugD("CAN: TX %u, RX %u frames, %u send failures, load %.1f%%",
+         c.frames_sent, c.frames_received, c.send_failures, bus_load * 100);
+
+  char line[22];
+  if (time_since_rx() > kReportIntervalMs) {
+    snprintf(line, sizeof(line), "%s no RX", state_name(state_));
+  } else {
+    snprintf(line, sizeof(line), "%s %.0f%% %.0f/s", state_name(state_),
+             bus_load * 100, c.frames_received / seconds);
+  }
+  summary.set(line);
+
+  interval_ = Counters();
+}
+
+}  // namespace halmet
@@ -0,0 +1,129 @@
+#ifndef HALMET_SRC_CAN_METRICS_H_
+#define HALMET_SRC_CAN_METRICS_H_
+
+#include <Arduino.h>
+#include <NMEA2000.h>
+
+#include "power_manager.h"
+#include "sensesp/signalk/signalk_output.h"
+#include "sensesp/system/observablevalue.h"
+
+namespace halmet {
+
+/// Error state of the CAN controller, from best to worst
+enum class CanBusState : uint8_t {
+  kErrorActive = 0,
+  kErrorWarning,  // An error counter at 96 or above
+  kErrorPassive,  // An error counter at 128 or above
+  kBusOff,
+};
+
+/**
+ * @brief CAN bus and NMEA 2000 stack health.
+ *
+ * The driver reports every frame and the senders every message; each report
+ * is a few counter increments on the event loop task. The controller status
+ * register is polled every 100 ms for error-passive and bus-off transitions,
+ * stretched by the power manager with the engines off.
+ *
+ * The ESP32 controller puts itself in reset mode on bus-off and stays off
+ * the bus until it is restarted. If bus-off lasts longer than
+ * kBusOffRestartMs, the watchdog restarts the controller, which then goes
+ * through the bus-off recovery sequence of the CAN standard. The time from
+ * bus-off to error-active again is reported as the recovery time.
+ *
+ * Every 10 s, the frame and message rates, send failures, buffer
+ * high-water marks and estimated bus load of the last interval are
+ * published to sensors.halmet.can, and a short summary is emitted for the
+ * display. Message rates are also given per PGN, for the first kMaxPgns
+ * PGNs seen; the messages of any others are counted under "other".
+ */
+class CanMetrics {
+ public:
+  static const uint32_t kReportIntervalMs = 10000;
+  static const uint32_t kBusOffRestartMs = 1000;
+  static const int kMaxPgns = 16;
+
+  static CanMetrics* get();
+
+  /// Start polling and reporting. Call after nmea2000->Open(). Received
+  /// messages are counted by a handler attached for all PGNs; the
+  /// stack's SetMsgHandler() is left to the application.
+  void start(tNMEA2000* nmea2000, PowerManager* power_manager);
+
+  /// A frame was handed to the controller, with the frames then waiting in
+  /// the stack's send buffer
+  void frame_sent(uint8_t len, uint16_t send_buffer_used);
+  /// The controller queue was full. The stack keeps the frame and retries.
+  void frame_rejected() { interval_.frames_rejected++; }
+  void frame_received(uint8_t len);
+  /// Call after each ParseMessages(), which drains the receive queue
+  void messages_parsed();
+
+  void message_sent(uint32_t pgn, bool sent);
+  void message_received(uint32_t pgn);
+
+  CanBusState get_state() const { return state_; }
+  uint32_t time_since_rx() const { return millis() - last_rx_ms_; }
+  uint32_t time_since_tx() const { return millis() - last_tx_ms_; }
+
+  /// One-line summary for the display, updated with every report
+  sensesp::ObservableValue<String> summary;
+
+  static const char* state_name(CanBusState state);
+
+ protected:
+  struct Counters {
+    uint32_t frames_sent = 0;
+    uint32_t frames_received = 0;
+    uint32_t frames_rejected = 0;
+    uint32_t messages_sent = 0;
+    uint32_t messages_received = 0;
+    uint32_t send_failures = 0;
+    uint32_t bits = 0;
+    uint16_t send_buffer_peak = 0;
+    uint16_t receive_backlog_peak = 0;
+  };
+
+  struct PgnCounters {
+    uint32_t pgn;
+    uint32_t sent;
+    uint32_t received;
+  };
+
+  /// Counters of pgn, or of "other" if the table is full
+  PgnCounters* find_pgn(uint32_t pgn);
+  void poll();
+  void report();
+
+  tNMEA2000* nmea2000_ = nullptr;
+  sensesp::SKOutputRawJson* sk_output_ = nullptr;
+  Counters interval_;
+  // Kept across intervals, with the counts reset by each report
+  PgnCounters pgns_[kMaxPgns];
+  int num_pgns_ = 0;
+  PgnCounters other_pgns_ = {};
+  uint16_t receive_backlog_ = 0;
+  uint32_t last_rx_ms_ = 0;
+  uint32_t last_tx_ms_ = 0;
+
+  CanBusState state_ = CanBusState::kErrorActive;
+  uint32_t error_passive_count_ = 0;
+  uint32_t bus_off_count_ = 0;
+  uint32_t restart_count_ = 0;
+  uint32_t bus_off_ms_ = 0;  // Start of the current bus-off
+  uint32_t last_restart_ms_ = 0;
+  float recovery_time_ = NAN;  // Of the last bus-off, in s
+  uint32_t address_changes_ = 0;
+};
+
+/// tNMEA2000::SendMsg(), counted in the CAN metrics
+inline bool SendN2kMsg(tNMEA2000* nmea2000, const tN2kMsg& msg) {
+  bool sent = nmea2000->SendMsg(msg);
+  CanMetrics::get()->message_sent(msg.PGN, sent);
+  return sent;
+}
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_CAN_METRICS_H_
@@ -0,0 +1,384 @@
+#include "channel_logger.h"
+
+#include <ArduinoJson.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/net/http_server.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp_app.h"
+
+namespace halmet {
+
+namespace {
+
+// "HCLC" in little endian
+const uint32_t kChunkMagic = 0x434c4348;
+const char kStreamMagic[4] = {'H', 'C', 'L', '1'};
+
+const uint32_t kSectorSize = 4096;
+
+// Quantized values are clamped so that a delta, zigzag encoded and shifted
+// left by the valid bit, always fits a 5 byte varint.
+const int32_t kMaxQuantized = 1 << 28;
+
+uint8_t* WriteVarint(uint8_t* p, uint32_t value) {
+  while (value >= 0x80) {
+    *p++ = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  *p++ = value;
+  return p;
+}
+
+uint32_t Padded(uint32_t length) { return (length + 3) & ~3; }
+
+}  // namespace
+
+ChannelLogger::ChannelLogger(unsigned int sample_interval_ms,
+                             const char* partition_label)
+    : sample_interval_ms_{sample_interval_ms} {
+  partition_ = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+  if (partition_ == nullptr) {
+    debugW("No %s partition; channel logging disabled", partition_label);
+  }
+}
+
+void ChannelLogger::add_channel(const char* name, float scale,
+                                sensesp::FloatProducer* producer) {
+  if (num_channels_ >= kMaxChannels) {
+    debugE("Too many logger channels, %s not logged", name);
+    return;
+  }
+  Channel* channel = &channels_[num_channels_++];
+  channel->name = name;
+  channel->scale = scale;
+  channel->latest = 0;
+  channel->valid = false;
+  producer->connect_to(
+      ArenaNew<sensesp::LambdaConsumer<float>>([channel](float value) {
+        channel->latest = value;
+        channel->valid = !isnan(value);
+      }));
+}
+
+void ChannelLogger::add_channel(const char* name,
+                                sensesp::BoolProducer* producer) {
+  if (num_channels_ >= kMaxChannels) {
+    debugE("Too many logger channels, %s not logged", name);
+    return;
+  }
+  Channel* channel = &channels_[num_channels_++];
+  channel->name = name;
+  channel->scale = 1;
+  channel->latest = 0;
+  channel->valid = false;
+  producer->connect_to(
+      ArenaNew<sensesp::LambdaConsumer<bool>>([channel](bool value) {
+        channel->latest = value;
+        channel->valid = true;
+      }));
+}
+
+bool ChannelLogger::start() {
+  if (partition_ == nullptr || num_channels_ == 0) {
+    return false;
+  }
+
+  find_write_position();
+
+  queue_ = xQueueCreate(2, sizeof(Block*));
+  xTaskCreate(writer_task, "channel_logger", 4096, this, tskIDLE_PRIORITY + 1,
+              nullptr);
+
+  started_ms_ = millis();
+  sensesp::event_loop()->onRepeat(sample_interval_ms_,
+                                  [this]() { this->sample(); });
+
+  sensesp::event_loop()->onRepeat(600000, [this]() {
+    debugI("Channel log: compression %.1fx, %.1f bytes/s, max sample %u us, "
+           "%u chunks dropped",
+           get_compression_ratio(), get_write_rate(), max_sample_us_,
+           dropped_chunks_);
+  });
+
+  register_http_handlers();
+
+  debugI("Logging %d channels every %u ms to %s at offset %u", num_channels_,
+         sample_interval_ms_, partition_->label, write_offset_);
+  return true;
+}
+
+void ChannelLogger::sample() {
+  int64_t start_us = esp_timer_get_time();
+
+  Block* block = &blocks_[active_block_];
+  if (row_ == 0) {
+    block->start_ms = millis();
+  }
+
+  uint32_t valid = 0;
+  for (int i = 0; i < num_channels_; i++) {
+    const Channel& channel = channels_[i];
+    int32_t value = 0;
+    if (channel.valid) {
+      value = constrain(lroundf(channel.latest * channel.scale),
+                        -kMaxQuantized, kMaxQuantized);
+      valid |= 1 << i;
+    }
+    block->values[row_][i] = value;
+  }
+  block->valid[row_] = valid;
+
+  if (++row_ == kRowsPerChunk) {
+    row_ = 0;
+    int next_block = active_block_ ^ 1;
+    if (block_busy_[next_block]) {
+      // The writer is still busy with the previous block. Overwrite this one
+      // rather than stalling the event loop.
+      dropped_chunks_++;
+    } else {
+      block_busy_[active_block_] = true;
+      xQueueSend(queue_, &block, 0);
+      active_block_ = next_block;
+    }
+  }
+
+  uint32_t elapsed_us = esp_timer_get_time() - start_us;
+  if (elapsed_us > max_sample_us_) {
+    max_sample_us_ = elapsed_us;
+  }
+}
+
+size_t ChannelLogger::encode(const Block& block, uint8_t* out) const {
+  ChunkHeader* header = reinterpret_cast<ChunkHeader*>(out);
+  uint8_t* payload = out + sizeof(ChunkHeader);
+  uint8_t* p = payload;
+
+  // Column by column, so that each channel's slowly varying deltas sit next
+  // to each other. A missing value repeats the previous one with the valid
+  // bit cleared, which costs one byte.
+  for (int i = 0; i < num_channels_; i++) {
+    int32_t previous = 0;
+    for (int row = 0; row < kRowsPerChunk; row++) {
+      bool valid = block.valid[row] & (1 << i);
+      int32_t value = valid ? block.values[row][i] : previous;
+      int32_t delta = value - previous;
+      uint32_t zigzag = (static_cast<uint32_t>(delta) << 1) ^
+                        static_cast<uint32_t>(delta >> 31);
+      p = WriteVarint(p, (zigzag << 1) | valid);
+      previous = value;
+    }
+  }
+
+  header->magic = kChunkMagic;
+  header->sequence = sequence_;
+  header->start_ms = block.start_ms;
+  header->sample_interval_ms = sample_interval_ms_;
+  header->rows = kRowsPerChunk;
+  header->channels = num_channels_;
+  header->length = p - payload;
+  header->reserved = 0;
+  header->crc = esp_rom_crc32_le(0, payload, header->length);
+
+  size_t length = p - out;
+  // Pad with erased flash so that the next chunk stays word aligned
+  while (length % 4 != 0) {
+    out[length++] = 0xff;
+  }
+  return length;
+}
+
+void ChannelLogger::write_chunk(const Block& block) {
+  size_t length = encode(block, chunk_buffer_);
+
+  // Chunks don't span sectors, so that each sector can be erased and read
+  // on its own.
+  uint32_t sector_offset = write_offset_ % kSectorSize;
+  if (sector_offset != 0 && sector_offset + length > kSectorSize) {
+    write_offset_ += kSectorSize - sector_offset;
+  }
+  if (write_offset_ + length > partition_->size) {
+    write_offset_ = 0;
+  }
+  if (write_offset_ % kSectorSize == 0) {
+    // Erasing takes tens of ms, which is why this runs in its own task
+    esp_partition_erase_range(partition_, write_offset_, kSectorSize);
+  }
+
+  esp_err_t err =
+      esp_partition_write(partition_, write_offset_, chunk_buffer_, length);
+  if (err != ESP_OK) {
+    debugE("Channel log write failed at %u: %d", write_offset_, err);
+    return;
+  }
+  write_offset_ += length;
+  sequence_++;
+
+  chunks_written_++;
+  raw_bytes_ += kRowsPerChunk * num_channels_ * sizeof(int32_t);
+  encoded_bytes_ += length;
+}
+
+void ChannelLogger::writer_task(void* arg) {
+  auto self = static_cast<ChannelLogger*>(arg);
+  while (true) {
+    Block* block;
+    if (xQueueReceive(self->queue_, &block, portMAX_DELAY) == pdTRUE) {
+      self->write_chunk(*block);
+      self->block_busy_[block - self->blocks_] = false;
+    }
+  }
+}
+
+bool ChannelLogger::read_chunk_header(uint32_t offset,
+                                      ChunkHeader* header) const {
+  if (offset % kSectorSize + sizeof(ChunkHeader) > kSectorSize ||
+      esp_partition_read(partition_, offset, header, sizeof(ChunkHeader)) !=
+          ESP_OK) {
+    return false;
+  }
+  return header->magic == kChunkMagic &&
+         offset % kSectorSize + sizeof(ChunkHeader) + header->length <=
+             kSectorSize;
+}
+
+void ChannelLogger::find_write_position() {
+  // The sector holding the highest sequence number is the one last written
+  // to. Continue after its last chunk.
+  uint32_t num_sectors = partition_->size / kSectorSize;
+  bool found = false;
+  uint32_t newest_sector = 0;
+  uint32_t newest_sequence = 0;
+  for (uint32_t sector = 0; sector < num_sectors; sector++) {
+    ChunkHeader header;
+    if (read_chunk_header(sector * kSectorSize, &header) &&
+        (!found || static_cast<int32_t>(header.sequence -
+                                        newest_sequence) > 0)) {
+      found = true;
+      newest_sector = sector;
+      newest_sequence = header.sequence;
+    }
+  }
+
+  if (!found) {
+    write_offset_ = 0;
+    sequence_ = 0;
+    return;
+  }
+
+  uint32_t offset = newest_sector * kSectorSize;
+  ChunkHeader header;
+  while (offset < (newest_sector + 1) * kSectorSize &&
+         read_chunk_header(offset, &header)) {
+    sequence_ = header.sequence + 1;
+    offset += Padded(sizeof(ChunkHeader) + header.length);
+  }
+  write_offset_ = offset;
+}
+
+float ChannelLogger::get_compression_ratio() const {
+  return encoded_bytes_ == 0 ? 0 : static_cast<float>(raw_bytes_) /
+                                       encoded_bytes_;
+}
+
+float ChannelLogger::get_write_rate() const {
+  unsigned long elapsed_ms = millis() - started_ms_;
+  return elapsed_ms == 0 ? 0 : encoded_bytes_ * 1000.0f / elapsed_ms;
+}
+
+String ChannelLogger::stats_to_json() const {
+  JsonDocument doc;
+  doc["sample_interval_ms"] = sample_interval_ms_;
+  doc["partition_size"] = partition_->size;
+  doc["chunks_written"] = chunks_written_;
+  doc["raw_bytes"] = raw_bytes_;
+  doc["encoded_bytes"] = encoded_bytes_;
+  doc["compression_ratio"] = get_compression_ratio();
+  doc["write_rate"] = get_write_rate();
+  doc["max_sample_us"] = max_sample_us_;
+  doc["dropped_chunks"] = dropped_chunks_;
+  JsonArray channels = doc["channels"].to<JsonArray>();
+  for (int i = 0; i < num_channels_; i++) {
+    JsonObject channel = channels.add<JsonObject>();
+    channel["name"] = channels_[i].name;
+    channel["scale"] = channels_[i].scale;
+  }
+
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
+
+esp_err_t ChannelLogger::send_log(httpd_req_t* req) const {
+  httpd_resp_set_type(req, "application/octet-stream");
+  httpd_resp_set_hdr(req, "Content-Disposition",
+                     "attachment; filename=\"halmet_log.bin\"");
+
+  // Stream header: magic, channel count, then scale and name per channel
+  uint8_t buffer[512];
+  uint8_t* p = buffer;
+  memcpy(p, kStreamMagic, sizeof(kStreamMagic));
+  p += sizeof(kStreamMagic);
+  *p++ = num_channels_;
+  for (int i = 0; i < num_channels_; i++) {
+    uint8_t name_length = strnlen(channels_[i].name, 23);
+    memcpy(p, &channels_[i].scale, sizeof(float));
+    p += sizeof(float);
+    *p++ = name_length;
+    memcpy(p, channels_[i].name, name_length);
+    p += name_length;
+  }
+  if (httpd_resp_send_chunk(req, reinterpret_cast<const char*>(buffer),
+                            p - buffer) != ESP_OK) {
+    return ESP_FAIL;
+  }
+
+  // Chunks from the oldest sector, the one after the current write position,
+  // around to the current one. A sector may be erased by the writer while it
+  // is being sent; clients drop chunks with a bad CRC.
+  uint32_t num_sectors = partition_->size / kSectorSize;
+  uint32_t current_sector = write_offset_ / kSectorSize;
+  for (uint32_t i = 1; i <= num_sectors; i++) {
+    uint32_t sector_start = ((current_sector + i) % num_sectors) * kSectorSize;
+    uint32_t offset = sector_start;
+    ChunkHeader header;
+    while (offset < sector_start + kSectorSize &&
+           read_chunk_header(offset, &header)) {
+      uint32_t end = offset + sizeof(ChunkHeader) + header.length;
+      while (offset < end) {
+        size_t length = std::min<size_t>(end - offset, sizeof(buffer));
+        if (esp_partition_read(partition_, offset, buffer, length) != ESP_OK ||
+            httpd_resp_send_chunk(req, reinterpret_cast<const char*>(buffer),
+                                  length) != ESP_OK) {
+          return ESP_FAIL;
+        }
+        offset += length;
+      }
+      offset = sector_start + Padded(end - sector_start);
+    }
+  }
+
+  return httpd_resp_send_chunk(req, nullptr, 0);
+}
+
+void ChannelLogger::register_http_handlers() {
+  auto http_server = sensesp::sensesp_app->get_http_server();
+
+  http_server->add_handler(std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_GET, "/api/log",
+      [this](httpd_req_t* req) { return send_log(req); }));
+
+  http_server->add_handler(std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_GET, "/api/log/stats", [this](httpd_req_t* req) {
+        String json = stats_to_json();
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_send(req, json.c_str(), json.length());
+        return ESP_OK;
+      }));
+}
+
+}  // namespace halmet
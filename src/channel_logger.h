@@ -0,0 +1,123 @@
+#ifndef HALMET_SRC_CHANNEL_LOGGER_H_
+#define HALMET_SRC_CHANNEL_LOGGER_H_
+
+#include <Arduino.h>
+#include <esp_http_server.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/**
+ * @brief On-device history of all channels in a dedicated flash partition.
+ *
+ * The latest value of every registered channel is sampled at a fixed rate
+ * into a RAM block. Full blocks are handed to a low-priority task that
+ * encodes them column by column, as zigzag varint deltas of the channel
+ * values quantized with a per-channel scale, and appends the resulting
+ * chunk to a circular log in the halmetlog partition. The event loop only
+ * copies one row per sample period.
+ *
+ * The log is served as a binary stream from /api/log: a header with the
+ * channel names and scales, followed by the chunks from oldest to newest.
+ * Statistics are served from /api/log/stats.
+ */
+class ChannelLogger {
+ public:
+  static const int kMaxChannels = 16;
+  static const int kRowsPerChunk = 32;
+
+  ChannelLogger(unsigned int sample_interval_ms = 500,
+                const char* partition_label = "halmetlog");
+
+  /// Register a channel. Values are stored as round(value * scale).
+  void add_channel(const char* name, float scale,
+                   sensesp::FloatProducer* producer);
+  void add_channel(const char* name, sensesp::BoolProducer* producer);
+
+  /// Start sampling. Call after all channels have been added.
+  bool start();
+
+  /// Raw sample bytes (4 per value) per encoded flash byte
+  float get_compression_ratio() const;
+  /// Flash bytes written per second since start()
+  float get_write_rate() const;
+  /// Longest time spent on the event loop by one sample
+  uint32_t get_max_sample_us() const { return max_sample_us_; }
+  /// Blocks lost because the writer task fell behind
+  uint32_t get_dropped_chunks() const { return dropped_chunks_; }
+
+  String stats_to_json() const;
+
+ protected:
+  struct ChunkHeader {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t start_ms;
+    uint16_t sample_interval_ms;
+    uint8_t rows;
+    uint8_t channels;
+    uint16_t length;  // Payload bytes following the header
+    uint16_t reserved;
+    uint32_t crc;     // Payload CRC
+  };
+
+  struct Block {
+    uint32_t start_ms;
+    int32_t values[kRowsPerChunk][kMaxChannels];
+    uint32_t valid[kRowsPerChunk];  // One bit per channel
+  };
+
+  struct Channel {
+    const char* name;
+    float scale;
+    float latest;
+    bool valid;
+  };
+
+  void sample();
+  void find_write_position();
+  size_t encode(const Block& block, uint8_t* out) const;
+  void write_chunk(const Block& block);
+  bool read_chunk_header(uint32_t offset, ChunkHeader* header) const;
+  static void writer_task(void* arg);
+  void register_http_handlers();
+  esp_err_t send_log(httpd_req_t* req) const;
+
+  unsigned int sample_interval_ms_;
+  const esp_partition_t* partition_;
+
+  Channel channels_[kMaxChannels];
+  int num_channels_ = 0;
+
+  // Double-buffered raw blocks. The event loop fills one while the writer
+  // task encodes and writes the other.
+  Block blocks_[2];
+  volatile bool block_busy_[2] = {false, false};
+  int active_block_ = 0;
+  int row_ = 0;
+  QueueHandle_t queue_ = nullptr;
+
+  // Writer task state
+  uint32_t write_offset_ = 0;
+  uint32_t sequence_ = 0;
+  // Worst case is a 5 byte varint per value
+  uint8_t chunk_buffer_[sizeof(ChunkHeader) +
+                        kRowsPerChunk * kMaxChannels * 5];
+
+  // Statistics
+  uint32_t chunks_written_ = 0;
+  uint32_t raw_bytes_ = 0;
+  uint32_t encoded_bytes_ = 0;
+  unsigned long started_ms_ = 0;
+  uint32_t max_sample_us_ = 0;
+  uint32_t dropped_chunks_ = 0;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_CHANNEL_LOGGER_H_
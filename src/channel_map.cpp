@@ -0,0 +1,244 @@
+#include "channel_map.h"
+
+#include <set>
+
+#include "halmet_const.h"
+#include "sensesp.h"
+
+namespace halmet {
+
+namespace {
+
+// GPIOs that main.cpp wires to something other than a tacho
+struct ReservedPin {
+  int pin;
+  const char* use;
+};
+
+const ReservedPin kReservedPins[] = {
+    {sensesp::kDigitalInputPin2, "the D2 alarm and wake-up input"},
+    {sensesp::kDigitalInputPin3, "the D3 alarm input"},
+    {sensesp::kSDAPin, "I2C"},
+    {sensesp::kSCLPin, "I2C"},
+    {sensesp::kCANRxPin, "the CAN bus"},
+    {sensesp::kCANTxPin, "the CAN bus"},
+};
+
+}  // namespace
+
+ChannelMap::ChannelMap(const String& config_path)
+    : sensesp::FileSystemSaveable{config_path} {
+  adc_addresses = {sensesp::kADS1115Address};
+  engines = {{"1", 0, sensesp::kDigitalInputPin1, 3, 2, 1}};
+  tanks = {{"Fuel", "fuel.main", 0, 0, 0, 150}};
+  exhaust_engine = "1";
+  load();
+}
+
+String ChannelMap::input_name(int input) {
+  if (input < 4) {
+    return "A" + String(input + 1);
+  }
+  return "ADC" + String(input / 4 + 1) + " A" + String(input % 4 + 1);
+}
+
+String ChannelMap::input_id(int input) {
+  if (input < 4) {
+    return "a" + String(input + 1);
+  }
+  return "adc" + String(input / 4 + 1) + "a" + String(input % 4 + 1);
+}
+
+bool ChannelMap::check(size_t adc_count, const std::vector<Engine>& engines,
+                       const std::vector<Tank>& tanks,
+                       const String& exhaust_engine) {
+  std::set<int> inputs;
+  auto use_input = [&](int input, const String& user) {
+    if (input < 0) {
+      return true;
+    }
+    if (input >= static_cast<int>(adc_count * 4)) {
+      debugE("Channel map: %s uses input %d, but there are only %d",
+             user.c_str(), input, static_cast<int>(adc_count * 4));
+      return false;
+    }
+    if (!inputs.insert(input).second) {
+      debugE("Channel map: %s uses input %s, which is already in use",
+             user.c_str(), input_name(input).c_str());
+      return false;
+    }
+    return true;
+  };
+
+  std::set<int> tacho_pins;
+  std::set<String> engine_ids;
+  bool exhaust_engine_found = exhaust_engine.isEmpty();
+  for (const Engine& engine : engines) {
+    if (engine.id.isEmpty()) {
+      debugE("Channel map: an engine has no id");
+      return false;
+    }
+    if (!engine_ids.insert(engine.id).second) {
+      debugE("Channel map: engine id %s is used twice", engine.id.c_str());
+      return false;
+    }
+    String user = "engine " + engine.id;
+    if (!use_input(engine.temperature_input, user) ||
+        !use_input(engine.oil_pressure_input, user) ||
+        !use_input(engine.voltage_input, user)) {
+      return false;
+    }
+    if (engine.tacho_pin >= 0 && !tacho_pins.insert(engine.tacho_pin).second) {
+      debugE("Channel map: engine %s uses tacho GPIO %d twice",
+             engine.id.c_str(), engine.tacho_pin);
+      return false;
+    }
+    for (const ReservedPin& reserved : kReservedPins) {
+      if (engine.tacho_pin == reserved.pin) {
+        debugE("Channel map: engine %s tacho GPIO %d is %s",
+               engine.id.c_str(), engine.tacho_pin, reserved.use);
+        return false;
+      }
+    }
+    exhaust_engine_found |= engine.id == exhaust_engine;
+  }
+  std::set<String> tank_names;
+  std::set<String> tank_sk_ids;
+  for (const Tank& tank : tanks) {
+    if (!tank_names.insert(tank.name).second) {
+      debugE("Channel map: tank name %s is used twice", tank.name.c_str());
+      return false;
+    }
+    if (!tank_sk_ids.insert(tank.sk_id).second) {
+      debugE("Channel map: tank %s uses Signal K id %s, which is already in "
+             "use", tank.name.c_str(), tank.sk_id.c_str());
+      return false;
+    }
+    if (!use_input(tank.input, "tank " + tank.name)) {
+      return false;
+    }
+  }
+  if (!exhaust_engine_found) {
+    debugE("Channel map: no exhaust engine %s", exhaust_engine.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool ChannelMap::from_json(const JsonObject& config) {
+  if (!config["adcs"].is<JsonArray>() || !config["engines"].is<JsonArray>() ||
+      !config["tanks"].is<JsonArray>()) {
+    return false;
+  }
+
+  std::vector<uint8_t> new_adc_addresses;
+  for (JsonVariant address : config["adcs"].as<JsonArray>()) {
+    if (new_adc_addresses.size() < kMaxADCs) {
+      new_adc_addresses.push_back(address.as<uint8_t>());
+    }
+  }
+
+  std::vector<Engine> new_engines;
+  for (JsonObject obj : config["engines"].as<JsonArray>()) {
+    Engine engine;
+    engine.id = obj["id"] | "";
+    engine.n2k_instance = obj["n2k_instance"] | 0;
+    engine.tacho_pin = obj["tacho_pin"] | -1;
+    engine.temperature_input = obj["temperature_input"] | -1;
+    engine.oil_pressure_input = obj["oil_pressure_input"] | -1;
+    // Maps saved before the voltage input existed had A2 on the first
+    // engine
+    engine.voltage_input =
+        obj["voltage_input"] | (new_engines.empty() ? 1 : -1);
+    new_engines.push_back(engine);
+  }
+
+  std::vector<Tank> new_tanks;
+  for (JsonObject obj : config["tanks"].as<JsonArray>()) {
+    Tank tank;
+    tank.name = obj["name"] | "Fuel";
+    tank.sk_id = obj["sk_id"] | "fuel.main";
+    tank.input = obj["input"] | -1;
+    tank.n2k_instance = obj["n2k_instance"] | 0;
+    tank.fluid_type = obj["fluid_type"] | 0;
+    tank.capacity = obj["capacity"] | 150.0f;
+    new_tanks.push_back(tank);
+  }
+
+  String new_exhaust_engine;
+  if (config["exhaust_engine"].is<const char*>()) {
+    new_exhaust_engine = config["exhaust_engine"].as<String>();
+  } else if (!new_engines.empty()) {
+    // Maps saved before the exhaust engine existed used the first engine
+    new_exhaust_engine = new_engines[0].id;
+  }
+
+  if (!check(new_adc_addresses.size(), new_engines, new_tanks,
+             new_exhaust_engine)) {
+    return false;
+  }
+  adc_addresses = new_adc_addresses;
+  engines = new_engines;
+  tanks = new_tanks;
+  exhaust_engine = new_exhaust_engine;
+  return true;
+}
+
+bool ChannelMap::to_json(JsonObject& config) {
+  JsonArray adcs = config["adcs"].to<JsonArray>();
+  for (uint8_t address : adc_addresses) {
+    adcs.add(address);
+  }
+
+  JsonArray engines_json = config["engines"].to<JsonArray>();
+  for (const Engine& engine : engines) {
+    JsonObject obj = engines_json.add<JsonObject>();
+    obj["id"] = engine.id;
+    obj["n2k_instance"] = engine.n2k_instance;
+    obj["tacho_pin"] = engine.tacho_pin;
+    obj["temperature_input"] = engine.temperature_input;
+    obj["oil_pressure_input"] = engine.oil_pressure_input;
+    obj["voltage_input"] = engine.voltage_input;
+  }
+
+  JsonArray tanks_json = config["tanks"].to<JsonArray>();
+  for (const Tank& tank : tanks) {
+    JsonObject obj = tanks_json.add<JsonObject>();
+    obj["name"] = tank.name;
+    obj["sk_id"] = tank.sk_id;
+    obj["input"] = tank.input;
+    obj["n2k_instance"] = tank.n2k_instance;
+    obj["fluid_type"] = tank.fluid_type;
+    obj["capacity"] = tank.capacity;
+  }
+  config["exhaust_engine"] = exhaust_engine;
+  return true;
+}
+
+const String ConfigSchema(const ChannelMap& obj) {
+  return R"###({
+    "type": "object",
+    "properties": {
+      "adcs": { "title": "ADS1115 I2C addresses", "type": "array", "maxItems": 4, "description": "Decimal I2C addresses (72-75) of the ADS1115s. Inputs 0-3 are on the first, 4-7 on the second, and so on.", "items": { "type": "integer" } },
+      "engines": { "title": "Engines", "type": "array", "items": { "type": "object", "required": ["id"], "properties": {
+        "id": { "title": "Signal K engine id", "type": "string" },
+        "n2k_instance": { "title": "NMEA 2000 engine instance", "type": "integer" },
+        "tacho_pin": { "title": "Tacho input GPIO", "type": "integer" },
+        "temperature_input": { "title": "Temperature sender input", "type": "integer" },
+        "oil_pressure_input": { "title": "Oil pressure sender input", "type": "integer" },
+        "voltage_input": { "title": "Alternator voltage input", "type": "integer" }
+      } } },
+      "tanks": { "title": "Tanks", "type": "array", "items": { "type": "object", "properties": {
+        "name": { "title": "Name", "type": "string" },
+        "sk_id": { "title": "Signal K tank id", "type": "string" },
+        "input": { "title": "Sender input", "type": "integer" },
+        "n2k_instance": { "title": "NMEA 2000 tank instance", "type": "integer" },
+        "fluid_type": { "title": "NMEA 2000 fluid type", "type": "integer", "description": "0 fuel, 1 water, 2 gray water, 3 live well, 4 oil, 5 black water, 6 gasoline" },
+        "capacity": { "title": "Capacity", "type": "number", "description": "Liters" }
+      } } },
+      "exhaust_engine": { "title": "Exhaust alarm engine", "type": "string", "description": "Id of the engine whose exhaust temperature is monitored, or empty" }
+    }
+  })###";
+}
+
+}  // namespace halmet
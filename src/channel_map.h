@@ -0,0 +1,94 @@
+#ifndef HALMET_SRC_CHANNEL_MAP_H_
+#define HALMET_SRC_CHANNEL_MAP_H_
+
+#include <Arduino.h>
+
+#include <vector>
+
+#include "config_store.h"
+#include "sensesp/system/saveable.h"
+
+namespace halmet {
+
+/**
+ * @brief Which ADS1115s are fitted and which engines and tanks they serve.
+ *
+ * Analog inputs are numbered across the ADS1115s in the order listed:
+ * input 0..3 are A1..A4 of the first device, 4..7 those of the second,
+ * and so on. An input of -1 leaves the sender unconnected. A map that uses
+ * an input or a tacho pin twice, or an input beyond the listed ADS1115s,
+ * is rejected, because two users of an input would share its readings.
+ * So is a map with an engine without an id, with two engines of the same
+ * id or two tanks of the same name or Signal K id, whose configuration
+ * and outputs would collide, or with a tacho on a GPIO that is otherwise
+ * wired: the D2 and D3 alarm inputs, of which D2 wakes the board, I2C and
+ * CAN.
+ *
+ * Each engine can have an alternator voltage input, which also drives its
+ * ripple analysis and N2K charging bits. The exhaust temperature alarm
+ * drives the water flow bit of the exhaust engine.
+ *
+ * The defaults describe a single HALMET board with one engine on A3, A4
+ * and D1, its alternator on A2, and a 150 l fuel tank on A1, as previously
+ * hard-coded in main.cpp. Changes take effect after a restart.
+ */
+class ChannelMap : public sensesp::FileSystemSaveable {
+ public:
+  static const int kMaxADCs = 4;
+
+  struct Engine {
+    String id;              // Signal K propulsion.<id>
+    uint8_t n2k_instance;
+    int tacho_pin;          // GPIO, or -1
+    int temperature_input;
+    int oil_pressure_input;
+    int voltage_input;      // Alternator voltage
+  };
+
+  struct Tank {
+    String name;
+    String sk_id;           // Signal K tanks.<sk_id>
+    int input;
+    uint8_t n2k_instance;
+    uint8_t fluid_type;     // tN2kFluidType
+    float capacity;         // l
+  };
+
+  ChannelMap(const String& config_path);
+
+  std::vector<uint8_t> adc_addresses;
+  std::vector<Engine> engines;
+  std::vector<Tank> tanks;
+  String exhaust_engine;    // Engine id, or empty
+
+  /// Display name of an analog input: A1..A4 on the first ADS1115, and
+  /// "ADC2 A1" and so on for the others
+  static String input_name(int input);
+  /// Signal K id of an analog input: a1..a4, adc2a1, ...
+  static String input_id(int input);
+
+  virtual bool from_json(const JsonObject& config) override;
+  virtual bool to_json(JsonObject& config) override;
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+ protected:
+  /// Check that no input, tacho pin, engine id or tank name is used twice,
+  /// that all inputs exist, that no tacho is on a reserved GPIO and that
+  /// the exhaust engine exists. Logs the first conflict and returns false
+  /// if there is one.
+  static bool check(size_t adc_count, const std::vector<Engine>& engines,
+                    const std::vector<Tank>& tanks,
+                    const String& exhaust_engine);
+};
+
+const String ConfigSchema(const ChannelMap& obj);
+
+inline bool ConfigRequiresRestart(const ChannelMap& obj) { return true; }
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_CHANNEL_MAP_H_
@@ -0,0 +1,241 @@
+#include "config_cache.h"
+
+#include <ArduinoJson.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+
+#include "loop_monitor.h"
+#include "sensesp.h"
+#include "sensesp/net/http_server.h"
+#include "sensesp_app.h"
+
+namespace halmet {
+
+namespace {
+
+// The event loop normally gets to an update within a tick
+const TickType_t kUpdateTimeoutTicks = pdMS_TO_TICKS(2000);
+
+// Read-only view of /api/config_cache. Reports its load time, measured
+// from the start of navigation, to /api/config_cache/load.
+const char kPage[] = R"###(<!DOCTYPE html>
+<html><head><meta charset="utf-8"><title>HALMET configuration</title>
+<style>
+body{font-family:sans-serif;margin:1em}
+section{border-bottom:1px solid #ccc;padding:.5em 0}
+small{color:#666}td{padding:0 1em 0 0;vertical-align:top}
+</style></head>
+<body><h1>Configuration</h1><p id="timing">Loading...</p><div id="items"></div>
+<script>
+function add(parent, tag, text) {
+  const element = document.createElement(tag);
+  element.textContent = text;
+  parent.appendChild(element);
+  return element;
+}
+fetch('/api/config_cache').then(r => r.json()).then(doc => {
+  const root = document.getElementById('items');
+  doc.items.sort((a, b) => a.sort_order - b.sort_order);
+  for (const item of doc.items) {
+    const section = add(root, 'section', '');
+    add(section, 'h3', item.title || item.path);
+    add(section, 'small',
+        item.path + (item.requires_restart ? ' (restart to apply)' : ''));
+    if (item.description) add(section, 'p', item.description);
+    const properties = (item.schema && item.schema.properties) || {};
+    const table = add(section, 'table', '');
+    for (const [key, value] of Object.entries(item.config || {})) {
+      const row = add(table, 'tr', '');
+      add(row, 'td', (properties[key] && properties[key].title) || key);
+      add(row, 'td', JSON.stringify(value));
+    }
+  }
+  const ms = Math.round(performance.now());
+  return fetch('/api/config_cache/load?ms=' + ms).then(r => r.json());
+}).then(t => {
+  document.getElementById('timing').textContent =
+      t.items + ' items, page loaded in ' + t.page_load_ms + ' ms. ' +
+      'Document updated in ' + t.update_us + ' us on the event loop, ' +
+      'waited for ' + t.wait_us + ' us, sent in ' + t.send_us + ' us. ' +
+      'Longest event loop tick during the load: ' + t.longest_tick_us +
+      ' us.';
+});
+</script></body></html>
+)###";
+
+}  // namespace
+
+ConfigCache* ConfigCache::get() {
+  static ConfigCache cache;
+  return &cache;
+}
+
+void ConfigCache::start() {
+  updated_ = xSemaphoreCreateBinary();
+
+  auto server = sensesp::sensesp_app->get_http_server();
+  server->add_handler(std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_GET, "/api/config_cache",
+      [this](httpd_req_t* req) { return handle(req); }));
+  server->add_handler(std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_GET, "/api/config_cache/page",
+      [this](httpd_req_t* req) { return handle_page(req); }));
+  server->add_handler(std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_GET, "/api/config_cache/load",
+      [this](httpd_req_t* req) { return handle_load(req); }));
+}
+
+bool ConfigCache::update() {
+  if (items_.empty()) {
+    auto config_items = sensesp::ConfigItemBase::get_config_items();
+    for (auto& config_item : *config_items) {
+      String schema = config_item->get_config_schema();
+      JsonDocument doc;
+      doc["path"] = config_item->get_config_path();
+      doc["title"] = config_item->get_title();
+      doc["description"] = config_item->get_description();
+      doc["sort_order"] = config_item->get_sort_order();
+      doc["requires_restart"] = config_item->requires_restart();
+      doc["schema"] = serialized(schema.isEmpty() ? String("{}") : schema);
+      String prefix;
+      serializeJson(doc, prefix);
+      // Reopen the object for the config
+      prefix.remove(prefix.length() - 1);
+      prefix += ",\"config\":";
+      items_.push_back({config_item, prefix, ""});
+    }
+  }
+
+  // Only the configurations; the document is rebuilt if one changed
+  bool changed = document_.isEmpty();
+  for (Item& item : items_) {
+    JsonDocument doc;
+    JsonObject obj = doc.to<JsonObject>();
+    item.config_item->to_json(obj);
+    String config;
+    serializeJson(doc, config);
+    if (config != item.config) {
+      item.config = config;
+      changed = true;
+    }
+  }
+  if (!changed) {
+    return false;
+  }
+
+  size_t length = 16;
+  for (const Item& item : items_) {
+    length += item.prefix.length() + item.config.length() + 2;
+  }
+  document_ = "";
+  document_.reserve(length);
+  document_ += "{\"items\":[";
+  for (size_t i = 0; i < items_.size(); i++) {
+    if (i > 0) {
+      document_ += ",";
+    }
+    document_ += items_[i].prefix;
+    document_ += items_[i].config;
+    document_ += "}";
+  }
+  document_ += "]}";
+
+  uint32_t crc = esp_rom_crc32_le(
+      0, reinterpret_cast<const uint8_t*>(document_.c_str()),
+      document_.length());
+  snprintf(etag_, sizeof(etag_), "W/\"%08x\"", crc);
+  renders_++;
+  return true;
+}
+
+bool ConfigCache::update_from_server() {
+  // Requests are handled one at a time by the HTTP server task. An update
+  // left over from a request that timed out finishes before this one, as
+  // the event loop runs them in order.
+  uint32_t request = ++update_requests_;
+  sensesp::event_loop()->onDelay(0, [this, request]() {
+    int64_t start_us = esp_timer_get_time();
+    update_changed_ = update();
+    update_us_ = esp_timer_get_time() - start_us;
+    updates_done_ = request;
+    xSemaphoreGive(updated_);
+  });
+  while (updates_done_ != request) {
+    if (xSemaphoreTake(updated_, kUpdateTimeoutTicks) != pdTRUE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+esp_err_t ConfigCache::handle(httpd_req_t* req) {
+  int64_t start_us = esp_timer_get_time();
+  if (!update_from_server()) {
+    debugW("Config cache: the event loop didn't update the document");
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    return httpd_resp_send(req, nullptr, 0);
+  }
+  // The event loop doesn't touch the document until the next request
+  int64_t updated_us = esp_timer_get_time();
+
+  char if_none_match[16] = "";
+  httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match,
+                              sizeof(if_none_match));
+  bool not_modified = strcmp(if_none_match, etag_) == 0;
+
+  httpd_resp_set_hdr(req, "ETag", etag_);
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  esp_err_t result;
+  if (not_modified) {
+    httpd_resp_set_status(req, "304 Not Modified");
+    result = httpd_resp_send(req, nullptr, 0);
+  } else {
+    httpd_resp_set_type(req, "application/json");
+    result = httpd_resp_send(req, document_.c_str(), document_.length());
+  }
+
+  last_update_us_ = update_us_;
+  last_wait_us_ = updated_us - start_us;
+  last_send_us_ = esp_timer_get_time() - updated_us;
+  debugD("Config cache: %s, %d items, %u bytes, %s in %u us (waited %u us), "
+         "sent in %u us",
+         not_modified ? "304" : "200", static_cast<int>(items_.size()),
+         not_modified ? 0 : document_.length(),
+         update_changed_ ? "rendered" : "checked", last_update_us_,
+         last_wait_us_, last_send_us_);
+  return result;
+}
+
+esp_err_t ConfigCache::handle_page(httpd_req_t* req) {
+  LoopMonitor::get()->start_window();
+  httpd_resp_set_type(req, "text/html");
+  return httpd_resp_send(req, kPage, sizeof(kPage) - 1);
+}
+
+esp_err_t ConfigCache::handle_load(httpd_req_t* req) {
+  char query[24];
+  char value[12] = "";
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+    httpd_query_key_value(query, "ms", value, sizeof(value));
+  }
+  uint32_t page_load_ms = strtoul(value, nullptr, 10);
+  uint32_t longest_tick_us = LoopMonitor::get()->get_window_max_us();
+  debugI("Config page: loaded in %u ms, document updated in %u us, "
+         "waited %u us, sent in %u us, longest event loop tick %u us",
+         page_load_ms, last_update_us_, last_wait_us_, last_send_us_,
+         longest_tick_us);
+
+  JsonDocument doc;
+  doc["items"] = items_.size();
+  doc["page_load_ms"] = page_load_ms;
+  doc["update_us"] = last_update_us_;
+  doc["wait_us"] = last_wait_us_;
+  doc["send_us"] = last_send_us_;
+  doc["longest_tick_us"] = longest_tick_us;
+  String json;
+  serializeJson(doc, json);
+  httpd_resp_set_type(req, "application/json");
+  return httpd_resp_send(req, json.c_str(), json.length());
+}
+
+}  // namespace halmet
@@ -0,0 +1,85 @@
+#ifndef HALMET_SRC_CONFIG_CACHE_H_
+#define HALMET_SRC_CONFIG_CACHE_H_
+
+#include <Arduino.h>
+#include <esp_http_server.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <memory>
+#include <vector>
+
+#include "sensesp/ui/config_item.h"
+
+namespace halmet {
+
+/**
+ * @brief Pre-rendered configuration of all config items, with an ETag.
+ *
+ * GET /api/config_cache returns the path, title, description, sort order,
+ * restart flag, schema and current configuration of every config item in
+ * one JSON document:
+ *
+ *   {"items":[{"path":"/Voltage A2","title":...,"schema":{...},
+ *              "config":{...}}, ...]}
+ *
+ * GET /api/config_cache/page is a read-only configuration page that loads
+ * the document, shows each item's fields with the titles from its schema,
+ * and then reports its load time to GET /api/config_cache/load?ms=, which
+ * answers and logs it next to the render and send times and the longest
+ * event loop tick during the load, from the LoopMonitor.
+ *
+ * The document is rendered on the event loop, which owns the config
+ * items; the HTTP server task waits for it. The schemas and metadata are
+ * rendered once, on the first request. The configurations are serialized
+ * again on every request, as they change without a save in between, e.g.
+ * when a LiveTransform applies its staged configuration or a StagedValue
+ * takes effect, and SensESP's own items are saved without passing through
+ * HALMET; the document is only rebuilt if one of them changed. The weak
+ * ETag is the CRC of the document; a request with a matching If-None-Match
+ * gets 304 Not Modified without a body.
+ */
+class ConfigCache {
+ public:
+  static ConfigCache* get();
+
+  /// Register the HTTP handlers
+  void start();
+
+ protected:
+  struct Item {
+    std::shared_ptr<sensesp::ConfigItemBase> config_item;
+    String prefix;  // Everything up to the config object
+    String config;
+  };
+
+  /// Refresh the document on the event loop. Returns true if it changed.
+  bool update();
+  /// Have the event loop update the document and wait for it. Returns false
+  /// if the event loop didn't get to it in time.
+  bool update_from_server();
+  esp_err_t handle(httpd_req_t* req);
+  esp_err_t handle_page(httpd_req_t* req);
+  esp_err_t handle_load(httpd_req_t* req);
+
+  std::vector<Item> items_;
+  String document_;
+  char etag_[16] = "";
+  uint32_t renders_ = 0;
+
+  // Updates requested by the HTTP server task and done by the event loop
+  SemaphoreHandle_t updated_ = nullptr;
+  uint32_t update_requests_ = 0;
+  volatile uint32_t updates_done_ = 0;
+  volatile bool update_changed_ = false;
+  volatile uint32_t update_us_ = 0;
+
+  // Of the latest document request, for the page load report
+  uint32_t last_update_us_ = 0;
+  uint32_t last_wait_us_ = 0;
+  uint32_t last_send_us_ = 0;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_CONFIG_CACHE_H_
@@ -0,0 +1,430 @@
+#include "config_store.h"
+
+#include <ArduinoJson.h>
+#include <esp_rom_crc.h>
+
+#include <algorithm>
+
+#include "sensesp.h"
+
+namespace halmet {
+
+// "HCFG" and "HREC" in little endian
+const uint32_t kStoreMagic = 0x47464348;
+const uint32_t kRecordMagic = 0x43455248;
+const uint16_t kStoreVersion = 1;
+
+ConfigStore* ConfigStore::get() {
+  static ConfigStore store;
+  return &store;
+}
+
+uint32_t ConfigStore::hash(const char* str, size_t length) {
+  // 32-bit FNV-1a
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    h ^= static_cast<uint8_t>(str[i]);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+size_t ConfigStore::record_size(size_t path_length, size_t json_length) {
+  size_t size = sizeof(RecordHeader) + path_length + 1 + json_length + 1;
+  return (size + 3) & ~static_cast<size_t>(3);
+}
+
+bool ConfigStore::begin(const char* partition_label) {
+  unsigned long start = micros();
+
+  partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                        ESP_PARTITION_SUBTYPE_ANY,
+                                        partition_label);
+  if (partition_ == nullptr) {
+    debugW("Config store partition '%s' not found", partition_label);
+    return false;
+  }
+  size_ = partition_->size;
+
+  const void* mapped;
+  esp_err_t err = esp_partition_mmap(partition_, 0, size_,
+                                     ESP_PARTITION_MMAP_DATA, &mapped,
+                                     &mmap_handle_);
+  if (err != ESP_OK) {
+    debugE("Unable to map config store: %s", esp_err_to_name(err));
+    partition_ = nullptr;
+    return false;
+  }
+  base_ = static_cast<const uint8_t*>(mapped);
+
+  const Header* header = reinterpret_cast<const Header*>(base_);
+  size_t index_size = header->entry_count * sizeof(IndexEntry);
+  bool valid = header->magic == kStoreMagic &&
+               header->version == kStoreVersion &&
+               sizeof(Header) + index_size <= header->journal_offset &&
+               header->journal_offset <= size_ &&
+               esp_rom_crc32_le(0, base_ + sizeof(Header), index_size) ==
+                   header->crc;
+
+  if (!valid) {
+    // Blank or corrupted store. The per-file configuration is still intact,
+    // so start over with an empty image and let the nodes migrate again.
+    debugI("Initializing empty config store");
+    entry_count_ = 0;
+    overlay_.clear();
+    if (!compact()) {
+      close();
+      return false;
+    }
+  } else {
+    index_ = reinterpret_cast<const IndexEntry*>(base_ + sizeof(Header));
+    entry_count_ = header->entry_count;
+    journal_start_ = header->journal_offset;
+    scan_journal();
+  }
+
+  begin_duration_us_ = micros() - start;
+  debugI("Config store: %d indexed, %d journaled, %d/%d bytes, %u us",
+         entry_count_, overlay_.size(), journal_end_, size_,
+         begin_duration_us_);
+  return true;
+}
+
+void ConfigStore::close() {
+  partition_ = nullptr;
+  index_ = nullptr;
+  entry_count_ = 0;
+  journal_start_ = 0;
+  journal_end_ = 0;
+  overlay_.clear();
+}
+
+const ConfigStore::RecordHeader* ConfigStore::record_at(
+    uint32_t offset) const {
+  return reinterpret_cast<const RecordHeader*>(base_ + offset);
+}
+
+bool ConfigStore::record_matches(uint32_t offset, const String& path,
+                                 uint32_t path_hash) const {
+  const RecordHeader* record = record_at(offset);
+  return record->path_hash == path_hash &&
+         record->path_length == path.length() &&
+         memcmp(record + 1, path.c_str(), path.length()) == 0;
+}
+
+void ConfigStore::index_record(uint32_t offset) {
+  const RecordHeader* record = record_at(offset);
+  String path(reinterpret_cast<const char*>(record + 1));
+  IndexEntry entry = {record->path_hash, offset};
+  auto it = std::lower_bound(overlay_.begin(), overlay_.end(), entry,
+                             [](const IndexEntry& a, const IndexEntry& b) {
+                               return a.path_hash < b.path_hash;
+                             });
+  for (auto same = it;
+       same != overlay_.end() && same->path_hash == entry.path_hash; ++same) {
+    if (record_matches(same->record_offset, path, entry.path_hash)) {
+      same->record_offset = offset;
+      return;
+    }
+  }
+  overlay_.insert(it, entry);
+}
+
+void ConfigStore::scan_journal() {
+  overlay_.clear();
+
+  uint32_t offset = journal_start_;
+  while (offset + sizeof(RecordHeader) <= size_) {
+    const RecordHeader* record = record_at(offset);
+    if (record->magic != kRecordMagic) {
+      break;
+    }
+    size_t size = record_size(record->path_length, record->json_length);
+    if (offset + size > size_) {
+      break;
+    }
+
+    const uint8_t* payload = reinterpret_cast<const uint8_t*>(record + 1);
+    size_t payload_length = record->path_length + 1 + record->json_length + 1;
+    if (esp_rom_crc32_le(0, payload, payload_length) == record->crc) {
+      index_record(offset);
+    } else {
+      debugW("Skipping corrupted journal record at 0x%x", offset);
+    }
+    offset += size;
+  }
+
+  journal_end_ = offset;
+}
+
+bool ConfigStore::find(const String& path, const char** json,
+                       size_t* length) const {
+  if (partition_ == nullptr) {
+    return false;
+  }
+
+  uint32_t path_hash = hash(path.c_str(), path.length());
+  auto by_hash = [](const IndexEntry& entry, uint32_t h) {
+    return entry.path_hash < h;
+  };
+
+  // Journal records are newer than the indexed image, so check them first.
+  const IndexEntry* found = nullptr;
+  for (auto it = std::lower_bound(overlay_.begin(), overlay_.end(), path_hash,
+                                  by_hash);
+       it != overlay_.end() && it->path_hash == path_hash; ++it) {
+    if (record_matches(it->record_offset, path, path_hash)) {
+      found = &*it;
+      break;
+    }
+  }
+  if (found == nullptr) {
+    for (auto it = std::lower_bound(index_, index_ + entry_count_, path_hash,
+                                    by_hash);
+         it != index_ + entry_count_ && it->path_hash == path_hash; ++it) {
+      if (record_matches(it->record_offset, path, path_hash)) {
+        found = it;
+        break;
+      }
+    }
+  }
+  if (found == nullptr) {
+    return false;
+  }
+
+  const RecordHeader* record = record_at(found->record_offset);
+  *json = reinterpret_cast<const char*>(record + 1) + record->path_length + 1;
+  *length = record->json_length;
+  return true;
+}
+
+bool ConfigStore::write_record(uint32_t offset, const char* path,
+                               size_t path_length, const char* json,
+                               size_t json_length) {
+  size_t size = record_size(path_length, json_length);
+  size_t payload_length = size - sizeof(RecordHeader);
+  uint8_t* buffer = static_cast<uint8_t*>(malloc(size));
+  if (buffer == nullptr) {
+    return false;
+  }
+  memset(buffer, 0, size);
+
+  RecordHeader* record = reinterpret_cast<RecordHeader*>(buffer);
+  uint8_t* payload = buffer + sizeof(RecordHeader);
+  memcpy(payload, path, path_length);
+  memcpy(payload + path_length + 1, json, json_length);
+  record->magic = kRecordMagic;
+  record->path_hash = hash(path, path_length);
+  record->path_length = path_length;
+  record->json_length = json_length;
+  record->crc = esp_rom_crc32_le(0, payload, path_length + 1 + json_length + 1);
+
+  // Write the payload before the header so that a record interrupted by a
+  // power loss never carries a valid magic.
+  esp_err_t err = esp_partition_write(partition_, offset + sizeof(RecordHeader),
+                                      payload, payload_length);
+  if (err == ESP_OK) {
+    err = esp_partition_write(partition_, offset, record,
+                              sizeof(RecordHeader));
+  }
+  free(buffer);
+  return err == ESP_OK;
+}
+
+bool ConfigStore::put(const String& path, const char* json, size_t length) {
+  if (partition_ == nullptr || path.length() > UINT16_MAX ||
+      length > UINT16_MAX) {
+    return false;
+  }
+
+  const char* current;
+  size_t current_length;
+  if (find(path, &current, &current_length) && current_length == length &&
+      memcmp(current, json, length) == 0) {
+    // Unchanged; don't wear the flash.
+    return true;
+  }
+
+  size_t size = record_size(path.length(), length);
+  if (journal_end_ + size > size_) {
+    if (!compact() || journal_end_ + size > size_) {
+      debugE("Config store is full");
+      return false;
+    }
+  }
+
+  if (!write_record(journal_end_, path.c_str(), path.length(), json, length)) {
+    debugE("Unable to write config record for %s", path.c_str());
+    return false;
+  }
+
+  index_record(journal_end_);
+  journal_end_ += size;
+  return true;
+}
+
+bool ConfigStore::compact() {
+  // Collect the latest record of every path from the image and the journal
+  std::vector<IndexEntry> latest(index_, index_ + entry_count_);
+  for (const IndexEntry& entry : overlay_) {
+    const RecordHeader* record = record_at(entry.record_offset);
+    String path(reinterpret_cast<const char*>(record + 1));
+    auto it = std::find_if(latest.begin(), latest.end(),
+                           [&](const IndexEntry& e) {
+                             return record_matches(e.record_offset, path,
+                                                   entry.path_hash);
+                           });
+    if (it != latest.end()) {
+      it->record_offset = entry.record_offset;
+    } else {
+      latest.push_back(entry);
+    }
+  }
+  std::sort(latest.begin(), latest.end(),
+            [](const IndexEntry& a, const IndexEntry& b) {
+              return a.path_hash < b.path_hash;
+            });
+
+  size_t index_size = latest.size() * sizeof(IndexEntry);
+  size_t image_size = sizeof(Header) + index_size;
+  for (const IndexEntry& entry : latest) {
+    const RecordHeader* record = record_at(entry.record_offset);
+    image_size += record_size(record->path_length, record->json_length);
+  }
+  if (image_size > size_) {
+    return false;
+  }
+
+  // Build the new image in RAM because the records live in the flash area
+  // that is about to be erased.
+  uint8_t* image = static_cast<uint8_t*>(malloc(image_size));
+  if (image == nullptr) {
+    debugE("Not enough memory to compact config store");
+    return false;
+  }
+
+  IndexEntry* index = reinterpret_cast<IndexEntry*>(image + sizeof(Header));
+  uint32_t offset = sizeof(Header) + index_size;
+  for (size_t i = 0; i < latest.size(); i++) {
+    const RecordHeader* record = record_at(latest[i].record_offset);
+    size_t size = record_size(record->path_length, record->json_length);
+    memcpy(image + offset, record, size);
+    index[i] = {latest[i].path_hash, offset};
+    offset += size;
+  }
+
+  Header* header = reinterpret_cast<Header*>(image);
+  header->magic = kStoreMagic;
+  header->version = kStoreVersion;
+  header->entry_count = latest.size();
+  header->journal_offset = image_size;
+  header->crc = esp_rom_crc32_le(0, image + sizeof(Header), index_size);
+
+  esp_err_t err = esp_partition_erase_range(partition_, 0, size_);
+  if (err == ESP_OK) {
+    err = esp_partition_write(partition_, 0, image, image_size);
+  }
+  free(image);
+  if (err != ESP_OK) {
+    // The old image is (partly) erased and the new one incomplete, so
+    // neither the index nor the journal offsets point at valid records
+    // anymore. Close the store; the nodes fall back to their files, which
+    // hold the same configuration, and the next boot rebuilds the image.
+    debugE("Config store compaction failed: %s", esp_err_to_name(err));
+    close();
+    return false;
+  }
+
+  index_ = reinterpret_cast<const IndexEntry*>(base_ + sizeof(Header));
+  entry_count_ = latest.size();
+  journal_start_ = image_size;
+  journal_end_ = image_size;
+  overlay_.clear();
+  return true;
+}
+
+void ConfigStore::count_load(bool store_hit, bool migrated, bool file_read,
+                             uint32_t load_us) {
+  load_stats_.loads++;
+  load_stats_.store_hits += store_hit;
+  load_stats_.migrations += migrated;
+  load_stats_.file_reads += file_read;
+  load_stats_.load_us += load_us;
+}
+
+bool LoadCounted(sensesp::FileSystemSaveable* saveable) {
+#ifdef HALMET_CONFIG_STORE
+  // LoadFromConfigStore() counts its own loads
+  return saveable->load();
+#else
+  unsigned long start = micros();
+  bool loaded = saveable->load();
+  ConfigStore::get()->count_load(false, false, true, micros() - start);
+  return loaded;
+#endif
+}
+
+bool LoadFromConfigStore(sensesp::FileSystemSaveable* saveable) {
+  const String& path = saveable->get_config_path();
+  if (path.isEmpty()) {
+    return false;
+  }
+
+  unsigned long start = micros();
+  ConfigStore* store = ConfigStore::get();
+  const char* json;
+  size_t length;
+  if (store->find(path, &json, &length)) {
+    JsonDocument doc;
+    bool loaded =
+        deserializeJson(doc, json, length) == DeserializationError::Ok;
+    if (loaded) {
+      JsonObject obj = doc.as<JsonObject>();
+      loaded = saveable->from_json(obj);
+    } else {
+      debugW("Invalid stored config for %s", path.c_str());
+    }
+    store->count_load(true, false, false, micros() - start);
+    return loaded;
+  }
+
+  // Not in the store yet: read the per-file configuration and migrate it.
+  if (!saveable->sensesp::FileSystemSaveable::load()) {
+    store->count_load(false, false, true, micros() - start);
+    return false;
+  }
+  bool migrated = false;
+  if (store->is_ready()) {
+    JsonDocument doc;
+    JsonObject obj = doc.to<JsonObject>();
+    saveable->to_json(obj);
+    String serialized;
+    serializeJson(doc, serialized);
+    migrated = store->put(path, serialized.c_str(), serialized.length());
+    debugD("Migrated %s to config store", path.c_str());
+  }
+  store->count_load(false, migrated, true, micros() - start);
+  return true;
+}
+
+bool SaveToConfigStore(sensesp::FileSystemSaveable* saveable) {
+  const String& path = saveable->get_config_path();
+  if (path.isEmpty()) {
+    return false;
+  }
+
+  JsonDocument doc;
+  JsonObject obj = doc.to<JsonObject>();
+  saveable->to_json(obj);
+  String serialized;
+  serializeJson(doc, serialized);
+  bool stored =
+      ConfigStore::get()->put(path, serialized.c_str(), serialized.length());
+
+  // Keep the per-file copy as well so that a lost or reformatted store
+  // partition can always be rebuilt by migration.
+  bool saved = saveable->sensesp::FileSystemSaveable::save();
+  return stored || saved;
+}
+
+}  // namespace halmet
@@ -0,0 +1,214 @@
+#ifndef HALMET_SRC_CONFIG_STORE_H_
+#define HALMET_SRC_CONFIG_STORE_H_
+
+#include <Arduino.h>
+#include <esp_partition.h>
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "sensesp/system/saveable.h"
+
+namespace halmet {
+
+/**
+ * @brief Consolidated configuration store in a dedicated flash partition.
+ *
+ * All node configurations live in a single memory-mapped blob: a header, a
+ * hash-sorted index and the JSON records, followed by a journal of records
+ * appended since the last compaction. The blob is mapped once at boot and
+ * lookups return pointers straight into flash, so no file is opened and no
+ * buffer is allocated per node.
+ *
+ * Nodes that are not found in the store are loaded from their per-file
+ * configuration and written to the journal, which migrates an existing
+ * device transparently on its first boot.
+ *
+ * The journal is scanned once, in begin(); put() adds its record to the
+ * journal index. The loads of all nodes are counted and timed, with or
+ * without the store, for the boot report.
+ */
+class ConfigStore {
+ public:
+  /// Node configuration loads since boot
+  struct LoadStats {
+    uint32_t loads = 0;       // Nodes loaded
+    uint32_t store_hits = 0;  // Found in the store
+    uint32_t migrations = 0;  // Read from their file and added to the store
+    uint32_t file_reads = 0;  // Per-file configurations read
+    uint32_t load_us = 0;     // Total time spent loading
+  };
+
+  static ConfigStore* get();
+
+  /// Map the partition and index the journal. Returns false if the
+  /// partition does not exist, in which case all lookups fail and callers
+  /// fall back to the per-file layout.
+  bool begin(const char* partition_label = "halmetcfg");
+
+  /// Look up a config path. On success, `json` points into the mapped
+  /// partition and stays valid until the next compaction.
+  bool find(const String& path, const char** json, size_t* length) const;
+
+  /// Append a record to the journal. Compacts the store if the journal
+  /// is full.
+  bool put(const String& path, const char* json, size_t length);
+
+  /// Rewrite the latest version of every record into a fresh indexed image.
+  bool compact();
+
+  bool is_ready() const { return partition_ != nullptr; }
+  size_t get_entry_count() const { return entry_count_ + overlay_.size(); }
+  size_t get_journal_used() const { return journal_end_ - journal_start_; }
+  uint32_t get_begin_duration_us() const { return begin_duration_us_; }
+
+  const LoadStats& get_load_stats() const { return load_stats_; }
+  void count_load(bool store_hit, bool migrated, bool file_read,
+                  uint32_t load_us);
+
+ private:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_count;
+    uint32_t journal_offset;
+    uint32_t crc;
+  };
+
+  struct IndexEntry {
+    uint32_t path_hash;
+    uint32_t record_offset;
+  };
+
+  struct RecordHeader {
+    uint32_t magic;
+    uint32_t path_hash;
+    uint16_t path_length;
+    uint16_t json_length;
+    uint32_t crc;
+  };
+
+  static uint32_t hash(const char* str, size_t length);
+  static size_t record_size(size_t path_length, size_t json_length);
+
+  const RecordHeader* record_at(uint32_t offset) const;
+  bool record_matches(uint32_t offset, const String& path,
+                      uint32_t path_hash) const;
+  bool write_record(uint32_t offset, const char* path, size_t path_length,
+                    const char* json, size_t json_length);
+  void scan_journal();
+  /// Add the journal record at offset to the overlay index, replacing an
+  /// older record of its path
+  void index_record(uint32_t offset);
+  /// Forget the image and fail all further lookups and writes
+  void close();
+
+  const esp_partition_t* partition_ = nullptr;
+  esp_partition_mmap_handle_t mmap_handle_ = 0;
+  const uint8_t* base_ = nullptr;
+  size_t size_ = 0;
+
+  const IndexEntry* index_ = nullptr;
+  size_t entry_count_ = 0;
+  uint32_t journal_start_ = 0;
+  uint32_t journal_end_ = 0;
+
+  // Journal records newer than the indexed image, sorted by path hash.
+  std::vector<IndexEntry> overlay_;
+
+  uint32_t begin_duration_us_ = 0;
+  LoadStats load_stats_;
+};
+
+/// Load a node's configuration from the store, migrating it from the
+/// per-file layout if the store does not yet know about it.
+bool LoadFromConfigStore(sensesp::FileSystemSaveable* saveable);
+
+/// Save a node's configuration to the store journal and to its file.
+bool SaveToConfigStore(sensesp::FileSystemSaveable* saveable);
+
+/// Load a node's configuration with its own load(), counted and timed in
+/// the load stats of the ConfigStore
+bool LoadCounted(sensesp::FileSystemSaveable* saveable);
+
+/// Marks the config path argument of a Stored<T> constructor
+struct ConfigPath {
+  explicit ConfigPath(const String& path) : path{path} {}
+  String path;
+};
+
+/**
+ * @brief A SensESP node whose configuration is kept in the config store.
+ *
+ * For node types that can't override load() and save() themselves, such as
+ * SensESP's own sensors, transforms and Signal K outputs. The node's own
+ * constructor would load its file before the overrides exist, so pass the
+ * config path wrapped in a ConfigPath: the node is then constructed
+ * without a path, and the configuration is loaded once, afterwards, from
+ * the store if there is one.
+ *
+ *   ArenaNew<Stored<SKOutputFloat>>(sk_path, ConfigPath(config_path));
+ *
+ * Nodes that need their configuration in their constructor, such as
+ * OneWireTemperature, which claims its sensor by the configured address,
+ * and DigitalInputCounter, which starts its timer with the configured
+ * interval, get the path directly instead. They load their file in their
+ * constructor, and with HALMET_CONFIG_STORE, the store afterwards.
+ *
+ * Without HALMET_CONFIG_STORE, the overrides don't exist.
+ */
+template <typename T>
+class Stored : public T {
+ public:
+  template <typename... Args>
+  Stored(Args&&... args) : T(WithoutConfigPath(std::forward<Args>(args))...) {
+    String config_path;
+    (TakeConfigPath(args, &config_path), ...);
+    if (!config_path.isEmpty()) {
+      this->set_config_path(config_path);
+      LoadCounted(this);
+    } else {
+#ifdef HALMET_CONFIG_STORE
+      LoadCounted(this);
+#endif
+    }
+  }
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+ private:
+  template <typename A>
+  static decltype(auto) WithoutConfigPath(A&& arg) {
+    if constexpr (std::is_same<typename std::decay<A>::type,
+                               ConfigPath>::value) {
+      return String();
+    } else {
+      return std::forward<A>(arg);
+    }
+  }
+
+  template <typename A>
+  static void TakeConfigPath(const A& arg, String* config_path) {
+    if constexpr (std::is_same<A, ConfigPath>::value) {
+      *config_path = arg.path;
+    }
+  }
+};
+
+template <typename T>
+const String ConfigSchema(const Stored<T>& obj) {
+  return ConfigSchema(static_cast<const T&>(obj));
+}
+
+template <typename T>
+bool ConfigRequiresRestart(const Stored<T>& obj) {
+  return ConfigRequiresRestart(static_cast<const T&>(obj));
+}
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_CONFIG_STORE_H_
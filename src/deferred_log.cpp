@@ -0,0 +1,195 @@
+#include "deferred_log.h"
+
+#include <esp_log.h>
+
+#include "sensesp.h"
+
+namespace halmet {
+
+namespace {
+
+const char kLevelLetters[] = "NEWIDV";
+
+// Formatting task poll interval when the ring is empty
+const unsigned int kTaskDelayMs = 20;
+
+// Interval of the dropped record warnings
+const unsigned long kReportIntervalMs = 60000;
+
+bool IsConversion(char c) { return strchr("diouxXcfFeEgGaAsp", c) != nullptr; }
+
+bool IsLengthModifier(char c) { return strchr("hljztLq", c) != nullptr; }
+
+}  // namespace
+
+DeferredLog* DeferredLog::get() {
+  static DeferredLog log;
+  return &log;
+}
+
+DeferredLog::DeferredLog() {
+  for (uint32_t i = 0; i < kRingSize; i++) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+void DeferredLog::begin() {
+  xTaskCreate(task, "deferred_log", 3072, this, tskIDLE_PRIORITY + 1,
+              nullptr);
+}
+
+DeferredLog::Slot* DeferredLog::reserve() {
+  uint32_t position = head_.load(std::memory_order_relaxed);
+  while (true) {
+    Slot* slot = &slots_[position % kRingSize];
+    uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+    int32_t difference = static_cast<int32_t>(sequence - position);
+    if (difference == 0) {
+      if (head_.compare_exchange_weak(position, position + 1,
+                                      std::memory_order_relaxed)) {
+        slot->time_ms = millis();
+        return slot;
+      }
+    } else if (difference < 0) {
+      // The formatting task hasn't freed this slot yet
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else {
+      position = head_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void DeferredLog::commit(Slot* slot) {
+  uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+  slot->sequence.store(sequence + 1, std::memory_order_release);
+}
+
+bool DeferredLog::read(char* line, uint8_t* level, uint32_t* time_ms) {
+  Slot* slot = &slots_[tail_ % kRingSize];
+  if (slot->sequence.load(std::memory_order_acquire) != tail_ + 1) {
+    return false;
+  }
+  format(*slot, line);
+  *level = slot->level;
+  *time_ms = slot->time_ms;
+  slot->sequence.store(tail_ + kRingSize, std::memory_order_release);
+  tail_++;
+  return true;
+}
+
+size_t DeferredLog::format(const Slot& slot, char* line) const {
+  char* out = line;
+  char* end = line + kLineSize - 1;
+  const char* p = slot.format;
+  int arg = 0;
+  while (*p != '\0' && out < end) {
+    if (*p != '%') {
+      *out++ = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      *out++ = '%';
+      p += 2;
+      continue;
+    }
+
+    // Copy the conversion without its length modifier; the argument is
+    // passed with the type it was stored as.
+    char spec[16];
+    size_t spec_length = 0;
+    spec[spec_length++] = *p++;
+    while (*p != '\0' && !IsConversion(*p)) {
+      if (!IsLengthModifier(*p) && spec_length < sizeof(spec) - 2) {
+        spec[spec_length++] = *p;
+      }
+      p++;
+    }
+    if (*p == '\0') {
+      break;
+    }
+    char conversion = *p++;
+    spec[spec_length++] = conversion;
+    spec[spec_length] = '\0';
+
+    if (arg >= slot.num_args) {
+      break;
+    }
+    ArgType type = slot.types[arg];
+    uint32_t word = slot.args[arg];
+    arg++;
+    float f;
+    memcpy(&f, &word, 4);
+
+    size_t available = end - out + 1;
+    int length;
+    if (strchr("fFeEgGaA", conversion) != nullptr) {
+      double value = type == ArgType::kFloat ? f
+                     : type == ArgType::kInt ? static_cast<int32_t>(word)
+                                             : word;
+      length = snprintf(out, available, spec, value);
+    } else if (conversion == 's') {
+      const char* value = type == ArgType::kString
+                              ? reinterpret_cast<const char*>(word)
+                              : "?";
+      length = snprintf(out, available, spec, value);
+    } else if (conversion == 'p') {
+      length =
+          snprintf(out, available, spec, reinterpret_cast<const void*>(word));
+    } else if (conversion == 'd' || conversion == 'i') {
+      int32_t value = type == ArgType::kFloat ? static_cast<int32_t>(f)
+                                              : static_cast<int32_t>(word);
+      length = snprintf(out, available, spec, value);
+    } else {
+      uint32_t value = type == ArgType::kFloat ? static_cast<uint32_t>(f)
+                                               : word;
+      length = snprintf(out, available, spec, value);
+    }
+    if (length > 0) {
+      out += std::min<size_t>(length, available - 1);
+    }
+  }
+  *out = '\0';
+  return out - line;
+}
+
+void DeferredLog::task(void* arg) {
+  DeferredLog* log = static_cast<DeferredLog*>(arg);
+  char line[kLineSize];
+  uint8_t level;
+  uint32_t time_ms;
+  unsigned long last_report = millis();
+  while (true) {
+    while (log->read(line, &level, &time_ms)) {
+      esp_log_write(static_cast<esp_log_level_t>(level), "halmet",
+                    "%c (%u) halmet: %s\n", kLevelLetters[level % 6], time_ms,
+                    line);
+    }
+    if (millis() - last_report > kReportIntervalMs) {
+      last_report = millis();
+      uint32_t dropped = log->dropped_.exchange(0);
+      if (dropped > 0) {
+        debugW("Deferred log: %u records dropped", dropped);
+      }
+    }
+    vTaskDelay(pdMS_TO_TICKS(kTaskDelayMs));
+  }
+}
+
+void DeferredLog::benchmark() {
+  const float value = 12.345f;
+  uint32_t direct = UINT32_MAX;
+  uint32_t deferred = UINT32_MAX;
+  // Take the best of a few calls, so that cache misses don't count
+  for (int i = 0; i < 3; i++) {
+    uint32_t start = ESP.getCycleCount();
+    debugD("Log benchmark: %f", value);
+    direct = std::min(direct, ESP.getCycleCount() - start);
+    start = ESP.getCycleCount();
+    deferredD("Log benchmark: %f", value);
+    deferred = std::min(deferred, ESP.getCycleCount() - start);
+  }
+  debugI("Log call: %u cycles direct, %u cycles deferred", direct, deferred);
+}
+
+}  // namespace halmet
@@ -0,0 +1,143 @@
+#ifndef HALMET_SRC_DEFERRED_LOG_H_
+#define HALMET_SRC_DEFERRED_LOG_H_
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <type_traits>
+
+// Compile-time level of the deferred log macros, with the ESP log level
+// numbering: 1 error, 2 warning, 3 info, 4 debug. Calls above this level
+// compile to nothing, arguments included.
+#ifndef HALMET_DEFERRED_LOG_LEVEL
+#ifdef CORE_DEBUG_LEVEL
+#define HALMET_DEFERRED_LOG_LEVEL CORE_DEBUG_LEVEL
+#else
+#define HALMET_DEFERRED_LOG_LEVEL 3
+#endif
+#endif
+
+/// Log from hot paths like debugD() and friends, but without formatting or
+/// output on the calling task. The format must be a string literal, and
+/// string arguments must outlive the call (literals, not String::c_str()).
+#define deferredE(format, ...) HALMET_DEFERRED_LOG(1, format, ##__VA_ARGS__)
+#define deferredW(format, ...) HALMET_DEFERRED_LOG(2, format, ##__VA_ARGS__)
+#define deferredI(format, ...) HALMET_DEFERRED_LOG(3, format, ##__VA_ARGS__)
+#define deferredD(format, ...) HALMET_DEFERRED_LOG(4, format, ##__VA_ARGS__)
+
+#define HALMET_DEFERRED_LOG(level, format, ...)                        \
+  do {                                                                 \
+    if ((level) <= HALMET_DEFERRED_LOG_LEVEL) {                        \
+      halmet::DeferredLog::get()->write(level, format, ##__VA_ARGS__); \
+    }                                                                  \
+  } while (0)
+
+namespace halmet {
+
+/**
+ * @brief Log records kept in binary form and formatted later.
+ *
+ * A log call stores the address of its format string, a timestamp and the
+ * raw argument words in a fixed-size slot of a lock-free ring, which takes
+ * well under a microsecond; no formatting or UART output happens on the
+ * calling task. A low-priority task formats the records and writes them to
+ * the ESP log with their original timestamps. The records identify their
+ * format string by its address in flash, so they could be shipped raw and
+ * decoded on a host from the firmware ELF file, but there is no such
+ * decoder: they are always formatted on the device.
+ *
+ * Any task may log. The ring is a bounded multi-producer queue with a
+ * sequence number per slot; when it is full, records are dropped and
+ * counted rather than blocking the caller.
+ */
+class DeferredLog {
+ public:
+  static const int kMaxArgs = 4;
+
+  enum class ArgType : uint8_t { kInt, kUnsigned, kFloat, kString, kPointer };
+
+  static DeferredLog* get();
+
+  /// Start the formatting task. Records written before this are kept.
+  void begin();
+
+  template <typename... Args>
+  void write(uint8_t level, const char* format, Args... args) {
+    static_assert(sizeof...(Args) <= kMaxArgs, "Too many log arguments");
+    Slot* slot = reserve();
+    if (slot == nullptr) {
+      return;
+    }
+    slot->level = level;
+    slot->num_args = sizeof...(Args);
+    slot->format = format;
+    int i = 0;
+    int unused[] = {0, (store(slot, i++, args), 0)...};
+    (void)i;
+    (void)unused;
+    commit(slot);
+  }
+
+  /// Compare the cost of a deferred and a direct debugD() call, in CPU
+  /// cycles, and log the result. Runs at boot with ENABLE_LOG_BENCHMARK.
+  void benchmark();
+
+ protected:
+  static const int kRingSize = 128;  // Slots, a power of two
+  static const int kLineSize = 160;
+
+  struct Slot {
+    std::atomic<uint32_t> sequence;
+    uint32_t time_ms;
+    const char* format;
+    uint8_t level;
+    uint8_t num_args;
+    ArgType types[kMaxArgs];
+    uint32_t args[kMaxArgs];
+  };
+
+  DeferredLog();
+
+  Slot* reserve();
+  void commit(Slot* slot);
+  bool read(char* line, uint8_t* level, uint32_t* time_ms);
+  size_t format(const Slot& slot, char* line) const;
+  static void task(void* arg);
+
+  template <typename T>
+  static typename std::enable_if<std::is_arithmetic<T>::value>::type store(
+      Slot* slot, int i, T value) {
+    static_assert(sizeof(T) <= 4 || std::is_floating_point<T>::value,
+                  "64-bit integers are not supported");
+    if (std::is_floating_point<T>::value) {
+      float f = static_cast<float>(value);
+      slot->types[i] = ArgType::kFloat;
+      memcpy(&slot->args[i], &f, 4);
+    } else if (std::is_signed<T>::value) {
+      slot->types[i] = ArgType::kInt;
+      slot->args[i] = static_cast<int32_t>(value);
+    } else {
+      slot->types[i] = ArgType::kUnsigned;
+      slot->args[i] = static_cast<uint32_t>(value);
+    }
+  }
+
+  static void store(Slot* slot, int i, const char* value) {
+    slot->types[i] = ArgType::kString;
+    slot->args[i] = reinterpret_cast<uint32_t>(value);
+  }
+
+  static void store(Slot* slot, int i, const void* value) {
+    slot->types[i] = ArgType::kPointer;
+    slot->args[i] = reinterpret_cast<uint32_t>(value);
+  }
+
+  Slot slots_[kRingSize];
+  std::atomic<uint32_t> head_{0};  // Next slot to reserve
+  uint32_t tail_ = 0;              // Next slot to format
+  std::atomic<uint32_t> dropped_{0};
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_DEFERRED_LOG_H_
@@ -0,0 +1,104 @@
+#include "engine_state.h"
+
+#include "sensesp.h"
+
+namespace halmet {
+
+const char* EngineStateName(EngineState state) {
+  switch (state) {
+    case EngineState::kOff:
+      return "off";
+    case EngineState::kCooldown:
+      return "cooldown";
+    case EngineState::kCranking:
+      return "cranking";
+    case EngineState::kRunning:
+      return "running";
+  }
+  return "unknown";
+}
+
+EngineStateMachine::EngineStateMachine(const String& config_path)
+    : sensesp::FileSystemSaveable{config_path} {
+  load();
+}
+
+void EngineStateMachine::set(const float& revolutions) {
+  if (isnan(revolutions)) {
+    return;
+  }
+  float rpm = 60 * revolutions;
+
+  switch (state_) {
+    case EngineState::kOff:
+      if (rpm >= running_rpm_) {
+        transition(EngineState::kRunning);
+      } else if (rpm >= stopped_rpm_) {
+        transition(EngineState::kCranking);
+      }
+      break;
+    case EngineState::kCranking:
+      if (rpm >= running_rpm_) {
+        transition(EngineState::kRunning);
+      } else if (rpm < stopped_rpm_) {
+        // Failed start
+        transition(EngineState::kOff);
+      }
+      break;
+    case EngineState::kRunning:
+      if (rpm < stopped_rpm_) {
+        stopped_at_ = millis();
+        transition(EngineState::kCooldown);
+      }
+      break;
+    case EngineState::kCooldown:
+      if (rpm >= running_rpm_) {
+        transition(EngineState::kRunning);
+      } else if (rpm >= stopped_rpm_) {
+        transition(EngineState::kCranking);
+      } else if (millis() - stopped_at_ >= cooldown_ * 1000) {
+        transition(EngineState::kOff);
+      }
+      break;
+  }
+}
+
+void EngineStateMachine::transition(EngineState state) {
+  debugI("Engine state %s -> %s", EngineStateName(state_),
+         EngineStateName(state));
+  state_ = state;
+  this->emit(state_);
+}
+
+bool EngineStateMachine::from_json(const JsonObject& config) {
+  String expected[] = {"stopped_rpm", "running_rpm", "cooldown"};
+  for (auto str : expected) {
+    if (!config[str].is<float>()) {
+      return false;
+    }
+  }
+  stopped_rpm_ = config["stopped_rpm"];
+  running_rpm_ = config["running_rpm"];
+  cooldown_ = config["cooldown"];
+  return true;
+}
+
+bool EngineStateMachine::to_json(JsonObject& config) {
+  config["stopped_rpm"] = stopped_rpm_;
+  config["running_rpm"] = running_rpm_;
+  config["cooldown"] = cooldown_;
+  return true;
+}
+
+const String ConfigSchema(const EngineStateMachine& obj) {
+  return R"###({
+    "type": "object",
+    "properties": {
+      "stopped_rpm": { "title": "Stopped RPM", "type": "number", "description": "Below this speed the engine is considered stopped" },
+      "running_rpm": { "title": "Running RPM", "type": "number", "description": "From this speed the engine is considered running rather than cranking" },
+      "cooldown": { "title": "Cooldown", "type": "number", "description": "Seconds after the engine stops before it is considered off" }
+    }
+  })###";
+}
+
+}  // namespace halmet
@@ -0,0 +1,65 @@
+#ifndef HALMET_SRC_ENGINE_STATE_H_
+#define HALMET_SRC_ENGINE_STATE_H_
+
+#include <Arduino.h>
+
+#include "config_store.h"
+#include "sensesp/system/saveable.h"
+#include "sensesp/system/valueconsumer.h"
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/// Engine states, ordered from least to most active
+enum class EngineState { kOff = 0, kCooldown, kCranking, kRunning };
+
+const char* EngineStateName(EngineState state);
+
+/**
+ * @brief Engine state derived from the tacho.
+ *
+ * The engine is cranking when it turns above stopped_rpm, running from
+ * running_rpm, and cools down for cooldown seconds after it stops from
+ * running before it is considered off. Timeouts are evaluated as the
+ * tacho samples arrive; the tacho emits also when the engine is stopped.
+ * The state is emitted when it changes.
+ */
+class EngineStateMachine : public sensesp::FloatConsumer,
+                           public sensesp::ValueProducer<EngineState>,
+                           public sensesp::FileSystemSaveable {
+ public:
+  EngineStateMachine(const String& config_path = "");
+
+  /// Engine speed in r/s
+  void set(const float& revolutions) override;
+
+  EngineState get_state() const { return state_; }
+
+  virtual bool from_json(const JsonObject& config) override;
+  virtual bool to_json(JsonObject& config) override;
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+ protected:
+  void transition(EngineState state);
+
+  float stopped_rpm_ = 50;
+  float running_rpm_ = 400;
+  float cooldown_ = 600;  // s
+
+  EngineState state_ = EngineState::kOff;
+  unsigned long stopped_at_ = 0;
+};
+
+const String ConfigSchema(const EngineStateMachine& obj);
+
+inline bool ConfigRequiresRestart(const EngineStateMachine& obj) {
+  return false;
+}
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_ENGINE_STATE_H_
@@ -1,5 +1,10 @@
-include "halmet_analog.h"
+#include "halmet_analog.h"
 
+#include "arena.h"
+#include "pipeline.h"
+#include "sample_log.h"
+#include "tank_filter.h"
+#include "warm_start.h"
 #include "sensesp/sensors/sensor.h"
 #include "sensesp/signalk/signalk_output.h"
 #include "sensesp/system/valueproducer.h"
@@ -9,27 +14,39 @@ include "halmet_analog.h"
 
 namespace halmet {
 
-// HALMET constant measurement current (A)
-const float kMeasurementCurrent = 0.01;
-
 // Default fuel tank size, in m3
 const float kTankDefaultSize = 120. / 1000;
 
-sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
-                                          int channel, const String& name,
-                                          const String& sk_id, int sort_order,
-                                          bool enable_signalk_output) {
-  const uint ads_read_delay = 500;  // ms
+float ReadSenderResistance(Adafruit_ADS1115* ads1115, int channel) {
+  int16_t adc_output = ads1115->readADC_SingleEnded(channel);
+  SampleRecorder::get()->record(
+      static_cast<SampleSource>(
+          static_cast<int>(SampleSource::kA1Counts) + channel),
+      adc_output);
+  return SenderResistance(adc_output, ads1115->computeVolts(1));
+}
 
-  // Configure the sender resistance sensor
+sensesp::FloatProducer* ConnectSenderResistance(Adafruit_ADS1115* ads1115,
+                                                int channel,
+                                                unsigned int read_interval) {
+  return ArenaNew<sensesp::RepeatSensor<float>>(
+      read_interval,
+      [ads1115, channel]() { return ReadSenderResistance(ads1115, channel); });
+}
 
-  auto sender_resistance =
-      new sensesp::RepeatSensor<float>(ads_read_delay, [ads1115, channel]() {
-        int16_t adc_output = ads1115->readADC_SingleEnded(channel);
-        float adc_output_volts = ads1115->computeVolts(adc_output);
-        return kVoltageDividerScale * adc_output_volts / kMeasurementCurrent;
-      });
+sensesp::FloatProducer* ConnectTankSender(
+    Adafruit_ADS1115* ads1115, int channel, const String& name,
+    const String& sk_id, int sort_order, bool enable_signalk_output,
+    sensesp::FloatProducer* reference_rate) {
+  auto sender_resistance = ConnectSenderResistance(ads1115, channel);
+  return ConnectTankSender(sender_resistance, name, sk_id, sort_order,
+                           enable_signalk_output, reference_rate);
+}
 
+sensesp::FloatProducer* ConnectTankSender(
+    sensesp::FloatProducer* sender_resistance, const String& name,
+    const String& sk_id, int sort_order, bool enable_signalk_output,
+    sensesp::FloatProducer* reference_rate) {
   if (enable_signalk_output) {
     char resistance_sk_config_path[80];
     snprintf(resistance_sk_config_path, sizeof(resistance_sk_config_path),
@@ -51,8 +68,8 @@ sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
     snprintf(resistance_meta_description, sizeof(resistance_meta_description),
              "Measured tank %s sender resistance", name.c_str());
 
-    auto sender_resistance_sk_output = new sensesp::SKOutputFloat(
-        resistance_sk_path, resistance_sk_config_path,
+    auto sender_resistance_sk_output = ArenaNew<Stored<sensesp::SKOutputFloat>>(
+        resistance_sk_path, ConfigPath(resistance_sk_config_path),
         new sensesp::SKMetadata("ohm", resistance_meta_display_name,
                                 resistance_meta_description));
 
@@ -76,9 +93,10 @@ sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
   snprintf(curve_description, sizeof(curve_description),
            "Piecewise linear curve for the %s tank level", name.c_str());
 
-  auto tank_level = (new sensesp::CurveInterpolator(nullptr, curve_config_path))
-                        ->set_input_title("Sender Resistance (ohms)")
-                        ->set_output_title("Fuel Level (ratio)");
+  auto tank_level =
+      ArenaNew<LiveCurveInterpolator>(nullptr, ConfigPath(curve_config_path));
+  tank_level->set_input_title("Sender Resistance (ohms)")
+      ->set_output_title("Fuel Level (ratio)");
 
   ConfigItem(tank_level)
       ->set_title(curve_title)
@@ -93,7 +111,29 @@ sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
     tank_level->add_sample(sensesp::CurveInterpolator::Sample(1000., 1));
   }
 
-  sender_resistance->connect_to(tank_level);
+  // Reject sloshing before the level is published or sent anywhere
+
+  char filter_config_path[80];
+  snprintf(filter_config_path, sizeof(filter_config_path),
+           "/Tanks/%s/Level Filter", name.c_str());
+  char filter_title[80];
+  snprintf(filter_title, sizeof(filter_title), "%s Tank Level Filter",
+           name.c_str());
+
+  auto filtered_level = ArenaNew<TankLevelFilter>(filter_config_path);
+
+  ConfigItem(filtered_level)
+      ->set_title(filter_title)
+      ->set_description("Smoothing of the tank level against sloshing")
+      ->set_sort_order(sort_order + 6);
+
+  // A fixed chain: the curve runs inline, without a graph hop of its own
+  pipeline::From(sender_resistance) | pipeline::Curve(tank_level) |
+      pipeline::To(filtered_level);
+  // The filter takes minutes to fill, so keep it over a reset. The slow
+  // level is still valid half a minute later.
+  WarmStart::get()->add_state(filter_config_path, filtered_level);
+  WarmStart::get()->add_channel(filter_config_path, filtered_level, 30000);
 
   if (enable_signalk_output) {
     char level_config_path[80];
@@ -115,8 +155,8 @@ sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
     snprintf(level_meta_description, sizeof(level_meta_description),
              "Tank %s level", name.c_str());
 
-    auto tank_level_sk_output = new sensesp::SKOutputFloat(
-        level_sk_path, level_config_path,
+    auto tank_level_sk_output = ArenaNew<Stored<sensesp::SKOutputFloat>>(
+        level_sk_path, ConfigPath(level_config_path),
         new sensesp::SKMetadata("ratio", level_meta_display_name,
                                 level_meta_description));
 
@@ -125,7 +165,7 @@ sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
         ->set_description(level_description)
         ->set_sort_order(sort_order + 2);
 
-    tank_level->connect_to(tank_level_sk_output);
+    filtered_level->connect_to(tank_level_sk_output);
   }
 
   // Configure the linear transform for the tank volume
@@ -140,14 +180,14 @@ sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
   snprintf(volume_description, sizeof(volume_description),
            "Calculated total volume of the %s tank", name.c_str());
   auto tank_volume =
-      new sensesp::Linear(kTankDefaultSize, 0, volume_config_path);
+      ArenaNew<LiveLinear>(kTankDefaultSize, 0, ConfigPath(volume_config_path));
 
   ConfigItem(tank_volume)
       ->set_title(volume_title)
       ->set_description(volume_description)
       ->set_sort_order(sort_order + 3);
 
-  tank_level->connect_to(tank_volume);
+  filtered_level->connect_to(tank_volume);
 
   if (enable_signalk_output) {
     char volume_sk_config_path[80];
@@ -169,8 +209,8 @@ sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
     snprintf(volume_meta_description, sizeof(volume_meta_description),
              "Calculated tank %s remaining volume", name.c_str());
 
-    auto tank_volume_sk_output = new sensesp::SKOutputFloat(
-        volume_sk_path, volume_sk_config_path,
+    auto tank_volume_sk_output = ArenaNew<Stored<sensesp::SKOutputFloat>>(
+        volume_sk_path, ConfigPath(volume_sk_config_path),
         new sensesp::SKMetadata("m3", volume_meta_display_name,
                                 volume_meta_description));
 
@@ -182,7 +222,73 @@ sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
     tank_volume->connect_to(tank_volume_sk_output);
   }
 
-  return tank_level;
+  // Consumption rate and time to empty from the smoothed volume
+
+  char consumption_config_path[80];
+  snprintf(consumption_config_path, sizeof(consumption_config_path),
+           "/Tanks/%s/Consumption", name.c_str());
+  char consumption_title[80];
+  snprintf(consumption_title, sizeof(consumption_title),
+           "%s Tank Consumption", name.c_str());
+
+  auto consumption = ArenaNew<TankConsumption>(name, consumption_config_path);
+
+  ConfigItem(consumption)
+      ->set_title(consumption_title)
+      ->set_description("Consumption rate estimate from the tank volume")
+      ->set_sort_order(sort_order + 7);
+
+  tank_volume->connect_to(consumption);
+  WarmStart::get()->add_state(consumption_config_path, consumption);
+  if (reference_rate != nullptr) {
+    consumption->set_reference(reference_rate);
+  }
+
+  if (enable_signalk_output) {
+    char rate_config_path[80];
+    snprintf(rate_config_path, sizeof(rate_config_path),
+             "/Tanks/%s/Consumption Rate SK Path", name.c_str());
+    char rate_sk_path[80];
+    snprintf(rate_sk_path, sizeof(rate_sk_path), "tanks.%s.consumptionRate",
+             sk_id.c_str());
+    char rate_meta_display_name[80];
+    snprintf(rate_meta_display_name, sizeof(rate_meta_display_name),
+             "Tank %s consumption", name.c_str());
+
+    auto rate_sk_output = ArenaNew<Stored<sensesp::SKOutputFloat>>(
+        rate_sk_path, ConfigPath(rate_config_path),
+        new sensesp::SKMetadata("m3/s", rate_meta_display_name,
+                                "Consumption rate from the tank level"));
+
+    ConfigItem(rate_sk_output)
+        ->set_title(String(name) + " Tank Consumption Rate SK Path")
+        ->set_sort_order(sort_order + 8);
+
+    consumption->rate.connect_to(rate_sk_output);
+
+    char empty_config_path[80];
+    snprintf(empty_config_path, sizeof(empty_config_path),
+             "/Tanks/%s/Time To Empty SK Path", name.c_str());
+    char empty_sk_path[80];
+    snprintf(empty_sk_path, sizeof(empty_sk_path), "tanks.%s.timeToEmpty",
+             sk_id.c_str());
+    char empty_meta_display_name[80];
+    snprintf(empty_meta_display_name, sizeof(empty_meta_display_name),
+             "Tank %s time to empty", name.c_str());
+
+    auto empty_sk_output = ArenaNew<Stored<sensesp::SKOutputFloat>>(
+        empty_sk_path, ConfigPath(empty_config_path),
+        new sensesp::SKMetadata("s", empty_meta_display_name,
+                                "Time to empty at the current rate"));
+
+    ConfigItem(empty_sk_output)
+        ->set_title(String(name) + " Tank Time To Empty SK Path")
+        ->set_sort_order(sort_order + 9);
+
+    consumption->time_to_empty.connect_to(empty_sk_output);
+  }
+
+  return filtered_level;
 }
 
 ////// Engine Temperature Sensor - ConnectEngineSender /////
@@ -190,18 +296,17 @@ sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
 sensesp::FloatProducer* ConnectEngineSender(Adafruit_ADS1115* ads1115,
                                           int channel, const String& name,
                                           const String& sk_id, int sort_order,
-                                          bool enable_signalk_output) {
-  const uint ads_read_delay = 500;  // ms
-
-  // Configure the sender resistance sensor
-
-  auto sender_resistance =
-      new sensesp::RepeatSensor<float>(ads_read_delay, [ads1115, channel]() {
-        int16_t adc_output = ads1115->readADC_SingleEnded(channel);
-        float adc_output_volts = ads1115->computeVolts(adc_output);
-        return kVoltageDividerScale * adc_output_volts / kMeasurementCurrent;
-      });
+                                          bool enable_signalk_output,
+                                          const String& engine_id) {
+  auto sender_resistance = ConnectSenderResistance(ads1115, channel);
+  return ConnectEngineSender(sender_resistance, name, sk_id, sort_order,
+                             enable_signalk_output, engine_id);
+}
 
+sensesp::FloatProducer* ConnectEngineSender(
+    sensesp::FloatProducer* sender_resistance, const String& name,
+    const String& sk_id, int sort_order, bool enable_signalk_output,
+    const String& engine_id) {
   if (enable_signalk_output) {
     char resistance_sk_config_path[80];
     snprintf(resistance_sk_config_path, sizeof(resistance_sk_config_path),
@@ -215,7 +320,8 @@ sensesp::FloatProducer* ConnectEngineSender(Adafruit_ADS1115* ads1115,
              name.c_str());
     char resistance_sk_path[80];
     snprintf(resistance_sk_path, sizeof(resistance_sk_path),
-             "propulsion.1.%s.senderResistance", sk_id.c_str());
+             "propulsion.%s.%s.senderResistance", engine_id.c_str(),
+             sk_id.c_str());
     char resistance_meta_display_name[80];
     snprintf(resistance_meta_display_name, sizeof(resistance_meta_display_name),
              "Resistance %s", name.c_str());
@@ -223,10 +329,11 @@ sensesp::FloatProducer* ConnectEngineSender(Adafruit_ADS1115* ads1115,
     snprintf(resistance_meta_description, sizeof(resistance_meta_description),
              "%s sender resistance", name.c_str());
 
-    auto sender_resistance1_sk_output = new sensesp::SKOutputFloat(
-        resistance_sk_path, resistance_sk_config_path,
-        new sensesp::SKMetadata("ohm", resistance_meta_display_name,
-                                resistance_meta_description));
+    auto sender_resistance1_sk_output =
+        ArenaNew<Stored<sensesp::SKOutputFloat>>(
+            resistance_sk_path, ConfigPath(resistance_sk_config_path),
+            new sensesp::SKMetadata("ohm", resistance_meta_display_name,
+                                    resistance_meta_description));
 
     ConfigItem(sender_resistance1_sk_output)
         ->set_title(resistance_title)
@@ -248,9 +355,10 @@ sensesp::FloatProducer* ConnectEngineSender(Adafruit_ADS1115* ads1115,
   snprintf(curve_description, sizeof(curve_description),
            "Piecewise linear curve for the %s", name.c_str());
 
-  auto engine_level = (new sensesp::CurveInterpolator(nullptr, curve_config_path))
-                        ->set_input_title("Sender Resistance (ohms)")
-                        ->set_output_title("Fuel Level (ratio)");
+  auto engine_level =
+      ArenaNew<LiveCurveInterpolator>(nullptr, ConfigPath(curve_config_path));
+  engine_level->set_input_title("Sender Resistance (ohms)")
+      ->set_output_title("Fuel Level (ratio)");
 
   ConfigItem(engine_level)
       ->set_title(curve_title)
@@ -272,7 +380,10 @@ sensesp::FloatProducer* ConnectEngineSender(Adafruit_ADS1115* ads1115,
     engine_level->add_sample(sensesp::CurveInterpolator::Sample(300, 313.15));
   }
 
-  sender_resistance->connect_to(engine_level);
+  // A fixed chain: the curve runs inline, without a graph hop of its own
+  sensesp::FloatProducer* temperature = pipeline::From(sender_resistance) |
+                                        pipeline::Curve(engine_level) |
+                                        pipeline::ToProducer();
 
   if (enable_signalk_output) {
     char level_config_path[80];
@@ -285,8 +396,8 @@ sensesp::FloatProducer* ConnectEngineSender(Adafruit_ADS1115* ads1115,
     snprintf(level_description, sizeof(level_description),
              "Signal K path for the %s", name.c_str());
     char level_sk_path[80];
-    snprintf(level_sk_path, sizeof(level_sk_path), "propulsion.1.%s",
-             sk_id.c_str());
+    snprintf(level_sk_path, sizeof(level_sk_path), "propulsion.%s.%s",
+             engine_id.c_str(), sk_id.c_str());
     char level_meta_display_name[80];
     snprintf(level_meta_display_name, sizeof(level_meta_display_name),
              "%s", name.c_str());
@@ -294,8 +405,8 @@ sensesp::FloatProducer* ConnectEngineSender(Adafruit_ADS1115* ads1115,
     snprintf(level_meta_description, sizeof(level_meta_description),
              "%s", name.c_str());
 
-    auto engine_level_sk_output = new sensesp::SKOutputFloat(
-        level_sk_path, level_config_path,
+    auto engine_level_sk_output = ArenaNew<Stored<sensesp::SKOutputFloat>>(
+        level_sk_path, ConfigPath(level_config_path),
         new sensesp::SKMetadata("K", level_meta_display_name,
                                 level_meta_description));
 
@@ -304,10 +415,10 @@ sensesp::FloatProducer* ConnectEngineSender(Adafruit_ADS1115* ads1115,
         ->set_description(level_description)
         ->set_sort_order(sort_order + 2);
 
-    engine_level->connect_to(engine_level_sk_output);
+    temperature->connect_to(engine_level_sk_output);
   }
 
-  return engine_level;
+  return temperature;
 }
 
 ////// Engine Oil Pressure Sensor - ConnectEngineOilSender /////
@@ -315,18 +426,17 @@ sensesp::FloatProducer* ConnectEngineSender(Adafruit_ADS1115* ads1115,
 sensesp::FloatProducer* ConnectEngineOilSender(Adafruit_ADS1115* ads1115,
                                           int channel, const String& name,
                                           const String& sk_id, int sort_order,
-                                          bool enable_signalk_output) {
-  const uint ads_read_delay = 500;  // ms
-
-  // Configure the sender resistance sensor
-
-  auto sender_resistance =
-      new sensesp::RepeatSensor<float>(ads_read_delay, [ads1115, channel]() {
-        int16_t adc_output = ads1115->readADC_SingleEnded(channel);
-        float adc_output_volts = ads1115->computeVolts(adc_output);
-        return kVoltageDividerScale * adc_output_volts / kMeasurementCurrent;
-      });
+                                          bool enable_signalk_output,
+                                          const String& engine_id) {
+  auto sender_resistance = ConnectSenderResistance(ads1115, channel);
+  return ConnectEngineOilSender(sender_resistance, name, sk_id, sort_order,
+                                enable_signalk_output, engine_id);
+}
 
+sensesp::FloatProducer* ConnectEngineOilSender(
+    sensesp::FloatProducer* sender_resistance, const String& name,
+    const String& sk_id, int sort_order, bool enable_signalk_output,
+    const String& engine_id) {
   if (enable_signalk_output) {
     char resistance_sk_config_path[80];
     snprintf(resistance_sk_config_path, sizeof(resistance_sk_config_path),
@@ -340,7 +450,8 @@ sensesp::FloatProducer* ConnectEngineOilSender(Adafruit_ADS1115* ads1115,
              name.c_str());
     char resistance_sk_path[80];
     snprintf(resistance_sk_path, sizeof(resistance_sk_path),
-             "propulsion.1.%s.senderResistance", sk_id.c_str());
+             "propulsion.%s.%s.senderResistance", engine_id.c_str(),
+             sk_id.c_str());
     char resistance_meta_display_name[80];
     snprintf(resistance_meta_display_name, sizeof(resistance_meta_display_name),
              "Resistance %s", name.c_str());
@@ -348,10 +459,11 @@ sensesp::FloatProducer* ConnectEngineOilSender(Adafruit_ADS1115* ads1115,
     snprintf(resistance_meta_description, sizeof(resistance_meta_description),
              "%s sender resistance", name.c_str());
 
-    auto sender_resistance2_sk_output = new sensesp::SKOutputFloat(
-        resistance_sk_path, resistance_sk_config_path,
-        new sensesp::SKMetadata("ohm", resistance_meta_display_name,
-                                resistance_meta_description));
+    auto sender_resistance2_sk_output =
+        ArenaNew<Stored<sensesp::SKOutputFloat>>(
+            resistance_sk_path, ConfigPath(resistance_sk_config_path),
+            new sensesp::SKMetadata("ohm", resistance_meta_display_name,
+                                    resistance_meta_description));
 
     ConfigItem(sender_resistance2_sk_output)
         ->set_title(resistance_title)
@@ -373,8 +485,9 @@ sensesp::FloatProducer* ConnectEngineOilSender(Adafruit_ADS1115* ads1115,
   snprintf(curve_description, sizeof(curve_description),
            "Piecewise linear curve for the %s", name.c_str());
 
-  auto engine_oilPressure = (new sensesp::CurveInterpolator(nullptr, curve_config_path))
-                        ->set_input_title("Sender Resistance (ohms)");
+  auto engine_oilPressure =
+      ArenaNew<LiveCurveInterpolator>(nullptr, ConfigPath(curve_config_path));
+  engine_oilPressure->set_input_title("Sender Resistance (ohms)");
 
   ConfigItem(engine_oilPressure)
       ->set_title(curve_title)
@@ -398,7 +511,10 @@ sensesp::FloatProducer* ConnectEngineOilSender(Adafruit_ADS1115* ads1115,
     engine_oilPressure->add_sample(sensesp::CurveInterpolator::Sample(184, 0));
   }
 
-  sender_resistance->connect_to(engine_oilPressure);
+  // A fixed chain: the curve runs inline, without a graph hop of its own
+  sensesp::FloatProducer* oil_pressure = pipeline::From(sender_resistance) |
+                                         pipeline::Curve(engine_oilPressure) |
+                                         pipeline::ToProducer();
 
   if (enable_signalk_output) {
     char level_config_path[80];
@@ -411,8 +527,8 @@ sensesp::FloatProducer* ConnectEngineOilSender(Adafruit_ADS1115* ads1115,
     snprintf(level_description, sizeof(level_description),
              "Signal K path for the %s", name.c_str());
     char level_sk_path[80];
-    snprintf(level_sk_path, sizeof(level_sk_path), "propulsion.1.%s",
-             sk_id.c_str());
+    snprintf(level_sk_path, sizeof(level_sk_path), "propulsion.%s.%s",
+             engine_id.c_str(), sk_id.c_str());
     char level_meta_display_name[80];
     snprintf(level_meta_display_name, sizeof(level_meta_display_name),
              "%s", name.c_str());
@@ -420,20 +536,21 @@ sensesp::FloatProducer* ConnectEngineOilSender(Adafruit_ADS1115* ads1115,
     snprintf(level_meta_description, sizeof(level_meta_description),
              "%s", name.c_str());
 
-    auto engine_oilPressure_sk_output = new sensesp::SKOutputFloat(
-        level_sk_path, level_config_path,
-        new sensesp::SKMetadata("Pa", level_meta_display_name,
-                                level_meta_description));
+    auto engine_oilPressure_sk_output =
+        ArenaNew<Stored<sensesp::SKOutputFloat>>(
+            level_sk_path, ConfigPath(level_config_path),
+            new sensesp::SKMetadata("Pa", level_meta_display_name,
+                                    level_meta_description));
 
     ConfigItem(engine_oilPressure_sk_output)
         ->set_title(level_title)
         ->set_description(level_description)
         ->set_sort_order(sort_order + 2);
 
-    engine_oilPressure->connect_to(engine_oilPressure_sk_output);
+    oil_pressure->connect_to(engine_oilPressure_sk_output);
   }
 
-  return engine_oilPressure;
+  return oil_pressure;
 }
 
 }  // namespace halmet
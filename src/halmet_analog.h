@@ -3,28 +3,75 @@
 
 #include <Adafruit_ADS1X15.h>
 
+#include <functional>
+#include <vector>
+
+#include "adc_scheduler.h"
+#include "arena.h"
+#include "config_store.h"
+#include "live_config.h"
+#include "sample_log.h"
+#include "sender_resistance.h"
 #include "sensesp/sensors/sensor.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp/transforms/curveinterpolator.h"
+#include "sensesp/transforms/linear.h"
 #include "sensesp_base_app.h"
 
 namespace halmet {
 
-// HALMET voltage divider scale factor
-const float kVoltageDividerScale = 33.3 / 3.3;
+// Read the resistance (ohms) of the sender on an ADS1115 channel
+float ReadSenderResistance(Adafruit_ADS1115* ads1115, int channel);
 
-sensesp::FloatProducer* ConnectTankSender(Adafruit_ADS1115* ads1115,
-                                          int channel, const String& name,
-                                          const String& sk_id, int sort_order,
-                                          bool enable_signalk_output = true);
+// Calibration curves and scales whose configuration is applied without a
+// restart
+using LiveCurveInterpolator = LiveTransform<sensesp::CurveInterpolator>;
+using LiveLinear = LiveTransform<sensesp::Linear>;
+
+// Sender resistance (ohms) read from an ADS1115 channel every read_interval ms
+sensesp::FloatProducer* ConnectSenderResistance(
+    Adafruit_ADS1115* ads1115, int channel, unsigned int read_interval = 500);
+
+// The Connect*Sender functions build the chain for a resistive sender on an
+// ADS1115 channel. The overloads taking a sender_resistance producer build
+// the same chain on another source, such as an AdcScheduler channel or a
+// SampleReplay. Engine values go to propulsion.<engine_id>.<sk_id>.
+//
+// The tank chains return the level (ratio) after a TankLevelFilter, and
+// publish the consumption rate and time to empty. The consumption is
+// compared with reference_rate (m3/s) in the log, if given.
+
+sensesp::FloatProducer* ConnectTankSender(
+    Adafruit_ADS1115* ads1115, int channel, const String& name,
+    const String& sk_id, int sort_order, bool enable_signalk_output = true,
+    sensesp::FloatProducer* reference_rate = nullptr);
 
 sensesp::FloatProducer* ConnectEngineSender(Adafruit_ADS1115* ads1115,
                                           int channel, const String& name,
                                           const String& sk_id, int sort_order,
-                                          bool enable_signalk_output = true);
+                                          bool enable_signalk_output = true,
+                                          const String& engine_id = "1");
 
 sensesp::FloatProducer* ConnectEngineOilSender(Adafruit_ADS1115* ads1115,
                                           int channel, const String& name,
                                           const String& sk_id, int sort_order,
-                                          bool enable_signalk_output = true);
+                                          bool enable_signalk_output = true,
+                                          const String& engine_id = "1");
+
+sensesp::FloatProducer* ConnectTankSender(
+    sensesp::FloatProducer* sender_resistance, const String& name,
+    const String& sk_id, int sort_order, bool enable_signalk_output = true,
+    sensesp::FloatProducer* reference_rate = nullptr);
+
+sensesp::FloatProducer* ConnectEngineSender(
+    sensesp::FloatProducer* sender_resistance, const String& name,
+    const String& sk_id, int sort_order, bool enable_signalk_output = true,
+    const String& engine_id = "1");
+
+sensesp::FloatProducer* ConnectEngineOilSender(
+    sensesp::FloatProducer* sender_resistance, const String& name,
+    const String& sk_id, int sort_order, bool enable_signalk_output = true,
+    const String& engine_id = "1");
 
 class ADS1115VoltageInput : public sensesp::FloatSensor {
  public:
@@ -35,33 +82,116 @@ class ADS1115VoltageInput : public sensesp::FloatSensor {
       : sensesp::FloatSensor(config_path),
         ads1115_{ads1115},
         channel_{channel},
-        read_interval_{read_interval},
-        calibration_factor_{calibration_factor} {
+        config_{calibration_factor, read_interval} {
     load();
+    staged_.apply(config_);
+
+    repeat_event_ = set_repeat_event(config_.read_interval);
+  }
+
+  /// Read through an AdcScheduler instead of polling the ADS1115 directly
+  ADS1115VoltageInput(AdcScheduler* scheduler, int device, int channel,
+                      const String& config_path,
+                      float calibration_factor = 1.0)
+      : sensesp::FloatSensor(config_path),
+        ads1115_{nullptr},
+        scheduler_{scheduler},
+        device_{device},
+        channel_{channel},
+        config_{calibration_factor, 0} {
+    load();
+    staged_.apply(config_);
+
+    scheduler->add_voltage_channel(device, channel)
+        ->connect_to(ArenaNew<sensesp::LambdaConsumer<float>>(
+            [this](float volts) {
+              apply_config();
+              this->emit(config_.calibration_factor * volts);
+            }));
+  }
 
-    repeat_event_ = set_repeat_event(read_interval_);
+  /// Capture a burst of size samples at the ADC's maximum rate, through
+  /// the AdcScheduler. done is called with the calibrated voltages and the
+  /// sample rate (Hz), which is 0 if the burst failed. Returns false if the
+  /// input polls the ADS1115 directly or a burst is in progress.
+  bool capture_burst(int size,
+                     std::function<void(const float* volts, int size,
+                                        float sample_rate)>
+                         done) {
+    if (scheduler_ == nullptr || capturing_) {
+      return false;
+    }
+    // Allocated on the first burst, then reused
+    burst_counts_.resize(size);
+    burst_volts_.resize(size);
+    capturing_ = scheduler_->capture(
+        device_, channel_, burst_counts_.data(), size,
+        [this, size, done](float sample_rate) {
+          capturing_ = false;
+          apply_config();
+          Adafruit_ADS1115* ads = scheduler_->get_device(device_);
+          float scale = config_.calibration_factor * kVoltageDividerScale;
+          for (int i = 0; i < size; i++) {
+            burst_volts_[i] = scale * ads->computeVolts(burst_counts_[i]);
+          }
+          done(burst_volts_.data(), size, sample_rate);
+        });
+    return capturing_;
   }
 
+  /// True if the input polls the ADS1115 every read interval, false if the
+  /// AdcScheduler decides when it is read
+  bool has_read_interval() const { return ads1115_ != nullptr; }
+
   void update() {
+    apply_config();
     int16_t adc_output = ads1115_->readADC_SingleEnded(channel_);
+    SampleRecorder::get()->record(
+        static_cast<SampleSource>(
+            static_cast<int>(SampleSource::kA1Counts) + channel_),
+        adc_output);
     float adc_output_volts = ads1115_->computeVolts(adc_output);
-    this->emit(calibration_factor_ * kVoltageDividerScale * adc_output_volts);
+    this->emit(config_.calibration_factor * kVoltageDividerScale *
+               adc_output_volts);
   }
 
   virtual bool to_json(JsonObject& root) override {
-    root["calibration_factor"] = calibration_factor_;
+    Config config = config_;
+    staged_.peek(config);
+    root["calibration_factor"] = config.calibration_factor;
+    if (ads1115_ != nullptr) {
+      root["read_interval"] = config.read_interval;
+    }
     return true;
   };
 
+  // Changes are applied by the event loop before the next sample
   virtual bool from_json(const JsonObject& config) override {
-    if (config["calibration_factor"].is<float>()) {
-      calibration_factor_ = config["calibration_factor"];
-      return true;
+    if (!config["calibration_factor"].is<float>()) {
+      return false;
     }
-    return false;
+    Config new_config = config_;
+    staged_.peek(new_config);
+    new_config.calibration_factor = config["calibration_factor"];
+    if (ads1115_ != nullptr && config["read_interval"].is<int>()) {
+      new_config.read_interval =
+          std::max(config["read_interval"].as<unsigned int>(), 10U);
+    }
+    staged_.stage(new_config);
+    return true;
   }
 
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
  protected:
+  struct Config {
+    float calibration_factor;
+    unsigned int read_interval;  // ms, when polling the ADS1115
+  };
+
   reactesp::RepeatEvent* repeat_event_ = nullptr;
 
   reactesp::RepeatEvent* set_repeat_event(unsigned int read_interval) {
@@ -74,26 +204,51 @@ class ADS1115VoltageInput : public sensesp::FloatSensor {
     return repeat_event_;
   }
 
+  void apply_config() {
+    unsigned int read_interval = config_.read_interval;
+    if (!staged_.apply(config_) || config_.read_interval == read_interval) {
+      return;
+    }
+    // Not from within the repeat event being replaced
+    sensesp::event_loop()->onDelay(
+        0, [this]() { set_repeat_event(config_.read_interval); });
+  }
+
  private:
   Adafruit_ADS1115* ads1115_;
+  AdcScheduler* scheduler_ = nullptr;
+  int device_ = 0;
   int channel_;
-  unsigned int read_interval_;
-  float calibration_factor_;
+  Config config_;
+  StagedValue<Config> staged_;
+  std::vector<int16_t> burst_counts_;
+  std::vector<float> burst_volts_;
+  bool capturing_ = false;
 };
 
 inline const String ConfigSchema(const ADS1115VoltageInput& obj) {
-  const char SCHEMA[] = R"###({
+  // The read interval of an AdcScheduler input follows the scheduler
+  if (!obj.has_read_interval()) {
+    return R"###({
       "type": "object",
       "properties": {
           "calibration_factor": { "title": "Calibration factor", "type": "number", "description": "Multiplier to apply to the raw input value" }
       }
     })###";
+  }
+  const char SCHEMA[] = R"###({
+      "type": "object",
+      "properties": {
+          "calibration_factor": { "title": "Calibration factor", "type": "number", "description": "Multiplier to apply to the raw input value" },
+          "read_interval": { "title": "Read interval", "type": "integer", "description": "Milliseconds between readings" }
+      }
+    })###";
 
   return SCHEMA;
 }
 
 inline const bool ConfigRequiresRestart(const ADS1115VoltageInput& obj) {
-  return true;
+  return false;
 }
 
 }  // namespace halmet
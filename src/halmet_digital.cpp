@@ -1,13 +1,20 @@
 #include "halmet_digital.h"
 
+#include "arena.h"
+#include "config_store.h"
+#include "latency_tracer.h"
+#include "live_config.h"
+#include "sample_log.h"
 #include "sensesp/sensors/digital_input.h"
 #include "sensesp/sensors/sensor.h"
 #include "sensesp/signalk/signalk_output.h"
+#include "sensesp/system/lambda_consumer.h"
 #include "sensesp/transforms/frequency.h"
 #include "sensesp/ui/config_item.h"
 #define ENABLE_SIGNALK
 
 using namespace sensesp;
+using namespace halmet;
 
 // Default RPM count scale factor, corresponds to 100 pulses per revolution.
 // This is rarely, if ever correct.
@@ -15,7 +22,6 @@ const float kDefaultFrequencyScale = 1 / 100.;
 
 FloatProducer* ConnectTachoSender(int pin, String name) {
   char config_path[80];
-  char sk_path[80];
   char config_title[80];
   char config_description[80];
 
@@ -23,25 +29,49 @@ FloatProducer* ConnectTachoSender(int pin, String name) {
   snprintf(config_title, sizeof(config_title), "Tacho %s Pin", name.c_str());
   snprintf(config_description, sizeof(config_description), "Tacho %s Input Pin",
            name.c_str());
-  auto tacho_input =
-      new DigitalInputCounter(pin, INPUT, RISING, 500, config_path);
+  auto tacho_input = ArenaNew<Stored<DigitalInputCounter>>(pin, INPUT, RISING,
+                                                         500, config_path);
 
   ConfigItem(tacho_input)
       ->set_title(config_title)
       ->set_description(config_description);
 
+  int input_index = DigitalInputIndex(pin);
+  if (input_index >= 0) {
+    auto source = static_cast<SampleSource>(
+        static_cast<int>(SampleSource::kD1Count) + input_index);
+    tacho_input->connect_to(ArenaNew<LambdaConsumer<int>>([source](int count) {
+      SampleRecorder::get()->record(source, count);
+    }));
+  }
+
+  return ConnectTachoSender(tacho_input, name);
+}
+
+FloatProducer* ConnectTachoSender(IntProducer* tacho_input, String name) {
+  char config_path[80];
+  char sk_path[80];
+  char config_title[80];
+  char config_description[80];
+
   snprintf(config_path, sizeof(config_path), "/Tacho %s/Revolution Multiplier",
            name.c_str());
   snprintf(config_title, sizeof(config_title), "Tacho %s Multiplier",
            name.c_str());
   snprintf(config_description, sizeof(config_description),
            "Tacho %s Multiplier", name.c_str());
-  auto tacho_frequency = new Frequency(kDefaultFrequencyScale, config_path);
+  // The multiplier can be changed while the engine runs
+  auto tacho_frequency =
+      ArenaNew<LiveTransform<Frequency>>(kDefaultFrequencyScale,
+                                         ConfigPath(config_path));
 
   ConfigItem(tacho_frequency)
       ->set_title(config_title)
       ->set_description(config_description);
 
+  // Stamp the count before it goes through the chain
+  tacho_input->connect_to(ArenaNew<LambdaConsumer<int>>(
+      [](int) { LatencyTracer::get()->stamp(micros()); }));
   tacho_input->connect_to(tacho_frequency);
 
 #ifdef ENABLE_SIGNALK
@@ -53,7 +83,8 @@ FloatProducer* ConnectTachoSender(int pin, String name) {
   snprintf(config_description, sizeof(config_description),
            "Tacho %s Signal K Path", name.c_str());
 
-  auto tacho_frequency_sk_output = new SKOutputFloat(sk_path, config_path);
+  auto tacho_frequency_sk_output =
+      ArenaNew<Stored<SKOutputFloat>>(sk_path, ConfigPath(config_path));
 
   ConfigItem(tacho_frequency_sk_output)
       ->set_title(config_title)
@@ -66,13 +97,27 @@ FloatProducer* ConnectTachoSender(int pin, String name) {
 }
 
 BoolProducer* ConnectAlarmSender(int pin, String name) {
+  auto* alarm_input = ArenaNew<DigitalInputState>(pin, INPUT, 100);
+
+  int input_index = DigitalInputIndex(pin);
+  if (input_index >= 0) {
+    auto source = static_cast<SampleSource>(
+        static_cast<int>(SampleSource::kD1State) + input_index);
+    alarm_input->connect_to(
+        ArenaNew<LambdaConsumer<bool>>([source](bool state) {
+          SampleRecorder::get()->record(source, state);
+        }));
+  }
+
+  return ConnectAlarmSender(alarm_input, name);
+}
+
+BoolProducer* ConnectAlarmSender(BoolProducer* alarm_input, String name) {
   char config_path[80];
   char sk_path[80];
   char config_title[80];
   char config_description[80];
 
-  auto* alarm_input = new DigitalInputState(pin, INPUT, 100);
-
 #ifdef ENABLE_SIGNALK
   snprintf(config_path, sizeof(config_path), "/Alarm %s/SK Path", name.c_str());
   snprintf(sk_path, sizeof(sk_path), "alarm.%s", name.c_str());
@@ -81,7 +126,8 @@ BoolProducer* ConnectAlarmSender(int pin, String name) {
   snprintf(config_description, sizeof(config_description),
            "Alarm %s Signal K Path", name.c_str());
 
-  auto alarm_sk_output = new SKOutputBool(sk_path, config_path);
+  auto alarm_sk_output = ArenaNew<Stored<SKOutputBool>>(
+      sk_path, ConfigPath(config_path));
 
   ConfigItem(alarm_sk_output)
       ->set_title(config_title)
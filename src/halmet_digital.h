@@ -8,4 +8,9 @@ using namespace sensesp;
 FloatProducer* ConnectTachoSender(int pin, String name);
 BoolProducer* ConnectAlarmSender(int pin, String name);
 
+// Same as above, but driven by an existing pulse counter or state producer,
+// e.g. a SampleReplay.
+FloatProducer* ConnectTachoSender(IntProducer* tacho_input, String name);
+BoolProducer* ConnectAlarmSender(BoolProducer* alarm_input, String name);
+
 #endif
@@ -0,0 +1,117 @@
+#include "halmet_engine.h"
+
+#include "arena.h"
+#include "halmet_analog.h"
+#include "latency_tracer.h"
+#include "sensesp/signalk/signalk_output.h"
+#include "sensesp/system/observablevalue.h"
+#include "sensesp/transforms/lambda_transform.h"
+#include "sensesp/ui/config_item.h"
+
+namespace halmet {
+
+String EngineLabel(const String& engine_id, const char* label) {
+  if (engine_id == "1") {
+    return String("Engine ") + label;
+  }
+  return String("Engine ") + engine_id + " " + label;
+}
+
+sensesp::FloatProducer* UnconnectedInput() {
+  return ArenaNew<sensesp::ObservableValue<float>>();
+}
+
+EngineChannels ConnectEngine(const ChannelMap::Engine& engine,
+                             sensesp::FloatProducer* temperature_resistance,
+                             sensesp::FloatProducer* oil_pressure_resistance,
+                             sensesp::FloatProducer* revolutions,
+                             tNMEA2000* nmea2000, int sort_order) {
+  EngineChannels channels;
+  channels.revolutions = revolutions;
+  channels.oil_pressure = ConnectEngineOilSender(
+      oil_pressure_resistance, EngineLabel(engine.id, "Oil Pressure"),
+      "oilPressure", sort_order, true, engine.id);
+  channels.temperature = ConnectEngineSender(
+      temperature_resistance, EngineLabel(engine.id, "Temperature"),
+      "temperature", sort_order + 10, true, engine.id);
+
+  char config_path[80];
+  char config_title[80];
+  char config_description[80];
+
+  snprintf(config_path, sizeof(config_path), "/NMEA 2000/Engine %s Dynamic",
+           engine.id.c_str());
+  snprintf(config_title, sizeof(config_title), "Engine %s Dynamic",
+           engine.id.c_str());
+  snprintf(config_description, sizeof(config_description),
+           "NMEA 2000 dynamic engine parameters for engine %s",
+           engine.id.c_str());
+  channels.dynamic_sender = ArenaNew<N2kEngineParameterDynamicSender>(
+      config_path, engine.n2k_instance, nmea2000);
+
+  ConfigItem(channels.dynamic_sender)
+      ->set_title(config_title)
+      ->set_description(config_description)
+      ->set_sort_order(sort_order + 2010);
+
+  channels.temperature->connect_to(channels.dynamic_sender->temperature_);
+  channels.oil_pressure->connect_to(channels.dynamic_sender->oil_pressure_);
+  // Sampled just in time if the inputs are on-demand sources
+  channels.dynamic_sender->sample_before_send(temperature_resistance);
+  channels.dynamic_sender->sample_before_send(oil_pressure_resistance);
+  channels.dynamic_sender->trace_latency(
+      "propulsion." + engine.id + ".temperature.n2k", channels.temperature);
+  channels.dynamic_sender->trace_latency(
+      "propulsion." + engine.id + ".oilPressure.n2k", channels.oil_pressure);
+  LatencyTracer::get()->add_immediate_probe(
+      "propulsion." + engine.id + ".temperature.signalk.enqueue",
+      channels.temperature);
+  LatencyTracer::get()->add_immediate_probe(
+      "propulsion." + engine.id + ".oilPressure.signalk.enqueue",
+      channels.oil_pressure);
+
+  snprintf(config_path, sizeof(config_path),
+           "/NMEA 2000/Engine %s Rapid Update", engine.id.c_str());
+  snprintf(config_title, sizeof(config_title), "Engine %s Rapid Update",
+           engine.id.c_str());
+  snprintf(config_description, sizeof(config_description),
+           "NMEA 2000 rapid update engine parameters for engine %s",
+           engine.id.c_str());
+  channels.rapid_sender = ArenaNew<N2kEngineParameterRapidSender>(
+      config_path, engine.n2k_instance, nmea2000);
+
+  ConfigItem(channels.rapid_sender)
+      ->set_title(config_title)
+      ->set_description(config_description)
+      ->set_sort_order(sort_order + 2015);
+
+  revolutions->connect_to(&(channels.rapid_sender->engine_speed_));
+  channels.rapid_sender->trace_latency(
+      "propulsion." + engine.id + ".revolutions.n2k", revolutions);
+
+  channels.state = ArenaNew<EngineStateMachine>(
+      "/" + EngineLabel(engine.id, "State"));
+
+  ConfigItem(channels.state)
+      ->set_title(EngineLabel(engine.id, "State"))
+      ->set_description("Engine speed limits of the engine states")
+      ->set_sort_order(sort_order + 20);
+
+  revolutions->connect_to(channels.state);
+
+  // Signal K only knows started and stopped
+  channels.state
+      ->connect_to(ArenaNew<sensesp::LambdaTransform<EngineState, String>>(
+          [](EngineState state) {
+            return String(state == EngineState::kCranking ||
+                                  state == EngineState::kRunning
+                              ? "started"
+                              : "stopped");
+          }))
+      ->connect_to(ArenaNew<sensesp::SKOutputString>(
+          "propulsion." + engine.id + ".state"));
+
+  return channels;
+}
+
+}  // namespace halmet
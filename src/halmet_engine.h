@@ -0,0 +1,47 @@
+#ifndef HALMET_SRC_HALMET_ENGINE_H_
+#define HALMET_SRC_HALMET_ENGINE_H_
+
+#include <NMEA2000.h>
+
+#include "channel_map.h"
+#include "engine_state.h"
+#include "n2k_senders.h"
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/// Producers and N2K senders of one engine channel set
+struct EngineChannels {
+  sensesp::FloatProducer* temperature;   // K
+  sensesp::FloatProducer* oil_pressure;  // Pa
+  sensesp::FloatProducer* revolutions;   // r/s
+  N2kEngineParameterRapidSender* rapid_sender;
+  N2kEngineParameterDynamicSender* dynamic_sender;
+  EngineStateMachine* state;
+};
+
+/// UI and config label of an engine value. Engine "1" keeps the labels of
+/// the single-engine firmware, so that its saved configuration still applies.
+String EngineLabel(const String& engine_id, const char* label);
+
+/// A producer for an unconnected input. It never emits.
+sensesp::FloatProducer* UnconnectedInput();
+
+/**
+ * @brief Build the sender chains and N2K senders of one engine.
+ *
+ * The temperature and oil pressure senders are connected to the given
+ * resistance producers, and published to propulsion.<id>. Engine speed,
+ * temperature and oil pressure are sent in PGNs 127488 and 127489 with
+ * the configured N2K engine instance. The engine state is derived from the
+ * revolutions and published to propulsion.<id>.state.
+ */
+EngineChannels ConnectEngine(const ChannelMap::Engine& engine,
+                             sensesp::FloatProducer* temperature_resistance,
+                             sensesp::FloatProducer* oil_pressure_resistance,
+                             sensesp::FloatProducer* revolutions,
+                             tNMEA2000* nmea2000, int sort_order);
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_HALMET_ENGINE_H_
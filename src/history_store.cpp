@@ -0,0 +1,237 @@
+#include "history_store.h"
+
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/net/http_server.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp_app.h"
+
+namespace halmet {
+
+namespace {
+
+// Bucket length in seconds, number of buckets, and number of buckets of the
+// level below that make up one bucket, per level
+const int kLevelSeconds[HistoryStore::kNumLevels] = {1, 10, 60};
+const uint16_t kLevelSizes[HistoryStore::kNumLevels] = {600, 720, 2880};
+const uint16_t kLevelRatios[HistoryStore::kNumLevels] = {1, 10, 6};
+
+// Marks a bucket without data
+const int16_t kNoData = INT16_MIN;
+
+}  // namespace
+
+void HistoryStore::Accumulator::add(float min_value, float max_value,
+                                    float mean_value) {
+  if (count == 0) {
+    min = min_value;
+    max = max_value;
+  } else {
+    min = std::min(min, min_value);
+    max = std::max(max, max_value);
+  }
+  sum += mean_value;
+  count++;
+}
+
+bool HistoryStore::add_channel(const char* name, float scale, float offset,
+                               sensesp::FloatProducer* producer) {
+  if (num_channels_ >= kMaxChannels) {
+    debugE("Too many history channels, %s not stored", name);
+    return false;
+  }
+  bool psram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+  if (!psram && num_channels_ >= kMaxInternalChannels) {
+    debugW("No PSRAM, history of %s not stored", name);
+    return false;
+  }
+
+  // Allocated once here; the rings are never resized. Every bucket is
+  // written before it is read, so the rings aren't initialized.
+  Channel* channel = new Channel();
+  channel->name = name;
+  channel->scale = scale;
+  channel->offset = offset;
+  for (int i = 0; i < kNumLevels; i++) {
+    Level& level = channel->levels[i];
+    level.size = kLevelSizes[i];
+    level.buckets = static_cast<Bucket*>(
+        heap_caps_malloc(level.size * sizeof(Bucket),
+                         psram ? MALLOC_CAP_SPIRAM : MALLOC_CAP_8BIT));
+    if (level.buckets == nullptr) {
+      debugE("Not enough memory for the history of %s", name);
+      abort();
+    }
+  }
+  channels_[num_channels_++] = channel;
+
+  producer->connect_to(
+      ArenaNew<sensesp::LambdaConsumer<float>>([channel](float value) {
+        if (!isnan(value)) {
+          channel->samples.add(value, value, value);
+        }
+      }));
+  return true;
+}
+
+size_t HistoryStore::get_footprint() const {
+  size_t footprint = 0;
+  for (int i = 0; i < num_channels_; i++) {
+    footprint += sizeof(Channel);
+    for (int j = 0; j < kNumLevels; j++) {
+      footprint += channels_[i]->levels[j].size * sizeof(Bucket);
+    }
+  }
+  return footprint;
+}
+
+void HistoryStore::start() {
+  sensesp::event_loop()->onRepeat(1000, [this]() { this->tick(); });
+
+  auto handler = std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_GET, "/api/history",
+      [this](httpd_req_t* req) { return query(req); });
+  sensesp::sensesp_app->get_http_server()->add_handler(handler);
+
+  debugI("History of %d channels uses %u bytes", num_channels_,
+         get_footprint());
+}
+
+int16_t HistoryStore::quantize(const Channel& channel, float value) const {
+  return constrain(lroundf((value - channel.offset) * channel.scale), -32767,
+                   32767);
+}
+
+void HistoryStore::tick() {
+  for (int i = 0; i < num_channels_; i++) {
+    Channel* channel = channels_[i];
+    push(channel, 0, channel->samples);
+    channel->samples.reset();
+  }
+}
+
+void HistoryStore::push(Channel* channel, int level_index,
+                        const Accumulator& input) {
+  Level& level = channel->levels[level_index];
+  Bucket& bucket = level.buckets[level.head];
+  if (input.count == 0) {
+    bucket = {kNoData, kNoData, kNoData};
+  } else {
+    bucket = {quantize(*channel, input.min), quantize(*channel, input.max),
+              quantize(*channel, input.sum / input.count)};
+  }
+  level.head = (level.head + 1) % level.size;
+  if (level.filled < level.size) {
+    level.filled++;
+  }
+
+  // Feed the completed bucket to the next coarser level
+  if (level_index + 1 >= kNumLevels) {
+    return;
+  }
+  Level& next = channel->levels[level_index + 1];
+  if (input.count > 0) {
+    next.accumulator.add(input.min, input.max, input.sum / input.count);
+  }
+  if (++next.accumulator.inputs == kLevelRatios[level_index + 1]) {
+    Accumulator completed = next.accumulator;
+    next.accumulator.reset();
+    push(channel, level_index + 1, completed);
+  }
+}
+
+esp_err_t HistoryStore::query(httpd_req_t* req) {
+  int64_t start_us = esp_timer_get_time();
+
+  char query[96];
+  char name[24] = "";
+  char value[12];
+  int resolution = 1;
+  unsigned long seconds = ULONG_MAX;
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+    httpd_query_key_value(query, "channel", name, sizeof(name));
+    if (httpd_query_key_value(query, "resolution", value, sizeof(value)) ==
+        ESP_OK) {
+      resolution = atoi(value);
+    }
+    if (httpd_query_key_value(query, "seconds", value, sizeof(value)) ==
+        ESP_OK) {
+      seconds = strtoul(value, nullptr, 10);
+    }
+  }
+
+  const Channel* channel = nullptr;
+  for (int i = 0; i < num_channels_; i++) {
+    if (strcmp(channels_[i]->name, name) == 0) {
+      channel = channels_[i];
+    }
+  }
+  int level_index = -1;
+  for (int i = 0; i < kNumLevels; i++) {
+    if (kLevelSeconds[i] == resolution) {
+      level_index = i;
+    }
+  }
+  if (channel == nullptr || level_index < 0) {
+    httpd_resp_send_err(req, HTTPD_404_NOT_FOUND,
+                        "Unknown channel or resolution");
+    return ESP_FAIL;
+  }
+
+  // The rings are written by the event loop while this runs in the HTTP
+  // server task. Take the head once; a bucket overwritten during the
+  // response shows up as a newer value, not as a torn read of the ring.
+  const Level& level = channel->levels[level_index];
+  uint16_t head = level.head;
+  uint16_t filled = level.filled;
+  unsigned long wanted = seconds / resolution;
+  uint16_t count = wanted < filled ? wanted : filled;
+
+  httpd_resp_set_type(req, "application/json");
+  char buffer[512];
+  int length = snprintf(buffer, sizeof(buffer),
+                        "{\"channel\":\"%s\",\"resolution\":%d,"
+                        "\"buckets\":[",
+                        channel->name, resolution);
+
+  for (uint16_t i = 0; i < count; i++) {
+    const Bucket& bucket =
+        level.buckets[(head + level.size - count + i) % level.size];
+    const char* separator = i == 0 ? "" : ",";
+    if (bucket.mean == kNoData) {
+      length += snprintf(buffer + length, sizeof(buffer) - length, "%snull",
+                         separator);
+    } else {
+      length += snprintf(
+          buffer + length, sizeof(buffer) - length, "%s[%g,%g,%g]", separator,
+          bucket.min / channel->scale + channel->offset,
+          bucket.max / channel->scale + channel->offset,
+          bucket.mean / channel->scale + channel->offset);
+    }
+    if (length > static_cast<int>(sizeof(buffer)) - 64) {
+      if (httpd_resp_send_chunk(req, buffer, length) != ESP_OK) {
+        return ESP_FAIL;
+      }
+      length = 0;
+    }
+  }
+
+  length += snprintf(buffer + length, sizeof(buffer) - length, "]}");
+  if (httpd_resp_send_chunk(req, buffer, length) != ESP_OK) {
+    return ESP_FAIL;
+  }
+  httpd_resp_send_chunk(req, nullptr, 0);
+
+  uint32_t elapsed_us = esp_timer_get_time() - start_us;
+  if (elapsed_us > max_query_us_) {
+    max_query_us_ = elapsed_us;
+  }
+  debugD("History query %s/%d s: %u buckets in %u us (max %u us)",
+         channel->name, resolution, count, elapsed_us, max_query_us_);
+  return ESP_OK;
+}
+
+}  // namespace halmet
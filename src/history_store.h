@@ -0,0 +1,95 @@
+#ifndef HALMET_SRC_HISTORY_STORE_H_
+#define HALMET_SRC_HISTORY_STORE_H_
+
+#include <Arduino.h>
+#include <esp_http_server.h>
+
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/**
+ * @brief In-RAM history of a few channels at several resolutions.
+ *
+ * Each channel keeps three rings of min/max/mean buckets: 1 s for 10 min,
+ * 10 s for 2 h and 1 min for 48 h. The 1 s buckets summarize the samples
+ * received during that second; each coarser level is filled from the
+ * buckets completed in the level below, so the cost per second does not
+ * depend on the ring sizes. Values are stored as int16 of
+ * (value - offset) * scale, 6 bytes per bucket and about 25 kB per channel.
+ *
+ * The rings go to PSRAM on boards that have it. Without PSRAM, only the
+ * first kMaxInternalChannels channels are kept, at full resolution, and
+ * the others are dropped with a warning: add channels in order of
+ * importance.
+ *
+ * GET /api/history?channel=<name>&resolution=<1|10|60>[&seconds=<n>]
+ * returns the buckets covering the last n seconds, oldest first, as JSON.
+ * The response is streamed from the rings with a fixed stack buffer.
+ */
+class HistoryStore {
+ public:
+  static const int kMaxChannels = 4;
+  // Channels kept in internal RAM, on boards without PSRAM
+  static const int kMaxInternalChannels = 1;
+  static const int kNumLevels = 3;
+
+  /// Add a channel. Values must fit (value - offset) * scale in an int16.
+  /// Returns false if the channel isn't kept.
+  bool add_channel(const char* name, float scale, float offset,
+                   sensesp::FloatProducer* producer);
+
+  /// Start the 1 s tick and register the HTTP handler.
+  void start();
+
+  /// Bytes of bucket storage for all channels
+  size_t get_footprint() const;
+
+ protected:
+  struct Bucket {
+    int16_t min;
+    int16_t max;
+    int16_t mean;
+  };
+
+  // Running min/max/mean of the bucket being filled
+  struct Accumulator {
+    float min;
+    float max;
+    float sum;
+    uint16_t count;  // Values with data
+    uint16_t inputs;  // Values or sub-buckets received, with data or not
+
+    void reset() { *this = Accumulator{}; }
+    void add(float min_value, float max_value, float mean_value);
+  };
+
+  struct Level {
+    Bucket* buckets;
+    uint16_t size;
+    uint16_t head = 0;  // Next bucket to write
+    uint16_t filled = 0;
+    Accumulator accumulator;
+  };
+
+  struct Channel {
+    const char* name;
+    float scale;
+    float offset;
+    Level levels[kNumLevels];
+    Accumulator samples;  // Samples received in the current second
+  };
+
+  void tick();
+  void push(Channel* channel, int level_index, const Accumulator& input);
+  int16_t quantize(const Channel& channel, float value) const;
+  esp_err_t query(httpd_req_t* req);
+
+  Channel* channels_[kMaxChannels] = {};
+  int num_channels_ = 0;
+  uint32_t max_query_us_ = 0;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_HISTORY_STORE_H_
@@ -0,0 +1,171 @@
+#include "latency_tracer.h"
+
+#include <ArduinoJson.h>
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/net/http_server.h"
+#include "sensesp/signalk/signalk_output.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp_app.h"
+
+namespace halmet {
+
+namespace {
+
+int BinIndex(uint32_t age_ms) {
+  if (age_ms < 4) {
+    return age_ms;
+  }
+  int octave = 31 - __builtin_clz(age_ms);
+  int sub = (age_ms >> (octave - 2)) & 3;
+  return std::min(4 * (octave - 1) + sub, LatencyHistogram::kBins - 1);
+}
+
+// Lowest age of the next bin
+uint32_t BinUpperEdge(int bin) {
+  bin++;
+  if (bin < 4) {
+    return bin;
+  }
+  int octave = bin / 4 + 1;
+  return (4 + bin % 4) << (octave - 2);
+}
+
+}  // namespace
+
+void LatencyHistogram::add(uint32_t age_ms) {
+  uint16_t& bin = bins_[BinIndex(age_ms)];
+  if (bin < UINT16_MAX) {
+    bin++;
+  }
+  count_++;
+  max_ = std::max(max_, age_ms);
+}
+
+void LatencyHistogram::reset() { *this = LatencyHistogram(); }
+
+uint32_t LatencyHistogram::percentile(float fraction) const {
+  uint32_t target = ceilf(fraction * count_);
+  uint32_t sum = 0;
+  for (int i = 0; i < kBins; i++) {
+    sum += bins_[i];
+    if (sum >= target && sum > 0) {
+      return std::min(BinUpperEdge(i), max_);
+    }
+  }
+  return max_;
+}
+
+void LatencyProbe::latch() {
+  acquired_us_ = LatencyTracer::get()->get_stamp();
+  latched_ = true;
+}
+
+void LatencyProbe::send() {
+  if (!latched_) {
+    return;
+  }
+  uint32_t age_ms = (micros() - acquired_us_) / 1000;
+  if (age_ms <= max_age_ms_) {
+    current_.add(age_ms);
+  }
+}
+
+LatencyHistogram LatencyProbe::get_last() const {
+  portENTER_CRITICAL(&last_mux_);
+  LatencyHistogram last = last_;
+  portEXIT_CRITICAL(&last_mux_);
+  return last;
+}
+
+void LatencyProbe::roll() {
+  portENTER_CRITICAL(&last_mux_);
+  last_ = current_;
+  portEXIT_CRITICAL(&last_mux_);
+  current_.reset();
+}
+
+LatencyTracer* LatencyTracer::get() {
+  static LatencyTracer tracer;
+  return &tracer;
+}
+
+LatencyProbe* LatencyTracer::add_probe(const String& name,
+                                       sensesp::FloatProducer* input,
+                                       uint32_t max_age_ms) {
+  auto probe = ArenaNew<LatencyProbe>(name, max_age_ms);
+  probes_.push_back(probe);
+  input->connect_to(ArenaNew<sensesp::LambdaConsumer<float>>(
+      [probe](float) { probe->latch(); }));
+  return probe;
+}
+
+LatencyProbe* LatencyTracer::add_immediate_probe(
+    const String& name, sensesp::FloatProducer* input) {
+  auto probe = ArenaNew<LatencyProbe>(name, UINT32_MAX);
+  probes_.push_back(probe);
+  input->connect_to(
+      ArenaNew<sensesp::LambdaConsumer<float>>([probe](float) {
+        probe->latch();
+        probe->send();
+      }));
+  return probe;
+}
+
+void LatencyTracer::report() {
+  for (LatencyProbe* probe : probes_) {
+    probe->roll();
+  }
+}
+
+String LatencyTracer::to_json() const {
+  JsonDocument doc;
+  for (const LatencyProbe* probe : probes_) {
+    LatencyHistogram histogram = probe->get_last();
+    JsonObject obj = doc[probe->get_name()].to<JsonObject>();
+    obj["count"] = histogram.count();
+    obj["p50"] = histogram.percentile(0.5) / 1000.;
+    obj["p95"] = histogram.percentile(0.95) / 1000.;
+    obj["max"] = histogram.max() / 1000.;
+  }
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
+
+void LatencyTracer::enable_reporting() {
+  auto sk_outputs = ArenaNew<std::vector<sensesp::SKOutputRawJson*>>();
+  for (const LatencyProbe* probe : probes_) {
+    sk_outputs->push_back(ArenaNew<sensesp::SKOutputRawJson>(
+        "sensors.halmet.latency." + probe->get_name()));
+  }
+
+  sensesp::event_loop()->onRepeat(60000, [this, sk_outputs]() {
+    report();
+    for (size_t i = 0; i < probes_.size(); i++) {
+      LatencyHistogram histogram = probes_[i]->get_last();
+      if (histogram.count() == 0) {
+        continue;
+      }
+      char json[80];
+      snprintf(json, sizeof(json),
+               "{\"p50\":%.3f,\"p95\":%.3f,\"max\":%.3f,\"count\":%u}",
+               histogram.percentile(0.5) / 1000.,
+               histogram.percentile(0.95) / 1000., histogram.max() / 1000.,
+               histogram.count());
+      (*sk_outputs)[i]->set(json);
+    }
+  });
+
+  auto handler = std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_GET, "/api/latency", [this](httpd_req_t* req) {
+        String json = to_json();
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_send(req, json.c_str(), json.length());
+        return ESP_OK;
+      });
+  sensesp::sensesp_app->get_http_server()->add_handler(handler);
+}
+
+}  // namespace halmet
@@ -0,0 +1,121 @@
+#ifndef HALMET_SRC_LATENCY_TRACER_H_
+#define HALMET_SRC_LATENCY_TRACER_H_
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+#include <vector>
+
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/**
+ * @brief Histogram of ages in ms, with quarter-octave bins.
+ *
+ * Ages up to 3 ms have a bin each; above that every power of two is split
+ * into four bins, up to about two minutes. Percentiles are reported as the
+ * upper edge of their bin, so they are at most 19% high. Fixed size, O(1)
+ * per sample.
+ */
+class LatencyHistogram {
+ public:
+  static const int kBins = 64;
+
+  void add(uint32_t age_ms);
+  void reset();
+
+  uint32_t count() const { return count_; }
+  uint32_t max() const { return max_; }
+  /// Age in ms below which the given fraction of the samples falls
+  uint32_t percentile(float fraction) const;
+
+ private:
+  uint16_t bins_[kBins] = {};
+  uint32_t count_ = 0;
+  uint32_t max_ = 0;
+};
+
+/**
+ * @brief Age of the samples of one output at the time they are sent.
+ *
+ * latch() is called when the output caches a new value, send() when the
+ * cached value goes on the wire. The difference between the send time and
+ * the acquisition time of the cached sample is added to the histogram.
+ * Values older than max_age_ms are not sent by the output (they have
+ * expired) and are not counted.
+ */
+class LatencyProbe {
+ public:
+  LatencyProbe(const String& name, uint32_t max_age_ms)
+      : name_{name}, max_age_ms_{max_age_ms} {}
+
+  void latch();
+  void send();
+
+  const String& get_name() const { return name_; }
+  /// Copy of the last complete minute. Safe to call from any task.
+  LatencyHistogram get_last() const;
+  void roll();
+
+ private:
+  String name_;
+  uint32_t max_age_ms_;
+  bool latched_ = false;
+  uint32_t acquired_us_ = 0;
+  LatencyHistogram current_;
+  // Written by the event loop in roll() and read by the HTTP server task
+  LatencyHistogram last_;
+  mutable portMUX_TYPE last_mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
+
+/**
+ * @brief Sample-to-wire age tracing.
+ *
+ * The signal chains are synchronous: a sample travels from its source
+ * through every transform within one emit() call. A source stamps its
+ * acquisition time before emitting, and any probe latched during that
+ * call takes the stamp, so the timestamp follows the sample through the
+ * chain without changing the value types. Buffering stages, such as the
+ * tank level filter, emit during the call of their newest input sample,
+ * so their output is traced as of that sample.
+ *
+ * Stamping and latching are a few stores, and nothing is allocated per
+ * sample. Every minute, p50, p95 and max of the last minute are published
+ * to sensors.halmet.latency.<probe> and served at /api/latency.
+ */
+class LatencyTracer {
+ public:
+  static LatencyTracer* get();
+
+  /// Stamp the acquisition time of the sample about to be emitted
+  void stamp(uint32_t acquired_us) { stamp_us_ = acquired_us; }
+  uint32_t get_stamp() const { return stamp_us_; }
+
+  /// Probe for an output that caches the values of `input` and sends them
+  /// later, e.g. an N2K sender field. Call send() on it when sending.
+  LatencyProbe* add_probe(const String& name, sensesp::FloatProducer* input,
+                          uint32_t max_age_ms);
+
+  /// Probe for an output that sends every value of `input` right away, e.g.
+  /// a Signal K output. The age is taken when the value is queued for
+  /// sending, not when it leaves the device, so name the probe
+  /// "<path>.enqueue".
+  LatencyProbe* add_immediate_probe(const String& name,
+                                    sensesp::FloatProducer* input);
+
+  /// Start the statistics and publish them over Signal K and HTTP.
+  void enable_reporting();
+
+  String to_json() const;
+
+ protected:
+  void report();
+
+  uint32_t stamp_us_ = 0;
+  std::vector<LatencyProbe*> probes_;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_LATENCY_TRACER_H_
@@ -0,0 +1,138 @@
+#ifndef HALMET_SRC_LIVE_CONFIG_H_
+#define HALMET_SRC_LIVE_CONFIG_H_
+
+#include <ArduinoJson.h>
+
+#include <utility>
+
+#include "config_store.h"
+#include "sensesp/ui/config_item.h"
+#include "sensesp_base_app.h"
+#include "staged_value.h"
+
+namespace halmet {
+
+// True if value has the keys of reference, with values of the same JSON
+// types. Array elements are compared with the first element of the
+// reference array; an empty reference array matches any array.
+inline bool MatchesShape(JsonVariantConst value, JsonVariantConst reference) {
+  if (reference.is<JsonObjectConst>()) {
+    if (!value.is<JsonObjectConst>()) {
+      return false;
+    }
+    for (JsonPairConst pair : reference.as<JsonObjectConst>()) {
+      if (!MatchesShape(value[pair.key()], pair.value())) {
+        return false;
+      }
+    }
+    return true;
+  }
+  if (reference.is<JsonArrayConst>()) {
+    if (!value.is<JsonArrayConst>()) {
+      return false;
+    }
+    JsonArrayConst reference_array = reference.as<JsonArrayConst>();
+    if (reference_array.size() == 0) {
+      return true;
+    }
+    for (JsonVariantConst element : value.as<JsonArrayConst>()) {
+      if (!MatchesShape(element, reference_array[0])) {
+        return false;
+      }
+    }
+    return true;
+  }
+  if (reference.is<bool>()) {
+    return value.is<bool>();
+  }
+  if (reference.is<float>()) {
+    return value.is<float>();
+  }
+  if (reference.is<const char*>()) {
+    return value.is<const char*>();
+  }
+  return true;
+}
+
+/**
+ * @brief A SensESP transform whose configuration is applied between
+ * samples instead of after a restart.
+ *
+ * The configuration loaded at construction is applied directly. Later
+ * changes are checked against the keys and value types of the loaded
+ * configuration, staged and passed to the transform's own from_json() when
+ * the next input arrives, before it is processed. Until then, to_json()
+ * reports the staged configuration, so that it is what gets saved. The
+ * configuration is kept in the config store, if there is one.
+ */
+template <typename T>
+class LiveTransform : public Stored<T> {
+ public:
+  template <typename... Args>
+  LiveTransform(Args&&... args) : Stored<T>(std::forward<Args>(args)...) {
+    JsonObject root = shape_.to<JsonObject>();
+    T::to_json(root);
+  }
+
+  /// Stage config if it has the keys and value types of the configuration
+  /// at construction. Returns false and keeps the current configuration
+  /// otherwise, so that the web UI reports the error.
+  virtual bool from_json(const JsonObject& config) override {
+    if (!MatchesShape(config, shape_)) {
+      debugW("Rejected a configuration that doesn't match the transform");
+      return false;
+    }
+    JsonDocument document;
+    document.set(config);
+    staged_.stage(document);
+    return true;
+  }
+
+  virtual bool to_json(JsonObject& config) override {
+    JsonDocument document;
+    if (!staged_.peek(document)) {
+      return T::to_json(config);
+    }
+    for (JsonPair pair : document.as<JsonObject>()) {
+      config[pair.key()] = pair.value();
+    }
+    return true;
+  }
+
+  virtual void set(const typename T::input_type& input) override {
+    apply_staged();
+    T::set(input);
+  }
+
+  /// Apply the staged configuration, if any. For the pipeline stages that
+  /// read the configuration instead of calling set().
+  void apply_staged() {
+    if (!staged_.has_pending()) {
+      return;
+    }
+    JsonDocument document;
+    if (staged_.apply(document)) {
+      T::from_json(document.as<JsonObject>());
+    }
+  }
+
+ protected:
+  StagedValue<JsonDocument> staged_;
+  // Keys and value types of the configuration, for from_json(). Written
+  // at construction and only read afterwards.
+  JsonDocument shape_;
+};
+
+template <typename T>
+const String ConfigSchema(const LiveTransform<T>& obj) {
+  return ConfigSchema(static_cast<const T&>(obj));
+}
+
+template <typename T>
+bool ConfigRequiresRestart(const LiveTransform<T>& obj) {
+  return false;
+}
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_LIVE_CONFIG_H_
@@ -0,0 +1,21 @@
+#include "loop_monitor.h"
+
+#include "sensesp.h"
+#include "sensesp_base_app.h"
+
+namespace halmet {
+
+LoopMonitor* LoopMonitor::get() {
+  static LoopMonitor monitor;
+  return &monitor;
+}
+
+void LoopMonitor::start() {
+  sensesp::event_loop()->onRepeat(60000, [this]() {
+    debugD("Event loop: longest tick %u us at %u s", max_tick_us_,
+           max_tick_ms_ / 1000);
+    max_tick_us_ = 0;
+  });
+}
+
+}  // namespace halmet
@@ -0,0 +1,51 @@
+#ifndef HALMET_SRC_LOOP_MONITOR_H_
+#define HALMET_SRC_LOOP_MONITOR_H_
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+namespace halmet {
+
+/**
+ * @brief Longest event loop tick, to find stalls.
+ *
+ * Ticks are timed by the wall clock, so time in which the loop task is
+ * preempted by higher-priority tasks, such as the HTTP server sending a
+ * page, counts as well. The longest tick of each minute is logged with its
+ * time. A window, such as a page load, can also be timed on its own.
+ */
+class LoopMonitor {
+ public:
+  static LoopMonitor* get();
+
+  void start();
+
+  void tick_started() { tick_start_us_ = esp_timer_get_time(); }
+  void tick_finished() {
+    uint32_t tick_us = esp_timer_get_time() - tick_start_us_;
+    if (tick_us > max_tick_us_) {
+      max_tick_us_ = tick_us;
+      max_tick_ms_ = millis();
+    }
+    if (tick_us > window_max_tick_us_) {
+      window_max_tick_us_ = tick_us;
+    }
+  }
+
+  /// Start a window for get_window_max_us(). Can be called from any task.
+  void start_window() { window_max_tick_us_ = 0; }
+  /// Longest tick since start_window()
+  uint32_t get_window_max_us() const { return window_max_tick_us_; }
+
+ protected:
+  int64_t tick_start_us_ = 0;
+  uint32_t max_tick_us_ = 0;
+  uint32_t max_tick_ms_ = 0;  // Uptime of the longest tick
+  // Written by the event loop, reset and read by other tasks. A reset lost
+  // to a concurrent tick only keeps that tick.
+  volatile uint32_t window_max_tick_us_ = 0;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_LOOP_MONITOR_H_
@@ -9,6 +9,7 @@
 #include <Adafruit_SSD1306.h>
 #include <NMEA2000_esp32.h>
 #include <Adafruit_BMP280.h>
+#include <SPIFFS.h>
 #include <Wire.h>
 
 #include "n2k_senders.h"
@@ -33,13 +34,38 @@
 #define ENABLE_SIGNALK
 
 
+#include "adc_scheduler.h"
+#include "alarm_rules.h"
+#include "arena.h"
+#include "boot_timeline.h"
+#include "can_gateway.h"
+#include "can_metrics.h"
+#include "channel_logger.h"
+#include "channel_map.h"
+#include "config_cache.h"
+#include "config_store.h"
+#include "deferred_log.h"
 #include "halmet_analog.h"
 #include "halmet_const.h"
 #include "halmet_digital.h"
 #include "halmet_display.h"
+#include "halmet_engine.h"
 #include "halmet_serial.h"
+#include "history_store.h"
+#include "latency_tracer.h"
+#include "loop_monitor.h"
+#include "n2k_driver.h"
+#include "pipeline.h"
+#include "power_manager.h"
+#include "ripple_analyzer.h"
+#include "sample_log.h"
+#include "sample_scheduler.h"
 #include "sensesp/net/http_server.h"
 #include "sensesp/net/networking.h"
+#include "snapshot_server.h"
+#include "tacho_self_test.h"
+#include "warm_start.h"
+#include "windowed_statistics.h"
 
 using namespace sensesp;
 using namespace halmet;
@@ -53,19 +79,19 @@ class FuelInterpreter : public CurveInterpolator {
     // Populate a lookup table to translate RPM to m3/s
     clear_samples();
     // addSample(CurveInterpolator::Sample(RPM, m3/s));
-    add_sample(CurveInterpolator::Sample(500, 0.00000011));
-    add_sample(CurveInterpolator::Sample(1000, 0.00000019));
-    add_sample(CurveInterpolator::Sample(1500, 0.0000003));
-    add_sample(CurveInterpolator::Sample(1800, 0.00000041));
-    add_sample(CurveInterpolator::Sample(2000, 0.00000052));
-    add_sample(CurveInterpolator::Sample(2200, 0.00000066));
-    add_sample(CurveInterpolator::Sample(2400, 0.00000079));
-    add_sample(CurveInterpolator::Sample(2600, 0.00000097));
-    add_sample(CurveInterpolator::Sample(2800, 0.00000124));
-    add_sample(CurveInterpolator::Sample(3000, 0.00000153));
-    add_sample(CurveInterpolator::Sample(3200, 0.00000183));
-    add_sample(CurveInterpolator::Sample(3400, 0.000002));
-    add_sample(CurveInterpolator::Sample(3800, 0.00000205));  
+    add_sample(CurveInterpolator::Sample(500, 0.00000011f));
+    add_sample(CurveInterpolator::Sample(1000, 0.00000019f));
+    add_sample(CurveInterpolator::Sample(1500, 0.0000003f));
+    add_sample(CurveInterpolator::Sample(1800, 0.00000041f));
+    add_sample(CurveInterpolator::Sample(2000, 0.00000052f));
+    add_sample(CurveInterpolator::Sample(2200, 0.00000066f));
+    add_sample(CurveInterpolator::Sample(2400, 0.00000079f));
+    add_sample(CurveInterpolator::Sample(2600, 0.00000097f));
+    add_sample(CurveInterpolator::Sample(2800, 0.00000124f));
+    add_sample(CurveInterpolator::Sample(3000, 0.00000153f));
+    add_sample(CurveInterpolator::Sample(3200, 0.00000183f));
+    add_sample(CurveInterpolator::Sample(3400, 0.000002f));
+    add_sample(CurveInterpolator::Sample(3800, 0.00000205f));  
   }
 };
 
@@ -76,14 +102,25 @@ class FuelInterpreter : public CurveInterpolator {
 
 Adafruit_BMP280 bmp280;
 
-float read_temp_callback() { return (bmp280.readTemperature() + 273.15);}
-float read_pressure_callback() { return (bmp280.readPressure());}
+float read_temp_callback() {
+  float temperature = bmp280.readTemperature() + 273.15;
+  SampleRecorder::get()->record(SampleSource::kRoomTemp, temperature);
+  return temperature;
+}
+float read_pressure_callback() {
+  float pressure = bmp280.readPressure();
+  SampleRecorder::get()->record(SampleSource::kRoomPressure, pressure);
+  return pressure;
+}
+
+// Firmware version reported over NMEA 2000 and in the boot timeline
+const char kFirmwareVersion[] = "1.0.0";
 
 tNMEA2000* nmea2000;
-elapsedMillis n2k_time_since_rx = 0;
-elapsedMillis n2k_time_since_tx = 0;
 
 TwoWire* i2c;
+
+PowerManager* power_manager;
 Adafruit_SSD1306* display;
 
 // Store alarm states in an array for local display output
@@ -115,17 +152,154 @@ const int kTestOutputPin = GPIO_NUM_33;
 const int kTestOutputFrequency = 380;
 #endif
 
+// If ENABLE_TACHO_SELF_TEST is defined, the test output sweeps the tacho
+// range 10 s after boot, with the test output looped back to D1, and the
+// calibration table of the D1 tacho chain is logged and served at
+// /api/tacho_self_test. The test output stays off after the sweep. With
+// TACHO_SELF_TEST_SIMULATED, a simulated pulse source drives a separate
+// tacho chain instead, without any wiring.
+// #define ENABLE_TACHO_SELF_TEST
+// #define TACHO_SELF_TEST_SIMULATED
+#if defined(ENABLE_TACHO_SELF_TEST) && !defined(ENABLE_TEST_OUTPUT_PIN) && \
+    !defined(TACHO_SELF_TEST_SIMULATED)
+#error "The tacho self-test needs ENABLE_TEST_OUTPUT_PIN"
+#endif
+
+/////////////////////////////////////////////////////////////////////
+// Raw sample recording and replay. If ENABLE_SAMPLE_RECORDER is defined, the
+// raw inputs are recorded to kSampleLogPath on the filesystem. If
+// ENABLE_SAMPLE_REPLAY is defined, the tank, engine and tacho chains are fed
+// from that log instead of the hardware, and their outputs and the N2K
+// messages sent are written to kReplayOutputPath.
+// #define ENABLE_SAMPLE_RECORDER
+// #define ENABLE_SAMPLE_REPLAY
+const char kSampleLogPath[] = "/samples.bin";
+#ifdef ENABLE_SAMPLE_REPLAY
+const char kReplayOutputPath[] = "/replay.txt";
+// Replay speed relative to real time. Only a speed of 1 is faithful on the
+// device; see SampleReplay.
+const float kSampleReplaySpeed = 1;
+#endif
+
+/////////////////////////////////////////////////////////////////////
+// On-device channel history. If ENABLE_CHANNEL_LOGGER is defined, all
+// channels are sampled every kChannelLogInterval ms and logged to the
+// halmetlog flash partition. Download the log from /api/log. Only
+// halmet_partitions.csv has that partition, and the envs that use it define
+// HALMET_LOG_PARTITION.
+#ifdef HALMET_LOG_PARTITION
+#define ENABLE_CHANNEL_LOGGER
+#endif
+#ifdef ENABLE_CHANNEL_LOGGER
+// The ADS1115 inputs and the tacho counters, the fastest channels, update
+// every 500 ms, so this logs every sample they produce. A shorter interval
+// would only log repeated values.
+const unsigned int kChannelLogInterval = 500;
+#endif
+
+/////////////////////////////////////////////////////////////////////
+// If ENABLE_WINDOWED_STATISTICS is defined, count, mean, standard deviation,
+// min and max of the main engine values are sent to Signal K over 1 min,
+// 15 min and 1 h windows, as <path>.statistics.{1m,15m,1h}.
+#define ENABLE_WINDOWED_STATISTICS
+
+/////////////////////////////////////////////////////////////////////
+// If ENABLE_HISTORY_STORE is defined, the engine temperature, oil pressure
+// and RPM of the last 48 hours are kept in RAM at decreasing resolution and
+// served from /api/history for chart apps. Boards without PSRAM keep the
+// engine temperature only.
+#define ENABLE_HISTORY_STORE
+
+// If ENABLE_SNAPSHOT_SERVER is defined, the current value, age and validity
+// of every channel are served from /api/snapshot in one request.
+#define ENABLE_SNAPSHOT_SERVER
+
+// If ENABLE_CAN_GATEWAY is defined, all CAN frames can be streamed over TCP
+// or UDP in YDRAW or binary format for N2K diagnostics. The gateway is
+// enabled and configured in the web UI.
+#define ENABLE_CAN_GATEWAY
+
+// If ENABLE_JIT_SAMPLING is defined, the ADS1115 channels are converted
+// just before the N2K senders that use them transmit, and at least once a
+// second for Signal K. Otherwise, all channels are converted every 500 ms.
+// Both log the conversions per second; the data age at transmit is traced
+// by the latency tracer.
+#define ENABLE_JIT_SAMPLING
+
+// If ENABLE_RIPPLE_ANALYSIS is defined, the alternator voltage input of
+// each engine (A2 by default) is captured in uniformly timed bursts and
+// analyzed for ripple. The results go to Signal K and to the 127489 low
+// system voltage and charge indicator bits of that engine. The analysis is
+// benchmarked on the host in test/test_ripple.
+#define ENABLE_RIPPLE_ANALYSIS
+
+// If ENABLE_LOG_BENCHMARK is defined, the cost of a direct and a deferred
+// log call is measured once after setup and logged.
+// #define ENABLE_LOG_BENCHMARK
 
 /////////////////////////////////////////////////////////////////////
 // The setup function performs one-time application initialization.
 void setup() {
+  BootTimeline::get()->begin(kFirmwareVersion);
+
   SetupLogging(ESP_LOG_DEBUG);
+  // Check for a state snapshot of the previous run in RTC memory
+  WarmStart::get()->begin();
+  // Hot paths log with deferredD() and friends; the records are formatted
+  // and printed by a low-priority task.
+  DeferredLog::get()->begin();
 
   // These calls can be used for fine-grained control over the logging level.
   // esp_log_level_set("*", esp_log_level_t::ESP_LOG_DEBUG);
 
   Serial.begin(115200);
 
+  /////////////////////////////////////////////////////////////////////
+  // Initialize NMEA 2000 functionality
+
+  // The node is opened before WiFi starts, and after a warm start with the
+  // source address it had claimed, so that it is back on the bus first.
+  auto n2k_driver = new tNMEA2000_halmet(kCANTxPin, kCANRxPin);
+  nmea2000 = n2k_driver;
+
+  // Reserve enough buffer for sending all messages.
+  nmea2000->SetN2kCANSendFrameBufSize(250);
+  nmea2000->SetN2kCANReceiveFrameBufSize(250);
+
+  // Set Product information
+  // EDIT: Change the values below to match your device.
+  nmea2000->SetProductInformation(
+      "20231229",        // Manufacturer's Model serial code (max 32 chars)
+      104,               // Manufacturer's product code
+      "HALMET",          // Manufacturer's Model ID (max 33 chars)
+      kFirmwareVersion,  // Manufacturer's Software version code (max 40 chars)
+      "1.0.0"            // Manufacturer's Model version (max 24 chars)
+  );
+
+  // For device class/function information, see:
+  // http://www.nmea.org/Assets/20120726%20nmea%202000%20class%20&%20function%20codes%20v%202.00.pdf
+
+  // For mfg registration list, see:
+  // https://actisense.com/nmea-certified-product-providers/
+  // The format is inconvenient, but the manufacturer code below should be
+  // one not already on the list.
+
+  // EDIT: Change the class and function values below to match your device.
+  nmea2000->SetDeviceInformation(
+      GetBoardSerialNumber(),  // Unique number. Use e.g. Serial number.
+      140,                     // Device function: Engine
+      50,                      // Device class: Propulsion
+      2046);                   // Manufacturer code
+
+  // Default N2k node address, or the one claimed before a warm start
+  nmea2000->SetMode(tNMEA2000::N2km_NodeOnly,
+                    WarmStart::get()->n2k_source(71));
+  nmea2000->EnableForward(false);
+  nmea2000->Open();
+  // Send the address claim now rather than after setup()
+  nmea2000->ParseMessages();
+  BootTimeline::get()->mark(BootEvent::kN2kOpen);
+
   /////////////////////////////////////////////////////////////////////
   // Initialize the application framework
 
@@ -144,17 +318,36 @@ void setup() {
                     ->enable_ip_address_sensor()
                     ->enable_wifi_signal_sensor()
                     ->get_app();
+  BootTimeline::get()->mark(BootEvent::kAppReady);
+  ReportHeap("Before sensor graph");
+
+#ifdef HALMET_CONFIG_STORE
+  // Map the consolidated config store before any halmet nodes are created so
+  // that they are loaded from it instead of from individual files.
+  ConfigStore::get()->begin();
+#endif
 
   // initialize the I2C bus
   i2c = new TwoWire(0);
   i2c->begin(kSDAPin, kSCLPin);
-
-  // Initialize ADS1115
-  auto ads1115 = new Adafruit_ADS1115();
-
-  ads1115->setGain(kADS1115Gain);
-  bool ads_initialized = ads1115->begin(kADS1115Address, i2c);
-  debugD("ADS1115 initialized: %d", ads_initialized);
+  BootTimeline::get()->mark(BootEvent::kI2CReady);
+
+  // The channel map lists the ADS1115s, engines and tanks. The default is a
+  // single HALMET with one engine and one tank; edit it in the web UI.
+  auto channel_map = new ChannelMap("/Channel Map");
+
+  ConfigItem(channel_map)
+      ->set_title("Channel Map")
+      ->set_description("ADS1115 devices, engines and tanks")
+      ->set_sort_order(50);
+
+  // Initialize the ADS1115s. Conversions on all of them are interleaved by
+  // the scheduler.
+  auto adc_scheduler = new AdcScheduler(i2c, kADS1115Gain);
+  for (uint8_t address : channel_map->adc_addresses) {
+    adc_scheduler->add_device(address);
+  }
+  BootTimeline::get()->mark(BootEvent::kADS1115Ready);
 
 #ifdef ENABLE_TEST_OUTPUT_PIN
   pinMode(kTestOutputPin, OUTPUT);
@@ -166,51 +359,44 @@ void setup() {
   ledcWrite(kTestOutputPin, 4096);
 #endif
 
-  /////////////////////////////////////////////////////////////////////
-  // Initialize NMEA 2000 functionality
 
-  nmea2000 = new tNMEA2000_esp32(kCANTxPin, kCANRxPin);
+  // The engine and alarm states select the power profile. With the engines
+  // off, the sampling, display and CAN diagnostics intervals below are
+  // stretched.
+  power_manager = new PowerManager("/Power");
 
-  // Reserve enough buffer for sending all messages.
-  nmea2000->SetN2kCANSendFrameBufSize(250);
-  nmea2000->SetN2kCANReceiveFrameBufSize(250);
+  ConfigItem(power_manager)
+      ->set_title("Power Management")
+      ->set_description("Sampling intervals and sleep with the engines off")
+      ->set_sort_order(60);
 
-  // Set Product information
-  // EDIT: Change the values below to match your device.
-  nmea2000->SetProductInformation(
-      "20231229",  // Manufacturer's Model serial code (max 32 chars)
-      104,         // Manufacturer's product code
-      "HALMET",    // Manufacturer's Model ID (max 33 chars)
-      "1.0.0",     // Manufacturer's Software version code (max 40 chars)
-      "1.0.0"      // Manufacturer's Model version (max 24 chars)
-  );
+  /////////////////////////////////////////////////////////////////////
+  // NMEA 2000 diagnostics
 
-  // For device class/function information, see:
-  // http://www.nmea.org/Assets/20120726%20nmea%202000%20class%20&%20function%20codes%20v%202.00.pdf
+#ifdef ENABLE_CAN_GATEWAY
+  auto can_gateway = new CanGateway("/CAN Gateway");
 
-  // For mfg registration list, see:
-  // https://actisense.com/nmea-certified-product-providers/
-  // The format is inconvenient, but the manufacturer code below should be
-  // one not already on the list.
+  ConfigItem(can_gateway)
+      ->set_title("CAN Gateway")
+      ->set_description("Raw NMEA 2000 frame streaming over the network")
+      ->set_sort_order(2900);
 
-  // EDIT: Change the class and function values below to match your device.
-  nmea2000->SetDeviceInformation(
-      GetBoardSerialNumber(),  // Unique number. Use e.g. Serial number.
-      140,                     // Device function: Engine
-      50,                      // Device class: Propulsion
-      2046);                   // Manufacturer code
+  n2k_driver->set_gateway(can_gateway);
+  can_gateway->start(power_manager);
+#endif
 
-  nmea2000->SetMode(tNMEA2000::N2km_NodeOnly,
-                    71  // Default N2k node address
-  );
-  nmea2000->EnableForward(false);
-  nmea2000->Open();
+  // Frame and message rates, bus errors and the bus-off watchdog
+  CanMetrics::get()->start(nmea2000, power_manager);
 
   // No need to parse the messages at every single loop iteration; 1 ms will do
-  event_loop()->onRepeat(1, []() { nmea2000->ParseMessages(); });
+  power_manager->repeat(1, []() {
+    nmea2000->ParseMessages();
+    CanMetrics::get()->messages_parsed();
+  });
 
   // Initialize the OLED display
   bool display_present = InitializeSSD1306(sensesp_app->get(), &display, i2c);
+  BootTimeline::get()->mark(BootEvent::kDisplayReady);
 
   ///  1-Wire Temp Sensors ///
   /// Exhaust Temp Sensors ///
@@ -218,7 +404,8 @@ void setup() {
   DallasTemperatureSensors* dts = new DallasTemperatureSensors(4);
 
   auto* exhaust_temp =
-      new OneWireTemperature(dts, 1000, "/Exhaust Temperature/oneWire");
+      ArenaNew<Stored<OneWireTemperature>>(dts, 1000,
+                                           "/Exhaust Temperature/oneWire");
 
     ConfigItem(exhaust_temp)
       ->set_title("Exhaust Temperature Sender")
@@ -226,15 +413,16 @@ void setup() {
       ->set_sort_order(100);
 
     auto exhaust_temp_calibration =
-      new Linear(1.0, 0.0, "/Exhaust_Temperature/linear");
+      ArenaNew<LiveLinear>(1.0, 0.0, ConfigPath("/Exhaust_Temperature/linear"));
 
     ConfigItem(exhaust_temp_calibration)
       ->set_title("Exhaust Temperature Calibration")
       ->set_description("Calibration for the exhaust temperature sensor")
       ->set_sort_order(200);
 
-    auto exhaust_temp_sk_output = new SKOutputFloat(
-      "propulsion.engine.1.exhaustTemperature", "/Exhaust_Temperature/skPath");
+    auto exhaust_temp_sk_output = ArenaNew<Stored<SKOutputFloat>>(
+      "propulsion.engine.1.exhaustTemperature",
+      ConfigPath("/Exhaust_Temperature/skPath"));
      
      ConfigItem(exhaust_temp_sk_output)
       ->set_title("Exhaust Temperature Signal K Path")
@@ -244,10 +432,15 @@ void setup() {
     exhaust_temp->connect_to(exhaust_temp_calibration)
       ->connect_to(exhaust_temp_sk_output);
 
+    exhaust_temp->connect_to(ArenaNew<LambdaConsumer<float>>([](float value) {
+      SampleRecorder::get()->record(SampleSource::kExhaustTemp, value);
+    }));
+
 /// Oil Temp Sensors ///
 
   auto oil_temp =
-      new OneWireTemperature(dts, 1000, "/Oil Temperature/oneWire");
+      ArenaNew<Stored<OneWireTemperature>>(dts, 1000,
+                                           "/Oil Temperature/oneWire");
 
     ConfigItem(oil_temp)
       ->set_title("Oil Temperature Sender")
@@ -255,15 +448,16 @@ void setup() {
       ->set_sort_order(100);
 
     auto oil_temp_calibration =
-      new Linear(1.0, 0.0, "/oil_Temperature/linear");
+      ArenaNew<LiveLinear>(1.0, 0.0, ConfigPath("/oil_Temperature/linear"));
 
     ConfigItem(oil_temp_calibration)
       ->set_title("Oil Temperature Calibration")
       ->set_description("Calibration for the oil temperature sensor")
       ->set_sort_order(200);
 
-    auto oil_temp_sk_output = new SKOutputFloat(
-      "propulsion.engine.1.oilTemperature", "/oil_Temperature/skPath");
+    auto oil_temp_sk_output = ArenaNew<Stored<SKOutputFloat>>(
+      "propulsion.engine.1.oilTemperature",
+      ConfigPath("/oil_Temperature/skPath"));
      
      ConfigItem(oil_temp_sk_output)
       ->set_title("Oil Temperature Signal K Path")
@@ -272,6 +466,12 @@ void setup() {
 
     oil_temp->connect_to(oil_temp_calibration)
       ->connect_to(oil_temp_sk_output);
+
+    oil_temp->connect_to(ArenaNew<LambdaConsumer<float>>([](float value) {
+      SampleRecorder::get()->record(SampleSource::kOilTemp, value);
+    }));
+
+  BootTimeline::get()->mark(BootEvent::kOneWireReady);
   
   
   ///////////////////////////////////////////////////////////////////
@@ -279,62 +479,131 @@ void setup() {
 
   bool enable_signalk_output = true;
 
-  // Connect the tank senders.
-  // EDIT: To enable more tanks, uncomment the lines below.
-  auto tank_a1_volume = ConnectTankSender(ads1115, 0, "Fuel", "fuel.main", 3000,
-                                          enable_signalk_output);
-  // auto tank_a3_volume = ConnectTankSender(ads1115, 1, "A2");
-  auto engine_OilPressure = ConnectEngineOilSender(ads1115, 2, "Engine Oil Pressure", "oilPressure", 1000,
-                                          enable_signalk_output);
-  auto engine_temperature = ConnectEngineSender(ads1115, 3, "Engine Temperature", "temperature", 1000,
-                                          enable_signalk_output);
+#ifdef ENABLE_SAMPLE_RECORDER
+  SampleRecorder::get()->begin(SPIFFS, kSampleLogPath);
+#endif
+
+#ifdef ENABLE_SAMPLE_REPLAY
+  auto replay = new SampleReplay(
+      SPIFFS, kSampleLogPath, kSampleReplaySpeed,
+      adc_scheduler->get_device(0)->computeVolts(1), kReplayOutputPath);
+#endif
+
+  // Sender resistance of a channel map input. The replay only covers the
+  // inputs of the first ADS1115.
+  auto sender_input = [&](int input) -> FloatProducer* {
+    if (input < 0) {
+      return UnconnectedInput();
+    }
+#ifdef ENABLE_SAMPLE_REPLAY
+    if (input < AdcScheduler::kChannels) {
+      return replay->sender_resistance(input);
+    }
+#endif
+    return adc_scheduler->add_resistance_channel(
+        input / AdcScheduler::kChannels, input % AdcScheduler::kChannels);
+  };
+
+  // Total fuel rate of the engines from their tacho, set up with the
+  // engines below. The fuel tank consumption is compared against it.
+  auto engine_fuel_rate = ArenaNew<ObservableValue<float>>();
+
+  // Connect the tank senders listed in the channel map. The level (ratio)
+  // of the first tank feeds the display, alarm, logs and snapshot.
+  FloatProducer* tank_a1_level = nullptr;
+  for (size_t i = 0; i < channel_map->tanks.size(); i++) {
+    const ChannelMap::Tank& tank = channel_map->tanks[i];
+    bool fuel_tank = tank.sk_id.startsWith("fuel");
+    FloatProducer* tank_resistance = sender_input(tank.input);
+    auto tank_level = ConnectTankSender(
+        tank_resistance, tank.name, tank.sk_id, 3000 + 10 * i,
+        enable_signalk_output, fuel_tank ? engine_fuel_rate : nullptr);
+    if (tank_a1_level == nullptr) {
+      tank_a1_level = tank_level;
+    }
 
 #ifdef ENABLE_NMEA2000_OUTPUT
-  // Tank 1, instance 0. Capacity 150 liters. You can change the capacity
-  // in the web UI as well.
-  // EDIT: Make sure this matches your tank configuration above.
-  N2kFluidLevelSender* tank_a1_sender = new N2kFluidLevelSender(
-      "/Tanks/Fuel/NMEA 2000", 0, N2kft_Fuel, 150, nmea2000);
-
-  ConfigItem(tank_a1_sender)
-      ->set_title("Tank A1 NMEA 2000")
-      ->set_description("NMEA 2000 tank sender for tank A1")
-      ->set_sort_order(3005);
-
-  tank_a1_volume->connect_to(&(tank_a1_sender->tank_level_));
+    // The fluid type and capacity come from the channel map; the capacity
+    // can also be changed in the web UI.
+    char tank_config_path[80];
+    snprintf(tank_config_path, sizeof(tank_config_path),
+             "/Tanks/%s/NMEA 2000", tank.name.c_str());
+    char tank_title[80];
+    snprintf(tank_title, sizeof(tank_title), "Tank %s NMEA 2000",
+             tank.name.c_str());
+    N2kFluidLevelSender* tank_sender = ArenaNew<N2kFluidLevelSender>(
+        tank_config_path, tank.n2k_instance,
+        static_cast<tN2kFluidType>(tank.fluid_type), tank.capacity, nmea2000);
+
+    ConfigItem(tank_sender)
+        ->set_title(tank_title)
+        ->set_description("NMEA 2000 tank sender")
+        ->set_sort_order(3005 + 10 * i);
+
+    tank_level->connect_to(&(tank_sender->tank_level_));
+    // Sampled just in time if the input is an on-demand source
+    tank_sender->sample_before_send(tank_resistance);
+    tank_sender->trace_latency("tanks." + tank.sk_id + ".currentLevel.n2k",
+                               tank_level);
 #endif  // ENABLE_NMEA2000_OUTPUT
+  }
+  if (tank_a1_level == nullptr) {
+    tank_a1_level = UnconnectedInput();
+  }
 
   if (display_present) {
     // EDIT: Duplicate the lines below to make the display show all your tanks.
-    tank_a1_volume->connect_to(new LambdaConsumer<float>(
+    tank_a1_level->connect_to(ArenaNew<LambdaConsumer<float>>(
         [](float value) { PrintValue(display, 2, "Tank A1", 100 * value); }));
   }
 
-  // Read the voltage level of analog input A2
-  auto a2_voltage = new ADS1115VoltageInput(ads1115, 1, "/Voltage A2");
-
-  ConfigItem(a2_voltage)
-      ->set_title("Analog Voltage A2")
-      ->set_description("Voltage level of analog input A2")
-      ->set_sort_order(3000);
-
-  a2_voltage->connect_to(new LambdaConsumer<float>(
-      [](float value) { debugD("Voltage A2: %f", value); }));
-
-  // If you want to output something else than the voltage value,
-  // you can insert a suitable transform here.
-  // For example, to convert the voltage to a distance with a conversion
-  // factor of 0.17 m/V, you could use the following code:
-  // auto a2_distance = new Linear(0.17, 0.0);
-  // a2_voltage->connect_to(a2_distance);
+  // Read the alternator voltage of each engine that has one in the channel
+  // map, by default analog input A2 of the first engine. The names follow
+  // the input, e.g. "/Voltage A2" and sensors.a2.voltage.
+  std::vector<ADS1115VoltageInput*> engine_voltages;
+  for (size_t i = 0; i < channel_map->engines.size(); i++) {
+    int input = channel_map->engines[i].voltage_input;
+    if (input < 0) {
+      engine_voltages.push_back(nullptr);
+      continue;
+    }
+    String name = ChannelMap::input_name(input);
+    String id = ChannelMap::input_id(input);
+    auto voltage = ArenaNew<ADS1115VoltageInput>(
+        adc_scheduler, input / AdcScheduler::kChannels,
+        input % AdcScheduler::kChannels, "/Voltage " + name);
+
+    ConfigItem(voltage)
+        ->set_title("Analog Voltage " + name)
+        ->set_description("Voltage level of analog input " + name)
+        ->set_sort_order(3500 + 10 * i);
+
+    // If you want to output something else than the voltage value,
+    // you can insert a suitable transform here.
+    // For example, to convert the voltage to a distance with a conversion
+    // factor of 0.17 m/V, you could use the following code:
+    // auto distance = new Linear(0.17, 0.0);
+    // voltage->connect_to(distance);
+
+    voltage->connect_to(ArenaNew<SKOutputFloat>(
+        "sensors." + id + ".voltage", "Analog Voltage " + name,
+        new SKMetadata("V", "Analog Voltage " + name)));
+    engine_voltages.push_back(voltage);
+  }
+  // The first alternator voltage feeds the statistics, logs and snapshot
+  FloatProducer* a2_voltage = UnconnectedInput();
+  String a2_id = "a2";
+  for (size_t i = 0; i < engine_voltages.size(); i++) {
+    if (engine_voltages[i] != nullptr) {
+      a2_voltage = engine_voltages[i];
+      a2_id = ChannelMap::input_id(channel_map->engines[i].voltage_input);
+      break;
+    }
+  }
+  a2_voltage->connect_to(ArenaNew<LambdaConsumer<float>>(
+      [](float value) { deferredD("Alternator voltage: %f", value); }));
 
-  a2_voltage->connect_to(
-      new SKOutputFloat("sensors.a2.voltage", "Analog Voltage A2",
-                        new SKMetadata("V", "Analog Voltage A2")));
-  // Example of how to output the distance value to Signal K.
-  // a2_distance->connect_to(
-  //     new SKOutputFloat("sensors.a2.distance", "Analog Distance A2",
-  //                       new SKMetadata("m", "Analog Distance A2")));
+  BootTimeline::get()->mark(BootEvent::kAnalogReady);
 
   ///////////////////////////////////////////////////////////////////
   // Digital alarm inputs
@@ -347,61 +616,269 @@ void setup() {
 
   // Update the alarm states based on the input value changes.
   // EDIT: If you added more alarm inputs, uncomment the respective lines below.
-  alarm_d2_input->connect_to(
-      new LambdaConsumer<bool>([](bool value) { alarm_states[1] = value; }));
+  alarm_d2_input->connect_to(ArenaNew<LambdaConsumer<bool>>(
+      [](bool value) { alarm_states[1] = value; }));
   // In this example, alarm_d3_input is active low, so invert the value.
   auto alarm_d3_inverted = alarm_d3_input->connect_to(
-      new LambdaTransform<bool, bool>([](bool value) { return !value; }));
-  alarm_d3_inverted->connect_to(
-      new LambdaConsumer<bool>([](bool value) { alarm_states[2] = value; }));
+      ArenaNew<LambdaTransform<bool, bool>>([](bool value) { return !value; }));
+  alarm_d3_inverted->connect_to(ArenaNew<LambdaConsumer<bool>>(
+      [](bool value) { alarm_states[2] = value; }));
   // alarm_d4_input->connect_to(
   //     new LambdaConsumer<bool>([](bool value) { alarm_states[3] = value; }));
 
-  // EDIT: This example connects the D2 alarm input to the low oil pressure
-  // warning. Modify according to your needs.
-  N2kEngineParameterDynamicSender* engine_dynamic_sender =
-      new N2kEngineParameterDynamicSender("/NMEA 2000/Engine 1 Dynamic", 0,
-                                          nmea2000);
-
-  ConfigItem(engine_dynamic_sender)
-      ->set_title("Engine 1 Dynamic")
-      ->set_description("NMEA 2000 dynamic engine parameters for engine 1")
-      ->set_sort_order(3010);
+  // Send the alarm input changes to Signal K as notifications.
+  ConnectAlarmNotification(alarm_d2_input, "notifications.alarm.engineBilge",
+                           "Engine bilge alarm");
+  ConnectAlarmNotification(alarm_d3_inverted, "notifications.alarm.D3",
+                           "D3 alarm");
 
-  alarm_d2_input->connect_to(engine_dynamic_sender->low_oil_pressure_);
-
-  // This is just an example -- normally temperature alarms would not be
-  // active-low (inverted).
-  alarm_d3_inverted->connect_to(engine_dynamic_sender->over_temperature_);
+  ///////////////////////////////////////////////////////////////////
+  // Engines
+
+  // Each engine in the channel map gets its tacho, temperature and oil
+  // pressure senders and its own N2K engine instance. The first engine also
+  // feeds the display, statistics, history and logs below.
+  std::vector<EngineChannels> engines;
+  for (size_t i = 0; i < channel_map->engines.size(); i++) {
+    const ChannelMap::Engine& engine = channel_map->engines[i];
+
+    FloatProducer* revolutions;
+    int tacho_index = DigitalInputIndex(engine.tacho_pin);
+#ifdef ENABLE_SAMPLE_REPLAY
+    if (tacho_index >= 0) {
+      revolutions = ConnectTachoSender(replay->counter(tacho_index), engine.id);
+    } else {
+      revolutions = UnconnectedInput();
+    }
+#else
+    if (tacho_index >= 0) {
+      revolutions = ConnectTachoSender(engine.tacho_pin, engine.id);
+    } else {
+      revolutions = UnconnectedInput();
+    }
+#endif
 
-  // FIXME: Transmit the alarms over SK as well.
+    engines.push_back(ConnectEngine(
+        engine, sender_input(engine.temperature_input),
+        sender_input(engine.oil_pressure_input), revolutions, nmea2000,
+        1000 + 100 * i));
+
+    // Re-emitted after a warm start, so the first 127488 and 127489 are
+    // valid
+    const EngineChannels& channels = engines.back();
+    String prefix = "propulsion." + engine.id;
+    WarmStart::get()->add_channel(prefix + ".temperature",
+                                  channels.temperature);
+    WarmStart::get()->add_channel(prefix + ".oilPressure",
+                                  channels.oil_pressure);
+    WarmStart::get()->add_channel(prefix + ".revolutions",
+                                  channels.revolutions);
+  }
+#ifdef ENABLE_JIT_SAMPLING
+  // The monitor keeps the 500 ms Signal K rate of the ADC inputs
+  adc_scheduler->start_on_demand(500);
+  power_manager->connect_to(ArenaNew<LambdaConsumer<float>>(
+      [](float scale) { SampleScheduler::get()->set_scale(scale); }));
+#else
+  adc_scheduler->start();
+  power_manager->connect_to(
+      ArenaNew<LambdaConsumer<float>>([adc_scheduler](float scale) {
+        adc_scheduler->set_read_interval(500 * scale);
+      }));
+#endif
+  for (const EngineChannels& channels : engines) {
+    power_manager->add_engine(channels.state);
+  }
 
-  ///////////////////////////////////////////////////////////////////
-    // Digital tacho inputs
+  // Fuel rate of each engine from its speed, and the total of all engines
+  auto engine_fuel_rates = ArenaNew<std::vector<float>>(engines.size(), 0);
+  for (size_t i = 0; i < engines.size(); i++) {
+    const String& id = channel_map->engines[i].id;
+    EngineStateMachine* state = engines[i].state;
+    // A fixed chain, composed into a single graph node
+    FloatProducer* fuel_rate =
+        pipeline::From(engines[i].revolutions) | pipeline::Scale(60) |
+        pipeline::Curve(ArenaNew<FuelInterpreter>()) |
+        pipeline::Apply([state](float rate) {
+          // The curve doesn't go to zero below idle
+          return state->get_state() == EngineState::kRunning ? rate : 0;
+        }) |
+        pipeline::ToProducer();
+    fuel_rate->connect_to(ArenaNew<SKOutputFloat>(
+        "propulsion." + id + ".fuel.rate", "",
+        new SKMetadata("m3/s", "Engine " + id + " fuel rate")));
+    fuel_rate->connect_to(ArenaNew<LambdaConsumer<float>>(
+        [engine_fuel_rates, engine_fuel_rate, i](float rate) {
+          (*engine_fuel_rates)[i] = rate;
+          float total = 0;
+          for (float engine_rate : *engine_fuel_rates) {
+            total += engine_rate;
+          }
+          engine_fuel_rate->set(total);
+        }));
+  }
 
-  // Connect the tacho senders. Engine name is "main".
-  // EDIT: More tacho inputs can be defined by duplicating the line below.
-  auto tacho_d1_frequency = ConnectTachoSender(kDigitalInputPin1, "1");
+  if (engines.empty()) {
+    // Keep the single-engine extras below connected to something
+    engines.push_back({UnconnectedInput(), UnconnectedInput(),
+                       UnconnectedInput(), nullptr, nullptr, nullptr});
+  }
+  auto engine_temperature = engines[0].temperature;
+  auto engine_OilPressure = engines[0].oil_pressure;
+  auto tacho_d1_frequency = engines[0].revolutions;
+
+#ifdef ENABLE_TACHO_SELF_TEST
+#ifdef TACHO_SELF_TEST_SIMULATED
+  auto pulse_source = new SimulatedPulseSource();
+  auto tacho_self_test = new TachoSelfTest(
+      pulse_source, ConnectTachoSender(pulse_source, "selfTest"));
+#else
+  auto tacho_self_test = new TachoSelfTest(
+      new LedcPulseSource(kTestOutputPin), tacho_d1_frequency);
+#endif
+  tacho_self_test->enable_reporting();
+  tacho_self_test->start(10000);
+#endif
 
-  // Connect outputs to the N2k senders.
-  // EDIT: Make sure this matches your tacho configuration above.
-  //       Duplicate the lines below to connect more tachos, but be sure to
-  //       use different engine instances.
-  N2kEngineParameterRapidSender* engine_rapid_sender =
-      new N2kEngineParameterRapidSender("/NMEA 2000/Engine 1 Rapid Update", 0,
-                                        nmea2000);  // Engine 1, instance 0
+  if (display_present) {
+    pipeline::From(tacho_d1_frequency) | pipeline::Scale(60) |
+        pipeline::ToCallable(
+            [](float rpm) { PrintValue(display, 3, "RPM D1", rpm); });
+  }
 
-  ConfigItem(engine_rapid_sender)
-      ->set_title("Engine 1 Rapid Update")
-      ->set_description("NMEA 2000 rapid update engine parameters for engine 1")
-      ->set_sort_order(3015);
+  ///////////////////////////////////////////////////////////////////
+  // Engine alarms
+
+  // Each rule is evaluated as its input sample arrives, drives the matching
+  // 127489 status bit and raises a Signal K notification when it changes.
+  // EDIT: Adjust the default limits here or in the web UI.
+  for (size_t i = 0; i < channel_map->engines.size(); i++) {
+    const String& id = channel_map->engines[i].id;
+    const EngineChannels& channels = engines[i];
+    // Engine "1" keeps the single-engine alarm labels and config paths
+    String prefix = id == "1" ? String() : "Engine " + id + " ";
+
+    auto coolant_alarm = ArenaNew<AlarmRule>(
+        AlarmRule::Direction::kHigh,
+        368.15,  // 95 C
+        3,       // K hysteresis
+        10,      // s delay
+        "/Alarms/" + prefix + "Coolant Temperature");
+    ConfigItem(coolant_alarm)
+        ->set_title(prefix + "High Coolant Temperature Alarm")
+        ->set_description("Coolant temperature alarm limits (K)")
+        ->set_sort_order(4000 + 100 * i);
+    channels.temperature->connect_to(coolant_alarm);
+    coolant_alarm->connect_to(channels.dynamic_sender->over_temperature_);
+    ConnectAlarmNotification(
+        coolant_alarm, "notifications.propulsion." + id + ".temperature",
+        prefix + "High coolant temperature");
+
+    // Minimum oil pressure depends on engine speed: 1 bar at idle, 2 bar
+    // from 1500 rpm, and no alarm below 400 rpm when the engine is stopped.
+    auto oil_pressure_alarm = ArenaNew<AlarmRule>(
+        AlarmRule::Direction::kLow,
+        100000,  // Pa
+        20000,   // Pa hysteresis
+        5,       // s delay
+        "/Alarms/" + prefix + "Oil Pressure");
+    oil_pressure_alarm->set_rpm_condition(channels.revolutions, 400, 1500,
+                                          200000);
+    ConfigItem(oil_pressure_alarm)
+        ->set_title(prefix + "Low Oil Pressure Alarm")
+        ->set_description("Oil pressure alarm limits (Pa)")
+        ->set_sort_order(4010 + 100 * i);
+    channels.oil_pressure->connect_to(oil_pressure_alarm);
+    oil_pressure_alarm->connect_to(
+        channels.dynamic_sender->low_oil_pressure_);
+    ConnectAlarmNotification(
+        oil_pressure_alarm, "notifications.propulsion." + id + ".oilPressure",
+        prefix + "Low oil pressure");
+
+    power_manager->add_alarm(coolant_alarm);
+    power_manager->add_alarm(oil_pressure_alarm);
+  }
 
-  tacho_d1_frequency->connect_to(&(engine_rapid_sender->engine_speed_));
+  // A hot wet exhaust means the raw water flow has failed. The alarm drives
+  // the water flow bit of the exhaust engine from the channel map.
+  auto exhaust_alarm = ArenaNew<AlarmRule>(AlarmRule::Direction::kHigh,
+                                           343.15,  // 70 C
+                                           5,       // K hysteresis
+                                           10,      // s delay
+                                           "/Alarms/Exhaust Temperature");
+  ConfigItem(exhaust_alarm)
+      ->set_title("High Exhaust Temperature Alarm")
+      ->set_description("Exhaust temperature alarm limits (K)")
+      ->set_sort_order(4020);
+  exhaust_temp_calibration->connect_to(exhaust_alarm);
+  for (size_t i = 0; i < channel_map->engines.size(); i++) {
+    const String& id = channel_map->engines[i].id;
+    if (id != channel_map->exhaust_engine) {
+      continue;
+    }
+    exhaust_alarm->connect_to(engines[i].dynamic_sender->water_flow_);
+    ConnectAlarmNotification(
+        exhaust_alarm, "notifications.propulsion." + id + ".exhaustTemperature",
+        "High exhaust temperature");
+  }
 
-  if (display_present) {
-    tacho_d1_frequency->connect_to(new LambdaConsumer<float>(
-        [](float value) { PrintValue(display, 3, "RPM D1", 60 * value); }));
+#ifdef ENABLE_RIPPLE_ANALYSIS
+  // Charging health of each engine's alternator, cross-referenced with the
+  // speed of that engine
+  for (size_t i = 0; i < engine_voltages.size(); i++) {
+    if (engine_voltages[i] == nullptr) {
+      continue;
+    }
+    int input = channel_map->engines[i].voltage_input;
+    String name = ChannelMap::input_name(input);
+    String id = ChannelMap::input_id(input);
+    auto ripple = ArenaNew<RippleAnalyzer>(engine_voltages[i],
+                                           engines[i].revolutions,
+                                           "/Voltage " + name + "/Ripple");
+    ConfigItem(ripple)
+        ->set_title("Analog Voltage " + name + " Ripple")
+        ->set_description("Alternator ripple and charging limits of input " +
+                          name)
+        ->set_sort_order(3501 + 10 * i);
+    ripple->ripple_.connect_to(ArenaNew<SKOutputFloat>(
+        "sensors." + id + ".ripple", "Ripple " + name,
+        new SKMetadata("V", "Ripple " + name + " (RMS)")));
+    ripple->ripple_frequency_.connect_to(ArenaNew<SKOutputFloat>(
+        "sensors." + id + ".rippleFrequency", "Ripple Frequency " + name,
+        new SKMetadata("Hz", "Dominant ripple frequency " + name)));
+    ripple->ripple_order_.connect_to(ArenaNew<SKOutputFloat>(
+        "sensors." + id + ".rippleOrder", "Ripple Order " + name,
+        new SKMetadata("", "Ripple frequency per alternator electrical "
+                           "frequency")));
+    ripple->diode_ripple_.connect_to(ArenaNew<SKOutputFloat>(
+        "sensors." + id + ".diodeRipple", "Diode Ripple " + name,
+        new SKMetadata("V", "Ripple " + name +
+                                " at the alternator electrical frequency")));
+    ripple->low_voltage_.connect_to(
+        engines[i].dynamic_sender->low_system_voltage_);
+    ripple->charge_warning_.connect_to(
+        engines[i].dynamic_sender->charge_indicator_);
+    ripple->start();
   }
+#endif
+
+  // There is no 127489 bit for the tank level; notify over Signal K only.
+  // The alarm watches the first tank in the channel map.
+  String alarm_tank_id =
+      channel_map->tanks.empty() ? "fuel.main" : channel_map->tanks[0].sk_id;
+  auto tank_alarm = ArenaNew<AlarmRule>(AlarmRule::Direction::kLow,
+                                        0.15,  // ratio
+                                        0.05,  // ratio hysteresis
+                                        60,    // s delay, for sloshing
+                                        "/Alarms/Fuel Level");
+  ConfigItem(tank_alarm)
+      ->set_title("Low Fuel Level Alarm")
+      ->set_description("Fuel tank level alarm limits (ratio)")
+      ->set_sort_order(4030);
+  tank_a1_level->connect_to(tank_alarm);
+  ConnectAlarmNotification(
+      tank_alarm, "notifications.tanks." + alarm_tank_id + ".currentLevel",
+      "Low fuel level", "warn");
 
   /// BMP280 SENSOR CODE - Engine Room Temp Sensor ////  
 
@@ -409,39 +886,183 @@ void setup() {
   // If you need to use the TwoWire library instead of the Wire library, there
   // is a different constructor: see bmp280.h
 
+#ifdef ENABLE_SAMPLE_REPLAY
+  // Write the chain outputs and the transmitted N2K messages with the
+  // replay's virtual time, so that runs of different firmware versions can
+  // be diffed.
+  tank_a1_level->connect_to(ArenaNew<LambdaConsumer<float>>(
+      [replay](float value) { replay->record_output("tank_a1", value); }));
+  engine_OilPressure->connect_to(ArenaNew<LambdaConsumer<float>>(
+      [replay](float value) { replay->record_output("oil_pressure", value); }));
+  engine_temperature->connect_to(ArenaNew<LambdaConsumer<float>>(
+      [replay](float value) { replay->record_output("temperature", value); }));
+  tacho_d1_frequency->connect_to(ArenaNew<LambdaConsumer<float>>(
+      [replay](float value) { replay->record_output("tacho_d1", value); }));
+  if (replay->get_output_stream() != nullptr) {
+    nmea2000->SetForwardStream(replay->get_output_stream());
+    nmea2000->SetForwardType(tNMEA2000::fwdt_Text);
+    nmea2000->SetForwardOwnMessages(true);
+    nmea2000->EnableForward(true);
+  }
+#endif
+
+  BootTimeline::get()->mark(BootEvent::kDigitalReady);
+
   bmp280.begin(0x76);
+  BootTimeline::get()->mark(BootEvent::kBMP280Ready);
 
-  // Create a RepeatSensor with float output that reads the temperature
-  // using the function defined above.
-  auto* engine_room_temp =
-      new RepeatSensor<float>(5000, read_temp_callback);
+  // Read the temperature and pressure using the functions defined above,
+  // less often with the engines off.
+  auto* engine_room_temp = ArenaNew<ObservableValue<float>>();
+  power_manager->repeat(5000, [engine_room_temp]() {
+    engine_room_temp->set(read_temp_callback());
+  });
 
-  auto* engine_room_pressure = 
-      new RepeatSensor<float>(60000, read_pressure_callback);
+  auto* engine_room_pressure = ArenaNew<ObservableValue<float>>();
+  power_manager->repeat(60000, [engine_room_pressure]() {
+    engine_room_pressure->set(read_pressure_callback());
+  });
 
   // Send the temperature to the Signal K server as a Float
-  engine_room_temp->connect_to(new SKOutputFloat("propulsion.engineRoom.temperature"));
+  engine_room_temp->connect_to(ArenaNew<SKOutputFloat>("propulsion.engineRoom.temperature"));
+
+  engine_room_pressure->connect_to(ArenaNew<SKOutputFloat>("propulsion.engineRoom.pressure"));
+
+#ifdef ENABLE_WINDOWED_STATISTICS
+  {
+    String prefix = "propulsion." + (channel_map->engines.empty()
+                                         ? String("1")
+                                         : channel_map->engines[0].id);
+    ConnectWindowedStatistics(engine_temperature, prefix + ".temperature");
+    ConnectWindowedStatistics(engine_OilPressure, prefix + ".oilPressure");
+    ConnectWindowedStatistics(tacho_d1_frequency, prefix + ".revolutions");
+  }
+  ConnectWindowedStatistics(exhaust_temp_calibration,
+                            "propulsion.engine.1.exhaustTemperature");
+  ConnectWindowedStatistics(a2_voltage, "sensors." + a2_id + ".voltage");
+#endif
+
+#ifdef ENABLE_HISTORY_STORE
+  // Scales and offsets map the values to int16: 0.01 K around 0 C, 100 Pa
+  // and 0.01 r/s steps. Without PSRAM, only the first channel is kept.
+  auto history = ArenaNew<HistoryStore>();
+  history->add_channel("temperature", 100, 273.15, engine_temperature);
+  history->add_channel("oilPressure", 0.01, 0, engine_OilPressure);
+  history->add_channel("revolutions", 100, 0, tacho_d1_frequency);
+  history->start();
+#endif
+
+#ifdef ENABLE_CHANNEL_LOGGER
+  // Scales set the stored resolution, e.g. 10 stores 0.1 ohm steps.
+  auto channel_logger = new ChannelLogger(kChannelLogInterval);
+  channel_logger->add_channel("a1_resistance", 10, sender_input(0));
+  channel_logger->add_channel("a3_resistance", 10, sender_input(2));
+  channel_logger->add_channel("a4_resistance", 10, sender_input(3));
+  channel_logger->add_channel("tank_a1", 1000, tank_a1_level);
+  channel_logger->add_channel("oil_pressure", 0.1, engine_OilPressure);
+  channel_logger->add_channel("engine_temperature", 100, engine_temperature);
+  channel_logger->add_channel(strdup((a2_id + "_voltage").c_str()), 1000,
+                              a2_voltage);
+  channel_logger->add_channel("tacho_d1", 600, tacho_d1_frequency);
+  channel_logger->add_channel("exhaust_temperature", 100,
+                              exhaust_temp_calibration);
+  channel_logger->add_channel("oil_temperature", 100, oil_temp_calibration);
+  channel_logger->add_channel("engine_room_temperature", 100,
+                              engine_room_temp);
+  channel_logger->add_channel("engine_room_pressure", 1, engine_room_pressure);
+  channel_logger->add_channel("d2_alarm", alarm_d2_input);
+  channel_logger->add_channel("d3_alarm", alarm_d3_input);
+  channel_logger->start();
+#endif
 
-  engine_room_pressure->connect_to(new SKOutputFloat("propulsion.engineRoom.pressure"));
+#ifdef ENABLE_SNAPSHOT_SERVER
+  auto snapshot = ArenaNew<SnapshotServer>();
+  for (size_t i = 0; i < channel_map->engines.size(); i++) {
+    // The names live as long as the snapshot server
+    String prefix = "propulsion." + channel_map->engines[i].id + ".";
+    snapshot->add_channel(strdup((prefix + "temperature").c_str()),
+                          engines[i].temperature);
+    snapshot->add_channel(strdup((prefix + "oilPressure").c_str()),
+                          engines[i].oil_pressure);
+    snapshot->add_channel(strdup((prefix + "revolutions").c_str()),
+                          engines[i].revolutions);
+  }
+  // The tank chains return the filtered level (ratio), not the volume
+  snapshot->add_channel(
+      strdup(("tanks." + alarm_tank_id + ".currentLevel").c_str()),
+      tank_a1_level);
+  snapshot->add_channel(strdup(("sensors." + a2_id + ".voltage").c_str()),
+                        a2_voltage);
+  snapshot->add_channel("propulsion.engine.1.exhaustTemperature",
+                        exhaust_temp_calibration);
+  snapshot->add_channel("propulsion.engine.1.oilTemperature",
+                        oil_temp_calibration);
+  snapshot->add_channel("propulsion.engineRoom.temperature", engine_room_temp);
+  snapshot->add_channel("propulsion.engineRoom.pressure",
+                        engine_room_pressure);
+  snapshot->add_channel("alarm.engineBilge", alarm_d2_input);
+  snapshot->add_channel("alarm.D3", alarm_d3_input);
+  snapshot->start();
+#endif
 
   ///////////////////////////////////////////////////////////////////
   // Display setup
 
   // Connect the outputs to the display
   if (display_present) {
-    event_loop()->onRepeat(1000, []() {
+    power_manager->repeat(1000, []() {
       PrintValue(display, 1, "IP:", WiFi.localIP().toString());
     });
 
     // Create a poor man's "christmas tree" display for the alarms
-    event_loop()->onRepeat(1000, []() {
+    power_manager->repeat(1000, []() {
       char state_string[5] = {};
       for (int i = 0; i < 4; i++) {
         state_string[i] = alarm_states[i] ? '*' : '_';
       }
       PrintValue(display, 4, "Alarm", state_string);
     });
+
+    CanMetrics::get()->summary.connect_to(ArenaNew<LambdaConsumer<String>>(
+        [](String summary) { PrintValue(display, 5, "CAN", summary); }));
+  }
+
+  // Alarms keep the full sampling rate, and the bilge alarm ends a light
+  // sleep as soon as its input goes high.
+  power_manager->add_alarm(alarm_d2_input);
+  power_manager->add_alarm(alarm_d3_inverted);
+  power_manager->add_wake_pin(kDigitalInputPin2, HIGH);
+  power_manager->start();
+
+  // The graph is complete: restore the state of the previous run, if any,
+  // and start saving the current one. The restored values go out on N2K
+  // right away, from setup(), while WiFi is still connecting, instead of
+  // after the first period of each sender in the event loop.
+  if (WarmStart::get()->is_warm()) {
+    WarmStart::get()->restore();
+    BootTimeline::get()->mark(BootEvent::kStateRestored);
+    nmea2000->ParseMessages();
+    SampleScheduler::get()->transmit_now();
   }
+  WarmStart::get()->start(nmea2000);
+
+  Arena::get()->report("After sensor graph");
+  const ConfigStore::LoadStats& config_loads =
+      ConfigStore::get()->get_load_stats();
+  debugI("Config loads: %u nodes, %u from the store, %u migrated, "
+         "%u file reads, %u us",
+         config_loads.loads, config_loads.store_hits, config_loads.migrations,
+         config_loads.file_reads, config_loads.load_us);
+#ifdef ENABLE_LOG_BENCHMARK
+  DeferredLog::get()->benchmark();
+#endif
+
+  BootTimeline::get()->enable_reporting();
+  LatencyTracer::get()->enable_reporting();
+  // The config items are all registered by now
+  ConfigCache::get()->start();
+  LoopMonitor::get()->start();
+  BootTimeline::get()->mark(BootEvent::kSetupDone);
 
   // To avoid garbage collecting all shared pointers created in setup(),
   // loop from here.
@@ -450,4 +1071,9 @@ void setup() {
   }
 }
 
-void loop() { event_loop()->tick(); }
+void loop() {
+  LoopMonitor::get()->tick_started();
+  event_loop()->tick();
+  LoopMonitor::get()->tick_finished();
+  power_manager->idle();
+}
@@ -0,0 +1,67 @@
+#ifndef HALMET_SRC_N2K_DRIVER_H_
+#define HALMET_SRC_N2K_DRIVER_H_
+
+#include <NMEA2000_esp32.h>
+
+#include "can_gateway.h"
+#include "can_metrics.h"
+
+namespace halmet {
+
+/**
+ * @brief ESP32 NMEA 2000 driver that reports every CAN frame to the CAN
+ * metrics and, if set, to a gateway.
+ *
+ * The gateway is set once its configuration is loaded, which may be after
+ * the node is opened.
+ */
+class tNMEA2000_halmet : public tNMEA2000_esp32 {
+ public:
+  tNMEA2000_halmet(gpio_num_t tx_pin, gpio_num_t rx_pin)
+      : tNMEA2000_esp32(tx_pin, rx_pin) {}
+
+  void set_gateway(CanGateway* gateway) { gateway_ = gateway; }
+
+ protected:
+  bool CANSendFrame(unsigned long id, unsigned char len,
+                    const unsigned char* buf, bool wait_sent) override {
+    bool sent = tNMEA2000_esp32::CANSendFrame(id, len, buf, wait_sent);
+    if (!sent) {
+      CanMetrics::get()->frame_rejected();
+      return false;
+    }
+    CanMetrics::get()->frame_sent(len, send_buffer_used());
+    if (gateway_ != nullptr) {
+      gateway_->frame(id, len, buf, true);
+    }
+    return true;
+  }
+
+  bool CANGetFrame(unsigned long& id, unsigned char& len,
+                   unsigned char* buf) override {
+    bool received = tNMEA2000_esp32::CANGetFrame(id, len, buf);
+    if (received) {
+      CanMetrics::get()->frame_received(len);
+      if (gateway_ != nullptr) {
+        gateway_->frame(id, len, buf, false);
+      }
+    }
+    return received;
+  }
+
+  /// Frames waiting in the stack's own send buffer
+  uint16_t send_buffer_used() const {
+    if (MaxCANSendFrames == 0) {
+      return 0;
+    }
+    return (CANSendFrameBufferWrite + MaxCANSendFrames -
+            CANSendFrameBufferRead) %
+           MaxCANSendFrames;
+  }
+
+  CanGateway* gateway_ = nullptr;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_N2K_DRIVER_H_
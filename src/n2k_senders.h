@@ -4,13 +4,33 @@
 #include <N2kMessages.h>
 #include <NMEA2000.h>
 
+#include "arena.h"
+#include "boot_timeline.h"
+#include "can_metrics.h"
+#include "config_store.h"
+#include "latency_tracer.h"
+#include "live_config.h"
+#include "sample_scheduler.h"
 #include "sensesp/system/saveable.h"
-#include "sensesp/transforms/lambda_transform.h"
 #include "sensesp/transforms/repeat.h"
 #include "sensesp_base_app.h"
 
 namespace halmet {
 
+/**
+ * @brief Convert a float signal to a NMEA 2000 message field.
+ *
+ * The signal path runs in single precision, which the ESP32 FPU handles in
+ * hardware; the library takes doubles, so the conversion is done only here,
+ * once per message. Expired and NaN values are sent as not available.
+ */
+inline double N2kField(float value, double scale = 1) {
+  if (isnan(value) || value == N2kFloatNA) {
+    return N2kDoubleNA;
+  }
+  return scale * value;
+}
+
 /**
  * @brief Transmit NMEA 2000 PGN 127488: Engine Parameters, Rapid Update
  *
@@ -23,23 +43,32 @@ class N2kEngineParameterRapidSender : public sensesp::FileSystemSaveable {
         engine_instance_{engine_instance},
         nmea2000_{nmea2000},
         repeat_interval_{100},  // In ms. Dictated by NMEA 2000 standard!
-        expiry_{1000}           // In ms. When the inputs expire.
+        expiry_{1000},          // In ms. When the inputs expire.
+        freshness_{100}         // In ms. Max age of sampled inputs when sent.
   {
     this->initialize_members(repeat_interval_, expiry_);
-    sensesp::event_loop()->onRepeat(repeat_interval_, [this]() {
-      tN2kMsg N2kMsg;
-      // At the moment, the PGN is sent regardless of whether all the values
-      // are invalid or not.
-      SetN2kEngineParamRapid(
-          N2kMsg, this->engine_instance_, this->engine_speed_rpm_->get(),
-          this->engine_boost_pressure_->get(), this->engine_tilt_trim_->get());
-      this->nmea2000_->SendMsg(N2kMsg);
-    });
-
-    engine_speed_
-        .connect_to(new sensesp::LambdaTransform<double, double>(
-            [](double value) { return 60 * value; }))
-        ->connect_to(engine_speed_rpm_);
+    SampleScheduler::get()->add_deadline(
+        config_path, repeat_interval_, freshness_, [this]() {
+          tN2kMsg N2kMsg;
+          // At the moment, the PGN is sent regardless of whether all the values
+          // are invalid or not.
+          double engine_speed_rpm =
+              N2kField(this->engine_speed_hz_->get(), 60);
+          SetN2kEngineParamRapid(
+              N2kMsg, this->engine_instance_, engine_speed_rpm,
+              N2kField(this->engine_boost_pressure_->get()),
+              this->engine_tilt_trim_->get());
+          if (SendN2kMsg(this->nmea2000_, N2kMsg)) {
+            for (LatencyProbe* probe : this->latency_probes_) {
+              probe->send();
+            }
+            if (engine_speed_rpm != N2kDoubleNA) {
+              BootTimeline::get()->mark(BootEvent::kFirst127488);
+            }
+          }
+        });
+
+    engine_speed_.connect_to(engine_speed_hz_);
   }
 
   virtual bool from_json(const JsonObject& config) override {
@@ -55,33 +84,46 @@ class N2kEngineParameterRapidSender : public sensesp::FileSystemSaveable {
     return true;
   }
 
-  sensesp::ObservableValue<double>
-      engine_speed_;  // Connected to engine_speed_rpm_
-  std::shared_ptr<sensesp::RepeatExpiring<double>> engine_boost_pressure_;
+  /// Trace the age of the values of input when this PGN is sent
+  void trace_latency(const String& name, sensesp::FloatProducer* input) {
+    latency_probes_.push_back(
+        LatencyTracer::get()->add_probe(name, input, expiry_));
+  }
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+  sensesp::ObservableValue<float>
+      engine_speed_;  // In Hz. Connected to engine_speed_hz_
+  std::shared_ptr<sensesp::RepeatExpiring<float>> engine_boost_pressure_;
   std::shared_ptr<sensesp::RepeatExpiring<int8_t>> engine_tilt_trim_;
 
  protected:
   unsigned int repeat_interval_;
   unsigned int expiry_;
+  unsigned int freshness_;
   tNMEA2000* nmea2000_;
+  std::vector<LatencyProbe*> latency_probes_;
 
-  std::shared_ptr<sensesp::RepeatExpiring<double>> engine_speed_rpm_;
+  std::shared_ptr<sensesp::RepeatExpiring<float>> engine_speed_hz_;
 
   uint8_t engine_instance_ = 0;
 
  private:
   void initialize_members(unsigned int repeat_interval, unsigned int expiry) {
     // Initialize the RepeatExpiring objects
-    engine_boost_pressure_ = std::make_shared<sensesp::RepeatExpiring<double>>(
+    engine_boost_pressure_ = ArenaMakeShared<sensesp::RepeatExpiring<float>>(
         repeat_interval, expiry);
-    engine_tilt_trim_ = std::make_shared<sensesp::RepeatExpiring<int8_t>>(
+    engine_tilt_trim_ = ArenaMakeShared<sensesp::RepeatExpiring<int8_t>>(
         repeat_interval, expiry);
-    engine_speed_rpm_ = std::make_shared<sensesp::RepeatExpiring<double>>(
+    engine_speed_hz_ = ArenaMakeShared<sensesp::RepeatExpiring<float>>(
         repeat_interval, expiry);
   }
 };
 
-const String ConfigSchema(const N2kEngineParameterRapidSender& obj) {
+inline const String ConfigSchema(const N2kEngineParameterRapidSender& obj) {
   return R"###({
     "type": "object",
     "properties": {
@@ -102,33 +144,46 @@ class N2kEngineParameterDynamicSender : public sensesp::FileSystemSaveable {
         engine_instance_{engine_instance},
         nmea2000_{nmea2000},
         repeat_interval_{500},  // In ms. Dictated by NMEA 2000 standard!
-        expiry_{5000}           // In ms. When the inputs expire.
+        expiry_{5000},          // In ms. When the inputs expire.
+        freshness_{100}         // In ms. Max age of sampled inputs when sent.
   {
     this->initialize_members(repeat_interval_, expiry_);
 
-    sensesp::event_loop()->onRepeat(repeat_interval_, [this]() {
-      tN2kMsg N2kMsg;
-      SetN2kEngineDynamicParam(
-          N2kMsg, this->engine_instance_, this->oil_pressure_->get(),
-          this->oil_temperature_->get(), this->temperature_->get(),
-          this->alternator_potential_->get(), this->fuel_rate_->get(),
-          this->total_engine_hours_->get(), this->coolant_pressure_->get(),
-          this->fuel_pressure_->get(), this->engine_load_->get(),
-          this->engine_torque_->get(), this->get_engine_status_1(),
-          this->get_engine_status_2());
-      this->nmea2000_->SendMsg(N2kMsg);
-    });
+    deadline_ = SampleScheduler::get()->add_deadline(
+        config_path, repeat_interval_, freshness_, [this]() {
+          tN2kMsg N2kMsg;
+          double oil_pressure = N2kField(this->oil_pressure_->get());
+          double temperature = N2kField(this->temperature_->get());
+          SetN2kEngineDynamicParam(
+              N2kMsg, this->engine_instance_, oil_pressure,
+              N2kField(this->oil_temperature_->get()), temperature,
+              N2kField(this->alternator_potential_->get()),
+              N2kField(this->fuel_rate_->get()),
+              this->total_engine_hours_->get(),
+              N2kField(this->coolant_pressure_->get()),
+              N2kField(this->fuel_pressure_->get()), this->engine_load_->get(),
+              this->engine_torque_->get(), this->get_engine_status_1(),
+              this->get_engine_status_2());
+          if (SendN2kMsg(this->nmea2000_, N2kMsg)) {
+            for (LatencyProbe* probe : this->latency_probes_) {
+              probe->send();
+            }
+            if (oil_pressure != N2kDoubleNA || temperature != N2kDoubleNA) {
+              BootTimeline::get()->mark(BootEvent::kFirst127489);
+            }
+          }
+        });
   }
 
   // Data to be transmitted
-  std::shared_ptr<sensesp::RepeatExpiring<double>> oil_pressure_;
-  std::shared_ptr<sensesp::RepeatExpiring<double>> oil_temperature_;
-  std::shared_ptr<sensesp::RepeatExpiring<double>> temperature_;
-  std::shared_ptr<sensesp::RepeatExpiring<double>> alternator_potential_;
-  std::shared_ptr<sensesp::RepeatExpiring<double>> fuel_rate_;
+  std::shared_ptr<sensesp::RepeatExpiring<float>> oil_pressure_;
+  std::shared_ptr<sensesp::RepeatExpiring<float>> oil_temperature_;
+  std::shared_ptr<sensesp::RepeatExpiring<float>> temperature_;
+  std::shared_ptr<sensesp::RepeatExpiring<float>> alternator_potential_;
+  std::shared_ptr<sensesp::RepeatExpiring<float>> fuel_rate_;
   std::shared_ptr<sensesp::RepeatExpiring<uint32_t>> total_engine_hours_;
-  std::shared_ptr<sensesp::RepeatExpiring<double>> coolant_pressure_;
-  std::shared_ptr<sensesp::RepeatExpiring<double>> fuel_pressure_;
+  std::shared_ptr<sensesp::RepeatExpiring<float>> coolant_pressure_;
+  std::shared_ptr<sensesp::RepeatExpiring<float>> fuel_pressure_;
   std::shared_ptr<sensesp::RepeatExpiring<int>> engine_load_;
   std::shared_ptr<sensesp::RepeatExpiring<int>> engine_torque_;
   // Engine status 1 fields
@@ -171,6 +226,22 @@ class N2kEngineParameterDynamicSender : public sensesp::FileSystemSaveable {
     return true;
   }
 
+  /// Trace the age of the values of input when this PGN is sent
+  void trace_latency(const String& name, sensesp::FloatProducer* input) {
+    latency_probes_.push_back(
+        LatencyTracer::get()->add_probe(name, input, expiry_));
+  }
+
+  /// Have the SampleScheduler sample input just before this PGN is sent
+  void sample_before_send(sensesp::FloatProducer* input) {
+    SampleScheduler::get()->add_input(deadline_, input);
+  }
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
  protected:
   tN2kEngineDiscreteStatus1 get_engine_status_1() {
     tN2kEngineDiscreteStatus1 status = 0;
@@ -221,86 +292,90 @@ class N2kEngineParameterDynamicSender : public sensesp::FileSystemSaveable {
 
   unsigned int repeat_interval_;
   unsigned int expiry_;
+  unsigned int freshness_;
+  int deadline_;
   tNMEA2000* nmea2000_;
+  std::vector<LatencyProbe*> latency_probes_;
 
   uint8_t engine_instance_;
 
  private:
   void initialize_members(uint32_t repeat_interval_, uint32_t expiry_) {
     // Initialize all RepeatExpiring members
-    oil_pressure_ = std::make_shared<sensesp::RepeatExpiring<double>>(
+    oil_pressure_ = ArenaMakeShared<sensesp::RepeatExpiring<float>>(
         repeat_interval_, expiry_);
-    oil_temperature_ = std::make_shared<sensesp::RepeatExpiring<double>>(
+    oil_temperature_ = ArenaMakeShared<sensesp::RepeatExpiring<float>>(
         repeat_interval_, expiry_);
-    temperature_ = std::make_shared<sensesp::RepeatExpiring<double>>(
+    temperature_ = ArenaMakeShared<sensesp::RepeatExpiring<float>>(
         repeat_interval_, expiry_);
-    alternator_potential_ = std::make_shared<sensesp::RepeatExpiring<double>>(
+    alternator_potential_ = ArenaMakeShared<sensesp::RepeatExpiring<float>>(
         repeat_interval_, expiry_);
-    fuel_rate_ = std::make_shared<sensesp::RepeatExpiring<double>>(
+    fuel_rate_ = ArenaMakeShared<sensesp::RepeatExpiring<float>>(
         repeat_interval_, expiry_);
-    total_engine_hours_ = std::make_shared<sensesp::RepeatExpiring<uint32_t>>(
+    total_engine_hours_ = ArenaMakeShared<sensesp::RepeatExpiring<uint32_t>>(
         repeat_interval_, expiry_);
-    coolant_pressure_ = std::make_shared<sensesp::RepeatExpiring<double>>(
+    coolant_pressure_ = ArenaMakeShared<sensesp::RepeatExpiring<float>>(
         repeat_interval_, expiry_);
-    fuel_pressure_ = std::make_shared<sensesp::RepeatExpiring<double>>(
+    fuel_pressure_ = ArenaMakeShared<sensesp::RepeatExpiring<float>>(
         repeat_interval_, expiry_);
-    engine_load_ = std::make_shared<sensesp::RepeatExpiring<int>>(
+    engine_load_ = ArenaMakeShared<sensesp::RepeatExpiring<int>>(
         repeat_interval_, expiry_);
-    engine_torque_ = std::make_shared<sensesp::RepeatExpiring<int>>(
+    engine_torque_ = ArenaMakeShared<sensesp::RepeatExpiring<int>>(
         repeat_interval_, expiry_);
-    check_engine_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    check_engine_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    over_temperature_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    over_temperature_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    low_oil_pressure_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    low_oil_pressure_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    low_oil_level_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    low_oil_level_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    low_fuel_pressure_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    low_fuel_pressure_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    low_system_voltage_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    low_system_voltage_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    low_coolant_level_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    low_coolant_level_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    water_flow_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    water_flow_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    water_in_fuel_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    water_in_fuel_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    charge_indicator_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    charge_indicator_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    preheat_indicator_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    preheat_indicator_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    high_boost_pressure_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    high_boost_pressure_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    rev_limit_exceeded_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    rev_limit_exceeded_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    egr_system_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    egr_system_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    throttle_position_sensor_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    throttle_position_sensor_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    emergency_stop_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    emergency_stop_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    warning_level_1_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    warning_level_1_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    warning_level_2_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    warning_level_2_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    power_reduction_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    power_reduction_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    maintenance_needed_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    maintenance_needed_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    engine_comm_error_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    engine_comm_error_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
     sub_or_secondary_throttle_ =
-        std::make_shared<sensesp::RepeatExpiring<bool>>(repeat_interval_,
+        ArenaMakeShared<sensesp::RepeatExpiring<bool>>(repeat_interval_,
                                                         expiry_);
-    neutral_start_protect_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    neutral_start_protect_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
-    engine_shutting_down_ = std::make_shared<sensesp::RepeatExpiring<bool>>(
+    engine_shutting_down_ = ArenaMakeShared<sensesp::RepeatExpiring<bool>>(
         repeat_interval_, expiry_);
   }
 };
 
-const String ConfigSchema(const N2kEngineParameterDynamicSender& obj) {
+inline const String ConfigSchema(
+    const N2kEngineParameterDynamicSender& obj) {
   return R"###({
     "type": "object",
     "properties": {
@@ -316,7 +391,7 @@ const String ConfigSchema(const N2kEngineParameterDynamicSender& obj) {
 class N2kFluidLevelSender : public sensesp::FileSystemSaveable {
  public:
   N2kFluidLevelSender(String config_path, uint8_t tank_instance,
-                      tN2kFluidType tank_type, double tank_capacity,
+                      tN2kFluidType tank_type, float tank_capacity,
                       tNMEA2000* nmea2000)
       : sensesp::FileSystemSaveable{config_path},
         tank_instance_{tank_instance},
@@ -324,21 +399,37 @@ class N2kFluidLevelSender : public sensesp::FileSystemSaveable {
         tank_capacity_{tank_capacity},
         nmea2000_{nmea2000},
         repeat_interval_{2500},  // In ms. Dictated by NMEA 2000 standard!
-        expiry_{10000}           // In ms. When the inputs expire.
+        expiry_{10000},          // In ms. When the inputs expire.
+        freshness_{500}          // In ms. Max age of sampled inputs when sent.
   {
-    tank_level_
-        .connect_to(new sensesp::LambdaTransform<double, double>(
-            [this](double value) { return 100 * value; }))
-        ->connect_to(&tank_level_percent_);
-
-    sensesp::event_loop()->onRepeat(repeat_interval_, [this]() {
-      tN2kMsg N2kMsg;
-      // At the moment, the PGN is sent regardless of whether all the values
-      // are invalid or not.
-      SetN2kFluidLevel(N2kMsg, this->tank_instance_, this->tank_type_,
-                       this->tank_level_percent_.get(), this->tank_capacity_);
-      this->nmea2000_->SendMsg(N2kMsg);
-    });
+    tank_level_.connect_to(&tank_level_ratio_);
+
+    deadline_ = SampleScheduler::get()->add_deadline(
+        config_path, repeat_interval_, freshness_, [this]() {
+          // Take a changed configuration as a whole
+          Config config;
+          if (staged_.apply(config)) {
+            tank_instance_ = config.tank_instance;
+            tank_type_ = config.tank_type;
+            tank_capacity_ = config.tank_capacity;
+          }
+
+          tN2kMsg N2kMsg;
+          // At the moment, the PGN is sent regardless of whether all the values
+          // are invalid or not.
+          double tank_level_percent =
+              N2kField(this->tank_level_ratio_.get(), 100);
+          SetN2kFluidLevel(N2kMsg, this->tank_instance_, this->tank_type_,
+                           tank_level_percent, this->tank_capacity_);
+          if (SendN2kMsg(this->nmea2000_, N2kMsg)) {
+            for (LatencyProbe* probe : this->latency_probes_) {
+              probe->send();
+            }
+            if (tank_level_percent != N2kDoubleNA) {
+              BootTimeline::get()->mark(BootEvent::kFirst127505);
+            }
+          }
+        });
   }
 
   virtual bool from_json(const JsonObject& config) override {
@@ -350,34 +441,64 @@ class N2kFluidLevelSender : public sensesp::FileSystemSaveable {
         return false;
       }
     }
-    tank_instance_ = config["tank_instance"];
-    tank_type_ = config["tank_type"];
-    tank_capacity_ = config["tank_capacity"];
+    Config new_config;
+    new_config.tank_instance = config["tank_instance"];
+    new_config.tank_type = config["tank_type"];
+    new_config.tank_capacity = config["tank_capacity"];
+    staged_.stage(new_config);
     return true;
   }
 
   virtual bool to_json(JsonObject& config) override {
-    config["tank_instance"] = tank_instance_;
-    config["tank_type"] = tank_type_;
-    config["tank_capacity"] = tank_capacity_;
+    Config current = {tank_instance_, tank_type_, tank_capacity_};
+    staged_.peek(current);
+    config["tank_instance"] = current.tank_instance;
+    config["tank_type"] = current.tank_type;
+    config["tank_capacity"] = current.tank_capacity;
     return true;
   }
 
-  sensesp::ObservableValue<double> tank_level_;  // ratio
+  /// Trace the age of the values of input when this PGN is sent
+  void trace_latency(const String& name, sensesp::FloatProducer* input) {
+    latency_probes_.push_back(
+        LatencyTracer::get()->add_probe(name, input, expiry_));
+  }
+
+  /// Have the SampleScheduler sample input just before this PGN is sent
+  void sample_before_send(sensesp::FloatProducer* input) {
+    SampleScheduler::get()->add_input(deadline_, input);
+  }
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+  sensesp::ObservableValue<float> tank_level_;  // ratio
 
  protected:
+  struct Config {
+    uint8_t tank_instance;
+    tN2kFluidType tank_type;
+    float tank_capacity;
+  };
+
   unsigned int repeat_interval_;
   unsigned int expiry_;
+  unsigned int freshness_;
+  int deadline_;
   tNMEA2000* nmea2000_;
+  std::vector<LatencyProbe*> latency_probes_;
 
+  // Configuration changes, applied before the next message
+  StagedValue<Config> staged_;
   uint8_t tank_instance_;
   tN2kFluidType tank_type_;
-  double tank_capacity_;  // in liters
-  sensesp::RepeatExpiring<double> tank_level_percent_{repeat_interval_,
-                                                      expiry_};
+  float tank_capacity_;  // in liters
+  sensesp::RepeatExpiring<float> tank_level_ratio_{repeat_interval_, expiry_};
 };
 
-const String ConfigSchema(const N2kFluidLevelSender& obj) {
+inline const String ConfigSchema(const N2kFluidLevelSender& obj) {
   return R"###({
       "type": "object",
       "properties": {
@@ -388,6 +509,21 @@ const String ConfigSchema(const N2kFluidLevelSender& obj) {
     })###";
 };
 
+// The engine instance is a single byte, and the tank configuration is
+// staged, so all sender settings apply without a restart.
+inline bool ConfigRequiresRestart(const N2kEngineParameterRapidSender& obj) {
+  return false;
+}
+
+inline bool ConfigRequiresRestart(
+    const N2kEngineParameterDynamicSender& obj) {
+  return false;
+}
+
+inline bool ConfigRequiresRestart(const N2kFluidLevelSender& obj) {
+  return false;
+}
+
 }  // namespace halmet
 
 #endif  // HALMET_SRC_N2K_SENDERS_H_
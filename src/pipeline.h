@@ -0,0 +1,283 @@
+#ifndef HALMET_SRC_PIPELINE_H_
+#define HALMET_SRC_PIPELINE_H_
+
+#include <Arduino.h>
+
+#include <type_traits>
+
+#include "arena.h"
+#include "live_config.h"
+#include "sensesp/system/valueconsumer.h"
+#include "sensesp/system/valueproducer.h"
+#include "sensesp/transforms/curveinterpolator.h"
+#include "sensesp/transforms/transform.h"
+
+namespace halmet {
+
+/**
+ * Fixed signal chains composed at compile time.
+ *
+ * Each hop of a SensESP object graph is a virtual set() and a walk over the
+ * producer's observer list. For chains whose wiring never changes after
+ * setup(), the stages can instead be composed with operator| into a single
+ * function object that the compiler inlines:
+ *
+ *   using namespace halmet::pipeline;
+ *   FloatProducer* rpm = From(revolutions) | Scale(60) | Curve(curve)
+ *                        | ToProducer();
+ *   From(revolutions) | Scale(60) | To(sk_output);
+ *
+ * The chain starts at a dynamic producer and ends at a dynamic consumer or
+ * a new producer, so it costs one graph hop in total, whatever the number
+ * of stages; a Node() adds its transform's virtual set(), but no observer
+ * walk. Configurable transforms stay objects, as the web UI binds to
+ * them, but run inline through Node() or Curve() instead of being
+ * connected. Curve() interpolates the curve's sample table itself, without
+ * any virtual call. The benchmark in test/test_pipeline compares the cost
+ * per sample with the object graph.
+ */
+namespace pipeline {
+
+/// Base of the stage types, which are float to float function objects
+struct Stage {};
+
+template <typename T>
+using IsStage = std::is_base_of<Stage, T>;
+
+/// Two stages run one after the other
+template <typename A, typename B>
+class Chain : public Stage {
+ public:
+  Chain(const A& first, const B& second) : first_{first}, second_{second} {}
+  float operator()(float value) const { return second_(first_(value)); }
+
+ private:
+  A first_;
+  B second_;
+};
+
+template <typename A, typename B>
+typename std::enable_if<IsStage<A>::value && IsStage<B>::value,
+                        Chain<A, B>>::type
+operator|(const A& first, const B& second) {
+  return Chain<A, B>(first, second);
+}
+
+class Scale : public Stage {
+ public:
+  explicit Scale(float factor) : factor_{factor} {}
+  float operator()(float value) const { return factor_ * value; }
+
+ private:
+  float factor_;
+};
+
+class Offset : public Stage {
+ public:
+  explicit Offset(float offset) : offset_{offset} {}
+  float operator()(float value) const { return value + offset_; }
+
+ private:
+  float offset_;
+};
+
+class Clamp : public Stage {
+ public:
+  Clamp(float min, float max) : min_{min}, max_{max} {}
+  float operator()(float value) const {
+    return value < min_ ? min_ : value > max_ ? max_ : value;
+  }
+
+ private:
+  float min_;
+  float max_;
+};
+
+/**
+ * @brief A configurable SensESP transform, run in place as a stage.
+ *
+ * Calls the transform's own set() and takes its output, so the result is
+ * the transform's, including a LiveTransform's staged configuration
+ * changes. The transform holds the configuration for the web UI and is not
+ * connected to the chain's producer itself; its emit() has no observers.
+ */
+class Node : public Stage {
+ public:
+  explicit Node(sensesp::FloatTransform* transform) : transform_{transform} {}
+  float operator()(float value) const {
+    transform_->set(value);
+    return transform_->get();
+  }
+
+ private:
+  sensesp::FloatTransform* transform_;
+};
+
+// A LiveTransform's staged configuration, applied before a stage reads it.
+// Plain transforms have none.
+inline void ApplyStaged(sensesp::FloatTransform* transform) {}
+
+template <typename T>
+void ApplyStaged(LiveTransform<T>* transform) {
+  transform->apply_staged();
+}
+
+/**
+ * @brief A CurveInterpolator's sample table, interpolated inline.
+ *
+ * The result is the CurveInterpolator's, including 9999.9 above the last
+ * sample, and follows changes of the table, staged or not.
+ */
+template <typename C>
+class CurveStage : public Stage {
+ public:
+  explicit CurveStage(C* curve) : curve_{curve} {}
+
+  float operator()(float input) const {
+    ApplyStaged(curve_);
+    const auto& samples = curve_->get_samples();
+    float x0 = 0.0;
+    float y0 = 0.0;
+    auto it = samples.begin();
+    for (; it != samples.end() && input > it->input_; it++) {
+      x0 = it->input_;
+      y0 = it->output_;
+    }
+    if (it == samples.end()) {
+      return 9999.9;
+    }
+    float x1 = it->input_;
+    float y1 = it->output_;
+    return (y0 * (x1 - input) + y1 * (input - x0)) / (x1 - x0);
+  }
+
+ private:
+  C* curve_;
+};
+
+template <typename C>
+CurveStage<C> Curve(C* curve) {
+  static_assert(std::is_base_of<sensesp::CurveInterpolator, C>::value,
+                "Curve() takes a CurveInterpolator");
+  return CurveStage<C>(curve);
+}
+
+/// Any float to float function object or lambda
+template <typename F>
+class Map : public Stage {
+ public:
+  explicit Map(const F& function) : function_{function} {}
+  float operator()(float value) const { return function_(value); }
+
+ private:
+  F function_;
+};
+
+template <typename F>
+Map<F> Apply(const F& function) {
+  return Map<F>(function);
+}
+
+/// Chain node that runs the stages and emits the result
+template <typename S>
+class StageTransform : public sensesp::FloatConsumer,
+                       public sensesp::ValueProducer<float> {
+ public:
+  explicit StageTransform(const S& stages) : stages_{stages} {}
+  void set(const float& value) override { this->emit(stages_(value)); }
+
+ private:
+  S stages_;
+};
+
+/// Chain node that runs the stages and passes the result to a sink
+template <typename S, typename F>
+class StageSink : public sensesp::FloatConsumer {
+ public:
+  StageSink(const S& stages, const F& sink) : stages_{stages}, sink_{sink} {}
+  void set(const float& value) override { sink_(stages_(value)); }
+
+ private:
+  S stages_;
+  F sink_;
+};
+
+/// A dynamic producer with the stages applied to it so far
+template <typename S>
+class Source {
+ public:
+  Source(sensesp::FloatProducer* producer, const S& stages)
+      : producer_{producer}, stages_{stages} {}
+
+  sensesp::FloatProducer* producer() const { return producer_; }
+  const S& stages() const { return stages_; }
+
+ private:
+  sensesp::FloatProducer* producer_;
+  S stages_;
+};
+
+/// The identity, as the stages of a fresh Source
+class Pass : public Stage {
+ public:
+  float operator()(float value) const { return value; }
+};
+
+inline Source<Pass> From(sensesp::FloatProducer* producer) {
+  return Source<Pass>(producer, Pass());
+}
+
+template <typename S, typename B>
+typename std::enable_if<IsStage<B>::value, Source<Chain<S, B>>>::type
+operator|(const Source<S>& source, const B& stage) {
+  return Source<Chain<S, B>>(source.producer(),
+                             Chain<S, B>(source.stages(), stage));
+}
+
+/// End a chain in a new producer
+struct ToProducer {};
+
+template <typename S>
+sensesp::FloatProducer* operator|(const Source<S>& source, ToProducer) {
+  auto node = ArenaNew<StageTransform<S>>(source.stages());
+  source.producer()->connect_to(node);
+  return node;
+}
+
+/// End a chain in a function object or lambda taking the value
+template <typename F>
+struct ToCallableSink {
+  F function;
+};
+
+template <typename F>
+ToCallableSink<F> ToCallable(const F& function) {
+  return ToCallableSink<F>{function};
+}
+
+template <typename S, typename F>
+void operator|(const Source<S>& source, const ToCallableSink<F>& sink) {
+  source.producer()->connect_to(
+      ArenaNew<StageSink<S, F>>(source.stages(), sink.function));
+}
+
+/// End a chain in a dynamic consumer
+struct ToConsumer {
+  sensesp::ValueConsumer<float>* consumer;
+};
+
+inline ToConsumer To(sensesp::ValueConsumer<float>* consumer) {
+  return ToConsumer{consumer};
+}
+
+template <typename S>
+void operator|(const Source<S>& source, ToConsumer sink) {
+  sensesp::ValueConsumer<float>* consumer = sink.consumer;
+  source | ToCallable([consumer](float value) { consumer->set(value); });
+}
+
+}  // namespace pipeline
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_PIPELINE_H_
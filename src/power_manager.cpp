@@ -0,0 +1,194 @@
+#include "power_manager.h"
+
+#include <driver/gpio.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <esp_wifi.h>
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/system/lambda_consumer.h"
+
+namespace halmet {
+
+namespace {
+
+// CPU clock per profile, indexed by EngineState. 80 MHz is the lowest
+// clock that keeps the APB at 80 MHz.
+const int kCpuMhz[] = {80, 160, 240, 240};
+
+// Main loop yield with all engines off. The stretched intervals are all
+// longer than this.
+const unsigned int kIdleLoopDelayMs = 10;
+
+}  // namespace
+
+PowerManager::PowerManager(const String& config_path)
+    : sensesp::FileSystemSaveable{config_path} {
+  load();
+}
+
+void PowerManager::add_engine(
+    sensesp::ValueProducer<EngineState>* engine_state) {
+  int index = engine_states_.size();
+  engine_states_.push_back(EngineState::kOff);
+  engine_state->connect_to(ArenaNew<sensesp::LambdaConsumer<EngineState>>(
+      [this, index](EngineState state) {
+        engine_states_[index] = state;
+        update();
+      }));
+}
+
+void PowerManager::add_alarm(sensesp::BoolProducer* alarm) {
+  int index = alarms_.size();
+  alarms_.push_back(false);
+  alarm->connect_to(
+      ArenaNew<sensesp::LambdaConsumer<bool>>([this, index](bool active) {
+        if (alarms_[index] != active) {
+          alarms_[index] = active;
+          update();
+        }
+      }));
+}
+
+void PowerManager::add_wake_pin(int pin, int active_level) {
+  gpio_wakeup_enable(static_cast<gpio_num_t>(pin),
+                     active_level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+}
+
+void PowerManager::repeat(unsigned int interval,
+                          std::function<void()> callback) {
+  Repeat* repeat = new Repeat{interval, callback, nullptr};
+  repeats_.push_back(repeat);
+  if (started_) {
+    repeat->event = sensesp::event_loop()->onRepeat(
+        std::max(1U, (unsigned int)(interval * interval_scale_)), callback);
+  }
+}
+
+void PowerManager::start() {
+  profile_since_ = millis();
+  started_ = true;
+  apply(select_profile());
+
+  sensesp::event_loop()->onRepeat(600000, [this]() {
+    unsigned long now = millis();
+    profile_ms_[static_cast<int>(profile_)] += now - profile_since_;
+    profile_since_ = now;
+    for (int i = 0; i < kNumStates; i++) {
+      uint32_t seconds = profile_ms_[i] / 1000;
+      debugD("Power profile %s: %u s, %u loop iterations/s",
+             EngineStateName(static_cast<EngineState>(i)), seconds,
+             seconds > 0 ? loop_iterations_[i] / seconds : 0);
+    }
+  });
+}
+
+EngineState PowerManager::select_profile() const {
+  EngineState profile = EngineState::kOff;
+  for (EngineState state : engine_states_) {
+    profile = std::max(profile, state);
+  }
+  for (bool active : alarms_) {
+    if (active) {
+      profile = EngineState::kRunning;
+    }
+  }
+  return profile;
+}
+
+void PowerManager::update() {
+  EngineState profile = select_profile();
+  if (started_ && profile != profile_) {
+    apply(profile);
+  }
+}
+
+void PowerManager::apply(EngineState profile) {
+  unsigned long now = millis();
+  profile_ms_[static_cast<int>(profile_)] += now - profile_since_;
+  profile_since_ = now;
+  profile_ = profile;
+
+  bool idle = profile == EngineState::kOff;
+  bool sleepy = idle || profile == EngineState::kCooldown;
+  int cpu_mhz = kCpuMhz[static_cast<int>(profile)];
+
+  interval_scale_ = idle                                ? idle_scale_
+                    : profile == EngineState::kCooldown ? cooldown_scale_
+                                                        : 1;
+  loop_delay_ms_ = idle ? kIdleLoopDelayMs : 0;
+
+  esp_wifi_set_ps(sleepy ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+
+#ifdef CONFIG_PM_ENABLE
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+  esp_pm_config_t pm_config = {};
+#else
+  esp_pm_config_esp32_t pm_config = {};
+#endif
+  pm_config.max_freq_mhz = cpu_mhz;
+  pm_config.min_freq_mhz = 80;
+  pm_config.light_sleep_enable = idle && light_sleep_;
+  esp_pm_configure(&pm_config);
+#else
+  setCpuFrequencyMhz(cpu_mhz);
+#endif
+
+  for (Repeat* repeat : repeats_) {
+    if (repeat->event != nullptr) {
+      repeat->event->remove(sensesp::event_loop());
+    }
+    repeat->event = sensesp::event_loop()->onRepeat(
+        std::max(1U, (unsigned int)(repeat->interval * interval_scale_)),
+        repeat->callback);
+  }
+
+  debugI("Power profile %s: intervals x%g, %d MHz, modem sleep %d",
+         EngineStateName(profile), interval_scale_, cpu_mhz, sleepy);
+  this->emit(interval_scale_);
+}
+
+void PowerManager::idle() {
+  loop_iterations_[static_cast<int>(profile_)]++;
+  if (loop_delay_ms_ > 0) {
+    vTaskDelay(pdMS_TO_TICKS(loop_delay_ms_));
+  }
+}
+
+bool PowerManager::from_json(const JsonObject& config) {
+  String expected[] = {"idle_scale", "cooldown_scale"};
+  for (auto str : expected) {
+    if (!config[str].is<float>()) {
+      return false;
+    }
+  }
+  idle_scale_ = std::max(1.0f, config["idle_scale"].as<float>());
+  cooldown_scale_ = std::max(1.0f, config["cooldown_scale"].as<float>());
+  light_sleep_ = config["light_sleep"] | false;
+  if (started_) {
+    apply(profile_);
+  }
+  return true;
+}
+
+bool PowerManager::to_json(JsonObject& config) {
+  config["idle_scale"] = idle_scale_;
+  config["cooldown_scale"] = cooldown_scale_;
+  config["light_sleep"] = light_sleep_;
+  return true;
+}
+
+const String ConfigSchema(const PowerManager& obj) {
+  return R"###({
+    "type": "object",
+    "properties": {
+      "idle_scale": { "title": "Idle interval scale", "type": "number", "description": "Multiplier of the sampling and display intervals with all engines off" },
+      "cooldown_scale": { "title": "Cooldown interval scale", "type": "number", "description": "Multiplier of the sampling and display intervals while the engines cool down" },
+      "light_sleep": { "title": "Light sleep", "type": "boolean", "description": "Sleep between events with all engines off. NMEA 2000 messages are not received while asleep." }
+    }
+  })###";
+}
+
+}  // namespace halmet
@@ -0,0 +1,106 @@
+#ifndef HALMET_SRC_POWER_MANAGER_H_
+#define HALMET_SRC_POWER_MANAGER_H_
+
+#include <Arduino.h>
+#include <ReactESP.h>
+
+#include <functional>
+#include <vector>
+
+#include "config_store.h"
+#include "engine_state.h"
+#include "sensesp/system/saveable.h"
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/**
+ * @brief Power profile selection from the engine and alarm states.
+ *
+ * The most active engine state selects a profile; an active alarm selects
+ * the running profile regardless. With all engines off, the sampling
+ * intervals are stretched by idle_scale, WiFi goes to modem sleep and the
+ * CPU is clocked down to 80 MHz, which keeps the 80 MHz APB clock that
+ * the CAN controller and I2C depend on. During cooldown the intervals are
+ * stretched by cooldown_scale.
+ *
+ * Light sleep between events is optional and off by default: the CAN
+ * controller doesn't receive while the CPU sleeps, so the device may miss
+ * NMEA 2000 address claims. It requires power management support
+ * (CONFIG_PM_ENABLE) in the ESP-IDF build. Wake pins end a light sleep as
+ * soon as they reach their active level.
+ *
+ * The interval scale is emitted on changes, for components that manage
+ * their own timers. Time spent and main loop iterations per second per
+ * profile are logged every 10 minutes. With the idle loop delay, the
+ * iterations bound how often the CPU wakes up; light sleep exits are not
+ * counted separately.
+ */
+class PowerManager : public sensesp::ValueProducer<float>,
+                     public sensesp::FileSystemSaveable {
+ public:
+  PowerManager(const String& config_path = "");
+
+  void add_engine(sensesp::ValueProducer<EngineState>* engine_state);
+  void add_alarm(sensesp::BoolProducer* alarm);
+  void add_wake_pin(int pin, int active_level);
+
+  /// Call callback every interval ms, stretched in the idle profiles
+  void repeat(unsigned int interval, std::function<void()> callback);
+
+  /// Apply the initial profile and start the statistics
+  void start();
+
+  /// Call once per main loop iteration. Yields the CPU when idle, so that
+  /// the idle task can sleep.
+  void idle();
+
+  float get_interval_scale() const { return interval_scale_; }
+
+  virtual bool from_json(const JsonObject& config) override;
+  virtual bool to_json(JsonObject& config) override;
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+ protected:
+  struct Repeat {
+    unsigned int interval;
+    std::function<void()> callback;
+    reactesp::RepeatEvent* event;
+  };
+
+  static const int kNumStates = 4;
+
+  EngineState select_profile() const;
+  void update();
+  void apply(EngineState profile);
+
+  float idle_scale_ = 10;
+  float cooldown_scale_ = 2;
+  bool light_sleep_ = false;
+
+  std::vector<EngineState> engine_states_;
+  std::vector<bool> alarms_;
+  std::vector<Repeat*> repeats_;
+  bool started_ = false;
+
+  EngineState profile_ = EngineState::kRunning;
+  float interval_scale_ = 1;
+  unsigned int loop_delay_ms_ = 0;
+
+  // Statistics per profile
+  unsigned long profile_since_ = 0;
+  uint32_t profile_ms_[kNumStates] = {};
+  uint32_t loop_iterations_[kNumStates] = {};
+};
+
+const String ConfigSchema(const PowerManager& obj);
+
+inline bool ConfigRequiresRestart(const PowerManager& obj) { return false; }
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_POWER_MANAGER_H_
@@ -0,0 +1,125 @@
+#include "ripple_analyzer.h"
+
+#include <esp_timer.h>
+
+#include <algorithm>
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp_base_app.h"
+
+namespace halmet {
+
+namespace {
+
+// Below this, the engine is cranking or stopped and the alternator is not
+// expected to charge (r/s, 480 rpm)
+const float kMinChargingRevolutions = 8;
+
+}  // namespace
+
+RippleAnalyzer::RippleAnalyzer(ADS1115VoltageInput* input,
+                               sensesp::FloatProducer* revolutions,
+                               const String& config_path)
+    : sensesp::FileSystemSaveable{config_path}, input_{input} {
+  load();
+  revolutions->connect_to(ArenaNew<sensesp::LambdaConsumer<float>>(
+      [this](float value) { revolutions_ = isnan(value) ? 0 : value; }));
+}
+
+void RippleAnalyzer::start() {
+  capture();
+
+  sensesp::event_loop()->onRepeat(60000, [this]() {
+    debugD("Ripple: %.0f SPS, analysis %u us per burst, %u failed bursts",
+           sample_rate_, analysis_us_, failed_bursts_);
+  });
+}
+
+void RippleAnalyzer::capture() {
+  bool started = input_->capture_burst(
+      kBurstSize, [this](const float* volts, int size, float sample_rate) {
+        if (sample_rate > 0) {
+          analyze(volts, size, sample_rate);
+        } else {
+          failed_bursts_++;
+        }
+        sensesp::event_loop()->onDelay(interval_ * 1000,
+                                       [this]() { capture(); });
+      });
+  if (!started) {
+    sensesp::event_loop()->onDelay(interval_ * 1000, [this]() { capture(); });
+  }
+}
+
+void RippleAnalyzer::analyze(const float* volts, int size,
+                             float sample_rate) {
+  int64_t start_us = esp_timer_get_time();
+  RippleSpectrum spectrum = AnalyzeRipple(volts, size, sample_rate, work_);
+
+  float electrical_hz = revolutions_ * pulley_ratio_ * pole_pairs_;
+  float order = NAN;
+  float diode_ripple = NAN;
+  if (electrical_hz > 0) {
+    order = spectrum.peak_hz / electrical_hz;
+    diode_ripple = GoertzelAmplitude(work_, size, sample_rate,
+                                     spectrum.window_sum, electrical_hz);
+  }
+  analysis_us_ = esp_timer_get_time() - start_us;
+  sample_rate_ = sample_rate;
+
+  mean_voltage_.set(spectrum.mean);
+  ripple_.set(spectrum.ripple);
+  ripple_frequency_.set(spectrum.peak_hz);
+  ripple_order_.set(order);
+  diode_ripple_.set(diode_ripple);
+  low_voltage_.set(spectrum.mean < low_voltage_limit_);
+  charge_warning_.set(revolutions_ > kMinChargingRevolutions &&
+                      (spectrum.mean < charging_voltage_ ||
+                       spectrum.ripple > max_ripple_));
+}
+
+bool RippleAnalyzer::from_json(const JsonObject& config) {
+  String expected[] = {"interval",   "low_voltage",  "charging_voltage",
+                       "max_ripple", "pulley_ratio", "pole_pairs"};
+  for (auto str : expected) {
+    if (!config[str].is<float>()) {
+      return false;
+    }
+  }
+  // The N2K engine status inputs expire after 5 s
+  interval_ = std::min(std::max(config["interval"].as<float>(), 1.0f), 4.0f);
+  low_voltage_limit_ = config["low_voltage"];
+  charging_voltage_ = config["charging_voltage"];
+  max_ripple_ = config["max_ripple"];
+  pulley_ratio_ = config["pulley_ratio"];
+  pole_pairs_ = config["pole_pairs"];
+  return true;
+}
+
+bool RippleAnalyzer::to_json(JsonObject& config) {
+  config["interval"] = interval_;
+  config["low_voltage"] = low_voltage_limit_;
+  config["charging_voltage"] = charging_voltage_;
+  config["max_ripple"] = max_ripple_;
+  config["pulley_ratio"] = pulley_ratio_;
+  config["pole_pairs"] = pole_pairs_;
+  return true;
+}
+
+const String ConfigSchema(const RippleAnalyzer& obj) {
+  return R"###({
+    "type": "object",
+    "properties": {
+      "interval": { "title": "Burst interval", "type": "number", "description": "Seconds between ripple bursts (1-4)" },
+      "low_voltage": { "title": "Low voltage", "type": "number", "description": "Mean voltage below which low system voltage is reported (V)" },
+      "charging_voltage": { "title": "Charging voltage", "type": "number", "description": "Mean voltage below which the alternator is not charging with the engine running (V)" },
+      "max_ripple": { "title": "Maximum ripple", "type": "number", "description": "Ripple above which the charging system is faulty (V RMS)" },
+      "pulley_ratio": { "title": "Pulley ratio", "type": "number", "description": "Alternator revolutions per engine revolution" },
+      "pole_pairs": { "title": "Pole pairs", "type": "number", "description": "Pole pairs of the alternator rotor" }
+    }
+  })###";
+}
+
+}  // namespace halmet
@@ -0,0 +1,91 @@
+#ifndef HALMET_SRC_RIPPLE_ANALYZER_H_
+#define HALMET_SRC_RIPPLE_ANALYZER_H_
+
+#include <Arduino.h>
+
+#include "config_store.h"
+#include "halmet_analog.h"
+#include "ripple_spectrum.h"
+#include "sensesp/system/observablevalue.h"
+#include "sensesp/system/saveable.h"
+
+namespace halmet {
+
+/**
+ * @brief Alternator ripple and charging health from bursts of a voltage
+ * input.
+ *
+ * Every interval seconds, a burst of kBurstSize samples is captured at the
+ * AdcScheduler's uniform burst rate and analyzed for its mean voltage,
+ * ripple (RMS) and dominant ripple frequency. The dominant frequency is
+ * also given as an order of the alternator's electrical frequency, which
+ * follows from the engine revolutions, the pulley ratio and the
+ * alternator's pole pairs, together with the ripple amplitude at the
+ * electrical frequency itself.
+ * A healthy three-phase bridge ripples at six times the electrical
+ * frequency; an open diode adds ripple at once and twice it.
+ *
+ * At 400 samples per second, frequencies up to 200 Hz are resolved, which
+ * covers the electrical frequency of most alternators at idle; above it,
+ * the order and diode ripple are not available. Higher ripple is only
+ * attenuated by the 1.2 ms conversion time, so it aliases into the
+ * spectrum below 200 Hz, and adds to the RMS.
+ *
+ * low_voltage_ is set below the low voltage. charge_warning_ is set while
+ * the engine turns and the mean voltage is below the charging voltage or
+ * the ripple is above the maximum.
+ */
+class RippleAnalyzer : public sensesp::FileSystemSaveable {
+ public:
+  static const int kBurstSize = 256;
+
+  RippleAnalyzer(ADS1115VoltageInput* input,
+                 sensesp::FloatProducer* revolutions,
+                 const String& config_path = "");
+
+  /// Start the bursts
+  void start();
+
+  virtual bool from_json(const JsonObject& config) override;
+  virtual bool to_json(JsonObject& config) override;
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+  sensesp::ObservableValue<float> mean_voltage_;      // V
+  sensesp::ObservableValue<float> ripple_;            // V RMS
+  sensesp::ObservableValue<float> ripple_frequency_;  // Hz
+  sensesp::ObservableValue<float> ripple_order_;      // Of the electrical Hz
+  sensesp::ObservableValue<float> diode_ripple_;      // V at the electrical Hz
+  sensesp::ObservableValue<bool> low_voltage_;
+  sensesp::ObservableValue<bool> charge_warning_;
+
+ protected:
+  void capture();
+  void analyze(const float* volts, int size, float sample_rate);
+
+  ADS1115VoltageInput* input_;
+  float revolutions_ = 0;  // r/s
+
+  float interval_ = 3;  // s
+  float low_voltage_limit_ = 12.0;
+  float charging_voltage_ = 13.0;
+  float max_ripple_ = 0.5;  // V RMS
+  float pulley_ratio_ = 2.5;
+  float pole_pairs_ = 6;
+
+  float work_[kBurstSize];
+  uint32_t analysis_us_ = 0;
+  float sample_rate_ = 0;
+  uint32_t failed_bursts_ = 0;
+};
+
+const String ConfigSchema(const RippleAnalyzer& obj);
+
+inline bool ConfigRequiresRestart(const RippleAnalyzer& obj) { return false; }
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_RIPPLE_ANALYZER_H_
@@ -0,0 +1,97 @@
+#include "ripple_spectrum.h"
+
+#include <algorithm>
+
+namespace halmet {
+
+namespace {
+
+// In single precision, which the FPU handles in hardware
+const float kTwoPi = 2 * PI;
+
+// Power of the Goertzel filter at omega (rad/sample)
+float GoertzelPower(const float* x, int size, float omega) {
+  float coeff = 2 * cosf(omega);
+  float s1 = 0;
+  float s2 = 0;
+  for (int i = 0; i < size; i++) {
+    float s0 = x[i] + coeff * s1 - s2;
+    s2 = s1;
+    s1 = s0;
+  }
+  return s1 * s1 + s2 * s2 - coeff * s1 * s2;
+}
+
+}  // namespace
+
+RippleSpectrum AnalyzeRipple(const float* volts, int size, float sample_rate,
+                             float* work, float min_hz) {
+  RippleSpectrum spectrum = {NAN, NAN, NAN, NAN, 0};
+  if (size < 8 || sample_rate <= 0) {
+    return spectrum;
+  }
+
+  float sum = 0;
+  for (int i = 0; i < size; i++) {
+    sum += volts[i];
+  }
+  spectrum.mean = sum / size;
+
+  float square_sum = 0;
+  for (int i = 0; i < size; i++) {
+    float ac = volts[i] - spectrum.mean;
+    square_sum += ac * ac;
+    float window = 0.5f - 0.5f * cosf(kTwoPi * i / (size - 1));
+    work[i] = ac * window;
+    spectrum.window_sum += window;
+  }
+  spectrum.ripple = sqrtf(square_sum / size);
+
+  // The Hann main lobe of DC spans two bins
+  int first_bin = std::max(2, static_cast<int>(ceilf(min_hz * size /
+                                                       sample_rate)));
+  int last_bin = size / 2 - 1;
+  if (first_bin >= last_bin) {
+    return spectrum;
+  }
+
+  int peak_bin = first_bin;
+  float peak_power = 0;
+  for (int k = first_bin; k <= last_bin; k++) {
+    float power = GoertzelPower(work, size, kTwoPi * k / size);
+    if (power > peak_power) {
+      peak_power = power;
+      peak_bin = k;
+    }
+  }
+
+  // Parabolic interpolation of the magnitudes around the peak
+  float offset = 0;
+  if (peak_bin > first_bin && peak_bin < last_bin) {
+    float before =
+        sqrtf(GoertzelPower(work, size, kTwoPi * (peak_bin - 1) / size));
+    float peak = sqrtf(peak_power);
+    float after =
+        sqrtf(GoertzelPower(work, size, kTwoPi * (peak_bin + 1) / size));
+    float denominator = before - 2 * peak + after;
+    if (denominator < 0) {
+      offset = 0.5f * (before - after) / denominator;
+    }
+  }
+  spectrum.peak_hz = (peak_bin + offset) * sample_rate / size;
+  // Measured at the interpolated frequency, to avoid the scalloping loss
+  spectrum.peak_amplitude = GoertzelAmplitude(
+      work, size, sample_rate, spectrum.window_sum, spectrum.peak_hz);
+  return spectrum;
+}
+
+float GoertzelAmplitude(const float* windowed, int size, float sample_rate,
+                        float window_sum, float hz) {
+  if (window_sum <= 0 || hz <= 0 || hz >= sample_rate / 2) {
+    return NAN;
+  }
+  float power = GoertzelPower(windowed, size, kTwoPi * hz / sample_rate);
+  return 2 * sqrtf(std::max(power, 0.0f)) / window_sum;
+}
+
+}  // namespace halmet
@@ -0,0 +1,32 @@
+#ifndef HALMET_SRC_RIPPLE_SPECTRUM_H_
+#define HALMET_SRC_RIPPLE_SPECTRUM_H_
+
+#include <Arduino.h>
+
+namespace halmet {
+
+/// Spectrum summary of a voltage burst
+struct RippleSpectrum {
+  float mean;            // V
+  float ripple;          // V RMS of the AC part
+  float peak_hz;         // Dominant ripple frequency
+  float peak_amplitude;  // V, of the dominant frequency
+  float window_sum;      // Of the Hann window applied to the burst
+};
+
+// Analyze a burst of size voltages sampled at sample_rate (Hz). A Goertzel
+// filter per DFT bin from min_hz up to the Nyquist frequency finds the
+// dominant ripple, which is then refined by parabolic interpolation and
+// measured at the interpolated frequency. work (size floats) is left with
+// the Hann-windowed AC part of the burst, for GoertzelAmplitude(). This is
+// plain arithmetic, tested and benchmarked on the host in test/test_ripple.
+RippleSpectrum AnalyzeRipple(const float* volts, int size, float sample_rate,
+                             float* work, float min_hz = 2);
+
+// Amplitude (V) of frequency hz in a burst windowed by AnalyzeRipple()
+float GoertzelAmplitude(const float* windowed, int size, float sample_rate,
+                        float window_sum, float hz);
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_RIPPLE_SPECTRUM_H_
@@ -0,0 +1,327 @@
+#include "sample_log.h"
+
+#include "halmet_analog.h"
+#include "halmet_const.h"
+#include "latency_tracer.h"
+#include "sensesp.h"
+#include "sensesp_base_app.h"
+
+namespace halmet {
+
+namespace {
+
+const char kMagic[4] = {'H', 'S', 'L', '1'};
+
+enum class PayloadType { kZigzag, kVarint, kByte, kFloat };
+
+PayloadType GetPayloadType(SampleSource source) {
+  if (source <= SampleSource::kA4Counts) {
+    return PayloadType::kZigzag;
+  } else if (source <= SampleSource::kD4Count) {
+    return PayloadType::kVarint;
+  } else if (source <= SampleSource::kD4State) {
+    return PayloadType::kByte;
+  }
+  return PayloadType::kFloat;
+}
+
+uint8_t* WriteVarint(uint8_t* p, uint32_t value) {
+  while (value >= 0x80) {
+    *p++ = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  *p++ = value;
+  return p;
+}
+
+}  // namespace
+
+int DigitalInputIndex(int pin) {
+  switch (pin) {
+    case sensesp::kDigitalInputPin1:
+      return 0;
+    case sensesp::kDigitalInputPin2:
+      return 1;
+    case sensesp::kDigitalInputPin3:
+      return 2;
+    case sensesp::kDigitalInputPin4:
+      return 3;
+    default:
+      return -1;
+  }
+}
+
+SampleRecorder* SampleRecorder::get() {
+  static SampleRecorder recorder;
+  return &recorder;
+}
+
+bool SampleRecorder::begin(fs::FS& fs, const char* path, size_t max_size) {
+  file_ = fs.open(path, FILE_WRITE);
+  if (!file_) {
+    debugE("Unable to open sample log %s", path);
+    return false;
+  }
+
+  uint32_t start_ms = millis();
+  file_.write(reinterpret_cast<const uint8_t*>(kMagic), sizeof(kMagic));
+  file_.write(reinterpret_cast<const uint8_t*>(&start_ms), sizeof(start_ms));
+  written_ = sizeof(kMagic) + sizeof(start_ms);
+  max_size_ = max_size;
+  last_record_ms_ = start_ms;
+  buffer_length_ = 0;
+  recording_ = true;
+
+  // Don't leave more than a few seconds of samples in RAM
+  sensesp::event_loop()->onRepeat(5000, [this]() { flush(); });
+
+  debugI("Recording samples to %s", path);
+  return true;
+}
+
+void SampleRecorder::end() {
+  if (!recording_) {
+    return;
+  }
+  flush();
+  file_.close();
+  recording_ = false;
+  debugI("Sample recording stopped at %u bytes", written_);
+}
+
+uint8_t* SampleRecorder::start_record(SampleSource source,
+                                      size_t max_payload) {
+  // Source byte, time delta varint and payload
+  if (buffer_length_ + 1 + 5 + max_payload > sizeof(buffer_)) {
+    flush();
+    if (!recording_) {
+      return nullptr;
+    }
+  }
+
+  unsigned long now = millis();
+  uint8_t* p = buffer_ + buffer_length_;
+  *p++ = static_cast<uint8_t>(source);
+  p = WriteVarint(p, now - last_record_ms_);
+  last_record_ms_ = now;
+  return p;
+}
+
+void SampleRecorder::record(SampleSource source, int16_t adc_counts) {
+  if (!recording_) {
+    return;
+  }
+  uint8_t* p = start_record(source, 3);
+  if (p == nullptr) {
+    return;
+  }
+  uint32_t zigzag = (static_cast<uint32_t>(adc_counts) << 1) ^
+                    static_cast<uint32_t>(adc_counts >> 15);
+  p = WriteVarint(p, zigzag & 0x1ffff);
+  buffer_length_ = p - buffer_;
+}
+
+void SampleRecorder::record(SampleSource source, int count) {
+  if (!recording_) {
+    return;
+  }
+  uint8_t* p = start_record(source, 5);
+  if (p == nullptr) {
+    return;
+  }
+  p = WriteVarint(p, count < 0 ? 0 : count);
+  buffer_length_ = p - buffer_;
+}
+
+void SampleRecorder::record(SampleSource source, bool state) {
+  if (!recording_) {
+    return;
+  }
+  uint8_t* p = start_record(source, 1);
+  if (p == nullptr) {
+    return;
+  }
+  *p++ = state;
+  buffer_length_ = p - buffer_;
+}
+
+void SampleRecorder::record(SampleSource source, float value) {
+  if (!recording_) {
+    return;
+  }
+  uint8_t* p = start_record(source, sizeof(value));
+  if (p == nullptr) {
+    return;
+  }
+  memcpy(p, &value, sizeof(value));
+  p += sizeof(value);
+  buffer_length_ = p - buffer_;
+}
+
+void SampleRecorder::flush() {
+  if (!recording_ || buffer_length_ == 0) {
+    return;
+  }
+  if (written_ + buffer_length_ > max_size_) {
+    buffer_length_ = 0;
+    end();
+    return;
+  }
+  file_.write(buffer_, buffer_length_);
+  file_.flush();
+  written_ += buffer_length_;
+  buffer_length_ = 0;
+}
+
+SampleReplay::SampleReplay(fs::FS& fs, const char* path, float speed,
+                           float volts_per_count, const char* output_path,
+                           Clock clock)
+    : speed_{speed}, volts_per_count_{volts_per_count}, clock_{clock} {
+  if (!clock_) {
+    clock_ = []() { return static_cast<uint32_t>(millis()); };
+  }
+  file_ = fs.open(path, FILE_READ);
+  char magic[sizeof(kMagic)];
+  uint32_t recording_start_ms;
+  if (!file_ ||
+      file_.read(reinterpret_cast<uint8_t*>(magic), sizeof(magic)) !=
+          sizeof(magic) ||
+      memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+      file_.read(reinterpret_cast<uint8_t*>(&recording_start_ms),
+                 sizeof(recording_start_ms)) != sizeof(recording_start_ms)) {
+    debugE("Unable to open sample log %s", path);
+    finished_ = true;
+    return;
+  }
+
+  if (output_path != nullptr) {
+    output_ = fs.open(output_path, FILE_WRITE);
+  }
+
+  debugI("Replaying %s at %.0fx", path, speed_);
+  start_ms_ = clock_();
+  sensesp::event_loop()->onTick([this]() { this->tick(); });
+}
+
+bool SampleReplay::read_varint(uint32_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    int c = file_.read();
+    if (c < 0) {
+      return false;
+    }
+    *value |= static_cast<uint32_t>(c & 0x7f) << shift;
+    if ((c & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SampleReplay::read_record() {
+  int source = file_.read();
+  uint32_t delta_ms;
+  if (source < 0 || source >= static_cast<int>(SampleSource::kCount) ||
+      !read_varint(&delta_ms)) {
+    return false;
+  }
+  pending_source_ = static_cast<SampleSource>(source);
+  pending_ms_ += delta_ms;
+
+  uint32_t raw;
+  switch (GetPayloadType(pending_source_)) {
+    case PayloadType::kZigzag:
+      if (!read_varint(&raw)) {
+        return false;
+      }
+      pending_int_ =
+          static_cast<int32_t>(raw >> 1) ^ -static_cast<int32_t>(raw & 1);
+      break;
+    case PayloadType::kVarint:
+      if (!read_varint(&raw)) {
+        return false;
+      }
+      pending_int_ = raw;
+      break;
+    case PayloadType::kByte: {
+      int c = file_.read();
+      if (c < 0) {
+        return false;
+      }
+      pending_int_ = c;
+      break;
+    }
+    case PayloadType::kFloat:
+      if (file_.read(reinterpret_cast<uint8_t*>(&pending_float_),
+                     sizeof(pending_float_)) != sizeof(pending_float_)) {
+        return false;
+      }
+      break;
+  }
+  return true;
+}
+
+void SampleReplay::tick() {
+  if (finished_) {
+    return;
+  }
+
+  uint32_t now_virtual_ms = (clock_() - start_ms_) * speed_;
+
+  while (true) {
+    if (!pending_) {
+      if (!read_record()) {
+        finished_ = true;
+        file_.close();
+        if (output_) {
+          output_.close();
+        }
+        debugI("Replay finished at %u ms virtual time", pending_ms_);
+        return;
+      }
+      pending_ = true;
+    }
+    if (pending_ms_ > now_virtual_ms) {
+      virtual_ms_ = now_virtual_ms;
+      return;
+    }
+    pending_ = false;
+
+    // Emit with the record's own timestamp as the virtual time
+    virtual_ms_ = pending_ms_;
+    LatencyTracer::get()->stamp(micros());
+    int index = static_cast<int>(pending_source_);
+    switch (GetPayloadType(pending_source_)) {
+      case PayloadType::kZigzag:
+        resistance_[index].set(
+            SenderResistance(pending_int_, volts_per_count_));
+        break;
+      case PayloadType::kVarint:
+        counts_[index - static_cast<int>(SampleSource::kD1Count)].set(
+            pending_int_);
+        break;
+      case PayloadType::kByte:
+        states_[index - static_cast<int>(SampleSource::kD1State)].set(
+            pending_int_ != 0);
+        break;
+      case PayloadType::kFloat:
+        values_[index - static_cast<int>(SampleSource::kExhaustTemp)].set(
+            pending_float_);
+        break;
+    }
+  }
+}
+
+void SampleReplay::record_output(const char* name, float value) {
+  if (output_) {
+    output_.printf("%u %s %.6g\n", virtual_ms_, name, value);
+  }
+}
+
+void SampleReplay::record_output(const char* name, bool value) {
+  if (output_) {
+    output_.printf("%u %s %d\n", virtual_ms_, name, value);
+  }
+}
+
+}  // namespace halmet
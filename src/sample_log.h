@@ -0,0 +1,156 @@
+#ifndef HALMET_SRC_SAMPLE_LOG_H_
+#define HALMET_SRC_SAMPLE_LOG_H_
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <functional>
+
+#include "sensesp/system/observablevalue.h"
+
+namespace halmet {
+
+/// Raw inputs that can be recorded and replayed.
+enum class SampleSource : uint8_t {
+  kA1Counts = 0,  // ADS1115 counts, A1..A4
+  kA2Counts,
+  kA3Counts,
+  kA4Counts,
+  kD1Count,       // Pulse counts per counter interval, D1..D4
+  kD2Count,
+  kD3Count,
+  kD4Count,
+  kD1State,       // Digital input states, D1..D4
+  kD2State,
+  kD3State,
+  kD4State,
+  kExhaustTemp,   // 1-Wire temperatures (K)
+  kOilTemp,
+  kRoomTemp,      // BMP280 temperature (K) and pressure (Pa)
+  kRoomPressure,
+  kCount
+};
+
+/// Digital input index (0 for D1) of a HALMET pin, or -1.
+int DigitalInputIndex(int pin);
+
+/**
+ * @brief Records raw inputs with timestamps into a compact binary log.
+ *
+ * The file starts with the magic "HSL1" and the recording start time. Each
+ * record is a source byte, the varint time delta in ms since the previous
+ * record, and a payload: a zigzag varint for ADC counts, a varint for pulse
+ * counts, one byte for digital states and a raw float for temperatures and
+ * pressure. A typical record takes 3-4 bytes.
+ *
+ * Records are collected in a small RAM buffer and appended to the file in
+ * blocks. Recording stops when the file reaches its size limit.
+ */
+class SampleRecorder {
+ public:
+  static SampleRecorder* get();
+
+  bool begin(fs::FS& fs, const char* path, size_t max_size = 256 * 1024);
+  void end();
+  bool is_recording() const { return recording_; }
+
+  void record(SampleSource source, int16_t adc_counts);
+  void record(SampleSource source, int count);
+  void record(SampleSource source, bool state);
+  void record(SampleSource source, float value);
+
+ protected:
+  uint8_t* start_record(SampleSource source, size_t max_payload);
+  void flush();
+
+  bool recording_ = false;
+  fs::File file_;
+  size_t max_size_ = 0;
+  size_t written_ = 0;
+  unsigned long last_record_ms_ = 0;
+  uint8_t buffer_[256];
+  size_t buffer_length_ = 0;
+};
+
+/**
+ * @brief Feeds a recorded sample log back into the signal chains.
+ *
+ * The log is replayed under a virtual clock that starts at the
+ * recording's start and runs `speed` times faster than the replay clock,
+ * millis() unless another one is passed. Connect the chains to the
+ * producers below instead of the hardware inputs.
+ *
+ * On the device, stages that keep their own wall clock time (the tacho
+ * Frequency transform, RepeatExpiring expiry and the N2K transmit timers)
+ * are only faithful at a speed of 1. On the host (env:native), the whole
+ * firmware runs on the simulated clock of the test, so a replay at a speed
+ * of 1 is faithful and still runs as fast as the host can;
+ * test/test_sample_replay checks its outputs against a golden file.
+ *
+ * The chain outputs passed to record_output() are written with their
+ * virtual timestamps to a text file, which can be diffed between firmware
+ * versions.
+ */
+class SampleReplay {
+ public:
+  /// Time in ms
+  using Clock = std::function<uint32_t()>;
+
+  SampleReplay(fs::FS& fs, const char* path, float speed,
+               float volts_per_count, const char* output_path = nullptr,
+               Clock clock = nullptr);
+
+  /// Sender resistance (ohms) of analog input A1..A4 (channel 0..3)
+  sensesp::FloatProducer* sender_resistance(int channel) {
+    return &resistance_[channel];
+  }
+  /// Pulse counts of digital input D1..D4 (index 0..3)
+  sensesp::IntProducer* counter(int index) { return &counts_[index]; }
+  /// State of digital input D1..D4 (index 0..3)
+  sensesp::BoolProducer* state(int index) { return &states_[index]; }
+  /// Temperature or pressure source
+  sensesp::FloatProducer* value(SampleSource source) {
+    return &values_[static_cast<int>(source) -
+                    static_cast<int>(SampleSource::kExhaustTemp)];
+  }
+
+  void record_output(const char* name, float value);
+  void record_output(const char* name, bool value);
+
+  /// Output file as a stream, e.g. for forwarding N2K messages. Returns
+  /// nullptr if no output file is open.
+  Stream* get_output_stream() { return output_ ? &output_ : nullptr; }
+
+  uint32_t get_virtual_ms() const { return virtual_ms_; }
+  bool is_finished() const { return finished_; }
+
+ protected:
+  void tick();
+  bool read_record();
+  bool read_varint(uint32_t* value);
+
+  fs::File file_;
+  fs::File output_;
+  float speed_;
+  float volts_per_count_;
+  Clock clock_;
+  uint32_t start_ms_;
+  uint32_t virtual_ms_ = 0;
+  bool finished_ = false;
+
+  // Next record, read ahead of its due time
+  bool pending_ = false;
+  SampleSource pending_source_;
+  uint32_t pending_ms_ = 0;
+  int32_t pending_int_ = 0;
+  float pending_float_ = 0;
+
+  sensesp::ObservableValue<float> resistance_[4];
+  sensesp::ObservableValue<int> counts_[4];
+  sensesp::ObservableValue<bool> states_[4];
+  sensesp::ObservableValue<float> values_[4];
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_SAMPLE_LOG_H_
@@ -0,0 +1,184 @@
+#include "sample_scheduler.h"
+
+#include <algorithm>
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp_base_app.h"
+
+namespace halmet {
+
+SampleScheduler* SampleScheduler::get() {
+  static SampleScheduler scheduler;
+  return &scheduler;
+}
+
+SampleScheduler::SampleScheduler() {
+  report_start_ms_ = millis();
+  sensesp::event_loop()->onRepeat(60000, [this]() { report(); });
+}
+
+int SampleScheduler::add_source(sensesp::FloatProducer* output,
+                                unsigned int lead_ms,
+                                std::function<void()> acquire) {
+  int index = sources_.size();
+  sources_.push_back({output, lead_ms, acquire});
+  // Resolve the deadline inputs once, rather than on every transmission
+  for (Deadline& deadline : deadlines_) {
+    for (sensesp::FloatProducer* input : deadline.inputs) {
+      if (input == output) {
+        deadline.sources.push_back(index);
+        break;
+      }
+    }
+  }
+  output->connect_to(
+      ArenaNew<sensesp::LambdaConsumer<float>>([this, index](float value) {
+        Source& source = sources_[index];
+        source.sampled = true;
+        source.pending = false;
+        source.updated_ms = millis();
+      }));
+  return index;
+}
+
+void SampleScheduler::set_lead(int source, unsigned int lead_ms) {
+  sources_[source].lead_ms = lead_ms;
+}
+
+int SampleScheduler::add_deadline(const String& name, unsigned int period_ms,
+                                  unsigned int freshness_ms,
+                                  std::function<void()> transmit) {
+  int index = deadlines_.size();
+  Deadline deadline;
+  deadline.name = name;
+  deadline.period_ms = period_ms;
+  deadline.freshness_ms = freshness_ms;
+  deadline.transmit = transmit;
+  deadlines_.push_back(deadline);
+  schedule(index);
+  return index;
+}
+
+void SampleScheduler::add_input(int deadline, sensesp::FloatProducer* input) {
+  deadlines_[deadline].inputs.push_back(input);
+  for (size_t i = 0; i < sources_.size(); i++) {
+    if (sources_[i].output == input) {
+      deadlines_[deadline].sources.push_back(i);
+      break;
+    }
+  }
+}
+
+void SampleScheduler::transmit_now() {
+  for (Deadline& deadline : deadlines_) {
+    if (deadline.transmit) {
+      deadline.transmit();
+    }
+  }
+}
+
+void SampleScheduler::set_scale(float scale) {
+  scale_ = scale;
+  for (size_t i = 0; i < deadlines_.size(); i++) {
+    if (!deadlines_[i].transmit) {
+      schedule(i);
+    }
+  }
+}
+
+void SampleScheduler::schedule(int index) {
+  Deadline& deadline = deadlines_[index];
+  if (deadline.event != nullptr) {
+    deadline.event->remove(sensesp::event_loop());
+  }
+  // Transmission periods are dictated by the outputs and don't stretch
+  unsigned int period_ms = deadline.transmit
+                               ? deadline.period_ms
+                               : deadline.period_ms * scale_;
+  deadline.event = sensesp::event_loop()->onRepeat(
+      period_ms, [this, index]() { prepare(index); });
+}
+
+void SampleScheduler::prepare(int index) {
+  Deadline& deadline = deadlines_[index];
+  uint32_t now = millis();
+
+  // Send once the slowest input has its sample
+  unsigned int lead_ms = 0;
+  for (int i : deadline.sources) {
+    lead_ms = std::max(lead_ms, sources_[i].lead_ms);
+  }
+
+  uint32_t send_ms = now + lead_ms;
+  int32_t freshness_ms = deadline.freshness_ms * scale_;
+  for (int i : deadline.sources) {
+    Source* source = &sources_[i];
+    // Time the sample that will be sent was (or will be) taken
+    uint32_t sample_ms = source->pending
+                             ? source->requested_ms + source->lead_ms
+                             : source->updated_ms;
+    bool fresh = (source->sampled || source->pending) &&
+                 static_cast<int32_t>(send_ms - sample_ms) <= freshness_ms;
+    if (!fresh) {
+      source->pending = true;
+      source->requested_ms = now;
+      acquisitions_++;
+      source->acquire();
+    }
+  }
+
+  if (!deadline.transmit) {
+    return;
+  }
+  if (lead_ms == 0) {
+    send(index);
+  } else {
+    sensesp::event_loop()->onDelay(lead_ms, [this, index]() { send(index); });
+  }
+}
+
+void SampleScheduler::send(int index) {
+  Deadline& deadline = deadlines_[index];
+  uint32_t now = millis();
+  for (int i : deadline.sources) {
+    const Source& source = sources_[i];
+    if (!source.sampled) {
+      continue;
+    }
+    uint32_t age_ms = now - source.updated_ms;
+    deadline.ages++;
+    deadline.age_sum_ms += age_ms;
+    deadline.max_age_ms = std::max(deadline.max_age_ms, age_ms);
+  }
+  deadline.transmits++;
+  deadline.transmit();
+}
+
+void SampleScheduler::report() {
+  uint32_t now = millis();
+  float seconds = (now - report_start_ms_) / 1000.0f;
+  report_start_ms_ = now;
+  if (sources_.empty() || seconds <= 0) {
+    return;
+  }
+
+  debugD("Sampling: %.2f acquisitions/s on %d sources",
+         acquisitions_ / seconds, static_cast<int>(sources_.size()));
+  acquisitions_ = 0;
+  for (Deadline& deadline : deadlines_) {
+    if (deadline.ages > 0) {
+      debugD("%s: %u sent, data age at transmit %u ms mean, %u ms max",
+             deadline.name.c_str(), deadline.transmits,
+             static_cast<uint32_t>(deadline.age_sum_ms / deadline.ages),
+             deadline.max_age_ms);
+    }
+    deadline.transmits = 0;
+    deadline.ages = 0;
+    deadline.age_sum_ms = 0;
+    deadline.max_age_ms = 0;
+  }
+}
+
+}  // namespace halmet
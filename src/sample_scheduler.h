@@ -0,0 +1,104 @@
+#ifndef HALMET_SRC_SAMPLE_SCHEDULER_H_
+#define HALMET_SRC_SAMPLE_SCHEDULER_H_
+
+#include <Arduino.h>
+#include <ReactESP.h>
+
+#include <functional>
+#include <vector>
+
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/**
+ * @brief Just-in-time sampling, driven by the deadlines of the outputs.
+ *
+ * A source is a producer whose samples are taken on request: acquire()
+ * starts an acquisition, and the producer emits the sample within lead_ms.
+ * A deadline is a periodic consumer, such as an N2K sender: it declares its
+ * period, the inputs it sends and the freshness they need when sent.
+ *
+ * lead_ms before each transmission, the inputs whose latest sample would be
+ * older than the freshness at the time of sending are acquired; inputs that
+ * are fresh enough, e.g. because a faster deadline shares them, are not.
+ * Sources are acquired only for deadlines, so samples that no output
+ * consumes are not taken. Deadlines without a transmission keep a minimum
+ * sample rate for outputs that send every value, such as Signal K.
+ *
+ * Deadline inputs that are not sources, e.g. counters that run on their own
+ * timer, are sent as they are. Every minute, the acquisitions per second
+ * and the mean and max data age at transmit of each deadline are logged.
+ */
+class SampleScheduler {
+ public:
+  static SampleScheduler* get();
+
+  /// Register an on-demand source and return its index
+  int add_source(sensesp::FloatProducer* output, unsigned int lead_ms,
+                 std::function<void()> acquire);
+  /// Change the lead of a source, e.g. once it has measured how long its
+  /// acquisitions take
+  void set_lead(int source, unsigned int lead_ms);
+
+  /// Add a deadline and return its index. transmit is called every period_ms
+  /// with its inputs at most freshness_ms old; without it, the inputs are
+  /// kept that fresh every period_ms.
+  int add_deadline(const String& name, unsigned int period_ms,
+                   unsigned int freshness_ms,
+                   std::function<void()> transmit = nullptr);
+  /// Add an input of a deadline. The input may be registered as a source
+  /// later.
+  void add_input(int deadline, sensesp::FloatProducer* input);
+
+  /// Transmit every deadline that has a transmission now, with its inputs as
+  /// they are, e.g. restored after a warm start, rather than waiting for
+  /// its first period in the event loop
+  void transmit_now();
+
+  /// Stretch the freshness of all deadlines, and the periods of those that
+  /// don't transmit, e.g. with the power manager's interval scale
+  void set_scale(float scale);
+
+ protected:
+  struct Source {
+    sensesp::FloatProducer* output;
+    unsigned int lead_ms;
+    std::function<void()> acquire;
+    bool sampled = false;
+    uint32_t updated_ms = 0;    // Time of the latest sample
+    uint32_t requested_ms = 0;  // Time of the latest acquisition
+    bool pending = false;
+  };
+
+  struct Deadline {
+    String name;
+    unsigned int period_ms;
+    unsigned int freshness_ms;
+    std::function<void()> transmit;
+    std::vector<sensesp::FloatProducer*> inputs;
+    std::vector<int> sources;  // Indices of the inputs that are sources
+    reactesp::RepeatEvent* event = nullptr;
+    uint32_t transmits = 0;
+    uint32_t ages = 0;  // Number of input ages in age_sum_ms
+    uint64_t age_sum_ms = 0;
+    uint32_t max_age_ms = 0;
+  };
+
+  SampleScheduler();
+
+  void schedule(int deadline);
+  void prepare(int deadline);
+  void send(int deadline);
+  void report();
+
+  std::vector<Source> sources_;
+  std::vector<Deadline> deadlines_;
+  float scale_ = 1;
+  uint32_t acquisitions_ = 0;
+  uint32_t report_start_ms_ = 0;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_SAMPLE_SCHEDULER_H_
@@ -0,0 +1,10 @@
+#include "sender_resistance.h"
+
+namespace halmet {
+
+float SenderResistance(int16_t adc_output, float volts_per_count) {
+  float adc_output_volts = adc_output * volts_per_count;
+  return kVoltageDividerScale * adc_output_volts / kMeasurementCurrent;
+}
+
+}  // namespace halmet
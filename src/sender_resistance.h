@@ -0,0 +1,21 @@
+#ifndef HALMET_SRC_SENDER_RESISTANCE_H_
+#define HALMET_SRC_SENDER_RESISTANCE_H_
+
+#include <Arduino.h>
+
+namespace halmet {
+
+// HALMET voltage divider scale factor
+const float kVoltageDividerScale = 33.3 / 3.3;
+
+// HALMET constant measurement current (A)
+const float kMeasurementCurrent = 0.01;
+
+// Convert a raw ADS1115 reading of a resistive sender input to ohms.
+// volts_per_count is the ADS1115's computeVolts(1) at its current gain. This
+// is plain arithmetic, tested on the host in test/test_sender_resistance.
+float SenderResistance(int16_t adc_output, float volts_per_count);
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_SENDER_RESISTANCE_H_
@@ -0,0 +1,355 @@
+#include "snapshot_server.h"
+
+#include <esp_timer.h>
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/net/http_server.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp_app.h"
+
+namespace halmet {
+
+namespace {
+
+// Widths of the fixed-width JSON fields. "%.7g" of a float is at most 14
+// characters; the age is a uint32 in ms.
+const int kValueWidth = 15;
+const int kAgeWidth = 10;
+const int kValidWidth = 5;
+
+// Values age past max_age_ms between updates; the validity and the waits
+// are checked this often
+const unsigned int kCheckIntervalMs = 250;
+
+// Right-align text in a field padded with spaces, which JSON ignores
+void WriteField(char* dest, int width, const char* text) {
+  int length = strlen(text);
+  memset(dest, ' ', width - length);
+  memcpy(dest + width - length, text, length);
+}
+
+}  // namespace
+
+SnapshotServer::SnapshotServer(uint32_t max_age_ms)
+    : max_age_ms_{max_age_ms}, mutex_{xSemaphoreCreateMutex()} {}
+
+void SnapshotServer::add_channel(const char* name,
+                                 sensesp::FloatProducer* producer) {
+  if (started_ || num_channels_ >= kMaxChannels) {
+    debugE("Can't add snapshot channel %s", name);
+    return;
+  }
+  int index = num_channels_++;
+  channels_[index].name = name;
+  producer->connect_to(ArenaNew<sensesp::LambdaConsumer<float>>(
+      [this, index](float value) { this->update(index, value); }));
+}
+
+void SnapshotServer::add_channel(const char* name,
+                                 sensesp::BoolProducer* producer) {
+  if (started_ || num_channels_ >= kMaxChannels) {
+    debugE("Can't add snapshot channel %s", name);
+    return;
+  }
+  int index = num_channels_++;
+  channels_[index].name = name;
+  producer->connect_to(ArenaNew<sensesp::LambdaConsumer<bool>>(
+      [this, index](bool value) { this->update(index, value ? 1 : 0); }));
+}
+
+void SnapshotServer::start() {
+  // Lay out the response once. Only the field contents change later.
+  String json = "{\"values\":{";
+  for (int i = 0; i < num_channels_; i++) {
+    Channel& channel = channels_[i];
+    if (i > 0) {
+      json += ",";
+    }
+    json += "\"";
+    json += channel.name;
+    json += "\":{\"value\":";
+    channel.value_offset = json.length();
+    for (int j = 0; j < kValueWidth; j++) {
+      json += " ";
+    }
+    json += ",\"age\":";
+    channel.age_offset = json.length();
+    for (int j = 0; j < kAgeWidth; j++) {
+      json += " ";
+    }
+    json += ",\"valid\":";
+    channel.valid_offset = json.length();
+    for (int j = 0; j < kValidWidth; j++) {
+      json += " ";
+    }
+    json += "}";
+  }
+  json += "}}";
+
+  json_length_ = json.length();
+  json_ = new char[json_length_];
+  memcpy(json_, json.c_str(), json_length_);
+  for (int i = 0; i < num_channels_; i++) {
+    WriteField(json_ + channels_[i].value_offset, kValueWidth, "null");
+  }
+
+  size_t response_length = std::max(json_length_, binary_length());
+  response_ = new char[response_length];
+  waiter_response_ = new char[response_length];
+  started_ = true;
+
+  auto handler = std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_GET, "/api/snapshot",
+      [this](httpd_req_t* req) { return handle(req); });
+  sensesp::sensesp_app->get_http_server()->add_handler(handler);
+
+  sensesp::event_loop()->onRepeat(kCheckIntervalMs, [this]() {
+    check_validity();
+    if (num_waiters_ > 0) {
+      answer_waiters();
+    }
+  });
+  sensesp::event_loop()->onRepeat(60000, [this]() {
+    debugD("Snapshot: %u requests, %u us max, %u waits", requests_,
+           max_request_us_, waits_);
+  });
+
+  debugI("Snapshot of %d channels, %u bytes of JSON", num_channels_,
+         json_length_);
+}
+
+void SnapshotServer::update(int index, float value) {
+  if (!started_) {
+    return;
+  }
+  Channel& channel = channels_[index];
+
+  // Format before taking the lock
+  char text[kValueWidth + 1];
+  if (isnan(value)) {
+    strcpy(text, "null");
+  } else {
+    snprintf(text, sizeof(text), "%.7g", value);
+  }
+
+  xSemaphoreTake(mutex_, portMAX_DELAY);
+  bool changed = !channel.received ||
+                 (value != channel.value &&
+                  !(isnan(value) && isnan(channel.value)));
+  WriteField(json_ + channel.value_offset, kValueWidth, text);
+  channel.value = value;
+  channel.updated_ms = millis();
+  channel.received = true;
+  // A repeated value makes an aged out channel valid again
+  bool valid = !isnan(value);
+  if (valid != channel.valid) {
+    channel.valid = valid;
+    changed = true;
+  }
+  if (changed) {
+    generation_++;
+  }
+  xSemaphoreGive(mutex_);
+
+  if (changed && num_waiters_ > 0 && !answer_scheduled_) {
+    // Answer after the other consumers of this value had their turn
+    answer_scheduled_ = true;
+    sensesp::event_loop()->onDelay(0, [this]() {
+      answer_scheduled_ = false;
+      answer_waiters();
+    });
+  }
+}
+
+bool SnapshotServer::is_valid(const Channel& channel, uint32_t now) const {
+  return channel.received && !isnan(channel.value) &&
+         now - channel.updated_ms <= max_age_ms_;
+}
+
+void SnapshotServer::check_validity() {
+  xSemaphoreTake(mutex_, portMAX_DELAY);
+  uint32_t now = millis();
+  bool changed = false;
+  for (int i = 0; i < num_channels_; i++) {
+    Channel& channel = channels_[i];
+    if (channel.valid && !is_valid(channel, now)) {
+      channel.valid = false;
+      changed = true;
+    }
+  }
+  if (changed) {
+    generation_++;
+  }
+  xSemaphoreGive(mutex_);
+}
+
+void SnapshotServer::answer_waiters() {
+  // Take the waiters to answer under the lock, answer them without it
+  Waiter answer[kMaxWaiters];
+  int num_answer = 0;
+  xSemaphoreTake(mutex_, portMAX_DELAY);
+  uint32_t now = millis();
+  int kept = 0;
+  for (int i = 0; i < num_waiters_; i++) {
+    const Waiter& waiter = waiters_[i];
+    if (waiter.generation != generation_ ||
+        static_cast<int32_t>(now - waiter.deadline_ms) >= 0) {
+      answer[num_answer++] = waiter;
+    } else {
+      waiters_[kept++] = waiter;
+    }
+  }
+  num_waiters_ = kept;
+  uint32_t generation = generation_;
+  xSemaphoreGive(mutex_);
+
+  for (int i = 0; i < num_answer; i++) {
+    httpd_req_t* req = answer[i].req;
+    if (answer[i].generation == generation) {
+      // The wait expired without a change
+      snprintf(waiter_etag_, sizeof(waiter_etag_), "W/\"%08x\"", generation);
+      httpd_resp_set_status(req, "304 Not Modified");
+      httpd_resp_set_hdr(req, "ETag", waiter_etag_);
+      httpd_resp_send(req, nullptr, 0);
+    } else if (answer[i].binary) {
+      fill_binary(req, waiter_response_, waiter_etag_);
+      httpd_resp_send(req, waiter_response_, binary_length());
+    } else {
+      fill_json(req, waiter_response_, waiter_etag_);
+      httpd_resp_send(req, waiter_response_, json_length_);
+    }
+    httpd_req_async_handler_complete(req);
+  }
+}
+
+esp_err_t SnapshotServer::handle(httpd_req_t* req) {
+  int64_t start_us = esp_timer_get_time();
+
+  char query[48];
+  char format[8] = "";
+  char value[8];
+  int wait_seconds = 0;
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+    httpd_query_key_value(query, "format", format, sizeof(format));
+    if (httpd_query_key_value(query, "wait", value, sizeof(value)) ==
+        ESP_OK) {
+      wait_seconds = atoi(value);
+      if (wait_seconds > kMaxWaitSeconds) {
+        wait_seconds = kMaxWaitSeconds;
+      }
+    }
+  }
+  bool binary = strcmp(format, "binary") == 0;
+
+  // The client already has the current generation
+  char if_none_match[16] = "";
+  httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match,
+                              sizeof(if_none_match));
+  uint32_t generation = generation_;
+  char etag[16];
+  snprintf(etag, sizeof(etag), "W/\"%08x\"", generation);
+  if (strcmp(if_none_match, etag) == 0) {
+    // Wait for a change on the event loop, if there is room. A change
+    // between the check above and here is caught by the next periodic
+    // check.
+    httpd_req_t* async_req = nullptr;
+    if (wait_seconds > 0 && num_waiters_ < kMaxWaiters &&
+        httpd_req_async_handler_begin(req, &async_req) == ESP_OK) {
+      xSemaphoreTake(mutex_, portMAX_DELAY);
+      waiters_[num_waiters_++] = {async_req, generation,
+                                  millis() + wait_seconds * 1000, binary};
+      xSemaphoreGive(mutex_);
+      waits_++;
+      return ESP_OK;
+    }
+    httpd_resp_set_status(req, "304 Not Modified");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    return httpd_resp_send(req, nullptr, 0);
+  }
+
+  esp_err_t result;
+  if (binary) {
+    fill_binary(req, response_, etag_);
+    result = httpd_resp_send(req, response_, binary_length());
+  } else {
+    fill_json(req, response_, etag_);
+    result = httpd_resp_send(req, response_, json_length_);
+  }
+
+  requests_++;
+  uint32_t elapsed_us = esp_timer_get_time() - start_us;
+  if (elapsed_us > max_request_us_) {
+    max_request_us_ = elapsed_us;
+  }
+  return result;
+}
+
+void SnapshotServer::fill_json(httpd_req_t* req, char* response,
+                               char* etag) {
+  // Copy under the lock, then fill in the time-dependent fields
+  uint32_t updated_ms[kMaxChannels];
+  bool valid[kMaxChannels];
+  bool received[kMaxChannels];
+  xSemaphoreTake(mutex_, portMAX_DELAY);
+  uint32_t now = millis();
+  memcpy(response, json_, json_length_);
+  uint32_t generation = generation_;
+  for (int i = 0; i < num_channels_; i++) {
+    updated_ms[i] = channels_[i].updated_ms;
+    valid[i] = is_valid(channels_[i], now);
+    received[i] = channels_[i].received;
+  }
+  xSemaphoreGive(mutex_);
+
+  char text[kAgeWidth + 1];
+  for (int i = 0; i < num_channels_; i++) {
+    const Channel& channel = channels_[i];
+    if (received[i]) {
+      snprintf(text, sizeof(text), "%u", now - updated_ms[i]);
+    } else {
+      strcpy(text, "null");
+    }
+    WriteField(response + channel.age_offset, kAgeWidth, text);
+    WriteField(response + channel.valid_offset, kValidWidth,
+               valid[i] ? "true" : "false");
+  }
+
+  snprintf(etag, sizeof(etag_), "W/\"%08x\"", generation);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "ETag", etag);
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+}
+
+void SnapshotServer::fill_binary(httpd_req_t* req, char* response,
+                                 char* etag) {
+  auto header = reinterpret_cast<BinaryHeader*>(response);
+  auto values =
+      reinterpret_cast<BinaryValue*>(response + sizeof(BinaryHeader));
+  memcpy(header->magic, "HSN1", 4);
+  header->num_channels = num_channels_;
+  header->reserved = 0;
+  header->valid = 0;
+
+  xSemaphoreTake(mutex_, portMAX_DELAY);
+  uint32_t now = millis();
+  header->uptime_ms = now;
+  header->generation = generation_;
+  for (int i = 0; i < num_channels_; i++) {
+    const Channel& channel = channels_[i];
+    values[i].value = channel.value;
+    values[i].age_ms =
+        channel.received ? now - channel.updated_ms : UINT32_MAX;
+    if (is_valid(channel, now)) {
+      header->valid |= 1UL << i;
+    }
+  }
+  xSemaphoreGive(mutex_);
+
+  snprintf(etag, sizeof(etag_), "W/\"%08x\"", header->generation);
+  httpd_resp_set_type(req, "application/octet-stream");
+  httpd_resp_set_hdr(req, "ETag", etag);
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+}
+
+}  // namespace halmet
@@ -0,0 +1,133 @@
+#ifndef HALMET_SRC_SNAPSHOT_SERVER_H_
+#define HALMET_SRC_SNAPSHOT_SERVER_H_
+
+#include <Arduino.h>
+#include <esp_http_server.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/**
+ * @brief Current value, age and validity of every channel in one request.
+ *
+ * GET /api/snapshot returns a JSON object keyed by channel name:
+ *
+ *   {"values":{"temperature":{"value": 351.25,"age":      120,"valid":true },
+ *   ...}}
+ *
+ * The response is kept pre-serialized with fixed-width fields. A new value
+ * is formatted into its slot in place, and a request copies the buffer and
+ * patches the age and validity of each channel. A value is valid if it was
+ * received in the last max_age_ms and is not NaN.
+ *
+ * GET /api/snapshot?format=binary returns a BinaryHeader followed by one
+ * BinaryValue per channel, in the order of the JSON response.
+ *
+ * Every value change, and every channel becoming valid or invalid as its
+ * value ages past max_age_ms, bumps a generation sent as a weak ETag. A
+ * request with If-None-Match set to the current ETag gets 304 Not
+ * Modified, or with &wait=<s>, is answered when the generation changes or
+ * the wait expires. A waiting request is detached from the HTTP server
+ * task with httpd_req_async_handler_begin() and answered by the event
+ * loop, so the server keeps serving the config UI and other clients in the
+ * meantime. Up to kMaxWaiters requests wait at a time; others get 304 at
+ * once.
+ */
+class SnapshotServer {
+ public:
+  static const int kMaxChannels = 32;
+  static const int kMaxWaiters = 4;
+  static const int kMaxWaitSeconds = 30;
+
+  struct BinaryHeader {
+    char magic[4];  // "HSN1"
+    uint32_t generation;
+    uint32_t uptime_ms;
+    uint16_t num_channels;
+    uint16_t reserved;
+    uint32_t valid;  // Bit i set if channel i is valid
+  } __attribute__((packed));
+
+  struct BinaryValue {
+    float value;
+    uint32_t age_ms;  // UINT32_MAX if never received
+  } __attribute__((packed));
+
+  SnapshotServer(uint32_t max_age_ms = 10000);
+
+  void add_channel(const char* name, sensesp::FloatProducer* producer);
+  void add_channel(const char* name, sensesp::BoolProducer* producer);
+
+  /// Build the response buffer and register the HTTP handler. Channels
+  /// can't be added after this.
+  void start();
+
+ protected:
+  struct Channel {
+    const char* name;
+    float value = NAN;
+    uint32_t updated_ms = 0;
+    bool received = false;
+    bool valid = false;  // As of the current generation
+    uint16_t value_offset;  // Offsets of the fixed-width fields in json_
+    uint16_t age_offset;
+    uint16_t valid_offset;
+  };
+
+  /// A request detached from the HTTP server task until the generation
+  /// changes
+  struct Waiter {
+    httpd_req_t* req;
+    uint32_t generation;
+    uint32_t deadline_ms;
+    bool binary;
+  };
+
+  void update(int index, float value);
+  bool is_valid(const Channel& channel, uint32_t now) const;
+  /// Bump the generation for the channels whose validity expired
+  void check_validity();
+  /// Answer the waiters whose generation is out of date or whose wait
+  /// expired
+  void answer_waiters();
+  esp_err_t handle(httpd_req_t* req);
+  // Fill the response buffer and set the response headers. The ETag
+  // buffer must outlive the response.
+  void fill_json(httpd_req_t* req, char* response, char* etag);
+  void fill_binary(httpd_req_t* req, char* response, char* etag);
+  size_t binary_length() const {
+    return sizeof(BinaryHeader) + num_channels_ * sizeof(BinaryValue);
+  }
+
+  uint32_t max_age_ms_;
+  Channel channels_[kMaxChannels];
+  int num_channels_ = 0;
+  bool started_ = false;
+
+  // Written by the event loop and read by the HTTP server task
+  SemaphoreHandle_t mutex_;
+  volatile uint32_t generation_ = 1;
+  char* json_ = nullptr;
+  size_t json_length_ = 0;
+  Waiter waiters_[kMaxWaiters];
+  volatile int num_waiters_ = 0;
+
+  // Used by the HTTP server task only
+  char* response_ = nullptr;
+  char etag_[16];
+  uint32_t requests_ = 0;
+  uint32_t max_request_us_ = 0;
+
+  // Used by the event loop only, to answer the waiters
+  char* waiter_response_ = nullptr;
+  char waiter_etag_[16];
+  bool answer_scheduled_ = false;
+  uint32_t waits_ = 0;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_SNAPSHOT_SERVER_H_
@@ -0,0 +1,60 @@
+#ifndef HALMET_SRC_STAGED_VALUE_H_
+#define HALMET_SRC_STAGED_VALUE_H_
+
+#include <atomic>
+#include <mutex>
+
+namespace halmet {
+
+/**
+ * @brief A configuration value handed from the HTTP server task to the
+ * event loop.
+ *
+ * Configuration changes from the web UI arrive in the HTTP server task,
+ * while the samples are processed by the event loop. stage() keeps the new
+ * value aside; the event loop calls apply() before processing a sample, so
+ * a sample never sees a half-applied configuration, and no sample goes
+ * without one. The zero-gap behavior is tested on the host in
+ * test/test_staged_value.
+ */
+template <typename T>
+class StagedValue {
+ public:
+  void stage(const T& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = value;
+    has_pending_ = true;
+  }
+
+  /// Copy the staged value, if any, to target. Returns true if it did.
+  bool apply(T& target) {
+    if (!has_pending_) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    target = pending_;
+    has_pending_ = false;
+    return true;
+  }
+
+  bool has_pending() const { return has_pending_; }
+
+  /// Copy the staged value, if any, to target without applying it
+  bool peek(T& target) {
+    if (!has_pending_) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    target = pending_;
+    return true;
+  }
+
+ protected:
+  std::mutex mutex_;
+  std::atomic<bool> has_pending_{false};
+  T pending_;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_STAGED_VALUE_H_
@@ -0,0 +1,220 @@
+#include "tacho_self_test.h"
+
+#include <ArduinoJson.h>
+
+#include <algorithm>
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/net/http_server.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp_app.h"
+
+namespace halmet {
+
+namespace {
+
+// The LEDC timer clock, and the widest timer on the ESP32
+const uint32_t kLedcClockHz = 80000000;
+const uint8_t kLedcMaxResolution = 20;
+
+// Settled output values stay within this share of the final value
+const float kSettlingTolerance = 0.02;
+
+// Roughly 1 ms at 240 MHz
+const int kBusyLoopIterations = 60000;
+
+// Fewest cycles of a few runs of a fixed busy loop. Interrupts on this core
+// stretch every run; preemption by other tasks only some of them.
+uint32_t BusyLoopCycles() {
+  uint32_t fewest = UINT32_MAX;
+  for (int run = 0; run < 5; run++) {
+    uint32_t start = ESP.getCycleCount();
+    for (volatile int i = 0; i < kBusyLoopIterations; i++) {
+    }
+    fewest = std::min(fewest, ESP.getCycleCount() - start);
+  }
+  return fewest;
+}
+
+}  // namespace
+
+uint8_t LedcPulseSource::resolution_for(float hz) {
+  // The fewest bits that keep the clock divider below 1024, which leaves it
+  // the most precision. A square wave needs no more.
+  uint8_t resolution = 1;
+  while (resolution < kLedcMaxResolution &&
+         kLedcClockHz / (hz * (1UL << resolution)) >= 1024) {
+    resolution++;
+  }
+  return resolution;
+}
+
+float LedcPulseSource::set_frequency(float hz) {
+  uint32_t rounded = std::max(1L, lroundf(hz));
+  resolution_ = resolution_for(rounded);
+  if (ledcChangeFrequency(pin_, rounded, resolution_) == 0) {
+    debugW("LEDC can't run at %u Hz with %u bits", rounded, resolution_);
+    ledcWrite(pin_, 0);
+    return 0;
+  }
+  ledcWrite(pin_, 1UL << (resolution_ - 1));
+  // The rate of the divider the timer got, with its 8 fractional bits.
+  // ledcChangeFrequency() truncates it to whole Hz.
+  float counts = static_cast<float>(rounded) * (1UL << resolution_);
+  float divider = roundf(kLedcClockHz * 256.0f / counts) / 256;
+  return kLedcClockHz / (divider * (1UL << resolution_));
+}
+
+void LedcPulseSource::stop() { ledcWrite(pin_, 0); }
+
+SimulatedPulseSource::SimulatedPulseSource(unsigned int read_interval)
+    : read_interval_{read_interval} {
+  sensesp::event_loop()->onRepeat(read_interval_, [this]() {
+    float pulses = hz_ * read_interval_ / 1000 + fraction_;
+    int count = pulses;
+    fraction_ = pulses - count;
+    this->emit(count);
+  });
+}
+
+float SimulatedPulseSource::set_frequency(float hz) {
+  hz_ = hz;
+  return hz;
+}
+
+TachoSelfTest::TachoSelfTest(PulseSource* source,
+                             sensesp::FloatProducer* output, float min_hz,
+                             float max_hz, int steps, uint32_t step_ms)
+    : source_{source},
+      min_hz_{min_hz},
+      max_hz_{max_hz},
+      num_steps_{std::max(2, steps)},
+      step_ms_{step_ms} {
+  output->connect_to(
+      ArenaNew<sensesp::LambdaConsumer<float>>([this](float value) {
+        if (running_ && num_samples_ < kMaxSamples && !isnan(value)) {
+          samples_[num_samples_++] = {millis() - step_start_ms_, value};
+        }
+      }));
+}
+
+void TachoSelfTest::start(uint32_t delay_ms) {
+  sensesp::event_loop()->onDelay(delay_ms, [this]() {
+    source_->stop();
+    baseline_cycles_ = BusyLoopCycles();
+    steps_.clear();
+    running_ = true;
+    debugI("Tacho self-test: %d steps from %.0f to %.0f Hz", num_steps_,
+           min_hz_, max_hz_);
+    start_step();
+  });
+}
+
+void TachoSelfTest::start_step() {
+  int index = steps_.size();
+  float hz = min_hz_ * powf(max_hz_ / min_hz_,
+                            static_cast<float>(index) / (num_steps_ - 1));
+  Step step = {};
+  step.set_hz = source_->set_frequency(hz);
+  steps_.push_back(step);
+  num_samples_ = 0;
+  step_start_ms_ = millis();
+  sensesp::event_loop()->onDelay(step_ms_, [this]() { finish_step(); });
+}
+
+void TachoSelfTest::finish_step() {
+  Step& step = steps_.back();
+  step.output = NAN;
+  step.ratio = NAN;
+  step.settling_ms = step_ms_;
+  if (num_samples_ > 0) {
+    int first = std::max(0, num_samples_ - 3);
+    float sum = 0;
+    for (int i = first; i < num_samples_; i++) {
+      sum += samples_[i].value;
+    }
+    step.output = sum / (num_samples_ - first);
+    step.ratio = step.set_hz > 0 ? step.output / step.set_hz : NAN;
+
+    // Last sample outside the tolerance band
+    float tolerance = kSettlingTolerance * fabsf(step.output);
+    int settled = 0;
+    for (int i = num_samples_ - 1; i >= 0; i--) {
+      if (fabsf(samples_[i].value - step.output) > tolerance) {
+        settled = i + 1;
+        break;
+      }
+    }
+    if (settled < num_samples_) {
+      step.settling_ms = samples_[settled].time_ms;
+    }
+  }
+
+  uint32_t cycles = BusyLoopCycles();
+  step.isr_load = std::max(0.0f, 1.0f - static_cast<float>(baseline_cycles_) /
+                                            cycles);
+
+  if (static_cast<int>(steps_.size()) < num_steps_) {
+    start_step();
+  } else {
+    finish();
+  }
+}
+
+void TachoSelfTest::finish() {
+  source_->stop();
+  running_ = false;
+
+  std::vector<float> ratios;
+  for (const Step& step : steps_) {
+    if (!isnan(step.ratio)) {
+      ratios.push_back(step.ratio);
+    }
+  }
+  float median = NAN;
+  if (!ratios.empty()) {
+    auto middle = ratios.begin() + ratios.size() / 2;
+    std::nth_element(ratios.begin(), middle, ratios.end());
+    median = *middle;
+  }
+
+  debugI("Tacho self-test: median multiplier %.6g", median);
+  debugI("    Hz       output     error  settling  ISR load");
+  for (Step& step : steps_) {
+    step.error = step.ratio / median - 1;
+    debugI("%8.1f %10.4f %8.2f%% %7u ms %8.2f%%", step.set_hz, step.output,
+           step.error * 100, step.settling_ms, step.isr_load * 100);
+  }
+}
+
+String TachoSelfTest::to_json() const {
+  JsonDocument doc;
+  doc["running"] = running_;
+  JsonArray steps = doc["steps"].to<JsonArray>();
+  for (const Step& step : steps_) {
+    JsonObject obj = steps.add<JsonObject>();
+    obj["hz"] = step.set_hz;
+    obj["output"] = step.output;
+    obj["ratio"] = step.ratio;
+    obj["error"] = step.error;
+    obj["settlingTime"] = step.settling_ms / 1000.;
+    obj["isrLoad"] = step.isr_load;
+  }
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
+
+void TachoSelfTest::enable_reporting() {
+  auto handler = std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_GET, "/api/tacho_self_test", [this](httpd_req_t* req) {
+        String json = to_json();
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_send(req, json.c_str(), json.length());
+        return ESP_OK;
+      });
+  sensesp::sensesp_app->get_http_server()->add_handler(handler);
+}
+
+}  // namespace halmet
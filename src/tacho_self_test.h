@@ -0,0 +1,137 @@
+#ifndef HALMET_SRC_TACHO_SELF_TEST_H_
+#define HALMET_SRC_TACHO_SELF_TEST_H_
+
+#include <Arduino.h>
+
+#include <vector>
+
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/// Square wave source for the tacho self-test
+class PulseSource {
+ public:
+  /// Start pulses at about the given rate. Returns the actual rate.
+  virtual float set_frequency(float hz) = 0;
+  virtual void stop() = 0;
+};
+
+/**
+ * @brief Pulses on an LEDC output, looped back to a digital input.
+ *
+ * The LEDC timer divides its clock by at most 1024 and by 2^resolution, so
+ * no single resolution covers the sweep: at 8 bits, the lowest rate is
+ * about 305 Hz from the 80 MHz APB clock and 3.8 Hz from the 1 MHz
+ * REF_TICK. Each rate gets the coarsest resolution the APB clock reaches
+ * it at, which keeps the rate within 0.01% and goes below 0.1 Hz at the
+ * ESP32's 20 bits. The pin must already be attached to the LEDC.
+ */
+class LedcPulseSource : public PulseSource {
+ public:
+  LedcPulseSource(int pin) : pin_{pin} {}
+
+  float set_frequency(float hz) override;
+  void stop() override;
+
+  /// Timer resolution in bits for the given rate
+  static uint8_t resolution_for(float hz);
+
+ protected:
+  int pin_;
+  uint8_t resolution_ = 8;
+};
+
+/**
+ * @brief Pulse counts as a DigitalInputCounter would emit them.
+ *
+ * Emits the number of pulses of each read interval, carrying the fraction
+ * over, so a tacho chain can be tested without the hardware.
+ */
+class SimulatedPulseSource : public PulseSource,
+                             public sensesp::ValueProducer<int> {
+ public:
+  SimulatedPulseSource(unsigned int read_interval = 500);
+
+  float set_frequency(float hz) override;
+  void stop() override { hz_ = 0; }
+
+ protected:
+  unsigned int read_interval_;
+  float hz_ = 0;
+  float fraction_ = 0;
+};
+
+/**
+ * @brief Frequency sweep of a tacho chain, with a calibration table.
+ *
+ * The pulse rate is stepped geometrically from min_hz to max_hz. At each
+ * step, the chain output is recorded for step_ms, and the step reports:
+ *
+ * - the settled output, as the mean of its last three values, and its
+ *   ratio to the pulse rate, which is the effective revolution multiplier;
+ * - the error of the ratio, relative to the median ratio of all steps;
+ * - the settling time until the output stays within 2% of the settled
+ *   value;
+ * - the CPU load of the counter ISR, from the slowdown of a fixed busy
+ *   loop compared to the same loop without pulses.
+ *
+ * The error shows where the counter loses accuracy: count resolution at
+ * low rates and missed pulses at high rates. The median ratio should match
+ * the configured multiplier. The table is logged and served at
+ * /api/tacho_self_test.
+ */
+class TachoSelfTest {
+ public:
+  struct Step {
+    float set_hz;
+    float output;
+    float ratio;
+    float error;
+    uint32_t settling_ms;
+    float isr_load;
+  };
+
+  TachoSelfTest(PulseSource* source, sensesp::FloatProducer* output,
+                float min_hz = 2, float max_hz = 10000, int steps = 16,
+                uint32_t step_ms = 5000);
+
+  /// Start the sweep after the given delay
+  void start(uint32_t delay_ms);
+  bool is_running() const { return running_; }
+
+  const std::vector<Step>& get_steps() const { return steps_; }
+  String to_json() const;
+
+  /// Serve the table over HTTP
+  void enable_reporting();
+
+ protected:
+  static const int kMaxSamples = 64;
+
+  struct Sample {
+    uint32_t time_ms;  // Since the start of the step
+    float value;
+  };
+
+  void start_step();
+  void finish_step();
+  void finish();
+
+  PulseSource* source_;
+  float min_hz_;
+  float max_hz_;
+  int num_steps_;
+  uint32_t step_ms_;
+
+  bool running_ = false;
+  uint32_t baseline_cycles_ = 0;
+  uint32_t step_start_ms_ = 0;
+  Sample samples_[kMaxSamples];
+  int num_samples_ = 0;
+  std::vector<Step> steps_;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_TACHO_SELF_TEST_H_
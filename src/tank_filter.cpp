@@ -0,0 +1,288 @@
+#include "tank_filter.h"
+
+#include <algorithm>
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/system/lambda_consumer.h"
+
+namespace halmet {
+
+namespace {
+
+// The consumption rate is estimated once this share of the window is filled
+const int kMinPoints = TankConsumption::kPoints / 4;
+
+}  // namespace
+
+// Passed by reference to std::min, so they need a definition
+const int TankLevelFilter::kMaxBuckets;
+const int TankConsumption::kPoints;
+
+TankLevelFilter::TankLevelFilter(const String& config_path)
+    : sensesp::FileSystemSaveable{config_path} {
+  load();
+}
+
+void TankLevelFilter::reset() {
+  current_ = 0;
+  filled_ = 0;
+  bucket_sum_ = 0;
+  bucket_count_ = 0;
+  bucket_start_ = millis();
+}
+
+void TankLevelFilter::set(const float& value) {
+  if (isnan(value)) {
+    return;
+  }
+  unsigned long now = millis();
+  if (filled_ == 0 && bucket_count_ == 0) {
+    bucket_start_ = now;
+  }
+  bucket_sum_ += value;
+  bucket_count_++;
+  // Buckets are contiguous, so that a slow sample rate still closes one
+  // bucket per sample rather than every other sample.
+  if (now - bucket_start_ < bucket_interval_ * 1000) {
+    return;
+  }
+  buckets_[current_] = bucket_sum_ / bucket_count_;
+  current_ = (current_ + 1) % window_;
+  filled_ = std::min(filled_ + 1, window_);
+  bucket_start_ = now;
+  bucket_sum_ = 0;
+  bucket_count_ = 0;
+  this->emit(median());
+}
+
+float TankLevelFilter::median() const {
+  float values[kMaxBuckets];
+  std::copy(buckets_, buckets_ + filled_, values);
+  float* middle = values + filled_ / 2;
+  std::nth_element(values, middle, values + filled_);
+  return *middle;
+}
+
+bool TankLevelFilter::from_json(const JsonObject& config) {
+  String expected[] = {"bucket_interval", "window"};
+  for (auto str : expected) {
+    if (!config[str].is<float>()) {
+      return false;
+    }
+  }
+  bucket_interval_ = std::max(0.1f, config["bucket_interval"].as<float>());
+  window_ = std::min(std::max(1, config["window"].as<int>()), kMaxBuckets);
+  reset();
+  return true;
+}
+
+bool TankLevelFilter::to_json(JsonObject& config) {
+  config["bucket_interval"] = bucket_interval_;
+  config["window"] = window_;
+  return true;
+}
+
+// The bucket means, oldest first
+size_t TankLevelFilter::save_state(uint8_t* buffer, size_t size) {
+  uint32_t count = filled_;
+  size_t needed = sizeof(count) + count * sizeof(float);
+  if (needed > size) {
+    return 0;
+  }
+  memcpy(buffer, &count, sizeof(count));
+  for (int i = 0; i < filled_; i++) {
+    float mean = buckets_[(current_ + window_ - filled_ + i) % window_];
+    memcpy(buffer + sizeof(count) + i * sizeof(float), &mean, sizeof(mean));
+  }
+  return needed;
+}
+
+void TankLevelFilter::restore_state(const uint8_t* buffer, size_t size,
+                                    uint32_t age_ms) {
+  uint32_t count;
+  if (size < sizeof(count)) {
+    return;
+  }
+  memcpy(&count, buffer, sizeof(count));
+  if (size != sizeof(count) + count * sizeof(float)) {
+    return;
+  }
+  reset();
+  // Keep the newest buckets if the window has shrunk
+  uint32_t window = window_;
+  for (uint32_t i = count > window ? count - window : 0; i < count; i++) {
+    memcpy(&buckets_[filled_++], buffer + sizeof(count) + i * sizeof(float),
+           sizeof(float));
+  }
+  current_ = filled_ % window_;
+}
+
+const String ConfigSchema(const TankLevelFilter& obj) {
+  return R"###({
+    "type": "object",
+    "properties": {
+      "bucket_interval": { "title": "Bucket interval", "type": "number", "description": "Seconds of samples averaged per bucket. Keep below 10 s for NMEA 2000." },
+      "window": { "title": "Window", "type": "integer", "description": "Number of buckets the median is taken over (1-64)" }
+    }
+  })###";
+}
+
+TankConsumption::TankConsumption(const String& name,
+                                 const String& config_path)
+    : sensesp::FileSystemSaveable{config_path}, name_{name} {
+  load();
+}
+
+void TankConsumption::reset() {
+  current_ = 0;
+  filled_ = 0;
+  volume_sum_ = 0;
+  volume_count_ = 0;
+  reference_sum_ = 0;
+  reference_count_ = 0;
+  point_start_ = millis();
+}
+
+void TankConsumption::set_reference(sensesp::FloatProducer* reference_rate) {
+  reference_rate->connect_to(
+      ArenaNew<sensesp::LambdaConsumer<float>>([this](float value) {
+        if (!isnan(value)) {
+          reference_sum_ += value;
+          reference_count_++;
+        }
+      }));
+}
+
+void TankConsumption::set(const float& volume) {
+  if (isnan(volume)) {
+    return;
+  }
+  unsigned long now = millis();
+  if (filled_ == 0 && volume_count_ == 0) {
+    point_start_ = now;
+  }
+  volume_sum_ += volume;
+  volume_count_++;
+  if (now - point_start_ < window_ * 60000 / kPoints) {
+    return;
+  }
+  add_point(now, volume_sum_ / volume_count_);
+  point_start_ = now;
+  volume_sum_ = 0;
+  volume_count_ = 0;
+}
+
+void TankConsumption::add_point(uint32_t time_ms, float volume) {
+  points_[current_] = {time_ms, volume,
+                       reference_count_ > 0 ? reference_sum_ / reference_count_
+                                            : NAN};
+  current_ = (current_ + 1) % kPoints;
+  filled_ = std::min(filled_ + 1, kPoints);
+  reference_sum_ = 0;
+  reference_count_ = 0;
+  if (filled_ < kMinPoints) {
+    return;
+  }
+
+  // Least-squares slope, with the times relative to the newest point
+  float sum_x = 0;
+  float sum_y = 0;
+  float sum_reference = 0;
+  int num_reference = 0;
+  for (int i = 0; i < filled_; i++) {
+    sum_x += static_cast<int32_t>(points_[i].time_ms - time_ms) / 1000.0f;
+    sum_y += points_[i].volume;
+    if (!isnan(points_[i].reference)) {
+      sum_reference += points_[i].reference;
+      num_reference++;
+    }
+  }
+  float mean_x = sum_x / filled_;
+  float mean_y = sum_y / filled_;
+  float sxy = 0;
+  float sxx = 0;
+  for (int i = 0; i < filled_; i++) {
+    float dx =
+        static_cast<int32_t>(points_[i].time_ms - time_ms) / 1000.0f - mean_x;
+    sxy += dx * (points_[i].volume - mean_y);
+    sxx += dx * dx;
+  }
+  if (sxx <= 0) {
+    return;
+  }
+  float consumption = -sxy / sxx;
+
+  rate.set(consumption);
+  time_to_empty.set(consumption > 0 ? volume / consumption : NAN);
+
+  if (num_reference > 0) {
+    // In l/h, which is easier to compare by eye
+    debugD("Tank %s: consumption %.2f l/h, reference %.2f l/h",
+           name_.c_str(), consumption * 3.6e6f,
+           sum_reference / num_reference * 3.6e6f);
+  }
+}
+
+bool TankConsumption::from_json(const JsonObject& config) {
+  if (!config["window"].is<float>()) {
+    return false;
+  }
+  window_ = std::max(1.0f, config["window"].as<float>());
+  reset();
+  return true;
+}
+
+bool TankConsumption::to_json(JsonObject& config) {
+  config["window"] = window_;
+  return true;
+}
+
+// The points, oldest first, with their age at the time of saving
+size_t TankConsumption::save_state(uint8_t* buffer, size_t size) {
+  uint32_t count = filled_;
+  size_t needed = sizeof(count) + count * sizeof(Point);
+  if (needed > size) {
+    return 0;
+  }
+  uint32_t now = millis();
+  memcpy(buffer, &count, sizeof(count));
+  for (int i = 0; i < filled_; i++) {
+    Point point = points_[(current_ + kPoints - filled_ + i) % kPoints];
+    point.time_ms = now - point.time_ms;
+    memcpy(buffer + sizeof(count) + i * sizeof(Point), &point, sizeof(point));
+  }
+  return needed;
+}
+
+void TankConsumption::restore_state(const uint8_t* buffer, size_t size,
+                                    uint32_t age_ms) {
+  uint32_t count;
+  if (size < sizeof(count)) {
+    return;
+  }
+  memcpy(&count, buffer, sizeof(count));
+  if (count > kPoints || size != sizeof(count) + count * sizeof(Point)) {
+    return;
+  }
+  reset();
+  uint32_t now = millis();
+  for (uint32_t i = 0; i < count; i++) {
+    Point& point = points_[filled_++];
+    memcpy(&point, buffer + sizeof(count) + i * sizeof(Point), sizeof(point));
+    // Times before boot wrap around, which the fit's differences handle
+    point.time_ms = now - point.time_ms - age_ms;
+  }
+  current_ = filled_ % kPoints;
+}
+
+const String ConfigSchema(const TankConsumption& obj) {
+  return R"###({
+    "type": "object",
+    "properties": {
+      "window": { "title": "Window", "type": "number", "description": "Minutes of tank volume the consumption rate is fitted over" }
+    }
+  })###";
+}
+
+}  // namespace halmet
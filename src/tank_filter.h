@@ -0,0 +1,147 @@
+#ifndef HALMET_SRC_TANK_FILTER_H_
+#define HALMET_SRC_TANK_FILTER_H_
+
+#include <Arduino.h>
+
+#include "config_store.h"
+#include "sensesp/system/observablevalue.h"
+#include "sensesp/system/saveable.h"
+#include "sensesp/system/valueconsumer.h"
+#include "sensesp/system/valueproducer.h"
+#include "warm_start.h"
+
+namespace halmet {
+
+/**
+ * @brief Tank level smoothing that rejects sloshing.
+ *
+ * The input samples are averaged over bucket_interval seconds, and the
+ * output is the median of the last `window` bucket means, emitted once per
+ * bucket. The bucket mean cancels sloshing faster than the bucket length;
+ * the median rejects the minutes-long swings of a seaway or a heel that
+ * the mean would follow. Samples cost O(1) and memory is fixed; only the
+ * median is computed per bucket.
+ *
+ * Keep bucket_interval below the 10 s expiry of the NMEA 2000 fluid level
+ * sender.
+ */
+class TankLevelFilter : public sensesp::FloatConsumer,
+                        public sensesp::ValueProducer<float>,
+                        public sensesp::FileSystemSaveable,
+                        public WarmState {
+ public:
+  static const int kMaxBuckets = 64;
+
+  TankLevelFilter(const String& config_path = "");
+
+  void set(const float& value) override;
+
+  virtual bool from_json(const JsonObject& config) override;
+  virtual bool to_json(JsonObject& config) override;
+
+  size_t max_state_size() const override {
+    return sizeof(uint32_t) + kMaxBuckets * sizeof(float);
+  }
+  size_t save_state(uint8_t* buffer, size_t size) override;
+  void restore_state(const uint8_t* buffer, size_t size,
+                     uint32_t age_ms) override;
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+ protected:
+  void reset();
+  float median() const;
+
+  float bucket_interval_ = 4;  // s
+  int window_ = 45;            // Buckets
+
+  float buckets_[kMaxBuckets];
+  int current_ = 0;
+  int filled_ = 0;
+  unsigned long bucket_start_ = 0;
+  float bucket_sum_ = 0;
+  int bucket_count_ = 0;
+};
+
+const String ConfigSchema(const TankLevelFilter& obj);
+
+inline bool ConfigRequiresRestart(const TankLevelFilter& obj) { return false; }
+
+/**
+ * @brief Consumption rate and time to empty from a smoothed tank volume.
+ *
+ * The volume is averaged into kPoints points over the window, and the
+ * consumption rate is the negated least-squares slope through them, so
+ * that it is positive when the tank empties. The time to empty is the
+ * volume divided by the rate, and NaN (null in Signal K) while the tank
+ * isn't emptying.
+ *
+ * If a reference rate is set, for example the engine fuel rate derived
+ * from the tacho, it is averaged over the same window and logged next to
+ * the measured rate after every point.
+ */
+class TankConsumption : public sensesp::FloatConsumer,
+                        public sensesp::FileSystemSaveable,
+                        public WarmState {
+ public:
+  static const int kPoints = 60;
+
+  TankConsumption(const String& name, const String& config_path = "");
+
+  /// Smoothed volume in m3
+  void set(const float& volume) override;
+
+  /// Compare the rate with another estimate in m3/s
+  void set_reference(sensesp::FloatProducer* reference_rate);
+
+  sensesp::ObservableValue<float> rate;           // m3/s
+  sensesp::ObservableValue<float> time_to_empty;  // s
+
+  virtual bool from_json(const JsonObject& config) override;
+  virtual bool to_json(JsonObject& config) override;
+
+  size_t max_state_size() const override {
+    return sizeof(uint32_t) + kPoints * sizeof(Point);
+  }
+  size_t save_state(uint8_t* buffer, size_t size) override;
+  void restore_state(const uint8_t* buffer, size_t size,
+                     uint32_t age_ms) override;
+
+#ifdef HALMET_CONFIG_STORE
+  virtual bool load() override { return LoadFromConfigStore(this); }
+  virtual bool save() override { return SaveToConfigStore(this); }
+#endif
+
+ protected:
+  struct Point {
+    uint32_t time_ms;
+    float volume;     // m3
+    float reference;  // m3/s, or NaN
+  };
+
+  void reset();
+  void add_point(uint32_t time_ms, float volume);
+
+  String name_;
+  float window_ = 30;  // min
+
+  Point points_[kPoints];
+  int current_ = 0;
+  int filled_ = 0;
+  unsigned long point_start_ = 0;
+  float volume_sum_ = 0;
+  int volume_count_ = 0;
+  float reference_sum_ = 0;
+  int reference_count_ = 0;
+};
+
+const String ConfigSchema(const TankConsumption& obj);
+
+inline bool ConfigRequiresRestart(const TankConsumption& obj) { return false; }
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_TANK_FILTER_H_
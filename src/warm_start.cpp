@@ -0,0 +1,239 @@
+#include "warm_start.h"
+
+#include <esp_attr.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <sys/time.h>
+
+#include "arena.h"
+#include "latency_tracer.h"
+#include "sensesp.h"
+#include "sensesp/net/http_server.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp_app.h"
+
+namespace halmet {
+
+namespace {
+
+// "WARM" in little endian
+const uint32_t kSnapshotMagic = 0x4d524157;
+
+// Snapshots older than this are from a different run of the boat
+const uint32_t kMaxDowntimeMs = 5 * 60 * 1000;
+
+struct ChannelRecord {
+  uint32_t key;
+  float value;
+  uint32_t age_ms;  // At the time of saving
+};
+
+// Header of each state in RtcSnapshot::states, followed by the state and
+// padded to four bytes
+struct StateHeader {
+  uint32_t key;
+  uint16_t size;
+  uint16_t reserved;
+};
+
+struct RtcSnapshot {
+  uint32_t magic;
+  uint32_t size;  // sizeof(RtcSnapshot), to catch layout changes
+  int64_t saved_us;
+  uint8_t n2k_source;
+  uint8_t num_channels;
+  uint16_t states_size;
+  ChannelRecord channels[WarmStart::kMaxChannels];
+  uint8_t states[WarmStart::kStateSize];
+  uint32_t crc;
+};
+
+RTC_NOINIT_ATTR RtcSnapshot rtc_snapshot;
+
+uint32_t ComputeCRC() {
+  return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&rtc_snapshot),
+                          offsetof(RtcSnapshot, crc));
+}
+
+// FNV-1a
+uint32_t Key(const String& name) {
+  uint32_t hash = 2166136261;
+  for (size_t i = 0; i < name.length(); i++) {
+    hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619;
+  }
+  return hash;
+}
+
+int64_t SystemTimeUs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+}  // namespace
+
+WarmStart* WarmStart::get() {
+  static WarmStart warm_start;
+  return &warm_start;
+}
+
+void WarmStart::begin() {
+  esp_reset_reason_t reason = esp_reset_reason();
+  int64_t downtime_us = SystemTimeUs() - rtc_snapshot.saved_us;
+  warm_ = reason != ESP_RST_POWERON && rtc_snapshot.magic == kSnapshotMagic &&
+          rtc_snapshot.size == sizeof(RtcSnapshot) &&
+          rtc_snapshot.crc == ComputeCRC() &&
+          rtc_snapshot.num_channels <= kMaxChannels &&
+          rtc_snapshot.states_size <= kStateSize && downtime_us >= 0 &&
+          downtime_us < kMaxDowntimeMs * 1000LL;
+  if (!warm_) {
+    rtc_snapshot.magic = 0;
+    return;
+  }
+  downtime_ms_ = downtime_us / 1000;
+  debugI("Warm start: snapshot from %u ms ago, N2K source %u", downtime_ms_,
+         rtc_snapshot.n2k_source);
+}
+
+uint8_t WarmStart::n2k_source(uint8_t default_source) const {
+  return warm_ && rtc_snapshot.n2k_source < 252 ? rtc_snapshot.n2k_source
+                                                : default_source;
+}
+
+void WarmStart::add_channel(const String& name,
+                            sensesp::FloatProducer* producer,
+                            uint32_t max_age_ms) {
+  if (channels_.size() >= kMaxChannels) {
+    debugW("Warm start: no room for channel %s", name.c_str());
+    return;
+  }
+  int index = channels_.size();
+  channels_.push_back({Key(name), producer, max_age_ms});
+  producer->connect_to(
+      ArenaNew<sensesp::LambdaConsumer<float>>([this, index](float value) {
+        if (!isnan(value)) {
+          channels_[index].value = value;
+          channels_[index].updated_ms = millis();
+        }
+      }));
+}
+
+void WarmStart::add_state(const String& name, WarmState* state) {
+  size_t needed =
+      sizeof(StateHeader) + ((state->max_state_size() + 3) & ~3);
+  if (reserved_size_ + needed > kStateSize) {
+    debugE("Warm start: no room for state %s (%u bytes, %u of %u reserved)",
+           name.c_str(), needed, reserved_size_, kStateSize);
+    refused_states_++;
+    return;
+  }
+  reserved_size_ += needed;
+  uint32_t key = Key(name);
+  states_.push_back({key, state});
+  if (!warm_) {
+    return;
+  }
+
+  size_t offset = 0;
+  while (offset + sizeof(StateHeader) <= rtc_snapshot.states_size) {
+    StateHeader header;
+    memcpy(&header, rtc_snapshot.states + offset, sizeof(header));
+    offset += sizeof(header);
+    if (header.key == key &&
+        offset + header.size <= rtc_snapshot.states_size) {
+      state->restore_state(rtc_snapshot.states + offset, header.size,
+                           downtime_ms_ + millis());
+      return;
+    }
+    offset += (header.size + 3) & ~3;
+  }
+}
+
+void WarmStart::restore() {
+  if (!warm_) {
+    return;
+  }
+  int restored = 0;
+  for (int i = 0; i < rtc_snapshot.num_channels; i++) {
+    const ChannelRecord& record = rtc_snapshot.channels[i];
+    for (Channel& channel : channels_) {
+      if (channel.key != record.key) {
+        continue;
+      }
+      uint32_t age_ms = record.age_ms + downtime_ms_ + millis();
+      if (age_ms < channel.max_age_ms && isnan(channel.value)) {
+        LatencyTracer::get()->stamp(micros() - age_ms * 1000);
+        channel.producer->emit(record.value);
+        channel.updated_ms = millis() - age_ms;
+        restored++;
+      }
+      break;
+    }
+  }
+  debugI("Warm start: restored %d of %d channels", restored,
+         rtc_snapshot.num_channels);
+}
+
+void WarmStart::save() {
+  uint32_t now = millis();
+
+  // A reset halfway leaves an invalid snapshot rather than a mixed one
+  rtc_snapshot.magic = 0;
+  rtc_snapshot.size = sizeof(RtcSnapshot);
+  rtc_snapshot.saved_us = SystemTimeUs();
+  rtc_snapshot.n2k_source =
+      nmea2000_ != nullptr ? nmea2000_->GetN2kSource() : 255;
+
+  int num_channels = 0;
+  for (const Channel& channel : channels_) {
+    if (isnan(channel.value)) {
+      continue;
+    }
+    rtc_snapshot.channels[num_channels++] = {channel.key, channel.value,
+                                             now - channel.updated_ms};
+  }
+  rtc_snapshot.num_channels = num_channels;
+
+  size_t offset = 0;
+  for (const State& state : states_) {
+    if (offset + sizeof(StateHeader) > kStateSize) {
+      break;
+    }
+    size_t size =
+        state.state->save_state(rtc_snapshot.states + offset +
+                                    sizeof(StateHeader),
+                                kStateSize - offset - sizeof(StateHeader));
+    if (size == 0) {
+      // Can't happen with the room reserved in add_state()
+      debugE("Warm start: state %08x larger than reserved", state.key);
+      continue;
+    }
+    StateHeader header = {state.key, static_cast<uint16_t>(size), 0};
+    memcpy(rtc_snapshot.states + offset, &header, sizeof(header));
+    offset += sizeof(header) + ((size + 3) & ~3);
+  }
+  rtc_snapshot.states_size = offset < kStateSize ? offset : kStateSize;
+
+  rtc_snapshot.magic = kSnapshotMagic;
+  rtc_snapshot.crc = ComputeCRC();
+}
+
+void WarmStart::start(tNMEA2000* nmea2000) {
+  nmea2000_ = nmea2000;
+  debugI("Warm start: %u of %u bytes reserved for %d states, %d refused",
+         reserved_size_, kStateSize, static_cast<int>(states_.size()),
+         refused_states_);
+  sensesp::event_loop()->onRepeat(1000, [this]() { save(); });
+
+  auto handler = std::make_shared<sensesp::HTTPRequestHandler>(
+      1 << HTTP_POST, "/api/warm_start/reset", [this](httpd_req_t* req) {
+        save();
+        httpd_resp_send(req, nullptr, 0);
+        delay(100);
+        esp_restart();
+        return ESP_OK;
+      });
+  sensesp::sensesp_app->get_http_server()->add_handler(handler);
+}
+
+}  // namespace halmet
@@ -0,0 +1,109 @@
+#ifndef HALMET_SRC_WARM_START_H_
+#define HALMET_SRC_WARM_START_H_
+
+#include <Arduino.h>
+#include <NMEA2000.h>
+
+#include <vector>
+
+#include "sensesp/system/valueproducer.h"
+
+namespace halmet {
+
+/**
+ * @brief State of an accumulator that can be carried over a reset.
+ *
+ * Times in the state must be saved relative to the time of saving, as
+ * millis() restarts from zero.
+ */
+class WarmState {
+ public:
+  /// Largest size save_state() can return, to reserve room in the snapshot
+  virtual size_t max_state_size() const = 0;
+  /// Write the state to buffer. Returns its size, or 0 if it doesn't fit.
+  virtual size_t save_state(uint8_t* buffer, size_t size) = 0;
+  /// Restore a state that was saved age_ms ago. Mismatching states, e.g.
+  /// after a configuration change, must be ignored.
+  virtual void restore_state(const uint8_t* buffer, size_t size,
+                             uint32_t age_ms) = 0;
+};
+
+/**
+ * @brief Snapshot of the live state in RTC memory, for a warm start.
+ *
+ * Once a second, the claimed N2K source address, the last valid value and
+ * age of each registered channel and the registered accumulator states are
+ * written to a CRC-protected snapshot in RTC slow memory. RTC memory
+ * survives software, watchdog, panic and brownout resets, and nothing is
+ * written to flash.
+ *
+ * After such a reset, begin() validates the snapshot. The N2K node then
+ * opens with its previous source address instead of the default,
+ * accumulators are restored as they register, and restore() re-emits the
+ * channel values that are younger than their max age, so the N2K senders
+ * have valid data on their first transmission. Each channel is stamped
+ * with its original acquisition time for the latency tracer.
+ *
+ * The time between the last save and the reset is taken from the system
+ * clock, which keeps counting through these resets.
+ */
+class WarmStart {
+ public:
+  static const int kMaxChannels = 16;
+  // Enough for the states of the default channel map: one engine, one tank,
+  // the exhaust temperature and the A2 voltage
+  static const size_t kStateSize = 4096;
+
+  static WarmStart* get();
+
+  /// Validate the snapshot of the previous run. Call early in setup().
+  void begin();
+  bool is_warm() const { return warm_; }
+
+  /// Source address to open the N2K node with
+  uint8_t n2k_source(uint8_t default_source) const;
+
+  /// Track the last valid value of a channel
+  void add_channel(const String& name, sensesp::FloatProducer* producer,
+                   uint32_t max_age_ms = 10000);
+
+  /// Save an accumulator state, and restore it now if the snapshot has one.
+  /// Room for its largest state is reserved; a state that doesn't fit is
+  /// refused with an error and starts cold after a reset.
+  void add_state(const String& name, WarmState* state);
+
+  /// Re-emit the restored channel values. Call once the graph is built.
+  void restore();
+
+  /// Start the periodic saves, and serve POST /api/warm_start/reset, which
+  /// saves the snapshot and restarts, to time a warm boot.
+  void start(tNMEA2000* nmea2000);
+
+  void save();
+
+ protected:
+  struct Channel {
+    uint32_t key;
+    sensesp::FloatProducer* producer;
+    uint32_t max_age_ms;
+    float value = NAN;
+    uint32_t updated_ms = 0;
+  };
+
+  struct State {
+    uint32_t key;
+    WarmState* state;
+  };
+
+  bool warm_ = false;
+  uint32_t downtime_ms_ = 0;  // From the last save to begin()
+  tNMEA2000* nmea2000_ = nullptr;
+  std::vector<Channel> channels_;
+  std::vector<State> states_;
+  size_t reserved_size_ = 0;  // Of kStateSize, by the registered states
+  int refused_states_ = 0;
+};
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_WARM_START_H_
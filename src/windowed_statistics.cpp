@@ -0,0 +1,149 @@
+#include "windowed_statistics.h"
+
+#include "arena.h"
+#include "sensesp.h"
+#include "sensesp/signalk/signalk_output.h"
+
+namespace halmet {
+
+void RunningStatistics::add(float value) {
+  if (count_ == 0) {
+    min_ = value;
+    max_ = value;
+  } else {
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+  count_++;
+  float delta = value - mean_;
+  mean_ += delta / count_;
+  m2_ += delta * (value - mean_);
+}
+
+void RunningStatistics::merge(const RunningStatistics& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+  if (count_ == 0) {
+    *this = other;
+    return;
+  }
+  // Chan et al. pairwise combination
+  uint32_t count = count_ + other.count_;
+  float delta = other.mean_ - mean_;
+  mean_ += delta * other.count_ / count;
+  m2_ += other.m2_ + delta * delta * count_ / count * other.count_;
+  count_ = count;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+void RunningStatistics::reset() { *this = RunningStatistics(); }
+
+StatisticsWindow::StatisticsWindow(unsigned long window_ms)
+    : StatisticsWindow(window_ms, 1) {}
+
+StatisticsWindow::StatisticsWindow(unsigned long window_ms, int buckets)
+    : num_buckets_{constrain(buckets, 1, kMaxBuckets)},
+      bucket_ms_{window_ms / num_buckets_} {
+  sensesp::event_loop()->onRepeat(bucket_ms_, [this]() { this->advance(); });
+}
+
+void StatisticsWindow::set(const float& value) {
+  if (!isnan(value)) {
+    buckets_[current_].add(value);
+  }
+}
+
+void StatisticsWindow::advance() {
+  RunningStatistics window;
+  for (int i = 0; i < filled_; i++) {
+    window.merge(buckets_[i]);
+  }
+  unsigned long window_s = filled_ * bucket_ms_ / 1000;
+
+  // Drop the oldest bucket, or the only one for a tumbling window
+  current_ = (current_ + 1) % num_buckets_;
+  buckets_[current_].reset();
+  if (filled_ < num_buckets_) {
+    filled_++;
+  }
+
+  if (window.count() == 0) {
+    return;
+  }
+  char json[160];
+  snprintf(json, sizeof(json),
+           "{\"count\":%u,\"mean\":%g,\"stddev\":%g,\"min\":%g,\"max\":%g,"
+           "\"window_s\":%lu}",
+           window.count(), window.mean(), window.stddev(), window.min(),
+           window.max(), window_s);
+  this->emit(json);
+}
+
+// The buckets, oldest first. The current bucket restarts its sub-window
+// after a restore.
+size_t StatisticsWindow::save_state(uint8_t* buffer, size_t size) {
+  uint32_t num_buckets = num_buckets_;
+  size_t needed = sizeof(num_buckets) + filled_ * sizeof(RunningStatistics);
+  if (needed > size) {
+    return 0;
+  }
+  memcpy(buffer, &num_buckets, sizeof(num_buckets));
+  for (int i = 0; i < filled_; i++) {
+    int index = (current_ + num_buckets_ - filled_ + 1 + i) % num_buckets_;
+    memcpy(buffer + sizeof(num_buckets) + i * sizeof(RunningStatistics),
+           &buckets_[index], sizeof(RunningStatistics));
+  }
+  return needed;
+}
+
+void StatisticsWindow::restore_state(const uint8_t* buffer, size_t size,
+                                     uint32_t age_ms) {
+  uint32_t num_buckets;
+  if (size < sizeof(num_buckets)) {
+    return;
+  }
+  memcpy(&num_buckets, buffer, sizeof(num_buckets));
+  size_t filled = (size - sizeof(num_buckets)) / sizeof(RunningStatistics);
+  if (num_buckets != static_cast<uint32_t>(num_buckets_) || filled < 1 ||
+      filled > num_buckets ||
+      size != sizeof(num_buckets) + filled * sizeof(RunningStatistics)) {
+    return;
+  }
+  for (size_t i = 0; i < filled; i++) {
+    memcpy(&buckets_[i],
+           buffer + sizeof(num_buckets) + i * sizeof(RunningStatistics),
+           sizeof(RunningStatistics));
+  }
+  filled_ = filled;
+  current_ = filled - 1;
+}
+
+void ConnectWindowedStatistics(sensesp::FloatProducer* producer,
+                               const String& sk_path) {
+  struct WindowDefinition {
+    const char* name;
+    unsigned long window_ms;
+    int buckets;
+  };
+  const WindowDefinition kWindows[] = {
+      {"1m", 60 * 1000, 1},
+      {"15m", 15 * 60 * 1000, 15},
+      {"1h", 60 * 60 * 1000, 12},
+  };
+
+  for (const auto& definition : kWindows) {
+    auto window =
+        ArenaNew<StatisticsWindow>(definition.window_ms, definition.buckets);
+    producer->connect_to(window);
+
+    char window_sk_path[80];
+    snprintf(window_sk_path, sizeof(window_sk_path), "%s.statistics.%s",
+             sk_path.c_str(), definition.name);
+    WarmStart::get()->add_state(window_sk_path, window);
+    window->connect_to(ArenaNew<sensesp::SKOutputRawJson>(window_sk_path));
+  }
+}
+
+}  // namespace halmet
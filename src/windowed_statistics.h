@@ -0,0 +1,91 @@
+#ifndef HALMET_SRC_WINDOWED_STATISTICS_H_
+#define HALMET_SRC_WINDOWED_STATISTICS_H_
+
+#include <Arduino.h>
+
+#include "sensesp/system/valueconsumer.h"
+#include "sensesp/system/valueproducer.h"
+#include "warm_start.h"
+
+namespace halmet {
+
+/**
+ * @brief Running count, mean, variance, min and max of a value stream.
+ *
+ * Uses Welford's method, which avoids the cancellation of the naive sum of
+ * squares when the spread is small compared to the mean (e.g. a coolant
+ * temperature of 360 K varying by tenths of a degree). Two accumulators can
+ * be merged, which is how sliding windows combine their sub-buckets.
+ */
+class RunningStatistics {
+ public:
+  void add(float value);
+  void merge(const RunningStatistics& other);
+  void reset();
+
+  uint32_t count() const { return count_; }
+  float mean() const { return mean_; }
+  float variance() const { return count_ > 1 ? m2_ / (count_ - 1) : 0; }
+  float stddev() const { return sqrtf(variance()); }
+  float min() const { return min_; }
+  float max() const { return max_; }
+
+ private:
+  uint32_t count_ = 0;
+  float mean_ = 0;
+  float m2_ = 0;  // Sum of squared deviations from the mean
+  float min_ = 0;
+  float max_ = 0;
+};
+
+/**
+ * @brief Summary statistics of the input over a time window.
+ *
+ * A tumbling window emits and restarts once per window length. A sliding
+ * window is split into `buckets` sub-buckets and emits the statistics of
+ * the last full window length every time a sub-bucket completes. Samples
+ * cost O(1) and memory is fixed; nothing is allocated after construction.
+ *
+ * The output is a JSON object with the keys count, mean, stddev, min and
+ * max, for use with SKOutputRawJson. window_s is the time the statistics
+ * actually cover, which is less than the window length until a sliding
+ * window has filled after boot. Windows without samples are not emitted.
+ */
+class StatisticsWindow : public sensesp::FloatConsumer,
+                         public sensesp::ValueProducer<String>,
+                         public WarmState {
+ public:
+  static const int kMaxBuckets = 15;
+
+  /// Tumbling window of window_ms
+  StatisticsWindow(unsigned long window_ms);
+  /// Sliding window of window_ms, advanced in window_ms / buckets steps
+  StatisticsWindow(unsigned long window_ms, int buckets);
+
+  void set(const float& value) override;
+
+  size_t max_state_size() const override {
+    return sizeof(uint32_t) + num_buckets_ * sizeof(RunningStatistics);
+  }
+  size_t save_state(uint8_t* buffer, size_t size) override;
+  void restore_state(const uint8_t* buffer, size_t size,
+                     uint32_t age_ms) override;
+
+ protected:
+  void advance();
+
+  int num_buckets_;
+  unsigned long bucket_ms_;
+  int current_ = 0;
+  int filled_ = 1;  // Buckets holding data, up to num_buckets_
+  RunningStatistics buckets_[kMaxBuckets];
+};
+
+/// Attach 1 min tumbling, 15 min sliding and 1 h sliding statistics to a
+/// producer, output to <sk_path>.statistics.{1m,15m,1h}.
+void ConnectWindowedStatistics(sensesp::FloatProducer* producer,
+                               const String& sk_path);
+
+}  // namespace halmet
+
+#endif  // HALMET_SRC_WINDOWED_STATISTICS_H_
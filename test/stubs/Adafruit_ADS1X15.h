@@ -0,0 +1,152 @@
+#ifndef HALMET_TEST_STUBS_ADAFRUIT_ADS1X15_H_
+#define HALMET_TEST_STUBS_ADAFRUIT_ADS1X15_H_
+
+// Adafruit_ADS1115 for host tests. The gain settings and computeVolts()
+// match the library. Instead of reading over I2C, a conversion returns the
+// counts set with set_counts(), or those of a signal set with set_signal()
+// at the time the conversion completes. A single-shot conversion takes the
+// nominal time of the data rate on the clock of Arduino.h; reading the
+// result before then returns the previous one, as the device does, and is
+// counted as an early read.
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#include <functional>
+
+typedef enum {
+  GAIN_TWOTHIRDS = 0x0000,
+  GAIN_ONE = 0x0200,
+  GAIN_TWO = 0x0400,
+  GAIN_FOUR = 0x0600,
+  GAIN_EIGHT = 0x0800,
+  GAIN_SIXTEEN = 0x0A00
+} adsGain_t;
+
+#define ADS1X15_REG_CONFIG_MUX_SINGLE_0 (0x4000)
+#define ADS1X15_REG_CONFIG_MUX_SINGLE_1 (0x5000)
+#define ADS1X15_REG_CONFIG_MUX_SINGLE_2 (0x6000)
+#define ADS1X15_REG_CONFIG_MUX_SINGLE_3 (0x7000)
+
+#define RATE_ADS1115_8SPS (0x0000)
+#define RATE_ADS1115_16SPS (0x0020)
+#define RATE_ADS1115_32SPS (0x0040)
+#define RATE_ADS1115_64SPS (0x0060)
+#define RATE_ADS1115_128SPS (0x0080)
+#define RATE_ADS1115_250SPS (0x00A0)
+#define RATE_ADS1115_475SPS (0x00C0)
+#define RATE_ADS1115_860SPS (0x00E0)
+
+class Adafruit_ADS1115 {
+ public:
+  /// Counts of a channel at a time (us)
+  using Signal = std::function<int16_t(uint8_t channel, uint64_t time_us)>;
+
+  bool begin(uint8_t address = 0x48, TwoWire* wire = &Wire) {
+    address_ = address;
+    return present_;
+  }
+
+  void setDataRate(uint16_t rate) { data_rate_ = rate; }
+  uint16_t getDataRate() { return data_rate_; }
+
+  void startADCReading(uint16_t mux, bool continuous) {
+    fake::Clock::get()->advance_if_manual(i2c_transaction_us_);
+    channel_ = (mux >> 12) & 0x3;
+    conversion_start_us_ = fake::Clock::get()->micros64();
+    converting_ = true;
+    conversions_++;
+  }
+
+  bool conversionComplete() {
+    return fake::Clock::get()->micros64() - conversion_start_us_ >=
+           conversion_us();
+  }
+
+  int16_t getLastConversionResults() {
+    fake::Clock::get()->advance_if_manual(i2c_transaction_us_);
+    if (converting_) {
+      if (conversionComplete()) {
+        result_ = sample(channel_, conversion_start_us_ + conversion_us());
+        converting_ = false;
+      } else {
+        early_reads_++;
+      }
+    }
+    return result_;
+  }
+
+  void setGain(adsGain_t gain) { gain_ = gain; }
+  adsGain_t getGain() { return gain_; }
+
+  int16_t readADC_SingleEnded(uint8_t channel) {
+    return sample(channel, fake::Clock::get()->micros64());
+  }
+
+  /// Nominal single-shot conversion time at the data rate
+  uint32_t conversion_us() const {
+    static const uint32_t kRates[] = {8, 16, 32, 64, 128, 250, 475, 860};
+    return 1000000 / kRates[(data_rate_ >> 5) & 0x7];
+  }
+
+  float computeVolts(int16_t counts) {
+    float fs_range;
+    switch (gain_) {
+      case GAIN_TWOTHIRDS:
+        fs_range = 6.144f;
+        break;
+      case GAIN_ONE:
+        fs_range = 4.096f;
+        break;
+      case GAIN_TWO:
+        fs_range = 2.048f;
+        break;
+      case GAIN_FOUR:
+        fs_range = 1.024f;
+        break;
+      case GAIN_EIGHT:
+        fs_range = 0.512f;
+        break;
+      case GAIN_SIXTEEN:
+        fs_range = 0.256f;
+        break;
+      default:
+        fs_range = 0.0f;
+    }
+    return counts * (fs_range / 32768);
+  }
+
+  // Test hooks
+
+  /// The counts the next read of channel returns
+  void set_counts(uint8_t channel, int16_t counts) { counts_[channel] = counts; }
+  void set_signal(Signal signal) { signal_ = signal; }
+  void set_present(bool present) { present_ = present; }
+  /// Time of the I2C write or read of each call, on a manual clock
+  void set_i2c_transaction_us(uint32_t us) { i2c_transaction_us_ = us; }
+  uint32_t get_conversions() const { return conversions_; }
+  /// Results read before their conversion was complete
+  uint32_t get_early_reads() const { return early_reads_; }
+  uint64_t get_conversion_start_us() const { return conversion_start_us_; }
+
+ protected:
+  int16_t sample(uint8_t channel, uint64_t time_us) {
+    return signal_ ? signal_(channel, time_us) : counts_[channel];
+  }
+
+  adsGain_t gain_ = GAIN_TWOTHIRDS;
+  uint16_t data_rate_ = RATE_ADS1115_128SPS;
+  uint8_t address_ = 0x48;
+  bool present_ = true;
+  int16_t counts_[4] = {};
+  Signal signal_;
+  uint32_t i2c_transaction_us_ = 0;
+  uint8_t channel_ = 0;
+  bool converting_ = false;
+  uint64_t conversion_start_us_ = 0;
+  int16_t result_ = 0;
+  uint32_t conversions_ = 0;
+  uint32_t early_reads_ = 0;
+};
+
+#endif  // HALMET_TEST_STUBS_ADAFRUIT_ADS1X15_H_
@@ -0,0 +1,61 @@
+#ifndef HALMET_TEST_STUBS_ADAFRUIT_GFX_H_
+#define HALMET_TEST_STUBS_ADAFRUIT_GFX_H_
+
+// Adafruit_GFX for host tests: the text API only. Text is kept per 8 pixel
+// row, the height of the default font at text size 1, so that tests can
+// read what a display shows.
+
+#include <Arduino.h>
+
+#include <map>
+
+class Adafruit_GFX : public Print {
+ public:
+  Adafruit_GFX(int16_t w, int16_t h) : width_{w}, height_{h} {}
+
+  using Print::write;
+  size_t write(uint8_t c) override {
+    if (c == '\n') {
+      cursor_x_ = 0;
+      cursor_y_ += kRowHeight;
+    } else {
+      rows_[cursor_y_ / kRowHeight] += static_cast<char>(c);
+      cursor_x_ += 6;
+    }
+    return 1;
+  }
+
+  void setRotation(uint8_t rotation) {}
+  void setTextSize(uint8_t size) {}
+  void setTextColor(uint16_t color) {}
+  void setCursor(int16_t x, int16_t y) {
+    cursor_x_ = x;
+    cursor_y_ = y;
+  }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    for (int row = y / kRowHeight; row < (y + h) / kRowHeight; row++) {
+      rows_.erase(row);
+    }
+  }
+  int16_t width() const { return width_; }
+  int16_t height() const { return height_; }
+
+  // Test hooks
+
+  /// The text on a row
+  String get_row(int row) const {
+    auto it = rows_.find(row);
+    return it == rows_.end() ? String() : it->second;
+  }
+
+ protected:
+  static const int kRowHeight = 8;
+
+  int16_t width_;
+  int16_t height_;
+  int16_t cursor_x_ = 0;
+  int16_t cursor_y_ = 0;
+  std::map<int, String> rows_;
+};
+
+#endif  // HALMET_TEST_STUBS_ADAFRUIT_GFX_H_
@@ -0,0 +1,41 @@
+#ifndef HALMET_TEST_STUBS_ADAFRUIT_SSD1306_H_
+#define HALMET_TEST_STUBS_ADAFRUIT_SSD1306_H_
+
+// Adafruit_SSD1306 for host tests. begin() fails if the display was set
+// absent, as it does when nothing answers at the I2C address; display()
+// counts the updates that would go over I2C.
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+
+class Adafruit_SSD1306 : public Adafruit_GFX {
+ public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* twi = &Wire,
+                   int8_t rst_pin = -1)
+      : Adafruit_GFX(w, h) {}
+
+  bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0,
+             bool reset = true, bool periph_begin = true) {
+    return present();
+  }
+  void clearDisplay() { rows_.clear(); }
+  void display() { updates_++; }
+
+  // Test hooks
+
+  /// Whether displays answer begin(), for all displays
+  static bool& present() {
+    static bool present = true;
+    return present;
+  }
+  uint32_t get_updates() const { return updates_; }
+
+ protected:
+  uint32_t updates_ = 0;
+};
+
+#endif  // HALMET_TEST_STUBS_ADAFRUIT_SSD1306_H_
@@ -0,0 +1,445 @@
+#ifndef HALMET_TEST_STUBS_ARDUINO_H_
+#define HALMET_TEST_STUBS_ARDUINO_H_
+
+// The part of the Arduino core API used by the code that is tested on the
+// host (env:native). Only what that code needs; extend as tests are added.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+namespace fake {
+
+/**
+ * @brief The clock behind millis() and micros().
+ *
+ * It follows the host's steady clock, for benchmarks, until a test sets it.
+ * From then on it only moves when the test moves it, so that timers,
+ * expiry and rates run on simulated time and every run is the same.
+ */
+class Clock {
+ public:
+  static Clock* get() {
+    static Clock clock;
+    return &clock;
+  }
+
+  uint64_t micros64() const {
+    if (manual_) {
+      return now_us_;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start_)
+        .count();
+  }
+
+  /// Take over the clock at the given time
+  void set_us(uint64_t us) {
+    manual_ = true;
+    now_us_ = us;
+  }
+  void advance_us(uint64_t us) { set_us(micros64() + us); }
+  void advance_ms(uint64_t ms) { advance_us(ms * 1000); }
+  /// Time taken by a simulated operation, which is only simulated when the
+  /// test has taken over the clock
+  void advance_if_manual(uint64_t us) {
+    if (manual_) {
+      now_us_ += us;
+    }
+  }
+  bool is_manual() const { return manual_; }
+
+ private:
+  const std::chrono::steady_clock::time_point start_ =
+      std::chrono::steady_clock::now();
+  bool manual_ = false;
+  uint64_t now_us_ = 0;
+};
+
+}  // namespace fake
+
+// 32 bits wide, and wrapping, as on the ESP32
+inline unsigned long micros() {
+  return static_cast<uint32_t>(fake::Clock::get()->micros64());
+}
+
+inline unsigned long millis() {
+  return static_cast<uint32_t>(fake::Clock::get()->micros64() / 1000);
+}
+
+inline void delay(uint32_t ms) {
+  if (fake::Clock::get()->is_manual()) {
+    fake::Clock::get()->advance_ms(ms);
+  } else {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+}
+
+inline void yield() {}
+
+#define constrain(amt, low, high) \
+  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// CPU clock
+
+namespace fake {
+
+inline uint32_t& cpu_frequency_mhz() {
+  static uint32_t mhz = 240;
+  return mhz;
+}
+
+}  // namespace fake
+
+inline bool setCpuFrequencyMhz(uint32_t cpu_freq_mhz) {
+  fake::cpu_frequency_mhz() = cpu_freq_mhz;
+  return true;
+}
+inline uint32_t getCpuFrequencyMhz() { return fake::cpu_frequency_mhz(); }
+
+/// The cycle counter follows the host's clock, even when a test has taken
+/// over millis(), so that busy loops take cycles
+class EspClass {
+ public:
+  uint32_t getCycleCount() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+               .count() *
+           fake::cpu_frequency_mhz();
+  }
+};
+
+inline EspClass ESP;
+
+// GPIO
+
+typedef enum {
+  GPIO_NUM_NC = -1,
+  GPIO_NUM_0 = 0,
+  GPIO_NUM_2 = 2,
+  GPIO_NUM_4 = 4,
+  GPIO_NUM_5 = 5,
+  GPIO_NUM_13 = 13,
+  GPIO_NUM_14 = 14,
+  GPIO_NUM_15 = 15,
+  GPIO_NUM_16 = 16,
+  GPIO_NUM_17 = 17,
+  GPIO_NUM_18 = 18,
+  GPIO_NUM_19 = 19,
+  GPIO_NUM_21 = 21,
+  GPIO_NUM_22 = 22,
+  GPIO_NUM_23 = 23,
+  GPIO_NUM_25 = 25,
+  GPIO_NUM_26 = 26,
+  GPIO_NUM_27 = 27,
+  GPIO_NUM_32 = 32,
+  GPIO_NUM_33 = 33,
+  GPIO_NUM_MAX = 40,
+} gpio_num_t;
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+namespace fake {
+
+/// Pin levels and interrupt handlers, set by the tests
+class Pins {
+ public:
+  static Pins* get() {
+    static Pins pins;
+    return &pins;
+  }
+
+  int read(uint8_t pin) const {
+    auto it = levels_.find(pin);
+    return it == levels_.end() ? LOW : it->second;
+  }
+
+  /// Set a pin level, calling its interrupt handler on a matching edge
+  void write(uint8_t pin, int level) {
+    int previous = read(pin);
+    levels_[pin] = level;
+    auto it = handlers_.find(pin);
+    if (it == handlers_.end() || previous == level) {
+      return;
+    }
+    int mode = it->second.mode;
+    if (mode == CHANGE || (mode == RISING && level == HIGH) ||
+        (mode == FALLING && level == LOW)) {
+      it->second.handler();
+    }
+  }
+
+  /// A full pulse, low to high to low
+  void pulse(uint8_t pin) {
+    write(pin, HIGH);
+    write(pin, LOW);
+  }
+
+  void attach(uint8_t pin, std::function<void()> handler, int mode) {
+    handlers_[pin] = {handler, mode};
+  }
+  void detach(uint8_t pin) { handlers_.erase(pin); }
+
+ private:
+  struct Handler {
+    std::function<void()> handler;
+    int mode;
+  };
+
+  std::map<uint8_t, int> levels_;
+  std::map<uint8_t, Handler> handlers_;
+};
+
+}  // namespace fake
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline int digitalRead(uint8_t pin) { return fake::Pins::get()->read(pin); }
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+  fake::Pins::get()->write(pin, level);
+}
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void attachInterrupt(uint8_t pin, std::function<void()> handler,
+                            int mode) {
+  fake::Pins::get()->attach(pin, handler, mode);
+}
+inline void detachInterrupt(uint8_t pin) { fake::Pins::get()->detach(pin); }
+
+// LEDC
+
+namespace fake {
+
+/**
+ * @brief The LEDC timers, as the ESP32 configures them.
+ *
+ * A timer runs from the 80 MHz APB clock, or the 1 MHz REF_TICK when the
+ * APB clock can't be divided down far enough, through a divider of 1 to
+ * 1024 with 8 fractional bits. A rate that neither clock reaches at the
+ * resolution fails with 0 Hz, as ledcChangeFrequency() does.
+ */
+class Ledc {
+ public:
+  struct Channel {
+    uint32_t hz = 0;
+    uint8_t resolution = 0;
+    uint32_t duty = 0;
+  };
+
+  static Ledc* get() {
+    static Ledc ledc;
+    return &ledc;
+  }
+
+  uint32_t set_frequency(uint8_t pin, uint32_t hz, uint8_t resolution) {
+    Channel& channel = channels_[pin];
+    channel.hz = 0;
+    channel.resolution = resolution;
+    const uint32_t kClocksHz[] = {80000000, 1000000};
+    for (uint32_t clock_hz : kClocksHz) {
+      if (hz == 0 || resolution == 0 || resolution > 20) {
+        break;
+      }
+      double counts = static_cast<double>(hz) * (1UL << resolution);
+      uint64_t divider = llround(clock_hz * 256.0 / counts);
+      if (divider >= 256 && divider < 256 * 1024) {
+        channel.hz = clock_hz * 256.0 / divider / (1UL << resolution);
+        break;
+      }
+    }
+    return channel.hz;
+  }
+
+  void write(uint8_t pin, uint32_t duty) { channels_[pin].duty = duty; }
+  const Channel& channel(uint8_t pin) { return channels_[pin]; }
+
+ private:
+  std::map<uint8_t, Channel> channels_;
+};
+
+}  // namespace fake
+
+inline bool ledcAttach(uint8_t pin, uint32_t freq, uint8_t resolution) {
+  return fake::Ledc::get()->set_frequency(pin, freq, resolution) != 0;
+}
+inline uint32_t ledcChangeFrequency(uint8_t pin, uint32_t freq,
+                                    uint8_t resolution) {
+  return fake::Ledc::get()->set_frequency(pin, freq, resolution);
+}
+inline bool ledcWrite(uint8_t pin, uint32_t duty) {
+  fake::Ledc::get()->write(pin, duty);
+  return true;
+}
+
+/// Arduino String, on top of std::string
+class String : public std::string {
+ public:
+  String() = default;
+  String(const char* str) : std::string(str == nullptr ? "" : str) {}
+  String(const std::string& str) : std::string(str) {}
+  explicit String(char c) : std::string(1, c) {}
+  explicit String(int value, unsigned char base = 10)
+      : String(static_cast<long>(value), base) {}
+  explicit String(unsigned int value, unsigned char base = 10)
+      : String(static_cast<unsigned long>(value), base) {}
+  explicit String(long value, unsigned char base = 10) {
+    char buffer[34];
+    if (base == 10) {
+      snprintf(buffer, sizeof(buffer), "%ld", value);
+    } else {
+      snprintf(buffer, sizeof(buffer), "%lx", value);
+    }
+    assign(buffer);
+  }
+  explicit String(unsigned long value, unsigned char base = 10) {
+    char buffer[34];
+    snprintf(buffer, sizeof(buffer), base == 10 ? "%lu" : "%lx", value);
+    assign(buffer);
+  }
+  explicit String(float value, unsigned char decimals = 2)
+      : String(static_cast<double>(value), decimals) {}
+  explicit String(double value, unsigned char decimals = 2) {
+    char buffer[40];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    assign(buffer);
+  }
+
+  bool isEmpty() const { return empty(); }
+  long toInt() const { return strtol(c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(c_str(), nullptr); }
+  bool startsWith(const String& prefix) const {
+    return compare(0, prefix.size(), prefix) == 0;
+  }
+  bool endsWith(const String& suffix) const {
+    return size() >= suffix.size() &&
+           compare(size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+  bool equals(const String& other) const { return *this == other; }
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t pos = find(c, from);
+    return pos == npos ? -1 : static_cast<int>(pos);
+  }
+  int indexOf(const String& str, unsigned int from = 0) const {
+    size_t pos = find(str, from);
+    return pos == npos ? -1 : static_cast<int>(pos);
+  }
+  String substring(unsigned int from) const {
+    return from >= size() ? String() : String(substr(from));
+  }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) {
+      std::swap(from, to);
+    }
+    return from >= size() ? String() : String(substr(from, to - from));
+  }
+  void remove(unsigned int index, unsigned int count = UINT32_MAX) {
+    if (index < size()) {
+      erase(index, count);
+    }
+  }
+  bool concat(const String& str) {
+    append(str);
+    return true;
+  }
+};
+
+inline String operator+(const String& lhs, const String& rhs) {
+  String result(lhs);
+  result.append(rhs);
+  return result;
+}
+
+inline String operator+(const String& lhs, const char* rhs) {
+  String result(lhs);
+  result.append(rhs);
+  return result;
+}
+
+inline String operator+(const char* lhs, const String& rhs) {
+  String result(lhs);
+  result.append(rhs);
+  return result;
+}
+
+/// Print and Stream, with a byte sink for subclasses to implement
+class Print {
+ public:
+  virtual ~Print() = default;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (n < size && write(buffer[n])) {
+      n++;
+    }
+    return n;
+  }
+  size_t write(const char* str) {
+    return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+  }
+  size_t print(const char* str) { return write(str); }
+  size_t print(const String& str) { return print(str.c_str()); }
+  size_t println(const char* str = "") { return print(str) + print("\n"); }
+  size_t println(const String& str) { return println(str.c_str()); }
+  size_t printf(const char* format, ...)
+      __attribute__((format(printf, 2, 3))) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) {
+      return 0;
+    }
+    return write(reinterpret_cast<const uint8_t*>(buffer),
+                 std::min<size_t>(length, sizeof(buffer) - 1));
+  }
+  virtual void flush() {}
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  size_t readBytes(uint8_t* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+      int c = read();
+      if (c < 0) {
+        break;
+      }
+      buffer[n++] = c;
+    }
+    return n;
+  }
+};
+
+// As on the ESP32, the Arduino core brings in FreeRTOS
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#endif  // HALMET_TEST_STUBS_ARDUINO_H_
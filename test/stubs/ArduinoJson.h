@@ -0,0 +1,1195 @@
+#ifndef HALMET_TEST_STUBS_ARDUINOJSON_H_
+#define HALMET_TEST_STUBS_ARDUINOJSON_H_
+
+// The subset of the ArduinoJson 7 API that the host-tested code uses, on a
+// plain tree of nodes. Objects keep their keys in insertion order. is<int>()
+// holds for integers in the range of int, is<float>() for any number, as in
+// ArduinoJson; a missing member reads as null and is created when written.
+
+#include <Arduino.h>
+
+#include <cinttypes>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fake_json {
+
+struct Node {
+  enum class Type { kNull, kBool, kInt, kFloat, kString, kRaw, kObject, kArray };
+
+  Type type = Type::kNull;
+  bool boolean = false;
+  int64_t integer = 0;
+  double number = 0;
+  bool single_precision = false;  // Printed with float precision
+  std::string string;             // kString and kRaw
+  std::vector<std::pair<std::string, std::unique_ptr<Node>>> members;
+  std::vector<std::unique_ptr<Node>> elements;
+
+  void clear() {
+    type = Type::kNull;
+    string.clear();
+    members.clear();
+    elements.clear();
+  }
+
+  void copy_from(const Node* other) {
+    if (other == this) {
+      return;
+    }
+    clear();
+    if (other == nullptr) {
+      return;
+    }
+    type = other->type;
+    boolean = other->boolean;
+    integer = other->integer;
+    number = other->number;
+    single_precision = other->single_precision;
+    string = other->string;
+    for (const auto& member : other->members) {
+      auto node = std::make_unique<Node>();
+      node->copy_from(member.second.get());
+      members.emplace_back(member.first, std::move(node));
+    }
+    for (const auto& element : other->elements) {
+      auto node = std::make_unique<Node>();
+      node->copy_from(element.get());
+      elements.push_back(std::move(node));
+    }
+  }
+
+  Node* find(const char* key) const {
+    if (type != Type::kObject) {
+      return nullptr;
+    }
+    for (const auto& member : members) {
+      if (member.first == key) {
+        return member.second.get();
+      }
+    }
+    return nullptr;
+  }
+
+  Node* find_or_add(const char* key) {
+    if (type != Type::kObject) {
+      clear();
+      type = Type::kObject;
+    }
+    Node* node = find(key);
+    if (node == nullptr) {
+      members.emplace_back(key, std::make_unique<Node>());
+      node = members.back().second.get();
+    }
+    return node;
+  }
+
+  Node* add_element() {
+    if (type != Type::kArray) {
+      clear();
+      type = Type::kArray;
+    }
+    elements.push_back(std::make_unique<Node>());
+    return elements.back().get();
+  }
+};
+
+void Serialize(const Node* node, std::string& out);
+bool Parse(const char*& p, const char* end, Node* node, int depth);
+
+}  // namespace fake_json
+
+/// serialized(): a string that is written to the output as it is
+struct RawJson {
+  std::string json;
+};
+
+inline RawJson serialized(const String& json) { return RawJson{json}; }
+inline RawJson serialized(const char* json) { return RawJson{json}; }
+
+class JsonVariant;
+class JsonVariantConst;
+class JsonObject;
+class JsonObjectConst;
+class JsonArray;
+class JsonArrayConst;
+class JsonDocument;
+
+namespace fake_json {
+
+template <typename T>
+using Decay = typename std::decay<T>::type;
+
+template <typename T>
+bool Is(const Node* node);
+template <typename T>
+T As(const Node* node);
+template <typename T>
+void Set(Node* node, const T& value);
+
+}  // namespace fake_json
+
+/// Read-only reference to a value, or to nothing
+class JsonVariantConst {
+ public:
+  JsonVariantConst(const fake_json::Node* node = nullptr) : node_{node} {}
+
+  template <typename T>
+  bool is() const {
+    return fake_json::Is<T>(node_);
+  }
+  template <typename T>
+  T as() const {
+    return fake_json::As<T>(node_);
+  }
+  template <typename T,
+            typename = typename std::enable_if<
+                !std::is_same<T, JsonVariantConst>::value>::type>
+  operator T() const {
+    return as<T>();
+  }
+
+  bool isNull() const {
+    return node_ == nullptr || node_->type == fake_json::Node::Type::kNull;
+  }
+  size_t size() const;
+
+  JsonVariantConst operator[](const char* key) const {
+    return JsonVariantConst(node_ == nullptr ? nullptr : node_->find(key));
+  }
+  JsonVariantConst operator[](const String& key) const {
+    return (*this)[key.c_str()];
+  }
+  JsonVariantConst operator[](size_t index) const {
+    if (node_ == nullptr || node_->type != fake_json::Node::Type::kArray ||
+        index >= node_->elements.size()) {
+      return JsonVariantConst();
+    }
+    return JsonVariantConst(node_->elements[index].get());
+  }
+  JsonVariantConst operator[](int index) const {
+    return (*this)[static_cast<size_t>(index)];
+  }
+
+  const fake_json::Node* node() const { return node_; }
+
+ private:
+  const fake_json::Node* node_;
+};
+
+/// Reference to a value, or to a member that is created when written
+class JsonVariant {
+ public:
+  JsonVariant(fake_json::Node* node = nullptr) : node_{node} {}
+  JsonVariant(fake_json::Node* parent, const char* key)
+      : parent_{parent}, key_{key} {}
+  JsonVariant(const JsonVariant& other) = default;
+
+  // Assignment writes the value, as with ArduinoJson's member proxies
+  JsonVariant& operator=(const JsonVariant& other) {
+    set(other);
+    return *this;
+  }
+  template <typename T>
+  JsonVariant& operator=(const T& value) {
+    set(value);
+    return *this;
+  }
+  JsonVariant& operator=(const char* value) {
+    set(value);
+    return *this;
+  }
+
+  template <typename T>
+  bool set(const T& value) {
+    fake_json::Set(create(), value);
+    return true;
+  }
+  bool set(const char* value) {
+    fake_json::Set<const char*>(create(), value);
+    return true;
+  }
+
+  template <typename T>
+  bool is() const {
+    return fake_json::Is<T>(resolve());
+  }
+  template <typename T>
+  typename std::enable_if<!std::is_same<T, JsonObject>::value &&
+                              !std::is_same<T, JsonArray>::value &&
+                              !std::is_same<T, JsonVariant>::value,
+                          T>::type
+  as() const {
+    return fake_json::As<T>(resolve());
+  }
+  template <typename T>
+  typename std::enable_if<std::is_same<T, JsonObject>::value ||
+                              std::is_same<T, JsonArray>::value ||
+                              std::is_same<T, JsonVariant>::value,
+                          T>::type
+  as() const;
+
+  template <typename T,
+            typename = typename std::enable_if<
+                !std::is_same<T, JsonVariant>::value &&
+                !std::is_same<T, JsonVariantConst>::value>::type>
+  operator T() const {
+    return as<T>();
+  }
+  operator JsonVariantConst() const { return JsonVariantConst(resolve()); }
+
+  /// Replace the value with an empty object or array
+  template <typename T>
+  T to();
+
+  template <typename T>
+  T add();
+
+  bool isNull() const {
+    const fake_json::Node* node = resolve();
+    return node == nullptr || node->type == fake_json::Node::Type::kNull;
+  }
+  size_t size() const { return JsonVariantConst(resolve()).size(); }
+
+  JsonVariant operator[](const char* key) const {
+    fake_json::Node* node = resolve();
+    if (node == nullptr) {
+      return JsonVariant();
+    }
+    return JsonVariant(node, key);
+  }
+  JsonVariant operator[](const String& key) const {
+    return (*this)[key.c_str()];
+  }
+
+  /// The default if the value is null or has another type
+  const char* operator|(const char* fallback) const {
+    return is<const char*>() ? as<const char*>() : fallback;
+  }
+  template <typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value, T>::type operator|(
+      T fallback) const {
+    return is<T>() ? as<T>() : fallback;
+  }
+
+  fake_json::Node* node() const { return resolve(); }
+
+ private:
+  fake_json::Node* resolve() const {
+    if (node_ == nullptr && parent_ != nullptr) {
+      return parent_->find(key_.c_str());
+    }
+    return node_;
+  }
+  fake_json::Node* create() {
+    if (node_ == nullptr && parent_ != nullptr) {
+      node_ = parent_->find_or_add(key_.c_str());
+    }
+    if (node_ == nullptr) {
+      // Written through a reference to nothing; goes nowhere
+      static fake_json::Node sink;
+      sink.clear();
+      return &sink;
+    }
+    return node_;
+  }
+
+  fake_json::Node* node_ = nullptr;
+  fake_json::Node* parent_ = nullptr;
+  std::string key_;
+};
+
+// A string comparison, false if the value isn't a string
+inline bool operator==(const JsonVariantConst& variant, const char* str) {
+  return variant.is<const char*>() &&
+         strcmp(variant.as<const char*>(), str) == 0;
+}
+inline bool operator!=(const JsonVariantConst& variant, const char* str) {
+  return !(variant == str);
+}
+inline bool operator==(const JsonVariant& variant, const char* str) {
+  return JsonVariantConst(variant) == str;
+}
+inline bool operator!=(const JsonVariant& variant, const char* str) {
+  return !(variant == str);
+}
+
+struct JsonPair {
+  const char* key_;
+  JsonVariant value_;
+  const char* key() const { return key_; }
+  JsonVariant value() const { return value_; }
+};
+
+struct JsonPairConst {
+  const char* key_;
+  JsonVariantConst value_;
+  const char* key() const { return key_; }
+  JsonVariantConst value() const { return value_; }
+};
+
+class JsonObjectConst {
+ public:
+  JsonObjectConst(const fake_json::Node* node = nullptr)
+      : node_{node != nullptr &&
+                      node->type == fake_json::Node::Type::kObject
+                  ? node
+                  : nullptr} {}
+
+  class Iterator {
+   public:
+    Iterator(const fake_json::Node* node, size_t index)
+        : node_{node}, index_{index} {}
+    JsonPairConst operator*() const {
+      const auto& member = node_->members[index_];
+      return {member.first.c_str(), JsonVariantConst(member.second.get())};
+    }
+    Iterator& operator++() {
+      index_++;
+      return *this;
+    }
+    bool operator!=(const Iterator& other) const {
+      return index_ != other.index_;
+    }
+
+   private:
+    const fake_json::Node* node_;
+    size_t index_;
+  };
+
+  Iterator begin() const { return Iterator(node_, 0); }
+  Iterator end() const { return Iterator(node_, size()); }
+  size_t size() const { return node_ == nullptr ? 0 : node_->members.size(); }
+  bool isNull() const { return node_ == nullptr; }
+
+  JsonVariantConst operator[](const char* key) const {
+    return JsonVariantConst(node_ == nullptr ? nullptr : node_->find(key));
+  }
+  JsonVariantConst operator[](const String& key) const {
+    return (*this)[key.c_str()];
+  }
+
+  operator JsonVariantConst() const { return JsonVariantConst(node_); }
+  const fake_json::Node* node() const { return node_; }
+
+ private:
+  const fake_json::Node* node_;
+};
+
+class JsonObject {
+ public:
+  JsonObject(fake_json::Node* node = nullptr)
+      : node_{node != nullptr &&
+                      node->type == fake_json::Node::Type::kObject
+                  ? node
+                  : nullptr} {}
+
+  class Iterator {
+   public:
+    Iterator(fake_json::Node* node, size_t index)
+        : node_{node}, index_{index} {}
+    JsonPair operator*() const {
+      auto& member = node_->members[index_];
+      return {member.first.c_str(), JsonVariant(member.second.get())};
+    }
+    Iterator& operator++() {
+      index_++;
+      return *this;
+    }
+    bool operator!=(const Iterator& other) const {
+      return index_ != other.index_;
+    }
+
+   private:
+    fake_json::Node* node_;
+    size_t index_;
+  };
+
+  Iterator begin() const { return Iterator(node_, 0); }
+  Iterator end() const { return Iterator(node_, size()); }
+  size_t size() const { return node_ == nullptr ? 0 : node_->members.size(); }
+  bool isNull() const { return node_ == nullptr; }
+
+  // Members are written through the returned reference, also of a const
+  // JsonObject, which is a reference itself
+  JsonVariant operator[](const char* key) const {
+    return node_ == nullptr ? JsonVariant() : JsonVariant(node_, key);
+  }
+  JsonVariant operator[](const String& key) const {
+    return (*this)[key.c_str()];
+  }
+
+  bool containsKey(const char* key) const {
+    return node_ != nullptr && node_->find(key) != nullptr;
+  }
+  void remove(const char* key) {
+    if (node_ == nullptr) {
+      return;
+    }
+    for (auto it = node_->members.begin(); it != node_->members.end(); ++it) {
+      if (it->first == key) {
+        node_->members.erase(it);
+        return;
+      }
+    }
+  }
+  void clear() const {
+    if (node_ != nullptr) {
+      node_->members.clear();
+    }
+  }
+
+  operator JsonVariantConst() const { return JsonVariantConst(node_); }
+  operator JsonObjectConst() const { return JsonObjectConst(node_); }
+  operator JsonVariant() const { return JsonVariant(node_); }
+  fake_json::Node* node() const { return node_; }
+
+ private:
+  fake_json::Node* node_;
+};
+
+class JsonArrayConst {
+ public:
+  JsonArrayConst(const fake_json::Node* node = nullptr)
+      : node_{node != nullptr && node->type == fake_json::Node::Type::kArray
+                  ? node
+                  : nullptr} {}
+
+  class Iterator {
+   public:
+    Iterator(const fake_json::Node* node, size_t index)
+        : node_{node}, index_{index} {}
+    JsonVariantConst operator*() const {
+      return JsonVariantConst(node_->elements[index_].get());
+    }
+    Iterator& operator++() {
+      index_++;
+      return *this;
+    }
+    bool operator!=(const Iterator& other) const {
+      return index_ != other.index_;
+    }
+
+   private:
+    const fake_json::Node* node_;
+    size_t index_;
+  };
+
+  Iterator begin() const { return Iterator(node_, 0); }
+  Iterator end() const { return Iterator(node_, size()); }
+  size_t size() const {
+    return node_ == nullptr ? 0 : node_->elements.size();
+  }
+  bool isNull() const { return node_ == nullptr; }
+  JsonVariantConst operator[](size_t index) const {
+    return index < size() ? JsonVariantConst(node_->elements[index].get())
+                          : JsonVariantConst();
+  }
+
+  operator JsonVariantConst() const { return JsonVariantConst(node_); }
+  const fake_json::Node* node() const { return node_; }
+
+ private:
+  const fake_json::Node* node_;
+};
+
+class JsonArray {
+ public:
+  JsonArray(fake_json::Node* node = nullptr)
+      : node_{node != nullptr && node->type == fake_json::Node::Type::kArray
+                  ? node
+                  : nullptr} {}
+
+  class Iterator {
+   public:
+    Iterator(fake_json::Node* node, size_t index)
+        : node_{node}, index_{index} {}
+    JsonVariant operator*() const {
+      return JsonVariant(node_->elements[index_].get());
+    }
+    Iterator& operator++() {
+      index_++;
+      return *this;
+    }
+    bool operator!=(const Iterator& other) const {
+      return index_ != other.index_;
+    }
+
+   private:
+    fake_json::Node* node_;
+    size_t index_;
+  };
+
+  Iterator begin() const { return Iterator(node_, 0); }
+  Iterator end() const { return Iterator(node_, size()); }
+  size_t size() const {
+    return node_ == nullptr ? 0 : node_->elements.size();
+  }
+  bool isNull() const { return node_ == nullptr; }
+
+  JsonVariant operator[](size_t index) const {
+    return index < size() ? JsonVariant(node_->elements[index].get())
+                          : JsonVariant();
+  }
+
+  template <typename T>
+  bool add(const T& value) const {
+    if (node_ == nullptr) {
+      return false;
+    }
+    fake_json::Set(node_->add_element(), value);
+    return true;
+  }
+  bool add(const char* value) const {
+    if (node_ == nullptr) {
+      return false;
+    }
+    fake_json::Set<const char*>(node_->add_element(), value);
+    return true;
+  }
+  /// Add an empty object or array
+  template <typename T>
+  typename std::enable_if<std::is_same<T, JsonObject>::value ||
+                              std::is_same<T, JsonArray>::value,
+                          T>::type
+  add() const {
+    if (node_ == nullptr) {
+      return T();
+    }
+    fake_json::Node* node = node_->add_element();
+    node->type = std::is_same<T, JsonObject>::value
+                     ? fake_json::Node::Type::kObject
+                     : fake_json::Node::Type::kArray;
+    return T(node);
+  }
+
+  operator JsonVariantConst() const { return JsonVariantConst(node_); }
+  operator JsonArrayConst() const { return JsonArrayConst(node_); }
+  operator JsonVariant() const { return JsonVariant(node_); }
+  fake_json::Node* node() const { return node_; }
+
+ private:
+  fake_json::Node* node_;
+};
+
+inline size_t JsonVariantConst::size() const {
+  if (node_ == nullptr) {
+    return 0;
+  }
+  return node_->type == fake_json::Node::Type::kArray ? node_->elements.size()
+         : node_->type == fake_json::Node::Type::kObject
+             ? node_->members.size()
+             : 0;
+}
+
+template <typename T>
+typename std::enable_if<std::is_same<T, JsonObject>::value ||
+                            std::is_same<T, JsonArray>::value ||
+                            std::is_same<T, JsonVariant>::value,
+                        T>::type
+JsonVariant::as() const {
+  return T(resolve());
+}
+
+template <typename T>
+T JsonVariant::to() {
+  fake_json::Node* node = create();
+  node->clear();
+  if (std::is_same<T, JsonObject>::value) {
+    node->type = fake_json::Node::Type::kObject;
+  } else if (std::is_same<T, JsonArray>::value) {
+    node->type = fake_json::Node::Type::kArray;
+  }
+  return T(node);
+}
+
+template <typename T>
+T JsonVariant::add() {
+  return JsonArray(create()->type == fake_json::Node::Type::kArray
+                       ? create()
+                       : nullptr)
+      .add<T>();
+}
+
+/// Owns the root value
+class JsonDocument {
+ public:
+  JsonDocument() : root_{std::make_unique<fake_json::Node>()} {}
+  JsonDocument(const JsonDocument& other) : JsonDocument() {
+    root_->copy_from(other.root_.get());
+  }
+  JsonDocument& operator=(const JsonDocument& other) {
+    root_->copy_from(other.root_.get());
+    return *this;
+  }
+
+  template <typename T>
+  T to() {
+    return JsonVariant(root_.get()).to<T>();
+  }
+  template <typename T>
+  T as() {
+    return JsonVariant(root_.get()).as<T>();
+  }
+  template <typename T>
+  T as() const {
+    return JsonVariantConst(root_.get()).as<T>();
+  }
+  template <typename T>
+  bool is() const {
+    return JsonVariantConst(root_.get()).is<T>();
+  }
+
+  template <typename T>
+  bool set(const T& value) {
+    fake_json::Set(root_.get(), value);
+    return true;
+  }
+
+  JsonVariant operator[](const char* key) {
+    return JsonVariant(root_.get(), key);
+  }
+  JsonVariant operator[](const String& key) { return (*this)[key.c_str()]; }
+  JsonVariantConst operator[](const char* key) const {
+    return JsonVariantConst(root_->find(key));
+  }
+
+  template <typename T>
+  bool add(const T& value) {
+    fake_json::Set(root_->add_element(), value);
+    return true;
+  }
+  template <typename T>
+  typename std::enable_if<std::is_same<T, JsonObject>::value, T>::type add() {
+    fake_json::Node* node = root_->add_element();
+    node->type = fake_json::Node::Type::kObject;
+    return T(node);
+  }
+
+  void clear() { root_->clear(); }
+  bool isNull() const { return root_->type == fake_json::Node::Type::kNull; }
+  size_t size() const { return JsonVariantConst(root_.get()).size(); }
+
+  operator JsonVariantConst() const { return JsonVariantConst(root_.get()); }
+  operator JsonVariant() { return JsonVariant(root_.get()); }
+  const fake_json::Node* node() const { return root_.get(); }
+  fake_json::Node* node() { return root_.get(); }
+
+ private:
+  std::unique_ptr<fake_json::Node> root_;
+};
+
+namespace fake_json {
+
+template <typename T>
+bool InRange(const Node* node) {
+  if (node->type == Node::Type::kInt) {
+    if (std::is_signed<T>::value) {
+      return node->integer >=
+                 static_cast<int64_t>(std::numeric_limits<T>::min()) &&
+             node->integer <=
+                 static_cast<int64_t>(std::numeric_limits<T>::max());
+    }
+    return node->integer >= 0 &&
+           static_cast<uint64_t>(node->integer) <=
+               static_cast<uint64_t>(std::numeric_limits<T>::max());
+  }
+  return false;
+}
+
+template <typename T>
+bool Is(const Node* node) {
+  using U = Decay<T>;
+  if (node == nullptr) {
+    return false;
+  }
+  if constexpr (std::is_same<U, bool>::value) {
+    return node->type == Node::Type::kBool;
+  } else if constexpr (std::is_enum<U>::value) {
+    return InRange<typename std::underlying_type<U>::type>(node);
+  } else if constexpr (std::is_integral<U>::value) {
+    return InRange<U>(node);
+  } else if constexpr (std::is_floating_point<U>::value) {
+    return node->type == Node::Type::kInt || node->type == Node::Type::kFloat;
+  } else if constexpr (std::is_same<U, const char*>::value ||
+                       std::is_same<U, String>::value) {
+    return node->type == Node::Type::kString;
+  } else if constexpr (std::is_same<U, JsonObject>::value ||
+                       std::is_same<U, JsonObjectConst>::value) {
+    return node->type == Node::Type::kObject;
+  } else if constexpr (std::is_same<U, JsonArray>::value ||
+                       std::is_same<U, JsonArrayConst>::value) {
+    return node->type == Node::Type::kArray;
+  } else {
+    return node->type != Node::Type::kNull;
+  }
+}
+
+template <typename T>
+T As(const Node* node) {
+  using U = Decay<T>;
+  if constexpr (std::is_same<U, bool>::value) {
+    if (node == nullptr) {
+      return false;
+    }
+    return node->type == Node::Type::kBool ? node->boolean
+           : node->type == Node::Type::kInt ? node->integer != 0
+           : node->type == Node::Type::kFloat ? node->number != 0
+                                              : false;
+  } else if constexpr (std::is_enum<U>::value) {
+    return static_cast<U>(As<int64_t>(node));
+  } else if constexpr (std::is_arithmetic<U>::value) {
+    if (node == nullptr) {
+      return 0;
+    }
+    switch (node->type) {
+      case Node::Type::kBool:
+        return node->boolean;
+      case Node::Type::kInt:
+        return static_cast<U>(node->integer);
+      case Node::Type::kFloat:
+        return static_cast<U>(node->number);
+      case Node::Type::kString:
+        if (std::is_floating_point<U>::value) {
+          return static_cast<U>(strtod(node->string.c_str(), nullptr));
+        }
+        return static_cast<U>(strtoll(node->string.c_str(), nullptr, 10));
+      default:
+        return 0;
+    }
+  } else if constexpr (std::is_same<U, const char*>::value) {
+    return node != nullptr && node->type == Node::Type::kString
+               ? node->string.c_str()
+               : nullptr;
+  } else if constexpr (std::is_same<U, String>::value) {
+    if (node == nullptr || node->type == Node::Type::kNull) {
+      return String("null");
+    }
+    if (node->type == Node::Type::kString) {
+      return String(node->string);
+    }
+    std::string json;
+    Serialize(node, json);
+    return String(json);
+  } else if constexpr (std::is_same<U, JsonVariantConst>::value ||
+                       std::is_same<U, JsonObjectConst>::value ||
+                       std::is_same<U, JsonArrayConst>::value) {
+    return U(node);
+  } else {
+    static_assert(sizeof(U) == 0, "Unsupported type");
+  }
+}
+
+template <typename T>
+void Set(Node* node, const T& value) {
+  using U = Decay<T>;
+  if constexpr (std::is_same<U, bool>::value) {
+    node->clear();
+    node->type = Node::Type::kBool;
+    node->boolean = value;
+  } else if constexpr (std::is_enum<U>::value ||
+                       std::is_integral<U>::value) {
+    node->clear();
+    node->type = Node::Type::kInt;
+    node->integer = static_cast<int64_t>(value);
+  } else if constexpr (std::is_floating_point<U>::value) {
+    node->clear();
+    node->type = Node::Type::kFloat;
+    node->number = value;
+    node->single_precision = std::is_same<U, float>::value;
+  } else if constexpr (std::is_same<U, const char*>::value ||
+                       std::is_same<U, char*>::value) {
+    node->clear();
+    if (value != nullptr) {
+      node->type = Node::Type::kString;
+      node->string = value;
+    }
+  } else if constexpr (std::is_same<U, String>::value ||
+                       std::is_same<U, std::string>::value) {
+    node->clear();
+    node->type = Node::Type::kString;
+    node->string = value;
+  } else if constexpr (std::is_same<U, RawJson>::value) {
+    node->clear();
+    node->type = Node::Type::kRaw;
+    node->string = value.json;
+  } else if constexpr (std::is_same<U, JsonDocument>::value) {
+    node->copy_from(value.node());
+  } else {
+    // JsonVariant, JsonObject, JsonArray and their const versions
+    node->copy_from(value.node());
+  }
+}
+
+inline void SerializeString(const std::string& str, std::string& out) {
+  out += '"';
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<uint8_t>(c) < 0x20) {
+          char buffer[8];
+          snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+          out += buffer;
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+// The shortest decimal that reads back as the same float or double
+inline void SerializeNumber(double value, bool single_precision,
+                            std::string& out) {
+  if (std::isnan(value) || std::isinf(value)) {
+    out += "null";
+    return;
+  }
+  char buffer[32];
+  int max_digits = single_precision ? 9 : 17;
+  for (int digits = 1; digits <= max_digits; digits++) {
+    snprintf(buffer, sizeof(buffer), "%.*g", digits, value);
+    double parsed = strtod(buffer, nullptr);
+    if (single_precision ? static_cast<float>(parsed) ==
+                               static_cast<float>(value)
+                         : parsed == value) {
+      break;
+    }
+  }
+  out += buffer;
+}
+
+inline void Serialize(const Node* node, std::string& out) {
+  if (node == nullptr) {
+    out += "null";
+    return;
+  }
+  switch (node->type) {
+    case Node::Type::kNull:
+      out += "null";
+      break;
+    case Node::Type::kBool:
+      out += node->boolean ? "true" : "false";
+      break;
+    case Node::Type::kInt: {
+      char buffer[24];
+      snprintf(buffer, sizeof(buffer), "%" PRId64, node->integer);
+      out += buffer;
+      break;
+    }
+    case Node::Type::kFloat:
+      SerializeNumber(node->number, node->single_precision, out);
+      break;
+    case Node::Type::kString:
+      SerializeString(node->string, out);
+      break;
+    case Node::Type::kRaw:
+      out += node->string;
+      break;
+    case Node::Type::kObject: {
+      out += '{';
+      bool first = true;
+      for (const auto& member : node->members) {
+        if (!first) {
+          out += ',';
+        }
+        first = false;
+        SerializeString(member.first, out);
+        out += ':';
+        Serialize(member.second.get(), out);
+      }
+      out += '}';
+      break;
+    }
+    case Node::Type::kArray: {
+      out += '[';
+      bool first = true;
+      for (const auto& element : node->elements) {
+        if (!first) {
+          out += ',';
+        }
+        first = false;
+        Serialize(element.get(), out);
+      }
+      out += ']';
+      break;
+    }
+  }
+}
+
+inline void SkipSpace(const char*& p, const char* end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+    p++;
+  }
+}
+
+inline bool ParseString(const char*& p, const char* end, std::string* out) {
+  if (p >= end || *p != '"') {
+    return false;
+  }
+  p++;
+  out->clear();
+  while (p < end && *p != '"') {
+    if (*p == '\\') {
+      p++;
+      if (p >= end) {
+        return false;
+      }
+      switch (*p) {
+        case 'n':
+          *out += '\n';
+          break;
+        case 'r':
+          *out += '\r';
+          break;
+        case 't':
+          *out += '\t';
+          break;
+        case 'b':
+          *out += '\b';
+          break;
+        case 'f':
+          *out += '\f';
+          break;
+        case 'u': {
+          if (end - p < 5) {
+            return false;
+          }
+          unsigned code = strtoul(std::string(p + 1, 4).c_str(), nullptr, 16);
+          // Only the ASCII range is needed
+          *out += static_cast<char>(code < 0x80 ? code : '?');
+          p += 4;
+          break;
+        }
+        default:
+          *out += *p;
+      }
+      p++;
+    } else {
+      *out += *p++;
+    }
+  }
+  if (p >= end) {
+    return false;
+  }
+  p++;
+  return true;
+}
+
+inline bool Parse(const char*& p, const char* end, Node* node, int depth) {
+  if (depth > 32) {
+    return false;
+  }
+  SkipSpace(p, end);
+  if (p >= end) {
+    return false;
+  }
+  node->clear();
+  if (*p == '{') {
+    p++;
+    node->type = Node::Type::kObject;
+    SkipSpace(p, end);
+    if (p < end && *p == '}') {
+      p++;
+      return true;
+    }
+    while (true) {
+      SkipSpace(p, end);
+      std::string key;
+      if (!ParseString(p, end, &key)) {
+        return false;
+      }
+      SkipSpace(p, end);
+      if (p >= end || *p != ':') {
+        return false;
+      }
+      p++;
+      Node* member = node->find_or_add(key.c_str());
+      if (!Parse(p, end, member, depth + 1)) {
+        return false;
+      }
+      SkipSpace(p, end);
+      if (p < end && *p == ',') {
+        p++;
+        continue;
+      }
+      if (p < end && *p == '}') {
+        p++;
+        return true;
+      }
+      return false;
+    }
+  }
+  if (*p == '[') {
+    p++;
+    node->type = Node::Type::kArray;
+    SkipSpace(p, end);
+    if (p < end && *p == ']') {
+      p++;
+      return true;
+    }
+    while (true) {
+      if (!Parse(p, end, node->add_element(), depth + 1)) {
+        return false;
+      }
+      SkipSpace(p, end);
+      if (p < end && *p == ',') {
+        p++;
+        continue;
+      }
+      if (p < end && *p == ']') {
+        p++;
+        return true;
+      }
+      return false;
+    }
+  }
+  if (*p == '"') {
+    node->type = Node::Type::kString;
+    return ParseString(p, end, &node->string);
+  }
+  auto literal = [&](const char* word) {
+    size_t length = strlen(word);
+    if (static_cast<size_t>(end - p) >= length &&
+        strncmp(p, word, length) == 0) {
+      p += length;
+      return true;
+    }
+    return false;
+  };
+  if (literal("true")) {
+    node->type = Node::Type::kBool;
+    node->boolean = true;
+    return true;
+  }
+  if (literal("false")) {
+    node->type = Node::Type::kBool;
+    return true;
+  }
+  if (literal("null")) {
+    return true;
+  }
+  const char* start = p;
+  bool is_float = false;
+  while (p < end && (isdigit(static_cast<unsigned char>(*p)) || *p == '-' ||
+                     *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) {
+    is_float |= *p == '.' || *p == 'e' || *p == 'E';
+    p++;
+  }
+  if (p == start) {
+    return false;
+  }
+  std::string number(start, p);
+  if (is_float) {
+    node->type = Node::Type::kFloat;
+    node->number = strtod(number.c_str(), nullptr);
+  } else {
+    node->type = Node::Type::kInt;
+    node->integer = strtoll(number.c_str(), nullptr, 10);
+  }
+  return true;
+}
+
+}  // namespace fake_json
+
+class DeserializationError {
+ public:
+  enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory };
+
+  DeserializationError(Code code = Ok) : code_{code} {}
+
+  Code code() const { return code_; }
+  explicit operator bool() const { return code_ != Ok; }
+  bool operator==(Code code) const { return code_ == code; }
+  bool operator!=(Code code) const { return code_ != code; }
+  const char* c_str() const {
+    static const char* const kNames[] = {"Ok", "EmptyInput",
+                                         "IncompleteInput", "InvalidInput",
+                                         "NoMemory"};
+    return kNames[code_];
+  }
+
+ private:
+  Code code_;
+};
+
+inline DeserializationError deserializeJson(JsonDocument& doc,
+                                            const char* json, size_t length) {
+  doc.clear();
+  const char* p = json;
+  const char* end = json + length;
+  fake_json::SkipSpace(p, end);
+  if (p == end) {
+    return DeserializationError::EmptyInput;
+  }
+  if (!fake_json::Parse(p, end, doc.node(), 0)) {
+    doc.clear();
+    return DeserializationError::InvalidInput;
+  }
+  return DeserializationError::Ok;
+}
+
+inline DeserializationError deserializeJson(JsonDocument& doc,
+                                            const char* json) {
+  return deserializeJson(doc, json, strlen(json));
+}
+
+inline DeserializationError deserializeJson(JsonDocument& doc,
+                                            const String& json) {
+  return deserializeJson(doc, json.c_str(), json.length());
+}
+
+inline size_t serializeJson(JsonVariantConst value, String& out) {
+  std::string json;
+  fake_json::Serialize(value.node(), json);
+  out = json;
+  return out.length();
+}
+
+inline size_t serializeJson(JsonVariantConst value, char* buffer,
+                            size_t size) {
+  std::string json;
+  fake_json::Serialize(value.node(), json);
+  if (size == 0) {
+    return 0;
+  }
+  size_t length = std::min(json.length(), size - 1);
+  memcpy(buffer, json.c_str(), length);
+  buffer[length] = '\0';
+  return length;
+}
+
+inline size_t serializeJson(JsonVariantConst value, Print& out) {
+  std::string json;
+  fake_json::Serialize(value.node(), json);
+  return out.write(reinterpret_cast<const uint8_t*>(json.c_str()),
+                   json.length());
+}
+
+inline size_t measureJson(JsonVariantConst value) {
+  std::string json;
+  fake_json::Serialize(value.node(), json);
+  return json.length();
+}
+
+#endif  // HALMET_TEST_STUBS_ARDUINOJSON_H_
@@ -0,0 +1,109 @@
+#ifndef HALMET_TEST_STUBS_FS_H_
+#define HALMET_TEST_STUBS_FS_H_
+
+// The Arduino file system API on files in host memory. A file opened for
+// writing is truncated; its content is visible to readers as it is
+// written.
+
+#include <Arduino.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+class File : public Stream {
+ public:
+  File() = default;
+  File(std::shared_ptr<std::string> content, bool writable)
+      : content_{content}, writable_{writable} {}
+
+  using Print::write;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    if (!content_ || !writable_) {
+      return 0;
+    }
+    content_->append(reinterpret_cast<const char*>(buffer), size);
+    return size;
+  }
+
+  int available() override {
+    return content_ ? static_cast<int>(content_->size() - position_) : 0;
+  }
+  int read() override {
+    if (available() <= 0) {
+      return -1;
+    }
+    return static_cast<uint8_t>((*content_)[position_++]);
+  }
+  int peek() override {
+    return available() > 0 ? static_cast<uint8_t>((*content_)[position_])
+                           : -1;
+  }
+  size_t read(uint8_t* buffer, size_t size) { return readBytes(buffer, size); }
+
+  size_t size() const { return content_ ? content_->size() : 0; }
+  size_t position() const { return position_; }
+  bool seek(size_t position) {
+    if (!content_ || position > content_->size()) {
+      return false;
+    }
+    position_ = position;
+    return true;
+  }
+  void close() { content_.reset(); }
+
+  explicit operator bool() const { return content_ != nullptr; }
+
+ private:
+  std::shared_ptr<std::string> content_;
+  bool writable_ = false;
+  size_t position_ = 0;
+};
+
+class FS {
+ public:
+  File open(const char* path, const char* mode = FILE_READ) {
+    std::string name(path);
+    if (mode[0] == 'r') {
+      auto it = files_.find(name);
+      if (it == files_.end()) {
+        return File();
+      }
+      return File(it->second, false);
+    }
+    auto& content = files_[name];
+    if (!content || mode[0] == 'w') {
+      content = std::make_shared<std::string>();
+    }
+    return File(content, true);
+  }
+  File open(const String& path, const char* mode = FILE_READ) {
+    return open(path.c_str(), mode);
+  }
+
+  bool exists(const char* path) const { return files_.count(path) > 0; }
+  bool remove(const char* path) { return files_.erase(path) > 0; }
+
+  /// Test hooks: the content of a file, or set it
+  std::string get_content(const char* path) const {
+    auto it = files_.find(path);
+    return it == files_.end() ? std::string() : *it->second;
+  }
+  void set_content(const char* path, const std::string& content) {
+    files_[path] = std::make_shared<std::string>(content);
+  }
+
+ private:
+  std::map<std::string, std::shared_ptr<std::string>> files_;
+};
+
+}  // namespace fs
+
+#endif  // HALMET_TEST_STUBS_FS_H_
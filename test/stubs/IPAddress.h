@@ -0,0 +1,22 @@
+#ifndef HALMET_TEST_STUBS_IPADDRESS_H_
+#define HALMET_TEST_STUBS_IPADDRESS_H_
+
+#include <Arduino.h>
+
+class IPAddress {
+ public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0)
+      : octets_{a, b, c, d} {}
+
+  String toString() const {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", octets_[0], octets_[1],
+             octets_[2], octets_[3]);
+    return buffer;
+  }
+
+ protected:
+  uint8_t octets_[4];
+};
+
+#endif  // HALMET_TEST_STUBS_IPADDRESS_H_
@@ -0,0 +1,175 @@
+#ifndef HALMET_TEST_STUBS_N2KMESSAGES_H_
+#define HALMET_TEST_STUBS_N2KMESSAGES_H_
+
+// The NMEA2000 library's setters and parsers of the PGNs that HALMET
+// sends, with the field layout and precision of N2kMessages.cpp.
+
+#include <N2kMsg.h>
+
+enum tN2kFluidType {
+  N2kft_Fuel = 0,
+  N2kft_Water = 1,
+  N2kft_GrayWater = 2,
+  N2kft_LiveWell = 3,
+  N2kft_Oil = 4,
+  N2kft_BlackWater = 5,
+  N2kft_FuelGasoline = 6,
+  N2kft_Error = 14,
+  N2kft_Unavailable = 15,
+};
+
+union tN2kEngineDiscreteStatus1 {
+  uint16_t Status;
+  struct {
+    uint16_t CheckEngine : 1;
+    uint16_t OverTemperature : 1;
+    uint16_t LowOilPressure : 1;
+    uint16_t LowOilLevel : 1;
+    uint16_t LowFuelPressure : 1;
+    uint16_t LowSystemVoltage : 1;
+    uint16_t LowCoolantLevel : 1;
+    uint16_t WaterFlow : 1;
+    uint16_t WaterInFuel : 1;
+    uint16_t ChargeIndicator : 1;
+    uint16_t PreheatIndicator : 1;
+    uint16_t HighBoostPressure : 1;
+    uint16_t RevLimitExceeded : 1;
+    uint16_t EGRSystem : 1;
+    uint16_t ThrottlePositionSensor : 1;
+    uint16_t EngineEmergencyStopMode : 1;
+  } Bits;
+  tN2kEngineDiscreteStatus1(uint16_t status = 0) : Status{status} {}
+};
+
+union tN2kEngineDiscreteStatus2 {
+  uint16_t Status;
+  struct {
+    uint16_t WarningLevel1 : 1;
+    uint16_t WarningLevel2 : 1;
+    uint16_t LowOiPowerReduction : 1;
+    uint16_t MaintenanceNeeded : 1;
+    uint16_t EngineCommError : 1;
+    uint16_t SubOrSecondaryThrottle : 1;
+    uint16_t NeutralStartProtect : 1;
+    uint16_t EngineShuttingDown : 1;
+    uint16_t Reserved : 8;
+  } Bits;
+  tN2kEngineDiscreteStatus2(uint16_t status = 0) : Status{status} {}
+};
+
+// PGN 127488: Engine Parameters, Rapid Update
+inline void SetN2kEngineParamRapid(tN2kMsg& N2kMsg,
+                                   unsigned char EngineInstance,
+                                   double EngineSpeed = N2kDoubleNA,
+                                   double EngineBoostPressure = N2kDoubleNA,
+                                   int8_t EngineTiltTrim = N2kInt8NA) {
+  N2kMsg.SetPGN(127488L);
+  N2kMsg.Priority = 2;
+  N2kMsg.AddByte(EngineInstance);
+  N2kMsg.Add2ByteUDouble(EngineSpeed, 0.25);
+  N2kMsg.Add2ByteUDouble(EngineBoostPressure, 100);
+  N2kMsg.AddByte(EngineTiltTrim);
+  N2kMsg.AddByte(0xff);  // Reserved
+  N2kMsg.AddByte(0xff);  // Reserved
+}
+
+inline bool ParseN2kEngineParamRapid(const tN2kMsg& N2kMsg,
+                                     unsigned char& EngineInstance,
+                                     double& EngineSpeed,
+                                     double& EngineBoostPressure,
+                                     int8_t& EngineTiltTrim) {
+  if (N2kMsg.PGN != 127488L) {
+    return false;
+  }
+  int index = 0;
+  EngineInstance = N2kMsg.GetByte(index);
+  EngineSpeed = N2kMsg.Get2ByteUDouble(0.25, index);
+  EngineBoostPressure = N2kMsg.Get2ByteUDouble(100, index);
+  EngineTiltTrim = N2kMsg.GetByte(index);
+  return true;
+}
+
+// PGN 127489: Engine Parameters, Dynamic
+inline void SetN2kEngineDynamicParam(
+    tN2kMsg& N2kMsg, unsigned char EngineInstance, double EngineOilPress,
+    double EngineOilTemp, double EngineCoolantTemp, double AltenatorVoltage,
+    double FuelRate, double EngineHours,
+    double EngineCoolantPress = N2kDoubleNA,
+    double EngineFuelPress = N2kDoubleNA, int8_t EngineLoad = N2kInt8NA,
+    int8_t EngineTorque = N2kInt8NA,
+    tN2kEngineDiscreteStatus1 Status1 = 0,
+    tN2kEngineDiscreteStatus2 Status2 = 0) {
+  N2kMsg.SetPGN(127489L);
+  N2kMsg.Priority = 2;
+  N2kMsg.AddByte(EngineInstance);
+  N2kMsg.Add2ByteUDouble(EngineOilPress, 100);
+  N2kMsg.Add2ByteUDouble(EngineOilTemp, 0.1);
+  N2kMsg.Add2ByteUDouble(EngineCoolantTemp, 0.01);
+  N2kMsg.Add2ByteDouble(AltenatorVoltage, 0.01);
+  N2kMsg.Add2ByteDouble(FuelRate, 0.1);
+  N2kMsg.Add4ByteUDouble(EngineHours, 1);
+  N2kMsg.Add2ByteUDouble(EngineCoolantPress, 100);
+  N2kMsg.Add2ByteUDouble(EngineFuelPress, 1000);
+  N2kMsg.AddByte(0xff);  // Reserved
+  N2kMsg.Add2ByteUInt(Status1.Status);
+  N2kMsg.Add2ByteUInt(Status2.Status);
+  N2kMsg.AddByte(EngineLoad);
+  N2kMsg.AddByte(EngineTorque);
+}
+
+inline bool ParseN2kEngineDynamicParam(
+    const tN2kMsg& N2kMsg, unsigned char& EngineInstance,
+    double& EngineOilPress, double& EngineOilTemp, double& EngineCoolantTemp,
+    double& AltenatorVoltage, double& FuelRate, double& EngineHours,
+    double& EngineCoolantPress, double& EngineFuelPress, int8_t& EngineLoad,
+    int8_t& EngineTorque, tN2kEngineDiscreteStatus1& Status1,
+    tN2kEngineDiscreteStatus2& Status2) {
+  if (N2kMsg.PGN != 127489L) {
+    return false;
+  }
+  int index = 0;
+  EngineInstance = N2kMsg.GetByte(index);
+  EngineOilPress = N2kMsg.Get2ByteUDouble(100, index);
+  EngineOilTemp = N2kMsg.Get2ByteUDouble(0.1, index);
+  EngineCoolantTemp = N2kMsg.Get2ByteUDouble(0.01, index);
+  AltenatorVoltage = N2kMsg.Get2ByteDouble(0.01, index);
+  FuelRate = N2kMsg.Get2ByteDouble(0.1, index);
+  EngineHours = N2kMsg.Get4ByteUDouble(1, index);
+  EngineCoolantPress = N2kMsg.Get2ByteUDouble(100, index);
+  EngineFuelPress = N2kMsg.Get2ByteUDouble(1000, index);
+  N2kMsg.GetByte(index);  // Reserved
+  Status1 = N2kMsg.Get2ByteUInt(index);
+  Status2 = N2kMsg.Get2ByteUInt(index);
+  EngineLoad = N2kMsg.GetByte(index);
+  EngineTorque = N2kMsg.GetByte(index);
+  return true;
+}
+
+// PGN 127505: Fluid Level
+inline void SetN2kFluidLevel(tN2kMsg& N2kMsg, unsigned char Instance,
+                             tN2kFluidType FluidType, double Level,
+                             double Capacity) {
+  N2kMsg.SetPGN(127505L);
+  N2kMsg.Priority = 6;
+  N2kMsg.AddByte((Instance & 0x0f) | ((FluidType & 0x0f) << 4));
+  N2kMsg.Add2ByteDouble(Level, 0.004);
+  N2kMsg.Add4ByteUDouble(Capacity, 0.1);
+  N2kMsg.AddByte(0xff);  // Reserved
+}
+
+inline bool ParseN2kFluidLevel(const tN2kMsg& N2kMsg, unsigned char& Instance,
+                               tN2kFluidType& FluidType, double& Level,
+                               double& Capacity) {
+  if (N2kMsg.PGN != 127505L) {
+    return false;
+  }
+  int index = 0;
+  unsigned char instance_and_type = N2kMsg.GetByte(index);
+  Instance = instance_and_type & 0x0f;
+  FluidType = static_cast<tN2kFluidType>((instance_and_type >> 4) & 0x0f);
+  Level = N2kMsg.Get2ByteDouble(0.004, index);
+  Capacity = N2kMsg.Get4ByteUDouble(0.1, index);
+  return true;
+}
+
+#endif  // HALMET_TEST_STUBS_N2KMESSAGES_H_
@@ -0,0 +1,134 @@
+#ifndef HALMET_TEST_STUBS_N2KMSG_H_
+#define HALMET_TEST_STUBS_N2KMSG_H_
+
+// The NMEA2000 library's message buffer, with the field encoders and
+// decoders of N2kMsg.cpp: fields are little endian, scaled by their
+// precision and rounded, with the all-ones value meaning "not available"
+// and the next lower one "out of range".
+
+#include <Arduino.h>
+
+#include <cmath>
+#include <cstdint>
+
+#define N2kDoubleNA -1e9
+#define N2kFloatNA -1e9f
+#define N2kUInt8NA 0xff
+#define N2kInt8NA 0x7f
+#define N2kUInt16NA 0xffff
+#define N2kInt16NA 0x7fff
+#define N2kUInt32NA 0xffffffff
+#define N2kInt32NA 0x7fffffff
+
+#define N2kUInt8OR 0xfe
+#define N2kInt8OR 0x7e
+#define N2kUInt16OR 0xfffe
+#define N2kInt16OR 0x7ffe
+#define N2kUInt32OR 0xfffffffe
+#define N2kInt32OR 0x7ffffffe
+
+class tN2kMsg {
+ public:
+  static const int MaxDataLen = 223;
+
+  unsigned char Priority = 6;
+  unsigned long PGN = 0;
+  unsigned char Source = 0;
+  unsigned char Destination = 0xff;
+  int DataLen = 0;
+  unsigned char Data[MaxDataLen] = {};
+  unsigned long MsgTime = 0;
+
+  void SetPGN(unsigned long pgn) {
+    PGN = pgn;
+    DataLen = 0;
+    MsgTime = millis();
+  }
+  void Clear() {
+    PGN = 0;
+    DataLen = 0;
+  }
+
+  void AddByte(unsigned char v) { put(v, 1); }
+  void Add2ByteUInt(uint16_t v) { put(v, 2); }
+  void Add2ByteInt(int16_t v) { put(static_cast<uint16_t>(v), 2); }
+  void Add4ByteUInt(uint32_t v) { put(v, 4); }
+
+  void Add1ByteDouble(double v, double precision, double undef = N2kDoubleNA) {
+    if (v == undef) {
+      put(N2kInt8NA, 1);
+      return;
+    }
+    double vd = round(v / precision);
+    int8_t vi = (vd >= -0x7e && vd < N2kInt8OR) ? static_cast<int8_t>(vd)
+                                                : N2kInt8OR;
+    put(static_cast<uint8_t>(vi), 1);
+  }
+  void Add2ByteDouble(double v, double precision, double undef = N2kDoubleNA) {
+    if (v == undef) {
+      put(N2kInt16NA, 2);
+      return;
+    }
+    double vd = round(v / precision);
+    int16_t vi = (vd >= -0x7ffe && vd < N2kInt16OR) ? static_cast<int16_t>(vd)
+                                                    : N2kInt16OR;
+    put(static_cast<uint16_t>(vi), 2);
+  }
+  void Add2ByteUDouble(double v, double precision,
+                       double undef = N2kDoubleNA) {
+    if (v == undef) {
+      put(N2kUInt16NA, 2);
+      return;
+    }
+    double vd = round(v / precision);
+    uint16_t vi = (vd >= 0 && vd < N2kUInt16OR) ? static_cast<uint16_t>(vd)
+                                                : N2kUInt16OR;
+    put(vi, 2);
+  }
+  void Add4ByteUDouble(double v, double precision,
+                       double undef = N2kDoubleNA) {
+    if (v == undef) {
+      put(N2kUInt32NA, 4);
+      return;
+    }
+    double vd = round(v / precision);
+    uint32_t vi = (vd >= 0 && vd < N2kUInt32OR) ? static_cast<uint32_t>(vd)
+                                                : N2kUInt32OR;
+    put(vi, 4);
+  }
+
+  unsigned char GetByte(int& index) const { return get(index, 1); }
+  uint16_t Get2ByteUInt(int& index) const { return get(index, 2); }
+  uint32_t Get4ByteUInt(int& index) const { return get(index, 4); }
+  double Get2ByteDouble(double precision, int& index,
+                        double def = N2kDoubleNA) const {
+    int16_t vi = static_cast<int16_t>(get(index, 2));
+    return vi == N2kInt16NA ? def : vi * precision;
+  }
+  double Get2ByteUDouble(double precision, int& index,
+                         double def = N2kDoubleNA) const {
+    uint16_t vi = get(index, 2);
+    return vi == N2kUInt16NA ? def : vi * precision;
+  }
+  double Get4ByteUDouble(double precision, int& index,
+                         double def = N2kDoubleNA) const {
+    uint32_t vi = get(index, 4);
+    return vi == N2kUInt32NA ? def : vi * precision;
+  }
+
+ private:
+  void put(uint32_t v, int bytes) {
+    for (int i = 0; i < bytes && DataLen < MaxDataLen; i++) {
+      Data[DataLen++] = (v >> (8 * i)) & 0xff;
+    }
+  }
+  uint32_t get(int& index, int bytes) const {
+    uint32_t v = 0;
+    for (int i = 0; i < bytes && index < DataLen; i++) {
+      v |= static_cast<uint32_t>(Data[index++]) << (8 * i);
+    }
+    return v;
+  }
+};
+
+#endif  // HALMET_TEST_STUBS_N2KMSG_H_
@@ -0,0 +1,110 @@
+#ifndef HALMET_TEST_STUBS_NMEA2000_H_
+#define HALMET_TEST_STUBS_NMEA2000_H_
+
+// The NMEA2000 library's stack object, without a bus: SendMsg() records
+// the messages, and receive() hands a message to the message handlers as
+// ParseMessages() would. Handlers attached with AttachMsgHandler() for PGN
+// 0 get every message.
+
+#include <N2kMsg.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+class tNMEA2000 {
+ public:
+  class tMsgHandler {
+   public:
+    tMsgHandler(unsigned long pgn = 0, tNMEA2000* nmea2000 = nullptr)
+        : pgn_{pgn} {
+      if (nmea2000 != nullptr) {
+        nmea2000->AttachMsgHandler(this);
+      }
+    }
+    virtual ~tMsgHandler() = default;
+    virtual void HandleMsg(const tN2kMsg& N2kMsg) = 0;
+    unsigned long GetPGN() const { return pgn_; }
+
+   protected:
+    unsigned long pgn_;
+  };
+
+  virtual ~tNMEA2000() = default;
+
+  bool Open() { return true; }
+  void ParseMessages() {}
+
+  bool SendMsg(const tN2kMsg& N2kMsg, int DeviceIndex = 0) {
+    if (fail_sends_) {
+      return false;
+    }
+    if (record_) {
+      sent_.push_back(N2kMsg);
+    }
+    sent_per_pgn_[N2kMsg.PGN]++;
+    return true;
+  }
+
+  void SetMsgHandler(void (*handler)(const tN2kMsg& N2kMsg)) {
+    msg_handler_ = handler;
+  }
+  void AttachMsgHandler(tMsgHandler* handler) { handlers_.push_back(handler); }
+  void DetachMsgHandler(tMsgHandler* handler) {
+    for (auto it = handlers_.begin(); it != handlers_.end(); ++it) {
+      if (*it == handler) {
+        handlers_.erase(it);
+        return;
+      }
+    }
+  }
+
+  unsigned char GetN2kSource(int DeviceIndex = 0) const { return source_; }
+  bool ReadResetAddressChanged() {
+    bool changed = address_changed_;
+    address_changed_ = false;
+    return changed;
+  }
+
+  // Test hooks
+
+  /// A message from the bus, as ParseMessages() hands it on
+  void receive(const tN2kMsg& N2kMsg) {
+    if (msg_handler_ != nullptr) {
+      msg_handler_(N2kMsg);
+    }
+    for (tMsgHandler* handler : handlers_) {
+      if (handler->GetPGN() == 0 || handler->GetPGN() == N2kMsg.PGN) {
+        handler->HandleMsg(N2kMsg);
+      }
+    }
+  }
+  const std::vector<tN2kMsg>& get_sent() const { return sent_; }
+  size_t get_sent_count(unsigned long pgn) const {
+    auto it = sent_per_pgn_.find(pgn);
+    return it == sent_per_pgn_.end() ? 0 : it->second;
+  }
+  void clear_sent() {
+    sent_.clear();
+    sent_per_pgn_.clear();
+  }
+  /// Count the messages sent, without keeping them
+  void set_record(bool record) { record_ = record; }
+  void set_fail_sends(bool fail) { fail_sends_ = fail; }
+  void set_source(unsigned char source) {
+    address_changed_ = source != source_;
+    source_ = source;
+  }
+
+ protected:
+  std::vector<tN2kMsg> sent_;
+  std::map<unsigned long, size_t> sent_per_pgn_;
+  bool record_ = true;
+  bool fail_sends_ = false;
+  unsigned char source_ = 22;
+  bool address_changed_ = false;
+  void (*msg_handler_)(const tN2kMsg& N2kMsg) = nullptr;
+  std::vector<tMsgHandler*> handlers_;
+};
+
+#endif  // HALMET_TEST_STUBS_NMEA2000_H_
@@ -0,0 +1,216 @@
+#ifndef HALMET_TEST_STUBS_REACTESP_H_
+#define HALMET_TEST_STUBS_REACTESP_H_
+
+// ReactESP's event loop, as in 3.x: timed events in a queue ordered by due
+// time, run by tick() on the clock of Arduino.h. A repeat event is due an
+// interval after its previous due time, or after now if it fell more than
+// an interval behind. Delay events are deleted after they run.
+//
+// For simulations, run_until() ticks the loop at every due time up to a
+// time, and counts the ticks in which a timed event ran: with the CPU in
+// light sleep between events, those are the wakeups.
+
+#include <Arduino.h>
+
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <utility>
+
+namespace reactesp {
+
+using react_callback = std::function<void()>;
+
+class EventLoop;
+
+class Event {
+ public:
+  explicit Event(react_callback callback) : callback_{callback} {}
+  virtual ~Event() = default;
+
+  void remove(EventLoop* event_loop);
+
+ protected:
+  friend class EventLoop;
+  react_callback callback_;
+};
+
+class TimedEvent : public Event {
+ public:
+  TimedEvent(uint64_t interval_us, react_callback callback)
+      : Event(callback), interval_us_{interval_us} {}
+
+  uint64_t get_interval_us() const { return interval_us_; }
+
+ protected:
+  friend class EventLoop;
+  uint64_t interval_us_;
+  uint64_t due_us_ = 0;
+  uint64_t sequence_ = 0;  // Keeps events due at the same time in order
+};
+
+class DelayEvent : public TimedEvent {
+ public:
+  using TimedEvent::TimedEvent;
+};
+
+class RepeatEvent : public TimedEvent {
+ public:
+  using TimedEvent::TimedEvent;
+};
+
+class TickEvent : public Event {
+ public:
+  using Event::Event;
+};
+
+class EventLoop {
+ public:
+  DelayEvent* onDelay(uint32_t delay_ms, react_callback callback) {
+    return onDelayMicros(uint64_t{delay_ms} * 1000, callback);
+  }
+  DelayEvent* onDelayMicros(uint64_t delay_us, react_callback callback) {
+    auto event = new DelayEvent(delay_us, callback);
+    schedule(event, now_us() + delay_us);
+    return event;
+  }
+  RepeatEvent* onRepeat(uint32_t interval_ms, react_callback callback) {
+    return onRepeatMicros(uint64_t{interval_ms} * 1000, callback);
+  }
+  RepeatEvent* onRepeatMicros(uint64_t interval_us, react_callback callback) {
+    auto event = new RepeatEvent(interval_us, callback);
+    schedule(event, now_us() + interval_us);
+    return event;
+  }
+  TickEvent* onTick(react_callback callback) {
+    auto event = new TickEvent(callback);
+    tick_events_.insert(event);
+    return event;
+  }
+
+  void remove(Event* event) {
+    if (event == running_) {
+      // Deleted once its callback returns
+      running_removed_ = true;
+      return;
+    }
+    for (auto it = timed_queue_.begin(); it != timed_queue_.end(); ++it) {
+      if (it->second == event) {
+        timed_queue_.erase(it);
+        delete event;
+        return;
+      }
+    }
+    if (tick_events_.erase(static_cast<TickEvent*>(event)) > 0) {
+      delete event;
+    }
+  }
+
+  /// Run the due timed events, then the tick events
+  void tick() {
+    uint64_t now = now_us();
+    bool woke = false;
+    while (!timed_queue_.empty() && timed_queue_.begin()->first.first <= now) {
+      TimedEvent* event = timed_queue_.begin()->second;
+      timed_queue_.erase(timed_queue_.begin());
+      run(event);
+      woke = true;
+      if (running_removed_ || dynamic_cast<DelayEvent*>(event) != nullptr) {
+        delete event;
+      } else {
+        uint64_t due_us = event->due_us_ + event->interval_us_;
+        if (due_us + event->interval_us_ < now) {
+          due_us = now + event->interval_us_;
+        }
+        schedule(event, due_us);
+      }
+      running_ = nullptr;
+      running_removed_ = false;
+    }
+    // A copy, as tick events may add or remove tick events
+    std::set<TickEvent*> tick_events = tick_events_;
+    for (TickEvent* event : tick_events) {
+      if (tick_events_.count(event) == 0) {
+        continue;
+      }
+      run(event);
+      if (running_removed_) {
+        tick_events_.erase(event);
+        delete event;
+      }
+      running_ = nullptr;
+      running_removed_ = false;
+    }
+    if (woke) {
+      wakeups_++;
+    }
+  }
+
+  /// Due time (us) of the next timed event, or UINT64_MAX if there is none
+  uint64_t next_due_us() const {
+    return timed_queue_.empty() ? UINT64_MAX
+                                : timed_queue_.begin()->first.first;
+  }
+
+  /// Take over the clock and tick at every due time until end_us
+  void run_until(uint64_t end_us) {
+    fake::Clock* clock = fake::Clock::get();
+    clock->set_us(clock->micros64());
+    while (next_due_us() <= end_us) {
+      clock->set_us(std::max(next_due_us(), clock->micros64()));
+      tick();
+    }
+    clock->set_us(end_us);
+    tick();
+  }
+  void run_for_ms(uint64_t ms) {
+    run_until(fake::Clock::get()->micros64() + ms * 1000);
+  }
+
+  /// Ticks in which a timed event ran, and timed events run
+  uint64_t get_wakeups() const { return wakeups_; }
+  uint64_t get_timed_runs() const { return timed_runs_; }
+  size_t get_timed_event_count() const { return timed_queue_.size(); }
+  size_t get_tick_event_count() const { return tick_events_.size(); }
+
+ private:
+  using Key = std::pair<uint64_t, uint64_t>;  // Due time and sequence
+
+  static uint64_t now_us() { return fake::Clock::get()->micros64(); }
+
+  void schedule(TimedEvent* event, uint64_t due_us) {
+    event->due_us_ = due_us;
+    event->sequence_ = sequence_++;
+    timed_queue_.insert({{due_us, event->sequence_}, event});
+  }
+
+  void run(Event* event) {
+    running_ = event;
+    running_removed_ = false;
+    if (dynamic_cast<TimedEvent*>(event) != nullptr) {
+      timed_runs_++;
+    }
+    event->callback_();
+  }
+
+  struct KeyLess {
+    bool operator()(const std::pair<Key, TimedEvent*>& a,
+                    const std::pair<Key, TimedEvent*>& b) const {
+      return a.first < b.first;
+    }
+  };
+
+  std::set<std::pair<Key, TimedEvent*>, KeyLess> timed_queue_;
+  std::set<TickEvent*> tick_events_;
+  uint64_t sequence_ = 0;
+  Event* running_ = nullptr;
+  bool running_removed_ = false;
+  uint64_t wakeups_ = 0;
+  uint64_t timed_runs_ = 0;
+};
+
+inline void Event::remove(EventLoop* event_loop) { event_loop->remove(this); }
+
+}  // namespace reactesp
+
+#endif  // HALMET_TEST_STUBS_REACTESP_H_
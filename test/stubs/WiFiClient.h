@@ -0,0 +1,45 @@
+#ifndef HALMET_TEST_STUBS_WIFICLIENT_H_
+#define HALMET_TEST_STUBS_WIFICLIENT_H_
+
+// A TCP client of the Arduino core, on a host socket. The fake server hands
+// out one end of a socket pair; the test reads the other.
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <unistd.h>
+
+#include <memory>
+
+class WiFiClient {
+ public:
+  WiFiClient() = default;
+  explicit WiFiClient(int fd)
+      : socket_{std::make_shared<Socket>(fd)} {}
+
+  int fd() const { return socket_ ? socket_->fd : -1; }
+  uint8_t connected() { return socket_ && socket_->fd >= 0; }
+  void stop() {
+    if (socket_ && socket_->fd >= 0) {
+      close(socket_->fd);
+      socket_->fd = -1;
+    }
+  }
+  IPAddress remoteIP() const { return IPAddress(192, 168, 4, 2); }
+  operator bool() { return connected(); }
+
+ protected:
+  // Shared by the copies, as the core's client socket handle is
+  struct Socket {
+    explicit Socket(int fd) : fd{fd} {}
+    ~Socket() {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+    int fd;
+  };
+
+  std::shared_ptr<Socket> socket_;
+};
+
+#endif  // HALMET_TEST_STUBS_WIFICLIENT_H_
@@ -0,0 +1,56 @@
+#ifndef HALMET_TEST_STUBS_WIFISERVER_H_
+#define HALMET_TEST_STUBS_WIFISERVER_H_
+
+// A TCP server of the Arduino core that doesn't listen: connect() makes a
+// local socket pair, queues one end as the next client and returns the
+// other to the test.
+
+#include <WiFiClient.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include <deque>
+
+class WiFiServer {
+ public:
+  explicit WiFiServer(uint16_t port = 80) : port_{port} {}
+
+  void begin(uint16_t port = 0) { listening_ = true; }
+  void setNoDelay(bool nodelay) {}
+  bool hasClient() { return !pending_.empty(); }
+  WiFiClient available() {
+    if (pending_.empty()) {
+      return WiFiClient();
+    }
+    int fd = pending_.front();
+    pending_.pop_front();
+    return WiFiClient(fd);
+  }
+
+  // Test hooks
+
+  /// Connect a client, and return the test's end of the connection, or -1.
+  /// The server's end doesn't block; its send buffer is send_buffer bytes,
+  /// if given, so that tests can fill it.
+  int connect(int send_buffer = 0) {
+    int fds[2];
+    if (!listening_ || socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      return -1;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    if (send_buffer > 0) {
+      setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &send_buffer,
+                 sizeof(send_buffer));
+    }
+    pending_.push_back(fds[0]);
+    return fds[1];
+  }
+  uint16_t get_port() const { return port_; }
+
+ protected:
+  uint16_t port_;
+  bool listening_ = false;
+  std::deque<int> pending_;
+};
+
+#endif  // HALMET_TEST_STUBS_WIFISERVER_H_
@@ -0,0 +1,41 @@
+#ifndef HALMET_TEST_STUBS_WIFIUDP_H_
+#define HALMET_TEST_STUBS_WIFIUDP_H_
+
+// UDP of the Arduino core. The datagrams are kept instead of sent.
+
+#include <Arduino.h>
+
+#include <string>
+#include <vector>
+
+class WiFiUDP {
+ public:
+  struct Packet {
+    String host;
+    uint16_t port;
+    std::string data;
+  };
+
+  int beginPacket(const char* host, uint16_t port) {
+    packet_ = {host, port, ""};
+    return 1;
+  }
+  size_t write(const uint8_t* buffer, size_t size) {
+    packet_.data.append(reinterpret_cast<const char*>(buffer), size);
+    return size;
+  }
+  int endPacket() {
+    packets_.push_back(packet_);
+    return 1;
+  }
+
+  // Test hooks
+
+  const std::vector<Packet>& get_packets() const { return packets_; }
+
+ protected:
+  Packet packet_;
+  std::vector<Packet> packets_;
+};
+
+#endif  // HALMET_TEST_STUBS_WIFIUDP_H_
@@ -0,0 +1,26 @@
+#ifndef HALMET_TEST_STUBS_WIRE_H_
+#define HALMET_TEST_STUBS_WIRE_H_
+
+// The I2C bus, without devices: the ADS1115 and display fakes answer
+// themselves.
+
+#include <Arduino.h>
+
+#include <cstdint>
+
+class TwoWire {
+ public:
+  explicit TwoWire(uint8_t bus_num = 0) {}
+
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) {
+    return true;
+  }
+  void setClock(uint32_t frequency) {}
+  bool lock() { return true; }
+  bool unlock() { return true; }
+};
+
+inline TwoWire Wire;
+inline TwoWire Wire1;
+
+#endif  // HALMET_TEST_STUBS_WIRE_H_
@@ -0,0 +1,23 @@
+#ifndef HALMET_TEST_STUBS_DRIVER_GPIO_H_
+#define HALMET_TEST_STUBS_DRIVER_GPIO_H_
+
+// ESP-IDF GPIO wakeup configuration, without effect on the host
+
+#include <Arduino.h>
+#include <esp_err.h>
+
+typedef enum {
+  GPIO_INTR_DISABLE = 0,
+  GPIO_INTR_POSEDGE,
+  GPIO_INTR_NEGEDGE,
+  GPIO_INTR_ANYEDGE,
+  GPIO_INTR_LOW_LEVEL,
+  GPIO_INTR_HIGH_LEVEL,
+} gpio_int_type_t;
+
+inline esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num,
+                                    gpio_int_type_t intr_type) {
+  return ESP_OK;
+}
+
+#endif  // HALMET_TEST_STUBS_DRIVER_GPIO_H_
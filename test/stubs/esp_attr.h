@@ -0,0 +1,14 @@
+#ifndef HALMET_TEST_STUBS_ESP_ATTR_H_
+#define HALMET_TEST_STUBS_ESP_ATTR_H_
+
+// Placement attributes; on the host, RTC memory is ordinary memory that is
+// zeroed at start, like RTC memory after a power-on reset.
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif  // HALMET_TEST_STUBS_ESP_ATTR_H_
@@ -0,0 +1,33 @@
+#ifndef HALMET_TEST_STUBS_ESP_HEAP_CAPS_H_
+#define HALMET_TEST_STUBS_ESP_HEAP_CAPS_H_
+
+// Heap queries, answered with the figures of an ESP32 without PSRAM after
+// boot
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#define MALLOC_CAP_EXEC (1 << 0)
+#define MALLOC_CAP_32BIT (1 << 1)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+inline size_t heap_caps_get_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : 180 * 1024;
+}
+
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : 110 * 1024;
+}
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? nullptr : malloc(size);
+}
+
+inline void heap_caps_free(void* ptr) { free(ptr); }
+
+#endif  // HALMET_TEST_STUBS_ESP_HEAP_CAPS_H_
@@ -0,0 +1,193 @@
+#ifndef HALMET_TEST_STUBS_ESP_HTTP_SERVER_H_
+#define HALMET_TEST_STUBS_ESP_HTTP_SERVER_H_
+
+// ESP-IDF's HTTP server request and response calls, on a request that the
+// tests build and a response they read back. An asynchronous copy of a
+// request (httpd_req_async_handler_begin()) answers into the same
+// response.
+
+#include <Arduino.h>
+#include <esp_err.h>
+#include <sys/types.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#define ESP_ERR_HTTPD_BASE 0xb000
+#define ESP_ERR_HTTPD_RESULT_TRUNC (ESP_ERR_HTTPD_BASE + 3)
+#define ESP_ERR_HTTPD_INVALID_REQ (ESP_ERR_HTTPD_BASE + 7)
+
+#define HTTPD_RESP_USE_STRLEN -1
+
+enum http_method {
+  HTTP_DELETE = 0,
+  HTTP_GET = 1,
+  HTTP_HEAD = 2,
+  HTTP_POST = 3,
+  HTTP_PUT = 4,
+};
+
+typedef enum {
+  HTTPD_500_INTERNAL_SERVER_ERROR = 0,
+  HTTPD_400_BAD_REQUEST = 3,
+  HTTPD_404_NOT_FOUND = 5,
+  HTTPD_408_REQ_TIMEOUT = 8,
+} httpd_err_code_t;
+
+namespace fake {
+
+struct HttpResponse {
+  String status = "200 OK";
+  String type = "text/html";
+  std::map<std::string, String> headers;
+  String body;
+  bool sent = false;      // Complete: sent, or the last chunk sent
+  int sends = 0;          // Calls of httpd_resp_send*()
+
+  int status_code() const { return status.toInt(); }
+};
+
+}  // namespace fake
+
+struct httpd_req_t {
+  int method = HTTP_GET;
+  String uri;
+  std::map<std::string, String> headers;
+  String content;
+  size_t content_read = 0;
+  std::shared_ptr<fake::HttpResponse> response =
+      std::make_shared<fake::HttpResponse>();
+  size_t content_len() const { return content.length(); }
+};
+
+inline esp_err_t httpd_resp_set_status(httpd_req_t* r, const char* status) {
+  r->response->status = status;
+  return ESP_OK;
+}
+
+inline esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type) {
+  r->response->type = type;
+  return ESP_OK;
+}
+
+inline esp_err_t httpd_resp_set_hdr(httpd_req_t* r, const char* field,
+                                    const char* value) {
+  r->response->headers[field] = value;
+  return ESP_OK;
+}
+
+inline esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf,
+                                 ssize_t buf_len) {
+  if (buf != nullptr) {
+    size_t length = buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : buf_len;
+    r->response->body.append(buf, length);
+  }
+  r->response->sent = true;
+  r->response->sends++;
+  return ESP_OK;
+}
+
+inline esp_err_t httpd_resp_sendstr(httpd_req_t* r, const char* str) {
+  return httpd_resp_send(r, str, HTTPD_RESP_USE_STRLEN);
+}
+
+inline esp_err_t httpd_resp_send_chunk(httpd_req_t* r, const char* buf,
+                                       ssize_t buf_len) {
+  size_t length = buf == nullptr ? 0
+                  : buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf)
+                                                     : buf_len;
+  r->response->sends++;
+  if (length == 0) {
+    r->response->sent = true;
+  } else {
+    r->response->body.append(buf, length);
+  }
+  return ESP_OK;
+}
+
+inline esp_err_t httpd_resp_send_err(httpd_req_t* r, httpd_err_code_t error,
+                                     const char* message) {
+  static const std::map<int, const char*> kStatus = {
+      {HTTPD_500_INTERNAL_SERVER_ERROR, "500 Internal Server Error"},
+      {HTTPD_400_BAD_REQUEST, "400 Bad Request"},
+      {HTTPD_404_NOT_FOUND, "404 Not Found"},
+      {HTTPD_408_REQ_TIMEOUT, "408 Request Timeout"}};
+  r->response->status = kStatus.at(error);
+  return httpd_resp_send(r, message, HTTPD_RESP_USE_STRLEN);
+}
+
+inline int httpd_req_recv(httpd_req_t* r, char* buf, size_t buf_len) {
+  size_t length = std::min(buf_len, r->content.length() - r->content_read);
+  memcpy(buf, r->content.c_str() + r->content_read, length);
+  r->content_read += length;
+  return length;
+}
+
+inline size_t httpd_req_get_hdr_value_len(httpd_req_t* r, const char* field) {
+  auto it = r->headers.find(field);
+  return it == r->headers.end() ? 0 : it->second.length();
+}
+
+inline esp_err_t CopyTruncated(const String& value, char* buf, size_t size) {
+  if (size == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  size_t length = std::min(value.length(), size - 1);
+  memcpy(buf, value.c_str(), length);
+  buf[length] = '\0';
+  return length < value.length() ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+inline esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* r,
+                                             const char* field, char* val,
+                                             size_t val_size) {
+  auto it = r->headers.find(field);
+  if (it == r->headers.end()) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  return CopyTruncated(it->second, val, val_size);
+}
+
+inline esp_err_t httpd_req_get_url_query_str(httpd_req_t* r, char* buf,
+                                             size_t buf_len) {
+  int start = r->uri.indexOf('?');
+  if (start < 0) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  return CopyTruncated(r->uri.substring(start + 1), buf, buf_len);
+}
+
+inline esp_err_t httpd_query_key_value(const char* qry, const char* key,
+                                       char* val, size_t val_size) {
+  String query(qry);
+  String prefix = String(key) + "=";
+  size_t start = 0;
+  while (start <= query.length()) {
+    int end = query.indexOf('&', start);
+    String pair = end < 0 ? query.substring(start) : query.substring(start, end);
+    if (pair.startsWith(prefix)) {
+      return CopyTruncated(pair.substring(prefix.length()), val, val_size);
+    }
+    if (end < 0) {
+      break;
+    }
+    start = end + 1;
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+/// A copy of the request that outlives the handler, answering into the same
+/// response
+inline esp_err_t httpd_req_async_handler_begin(httpd_req_t* r,
+                                               httpd_req_t** out) {
+  *out = new httpd_req_t(*r);
+  return ESP_OK;
+}
+
+inline esp_err_t httpd_req_async_handler_complete(httpd_req_t* r) {
+  delete r;
+  return ESP_OK;
+}
+
+#endif  // HALMET_TEST_STUBS_ESP_HTTP_SERVER_H_
@@ -0,0 +1,152 @@
+#ifndef HALMET_TEST_STUBS_ESP_PARTITION_H_
+#define HALMET_TEST_STUBS_ESP_PARTITION_H_
+
+// Flash partitions in host memory, added by the tests. Like NOR flash, an
+// erase sets the bytes to 0xff and a write can only clear bits. The mapping
+// is the memory itself, so writes show through it at once. Writes and
+// erases are counted.
+
+#include <esp_err.h>
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef enum {
+  ESP_PARTITION_TYPE_APP = 0x00,
+  ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+  ESP_PARTITION_SUBTYPE_DATA_NVS = 0x02,
+  ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+  ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef enum {
+  ESP_PARTITION_MMAP_DATA,
+  ESP_PARTITION_MMAP_INST,
+} esp_partition_mmap_memory_t;
+
+typedef uint32_t esp_partition_mmap_handle_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  uint32_t erase_size;
+  char label[17];
+} esp_partition_t;
+
+namespace fake {
+
+class Partitions {
+ public:
+  static Partitions* get() {
+    static Partitions partitions;
+    return &partitions;
+  }
+
+  /// Add an erased data partition, or erase it if it exists
+  const esp_partition_t* add(const char* label, uint32_t size) {
+    Partition& partition = partitions_[label];
+    partition.info = {};
+    partition.info.type = ESP_PARTITION_TYPE_DATA;
+    partition.info.subtype = ESP_PARTITION_SUBTYPE_DATA_SPIFFS;
+    partition.info.size = size;
+    partition.info.erase_size = 4096;
+    strncpy(partition.info.label, label, sizeof(partition.info.label) - 1);
+    partition.data.assign(size, 0xff);
+    return &partition.info;
+  }
+  void remove(const char* label) { partitions_.erase(label); }
+
+  const esp_partition_t* find(const char* label) {
+    auto it = partitions_.find(label);
+    return it == partitions_.end() ? nullptr : &it->second.info;
+  }
+  uint8_t* data(const esp_partition_t* info) {
+    return partitions_.at(info->label).data.data();
+  }
+
+  unsigned writes = 0;
+  unsigned erases = 0;
+
+ private:
+  struct Partition {
+    esp_partition_t info;
+    std::vector<uint8_t> data;
+  };
+
+  std::map<std::string, Partition> partitions_;
+};
+
+}  // namespace fake
+
+inline const esp_partition_t* esp_partition_find_first(
+    esp_partition_type_t type, esp_partition_subtype_t subtype,
+    const char* label) {
+  const esp_partition_t* partition = fake::Partitions::get()->find(label);
+  if (partition == nullptr || partition->type != type ||
+      (subtype != ESP_PARTITION_SUBTYPE_ANY &&
+       partition->subtype != subtype)) {
+    return nullptr;
+  }
+  return partition;
+}
+
+inline esp_err_t esp_partition_mmap(const esp_partition_t* partition,
+                                    size_t offset, size_t size,
+                                    esp_partition_mmap_memory_t memory,
+                                    const void** out_ptr,
+                                    esp_partition_mmap_handle_t* out_handle) {
+  if (offset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *out_ptr = fake::Partitions::get()->data(partition) + offset;
+  *out_handle = 1;
+  return ESP_OK;
+}
+
+inline void esp_partition_munmap(esp_partition_mmap_handle_t handle) {}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* partition,
+                                     size_t dst_offset, const void* src,
+                                     size_t size) {
+  if (dst_offset + size > partition->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  uint8_t* data = fake::Partitions::get()->data(partition) + dst_offset;
+  const uint8_t* bytes = static_cast<const uint8_t*>(src);
+  for (size_t i = 0; i < size; i++) {
+    data[i] &= bytes[i];
+  }
+  fake::Partitions::get()->writes++;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t* partition,
+                                    size_t src_offset, void* dst,
+                                    size_t size) {
+  if (src_offset + size > partition->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(dst, fake::Partitions::get()->data(partition) + src_offset, size);
+  return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* partition,
+                                           size_t offset, size_t size) {
+  if (offset % partition->erase_size != 0 ||
+      size % partition->erase_size != 0 || offset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(fake::Partitions::get()->data(partition) + offset, 0xff, size);
+  fake::Partitions::get()->erases++;
+  return ESP_OK;
+}
+
+#endif  // HALMET_TEST_STUBS_ESP_PARTITION_H_
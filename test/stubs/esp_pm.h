@@ -0,0 +1,9 @@
+#ifndef HALMET_TEST_STUBS_ESP_PM_H_
+#define HALMET_TEST_STUBS_ESP_PM_H_
+
+// ESP-IDF power management. The host build is without CONFIG_PM_ENABLE, as
+// the Arduino core is, so the clock is set with setCpuFrequencyMhz().
+
+#include <esp_err.h>
+
+#endif  // HALMET_TEST_STUBS_ESP_PM_H_
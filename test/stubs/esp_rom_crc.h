@@ -0,0 +1,22 @@
+#ifndef HALMET_TEST_STUBS_ESP_ROM_CRC_H_
+#define HALMET_TEST_STUBS_ESP_ROM_CRC_H_
+
+// The ROM's little-endian CRC-32 (polynomial 0xedb88320), which inverts the
+// CRC before and after, like zlib's crc32()
+
+#include <cstddef>
+#include <cstdint>
+
+inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf,
+                                 uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+#endif  // HALMET_TEST_STUBS_ESP_ROM_CRC_H_
@@ -0,0 +1,10 @@
+#ifndef HALMET_TEST_STUBS_ESP_SLEEP_H_
+#define HALMET_TEST_STUBS_ESP_SLEEP_H_
+
+// ESP-IDF sleep wakeup sources, without effect on the host
+
+#include <esp_err.h>
+
+inline esp_err_t esp_sleep_enable_gpio_wakeup() { return ESP_OK; }
+
+#endif  // HALMET_TEST_STUBS_ESP_SLEEP_H_
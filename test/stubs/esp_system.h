@@ -0,0 +1,42 @@
+#ifndef HALMET_TEST_STUBS_ESP_SYSTEM_H_
+#define HALMET_TEST_STUBS_ESP_SYSTEM_H_
+
+// Reset reason and restart. The tests set the reason of the "boot";
+// esp_restart() is counted instead of restarting.
+
+#include <esp_err.h>
+
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_EXT,
+  ESP_RST_SW,
+  ESP_RST_PANIC,
+  ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT,
+  ESP_RST_WDT,
+  ESP_RST_DEEPSLEEP,
+  ESP_RST_BROWNOUT,
+  ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+namespace fake {
+
+struct System {
+  static System* get() {
+    static System system;
+    return &system;
+  }
+  esp_reset_reason_t reset_reason = ESP_RST_POWERON;
+  unsigned restarts = 0;
+};
+
+}  // namespace fake
+
+inline esp_reset_reason_t esp_reset_reason() {
+  return fake::System::get()->reset_reason;
+}
+
+inline void esp_restart() { fake::System::get()->restarts++; }
+
+#endif  // HALMET_TEST_STUBS_ESP_SYSTEM_H_
@@ -0,0 +1,67 @@
+#ifndef HALMET_TEST_STUBS_ESP_TIMER_H_
+#define HALMET_TEST_STUBS_ESP_TIMER_H_
+
+// esp_timer on the clock of Arduino.h. Timers are created and started but
+// never fire; nothing that the host tests cover depends on them.
+
+#include <Arduino.h>
+#include <esp_err.h>
+
+#include <cstdint>
+
+typedef struct esp_timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+  ESP_TIMER_TASK,
+  ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+  esp_timer_cb_t callback;
+  void* arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char* name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct esp_timer {
+  esp_timer_create_args_t args;
+  uint64_t period_us;
+  bool running;
+};
+
+inline int64_t esp_timer_get_time() {
+  return static_cast<int64_t>(fake::Clock::get()->micros64());
+}
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t* args,
+                                  esp_timer_handle_t* out_handle) {
+  *out_handle = new esp_timer{*args, 0, false};
+  return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer,
+                                          uint64_t period_us) {
+  timer->period_us = period_us;
+  timer->running = true;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t timer,
+                                      uint64_t timeout_us) {
+  timer->running = true;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  timer->running = false;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  delete timer;
+  return ESP_OK;
+}
+
+#endif  // HALMET_TEST_STUBS_ESP_TIMER_H_
@@ -0,0 +1,33 @@
+#ifndef HALMET_TEST_STUBS_ESP_WIFI_H_
+#define HALMET_TEST_STUBS_ESP_WIFI_H_
+
+// ESP-IDF WiFi power save mode. The mode is kept, for tests that model the
+// power draw.
+
+#include <esp_err.h>
+
+typedef enum {
+  WIFI_PS_NONE,
+  WIFI_PS_MIN_MODEM,
+  WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+namespace fake {
+
+inline wifi_ps_type_t& wifi_ps() {
+  static wifi_ps_type_t type = WIFI_PS_NONE;
+  return type;
+}
+
+}  // namespace fake
+
+inline esp_err_t esp_wifi_set_ps(wifi_ps_type_t type) {
+  fake::wifi_ps() = type;
+  return ESP_OK;
+}
+inline esp_err_t esp_wifi_get_ps(wifi_ps_type_t* type) {
+  *type = fake::wifi_ps();
+  return ESP_OK;
+}
+
+#endif  // HALMET_TEST_STUBS_ESP_WIFI_H_
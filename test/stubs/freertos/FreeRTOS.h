@@ -0,0 +1,47 @@
+#ifndef HALMET_TEST_STUBS_FREERTOS_FREERTOS_H_
+#define HALMET_TEST_STUBS_FREERTOS_FREERTOS_H_
+
+// FreeRTOS types and critical sections. A tick is a millisecond. All
+// critical sections share one host mutex, which, like the spinlocks on a
+// single core, serializes them.
+
+#include <cstdint>
+#include <mutex>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY (static_cast<TickType_t>(0xffffffffUL))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define tskIDLE_PRIORITY 0
+
+typedef struct {
+  uint32_t owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+namespace fake {
+
+inline std::recursive_mutex& CriticalSection() {
+  static std::recursive_mutex mutex;
+  return mutex;
+}
+
+}  // namespace fake
+
+#define portENTER_CRITICAL(mux) fake::CriticalSection().lock()
+#define portEXIT_CRITICAL(mux) fake::CriticalSection().unlock()
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+#define taskENTER_CRITICAL(mux) portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux) portEXIT_CRITICAL(mux)
+
+#endif  // HALMET_TEST_STUBS_FREERTOS_FREERTOS_H_
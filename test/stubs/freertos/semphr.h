@@ -0,0 +1,59 @@
+#ifndef HALMET_TEST_STUBS_FREERTOS_SEMPHR_H_
+#define HALMET_TEST_STUBS_FREERTOS_SEMPHR_H_
+
+// Binary semaphores and mutexes on host threads. Waits are in real time, as
+// the host threads that take a semaphore are real.
+
+#include <freertos/FreeRTOS.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+struct QueueDefinition {
+  std::mutex mutex;
+  std::condition_variable available;
+  bool given = false;
+};
+typedef QueueDefinition* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return new QueueDefinition();
+}
+
+/// A mutex is a binary semaphore that starts out given
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  SemaphoreHandle_t semaphore = new QueueDefinition();
+  semaphore->given = true;
+  return semaphore;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  {
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    if (semaphore->given) {
+      return pdFALSE;
+    }
+    semaphore->given = true;
+  }
+  semaphore->available.notify_one();
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore,
+                                 TickType_t ticks_to_wait) {
+  std::unique_lock<std::mutex> lock(semaphore->mutex);
+  auto given = [semaphore]() { return semaphore->given; };
+  if (ticks_to_wait == portMAX_DELAY) {
+    semaphore->available.wait(lock, given);
+  } else if (!semaphore->available.wait_for(
+                 lock, std::chrono::milliseconds(ticks_to_wait), given)) {
+    return pdFALSE;
+  }
+  semaphore->given = false;
+  return pdTRUE;
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
+
+#endif  // HALMET_TEST_STUBS_FREERTOS_SEMPHR_H_
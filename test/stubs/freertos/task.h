@@ -0,0 +1,59 @@
+#ifndef HALMET_TEST_STUBS_FREERTOS_TASK_H_
+#define HALMET_TEST_STUBS_FREERTOS_TASK_H_
+
+// Tasks are created but not run; the host tests drive the event loop
+// only. Notifications are counted, so that a task body can be called by a
+// test if needed.
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+typedef void (*TaskFunction_t)(void*);
+
+struct tskTaskControlBlock {
+  TaskFunction_t function;
+  void* parameters;
+  uint32_t notifications;
+};
+typedef tskTaskControlBlock* TaskHandle_t;
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function,
+                                          const char* name,
+                                          uint32_t stack_depth,
+                                          void* parameters,
+                                          UBaseType_t priority,
+                                          TaskHandle_t* created_task,
+                                          BaseType_t core_id) {
+  TaskHandle_t task = new tskTaskControlBlock{function, parameters, 0};
+  if (created_task != nullptr) {
+    *created_task = task;
+  }
+  return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name,
+                              uint32_t stack_depth, void* parameters,
+                              UBaseType_t priority,
+                              TaskHandle_t* created_task) {
+  return xTaskCreatePinnedToCore(function, name, stack_depth, parameters,
+                                 priority, created_task, 0);
+}
+
+inline BaseType_t xPortGetCoreID() { return 1; }
+
+inline void xTaskNotifyGive(TaskHandle_t task) { task->notifications++; }
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit,
+                                 TickType_t ticks_to_wait) {
+  return 0;
+}
+
+inline TickType_t xTaskGetTickCount() { return millis(); }
+
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return 1024;
+}
+
+#endif  // HALMET_TEST_STUBS_FREERTOS_TASK_H_
@@ -0,0 +1,10 @@
+#ifndef HALMET_TEST_STUBS_LWIP_SOCKETS_H_
+#define HALMET_TEST_STUBS_LWIP_SOCKETS_H_
+
+// lwIP's BSD socket API is the host's
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#endif  // HALMET_TEST_STUBS_LWIP_SOCKETS_H_
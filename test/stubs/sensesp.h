@@ -0,0 +1,68 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_H_
+#define HALMET_TEST_STUBS_SENSESP_H_
+
+// SensESP's logging macros and event loop, as in 3.x. The log is quiet
+// unless HALMET_LOG is set in the environment; the tests can count the
+// messages of each level.
+
+#include <Arduino.h>
+#include <ReactESP.h>
+
+#include <cstdlib>
+
+namespace fake {
+
+class Log {
+ public:
+  enum Level { kDebug, kInfo, kWarning, kError, kNumLevels };
+
+  static Log* get() {
+    static Log log;
+    return &log;
+  }
+
+  void write(Level level, const char* format, ...) {
+    counts_[level]++;
+    if (!enabled_) {
+      return;
+    }
+    static const char kLetters[] = "DIWE";
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "[%c] ", kLetters[level]);
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+  }
+
+  unsigned count(Level level) const { return counts_[level]; }
+  void reset() {
+    for (unsigned& count : counts_) {
+      count = 0;
+    }
+  }
+
+ private:
+  Log() : enabled_{getenv("HALMET_LOG") != nullptr} {}
+
+  bool enabled_;
+  unsigned counts_[kNumLevels] = {};
+};
+
+}  // namespace fake
+
+#define debugD(...) fake::Log::get()->write(fake::Log::kDebug, __VA_ARGS__)
+#define debugI(...) fake::Log::get()->write(fake::Log::kInfo, __VA_ARGS__)
+#define debugW(...) fake::Log::get()->write(fake::Log::kWarning, __VA_ARGS__)
+#define debugE(...) fake::Log::get()->write(fake::Log::kError, __VA_ARGS__)
+
+namespace sensesp {
+
+inline reactesp::EventLoop* event_loop() {
+  static reactesp::EventLoop loop;
+  return &loop;
+}
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_H_
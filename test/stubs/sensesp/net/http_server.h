@@ -0,0 +1,81 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_NET_HTTP_SERVER_H_
+#define HALMET_TEST_STUBS_SENSESP_NET_HTTP_SERVER_H_
+
+// SensESP's HTTP server, as in 3.x: handlers registered for a method mask
+// and a URI, which may end in a * wildcard. request() dispatches a request
+// that the test builds, as the server task would, on the calling thread.
+
+#include <Arduino.h>
+#include <esp_http_server.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace sensesp {
+
+class HTTPRequestHandler {
+ public:
+  HTTPRequestHandler(uint32_t method_mask, String match_uri,
+                     std::function<esp_err_t(httpd_req_t*)> handler_func)
+      : method_mask_{method_mask},
+        match_uri_{match_uri},
+        handler_func_{handler_func} {}
+
+  const uint32_t method_mask_;
+  const String match_uri_;
+
+  esp_err_t call(httpd_req_t* req) { return handler_func_(req); }
+
+  bool matches(int method, const String& uri) const {
+    if ((method_mask_ & (1 << method)) == 0) {
+      return false;
+    }
+    String path = uri.substring(0, static_cast<unsigned int>(
+                                       std::min(uri.find('?'), uri.size())));
+    if (match_uri_.endsWith("*")) {
+      return path.startsWith(match_uri_.substring(0, match_uri_.length() - 1));
+    }
+    return path == match_uri_;
+  }
+
+ protected:
+  std::function<esp_err_t(httpd_req_t*)> handler_func_;
+};
+
+class HTTPServer {
+ public:
+  void add_handler(std::shared_ptr<HTTPRequestHandler> handler) {
+    handlers_.push_back(handler);
+  }
+
+  /// Dispatch a request to the first matching handler. The response is
+  /// 404 if there is none.
+  esp_err_t handle(httpd_req_t* req) {
+    for (auto& handler : handlers_) {
+      if (handler->matches(req->method, req->uri)) {
+        return handler->call(req);
+      }
+    }
+    return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+  }
+
+  std::shared_ptr<fake::HttpResponse> request(
+      int method, const String& uri,
+      std::map<std::string, String> headers = {}, const String& content = "") {
+    httpd_req_t req;
+    req.method = method;
+    req.uri = uri;
+    req.headers = headers;
+    req.content = content;
+    handle(&req);
+    return req.response;
+  }
+
+ protected:
+  std::vector<std::shared_ptr<HTTPRequestHandler>> handlers_;
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_NET_HTTP_SERVER_H_
@@ -0,0 +1,79 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_SENSORS_DIGITAL_INPUT_H_
+#define HALMET_TEST_STUBS_SENSESP_SENSORS_DIGITAL_INPUT_H_
+
+// SensESP's digital inputs, as in 3.x, on the pins of Arduino.h: the
+// counter counts interrupts and emits the count every read_delay, and the
+// state input emits the pin level every read_delay.
+
+#include <Arduino.h>
+
+#include "sensesp.h"
+#include "sensesp/sensors/sensor.h"
+
+namespace sensesp {
+
+class DigitalInput {
+ public:
+  DigitalInput(uint8_t pin, int pin_mode) : pin_{pin} {
+    pinMode(pin, pin_mode);
+  }
+
+ protected:
+  uint8_t pin_;
+};
+
+class DigitalInputCounter : public DigitalInput, public SensorT<int> {
+ public:
+  DigitalInputCounter(uint8_t pin, int pin_mode, int interrupt_type,
+                      unsigned int read_delay, const String& config_path = "")
+      : DigitalInput(pin, pin_mode),
+        SensorT<int>(config_path),
+        interrupt_type_{interrupt_type},
+        read_delay_{read_delay} {
+    this->load();
+    attachInterrupt(digitalPinToInterrupt(pin_), [this]() { counter_++; },
+                    interrupt_type_);
+    event_loop()->onRepeat(read_delay_, [this]() {
+      this->emit(counter_);
+      counter_ = 0;
+    });
+  }
+
+  bool to_json(JsonObject& root) override {
+    root["read_delay"] = read_delay_;
+    return true;
+  }
+
+  bool from_json(const JsonObject& config) override {
+    if (!config["read_delay"].is<unsigned int>()) {
+      return false;
+    }
+    read_delay_ = config["read_delay"];
+    return true;
+  }
+
+ protected:
+  int interrupt_type_;
+  unsigned int read_delay_;
+  volatile unsigned int counter_ = 0;
+};
+
+class DigitalInputState : public DigitalInput, public SensorT<bool> {
+ public:
+  DigitalInputState(uint8_t pin, int pin_mode, int read_delay = 1000,
+                    const String& config_path = "")
+      : DigitalInput(pin, pin_mode),
+        SensorT<bool>(config_path),
+        read_delay_{read_delay} {
+    this->load();
+    event_loop()->onRepeat(read_delay_,
+                           [this]() { this->emit(digitalRead(pin_)); });
+  }
+
+ protected:
+  int read_delay_;
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_SENSORS_DIGITAL_INPUT_H_
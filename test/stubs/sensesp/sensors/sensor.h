@@ -0,0 +1,53 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_SENSORS_SENSOR_H_
+#define HALMET_TEST_STUBS_SENSESP_SENSORS_SENSOR_H_
+
+// SensESP's sensors, as in 3.x: producers with a saved configuration, and
+// RepeatSensor, which emits the return value of a callback every interval
+// of the event loop.
+
+#include <Arduino.h>
+
+#include <functional>
+
+#include "sensesp.h"
+#include "sensesp/system/saveable.h"
+#include "sensesp/system/valueproducer.h"
+
+namespace sensesp {
+
+class SensorConfig : public FileSystemSaveable {
+ public:
+  SensorConfig(const String& config_path) : FileSystemSaveable(config_path) {}
+};
+
+template <typename T>
+class SensorT : public SensorConfig, public ValueProducer<T> {
+ public:
+  SensorT(const String& config_path) : SensorConfig(config_path) {}
+};
+
+using FloatSensor = SensorT<float>;
+using IntSensor = SensorT<int>;
+using BoolSensor = SensorT<bool>;
+using StringSensor = SensorT<String>;
+
+template <typename T>
+class RepeatSensor : public SensorT<T> {
+ public:
+  RepeatSensor(unsigned int repeat_interval_ms,
+               std::function<T()> returning_callback)
+      : SensorT<T>(""),
+        repeat_interval_ms_{repeat_interval_ms},
+        returning_callback_{returning_callback} {
+    event_loop()->onRepeat(repeat_interval_ms_,
+                           [this]() { this->emit(returning_callback_()); });
+  }
+
+ protected:
+  unsigned int repeat_interval_ms_;
+  std::function<T()> returning_callback_;
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_SENSORS_SENSOR_H_
@@ -0,0 +1,89 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_SIGNALK_SIGNALK_OUTPUT_H_
+#define HALMET_TEST_STUBS_SENSESP_SIGNALK_SIGNALK_OUTPUT_H_
+
+// SensESP's Signal K outputs, as in 3.x: a transform that passes its input
+// on, with a Signal K path that is part of its configuration. Nothing is
+// sent; the tests read the output's value.
+
+#include <Arduino.h>
+
+#include "sensesp/transforms/transform.h"
+
+namespace sensesp {
+
+class SKMetadata {
+ public:
+  SKMetadata(const String& units = "", const String& display_name = "",
+             const String& description = "", const String& short_name = "",
+             float timeout = -1.0)
+      : units_{units},
+        display_name_{display_name},
+        description_{description},
+        short_name_{short_name},
+        timeout_{timeout} {}
+
+  String units_;
+  String display_name_;
+  String description_;
+  String short_name_;
+  float timeout_;
+};
+
+template <typename T>
+class SKOutput : public SymmetricTransform<T> {
+ public:
+  SKOutput(const String& sk_path = "", const String& config_path = "",
+           SKMetadata* meta = nullptr)
+      : SymmetricTransform<T>(config_path), sk_path_{sk_path}, meta_{meta} {
+    this->load();
+  }
+  SKOutput(const String& sk_path, SKMetadata* meta)
+      : SKOutput(sk_path, "", meta) {}
+
+  void set(const T& new_value) override { this->emit(new_value); }
+
+  const String& get_sk_path() const { return sk_path_; }
+  SKMetadata* get_metadata() const { return meta_; }
+
+  bool to_json(JsonObject& root) override {
+    root["sk_path"] = sk_path_;
+    return true;
+  }
+
+  bool from_json(const JsonObject& config) override {
+    if (!config["sk_path"].is<String>()) {
+      return false;
+    }
+    sk_path_ = config["sk_path"].as<String>();
+    return true;
+  }
+
+ protected:
+  String sk_path_;
+  SKMetadata* meta_;
+};
+
+template <typename T>
+const String ConfigSchema(const SKOutput<T>& obj) {
+  return R"({"type":"object","properties":{"sk_path":{"title":"Signal K Path","type":"string"}}})";
+}
+
+template <typename T>
+bool ConfigRequiresRestart(const SKOutput<T>& obj) {
+  return true;
+}
+
+using SKOutputFloat = SKOutput<float>;
+using SKOutputInt = SKOutput<int>;
+using SKOutputBool = SKOutput<bool>;
+using SKOutputString = SKOutput<String>;
+
+/// A JSON value passed on as it is
+class SKOutputRawJson : public SKOutput<String> {
+ public:
+  using SKOutput<String>::SKOutput;
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_SIGNALK_SIGNALK_OUTPUT_H_
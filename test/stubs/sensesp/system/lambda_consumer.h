@@ -0,0 +1,24 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_SYSTEM_LAMBDA_CONSUMER_H_
+#define HALMET_TEST_STUBS_SENSESP_SYSTEM_LAMBDA_CONSUMER_H_
+
+#include <functional>
+
+#include "sensesp/system/valueconsumer.h"
+
+namespace sensesp {
+
+template <typename T>
+class LambdaConsumer : public ValueConsumer<T> {
+ public:
+  LambdaConsumer(std::function<void(const T&)> function)
+      : function_{function} {}
+
+  void set(const T& value) override { function_(value); }
+
+ protected:
+  std::function<void(const T&)> function_;
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_SYSTEM_LAMBDA_CONSUMER_H_
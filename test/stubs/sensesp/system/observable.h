@@ -0,0 +1,30 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_SYSTEM_OBSERVABLE_H_
+#define HALMET_TEST_STUBS_SENSESP_SYSTEM_OBSERVABLE_H_
+
+// SensESP's Observable, as in 3.x: a list of observer callbacks that
+// notify() walks.
+
+#include <forward_list>
+#include <functional>
+
+namespace sensesp {
+
+class Observable {
+ public:
+  void notify() {
+    for (auto& observer : observers_) {
+      observer();
+    }
+  }
+
+  void attach(std::function<void()> observer) {
+    observers_.push_front(observer);
+  }
+
+ private:
+  std::forward_list<std::function<void()>> observers_;
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_SYSTEM_OBSERVABLE_H_
@@ -0,0 +1,20 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_SYSTEM_OBSERVABLEVALUE_H_
+#define HALMET_TEST_STUBS_SENSESP_SYSTEM_OBSERVABLEVALUE_H_
+
+#include "sensesp/system/valueconsumer.h"
+#include "sensesp/system/valueproducer.h"
+
+namespace sensesp {
+
+template <typename T>
+class ObservableValue : public ValueConsumer<T>, public ValueProducer<T> {
+ public:
+  ObservableValue() = default;
+  ObservableValue(const T& value) : ValueProducer<T>(value) {}
+
+  void set(const T& value) override { this->emit(value); }
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_SYSTEM_OBSERVABLEVALUE_H_
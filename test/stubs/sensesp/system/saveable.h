@@ -0,0 +1,125 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_SYSTEM_SAVEABLE_H_
+#define HALMET_TEST_STUBS_SENSESP_SYSTEM_SAVEABLE_H_
+
+// SensESP's Serializable, Saveable and FileSystemSaveable, as in 3.x. The
+// configuration files are kept in memory by fake::ConfigFiles, which counts
+// the reads and writes.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <map>
+#include <string>
+
+namespace fake {
+
+class ConfigFiles {
+ public:
+  static ConfigFiles* get() {
+    static ConfigFiles files;
+    return &files;
+  }
+
+  bool read(const String& path, String* json) {
+    reads_++;
+    auto it = files_.find(path);
+    if (it == files_.end()) {
+      return false;
+    }
+    *json = it->second;
+    return true;
+  }
+  void write(const String& path, const String& json) {
+    writes_++;
+    files_[path] = json;
+  }
+  bool exists(const String& path) const { return files_.count(path) > 0; }
+  void remove(const String& path) { files_.erase(path); }
+  void clear() {
+    files_.clear();
+    reset_counts();
+  }
+
+  unsigned get_reads() const { return reads_; }
+  unsigned get_writes() const { return writes_; }
+  void reset_counts() {
+    reads_ = 0;
+    writes_ = 0;
+  }
+
+ private:
+  std::map<std::string, String> files_;
+  unsigned reads_ = 0;
+  unsigned writes_ = 0;
+};
+
+}  // namespace fake
+
+namespace sensesp {
+
+class Serializable {
+ public:
+  virtual ~Serializable() = default;
+  virtual bool to_json(JsonObject& root) { return false; }
+  virtual bool from_json(const JsonObject& root) { return false; }
+};
+
+class Saveable {
+ public:
+  Saveable(const String& config_path) : config_path_{config_path} {}
+  virtual ~Saveable() = default;
+
+  virtual bool load() { return false; }
+  virtual bool save() { return false; }
+  virtual bool clear() { return false; }
+
+  const String& get_config_path() const { return config_path_; }
+  void set_config_path(const String& config_path) {
+    config_path_ = config_path;
+  }
+
+ protected:
+  String config_path_;
+};
+
+class FileSystemSaveable : public Saveable, virtual public Serializable {
+ public:
+  FileSystemSaveable(const String& config_path) : Saveable(config_path) {}
+
+  virtual bool load() override {
+    if (config_path_.isEmpty()) {
+      return false;
+    }
+    String json;
+    if (!fake::ConfigFiles::get()->read(config_path_, &json)) {
+      return false;
+    }
+    JsonDocument doc;
+    if (deserializeJson(doc, json) != DeserializationError::Ok) {
+      return false;
+    }
+    return from_json(doc.as<JsonObject>());
+  }
+
+  virtual bool save() override {
+    if (config_path_.isEmpty()) {
+      return false;
+    }
+    JsonDocument doc;
+    JsonObject obj = doc.to<JsonObject>();
+    to_json(obj);
+    String json;
+    serializeJson(doc, json);
+    fake::ConfigFiles::get()->write(config_path_, json);
+    return true;
+  }
+
+  virtual bool clear() override {
+    fake::ConfigFiles::get()->remove(config_path_);
+    return true;
+  }
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_SYSTEM_SAVEABLE_H_
@@ -0,0 +1,24 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_SYSTEM_VALUECONSUMER_H_
+#define HALMET_TEST_STUBS_SENSESP_SYSTEM_VALUECONSUMER_H_
+
+#include <Arduino.h>
+
+namespace sensesp {
+
+template <typename T>
+class ValueConsumer {
+ public:
+  using input_type = T;
+
+  virtual ~ValueConsumer() = default;
+  virtual void set(const T& new_value) {}
+};
+
+using FloatConsumer = ValueConsumer<float>;
+using IntConsumer = ValueConsumer<int>;
+using BoolConsumer = ValueConsumer<bool>;
+using StringConsumer = ValueConsumer<String>;
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_SYSTEM_VALUECONSUMER_H_
@@ -0,0 +1,55 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_SYSTEM_VALUEPRODUCER_H_
+#define HALMET_TEST_STUBS_SENSESP_SYSTEM_VALUEPRODUCER_H_
+
+// SensESP's ValueProducer, as in 3.x: emit() stores the value and notifies
+// the observers, and connect_to() adds an observer that calls the
+// consumer's virtual set().
+
+#include <Arduino.h>
+
+#include <memory>
+
+#include "sensesp/system/observable.h"
+#include "sensesp/system/valueconsumer.h"
+
+namespace sensesp {
+
+template <typename T>
+class ValueProducer : virtual public Observable {
+ public:
+  using output_type = T;
+
+  ValueProducer() = default;
+  ValueProducer(const T& initial_value) : output_{initial_value} {}
+  virtual ~ValueProducer() = default;
+
+  virtual const T& get() const { return output_; }
+
+  template <typename C>
+  C* connect_to(C* consumer) {
+    this->attach([this, consumer]() { consumer->set(this->get()); });
+    return consumer;
+  }
+  template <typename C>
+  std::shared_ptr<C> connect_to(std::shared_ptr<C> consumer) {
+    connect_to(consumer.get());
+    return consumer;
+  }
+
+  void emit(const T& new_value) {
+    output_ = new_value;
+    this->notify();
+  }
+
+ protected:
+  T output_ = {};
+};
+
+using FloatProducer = ValueProducer<float>;
+using IntProducer = ValueProducer<int>;
+using BoolProducer = ValueProducer<bool>;
+using StringProducer = ValueProducer<String>;
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_SYSTEM_VALUEPRODUCER_H_
@@ -0,0 +1,110 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_TRANSFORMS_CURVEINTERPOLATOR_H_
+#define HALMET_TEST_STUBS_SENSESP_TRANSFORMS_CURVEINTERPOLATOR_H_
+
+#include <set>
+
+#include "sensesp/transforms/transform.h"
+
+namespace sensesp {
+
+// SensESP's CurveInterpolator, with the interpolation of its set() and the
+// configuration as in 3.x
+class CurveInterpolator : public FloatTransform {
+ public:
+  class Sample {
+   public:
+    float input_;
+    float output_;
+
+    Sample(float input, float output) : input_{input}, output_{output} {}
+
+    friend bool operator<(const Sample& lhs, const Sample& rhs) {
+      return lhs.input_ < rhs.input_;
+    }
+  };
+
+  CurveInterpolator(std::set<Sample>* defaults = nullptr,
+                    const String& config_path = "")
+      : FloatTransform(config_path) {
+    if (defaults != nullptr) {
+      samples_ = *defaults;
+    }
+    this->load();
+  }
+
+  void set(const float& input) override {
+    float x0 = 0.0;
+    float y0 = 0.0;
+
+    auto it = samples_.begin();
+    while (it != samples_.end()) {
+      auto& sample = *it;
+      if (input > sample.input_) {
+        x0 = sample.input_;
+        y0 = sample.output_;
+      } else {
+        break;
+      }
+      it++;
+    }
+
+    if (it != samples_.end()) {
+      auto& max = *it;
+      float x1 = max.input_;
+      float y1 = max.output_;
+      this->output_ = (y0 * (x1 - input) + y1 * (input - x0)) / (x1 - x0);
+    } else {
+      this->output_ = 9999.9;
+    }
+    this->notify();
+  }
+
+  bool to_json(JsonObject& root) override {
+    JsonArray json_samples = root["samples"].to<JsonArray>();
+    for (auto& sample : samples_) {
+      JsonObject entry = json_samples.add<JsonObject>();
+      entry["input"] = sample.input_;
+      entry["output"] = sample.output_;
+    }
+    return true;
+  }
+
+  bool from_json(const JsonObject& config) override {
+    if (!config["samples"].is<JsonArray>()) {
+      return false;
+    }
+    samples_.clear();
+    for (JsonVariant json_sample : config["samples"].as<JsonArray>()) {
+      Sample sample(json_sample["input"].as<float>(),
+                    json_sample["output"].as<float>());
+      samples_.insert(sample);
+    }
+    return true;
+  }
+
+  CurveInterpolator* set_input_title(const String& title) {
+    input_title_ = title;
+    return this;
+  }
+  CurveInterpolator* set_output_title(const String& title) {
+    output_title_ = title;
+    return this;
+  }
+
+  void clear_samples() { samples_.clear(); }
+  void add_sample(const Sample& sample) { samples_.insert(sample); }
+  const std::set<Sample>& get_samples() const { return samples_; }
+
+ protected:
+  std::set<Sample> samples_;
+  String input_title_ = "Input";
+  String output_title_ = "Output";
+};
+
+inline const String ConfigSchema(const CurveInterpolator& obj) {
+  return R"({"type":"object","properties":{"samples":{"title":"Sample values","type":"array"}}})";
+}
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_TRANSFORMS_CURVEINTERPOLATOR_H_
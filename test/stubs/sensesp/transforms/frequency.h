@@ -0,0 +1,48 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_TRANSFORMS_FREQUENCY_H_
+#define HALMET_TEST_STUBS_SENSESP_TRANSFORMS_FREQUENCY_H_
+
+#include "sensesp/transforms/transform.h"
+
+namespace sensesp {
+
+// SensESP's Frequency, as in 3.x: counts per elapsed time, in Hz, times
+// the multiplier
+class Frequency : public Transform<int, float> {
+ public:
+  Frequency(float multiplier = 1.0, const String& config_path = "")
+      : Transform<int, float>(config_path), multiplier_{multiplier} {
+    this->load();
+  }
+
+  void set(const int& input) override {
+    unsigned long cur_millis = millis();
+    unsigned long elapsed_millis = cur_millis - last_update_;
+    last_update_ = cur_millis;
+    this->emit(multiplier_ * 1000. * input / elapsed_millis);
+  }
+
+  bool to_json(JsonObject& root) override {
+    root["multiplier"] = multiplier_;
+    return true;
+  }
+
+  bool from_json(const JsonObject& config) override {
+    if (!config["multiplier"].is<float>()) {
+      return false;
+    }
+    multiplier_ = config["multiplier"];
+    return true;
+  }
+
+ protected:
+  float multiplier_;
+  unsigned long last_update_ = 0;
+};
+
+inline const String ConfigSchema(const Frequency& obj) {
+  return R"({"type":"object","properties":{"multiplier":{"title":"Multiplier","type":"number"}}})";
+}
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_TRANSFORMS_FREQUENCY_H_
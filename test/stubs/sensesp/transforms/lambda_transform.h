@@ -0,0 +1,25 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_TRANSFORMS_LAMBDA_TRANSFORM_H_
+#define HALMET_TEST_STUBS_SENSESP_TRANSFORMS_LAMBDA_TRANSFORM_H_
+
+#include <functional>
+
+#include "sensesp/transforms/transform.h"
+
+namespace sensesp {
+
+template <typename IN, typename OUT>
+class LambdaTransform : public Transform<IN, OUT> {
+ public:
+  LambdaTransform(std::function<OUT(IN)> function,
+                  const String& config_path = "")
+      : Transform<IN, OUT>(config_path), function_{function} {}
+
+  void set(const IN& input) override { this->emit(function_(input)); }
+
+ protected:
+  std::function<OUT(IN)> function_;
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_TRANSFORMS_LAMBDA_TRANSFORM_H_
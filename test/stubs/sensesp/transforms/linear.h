@@ -0,0 +1,47 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_TRANSFORMS_LINEAR_H_
+#define HALMET_TEST_STUBS_SENSESP_TRANSFORMS_LINEAR_H_
+
+#include "sensesp/transforms/transform.h"
+
+namespace sensesp {
+
+class Linear : public FloatTransform {
+ public:
+  Linear(float multiplier, float offset, const String& config_path = "")
+      : FloatTransform(config_path),
+        multiplier_{multiplier},
+        offset_{offset} {
+    this->load();
+  }
+
+  void set(const float& input) override {
+    this->emit(multiplier_ * input + offset_);
+  }
+
+  bool to_json(JsonObject& root) override {
+    root["multiplier"] = multiplier_;
+    root["offset"] = offset_;
+    return true;
+  }
+
+  bool from_json(const JsonObject& config) override {
+    if (!config["multiplier"].is<float>() || !config["offset"].is<float>()) {
+      return false;
+    }
+    multiplier_ = config["multiplier"];
+    offset_ = config["offset"];
+    return true;
+  }
+
+ protected:
+  float multiplier_;
+  float offset_;
+};
+
+inline const String ConfigSchema(const Linear& obj) {
+  return R"({"type":"object","properties":{"multiplier":{"title":"Multiplier","type":"number"},"offset":{"title":"Constant offset","type":"number"}}})";
+}
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_TRANSFORMS_LINEAR_H_
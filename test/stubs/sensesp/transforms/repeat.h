@@ -0,0 +1,75 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_TRANSFORMS_REPEAT_H_
+#define HALMET_TEST_STUBS_SENSESP_TRANSFORMS_REPEAT_H_
+
+// SensESP's Repeat transforms, as in 3.x: the input is passed on and then
+// repeated every interval. RepeatExpiring emits an expired value once the
+// input is older than max_age: NaN for floating point types, a default
+// value otherwise.
+
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#include "sensesp.h"
+#include "sensesp/transforms/transform.h"
+
+namespace sensesp {
+
+template <typename T>
+T get_expired_value() {
+  if constexpr (std::is_floating_point<T>::value) {
+    return std::numeric_limits<T>::quiet_NaN();
+  } else {
+    return T{};
+  }
+}
+
+template <typename FROM, typename TO>
+class Repeat : public Transform<FROM, TO> {
+ public:
+  Repeat(unsigned long interval) : Transform<FROM, TO>(), interval_{interval} {
+    repeat_event_ = event_loop()->onRepeat(interval_, [this]() { repeat(); });
+  }
+
+  void set(const FROM& input) override {
+    this->emit(input);
+    // Restart the interval from this input
+    repeat_event_->remove(event_loop());
+    repeat_event_ = event_loop()->onRepeat(interval_, [this]() { repeat(); });
+  }
+
+ protected:
+  virtual void repeat() { this->notify(); }
+
+  unsigned long interval_;
+  reactesp::RepeatEvent* repeat_event_ = nullptr;
+};
+
+template <typename T>
+class RepeatExpiring : public Repeat<T, T> {
+ public:
+  RepeatExpiring(unsigned long interval, unsigned long max_age)
+      : Repeat<T, T>(interval), max_age_{max_age} {
+    this->output_ = get_expired_value<T>();
+  }
+
+  void set(const T& input) override {
+    last_update_ = millis();
+    Repeat<T, T>::set(input);
+  }
+
+ protected:
+  void repeat() override {
+    if (millis() - last_update_ > max_age_) {
+      this->output_ = get_expired_value<T>();
+    }
+    this->notify();
+  }
+
+  unsigned long max_age_;
+  unsigned long last_update_ = 0;
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_TRANSFORMS_REPEAT_H_
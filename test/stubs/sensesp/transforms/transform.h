@@ -0,0 +1,41 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_TRANSFORMS_TRANSFORM_H_
+#define HALMET_TEST_STUBS_SENSESP_TRANSFORMS_TRANSFORM_H_
+
+// SensESP's transforms, as in 3.x: a consumer and producer with a
+// configuration saved under its config path.
+
+#include <Arduino.h>
+
+#include "sensesp/system/saveable.h"
+#include "sensesp/system/valueconsumer.h"
+#include "sensesp/system/valueproducer.h"
+
+namespace sensesp {
+
+class TransformBase : public FileSystemSaveable {
+ public:
+  TransformBase(const String& config_path) : FileSystemSaveable(config_path) {}
+};
+
+template <typename C, typename P>
+class Transform : public TransformBase,
+                  public ValueConsumer<C>,
+                  public ValueProducer<P> {
+ public:
+  Transform(const String& config_path = "") : TransformBase(config_path) {}
+};
+
+template <typename T>
+class SymmetricTransform : public Transform<T, T> {
+ public:
+  SymmetricTransform(const String& config_path = "")
+      : Transform<T, T>(config_path) {}
+};
+
+using FloatTransform = SymmetricTransform<float>;
+using IntTransform = SymmetricTransform<int>;
+using BoolTransform = SymmetricTransform<bool>;
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_TRANSFORMS_TRANSFORM_H_
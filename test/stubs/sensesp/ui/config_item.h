@@ -0,0 +1,153 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_UI_CONFIG_ITEM_H_
+#define HALMET_TEST_STUBS_SENSESP_UI_CONFIG_ITEM_H_
+
+// SensESP's config items, as in 3.x: ConfigItem() registers an object for
+// the web UI by its config path, and the item gets the object's schema and
+// restart flag from ConfigSchema() and ConfigRequiresRestart(), found by
+// argument-dependent lookup.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sensesp/system/saveable.h"
+
+namespace sensesp {
+
+template <typename T>
+const String ConfigSchema(const T& obj) {
+  return "null";
+}
+
+template <typename T>
+bool ConfigRequiresRestart(const T& obj) {
+  return false;
+}
+
+class ConfigItemBase : public std::enable_shared_from_this<ConfigItemBase> {
+ public:
+  virtual ~ConfigItemBase() = default;
+
+  const String& get_title() const { return title_; }
+  const String& get_description() const { return description_; }
+  int get_sort_order() const { return sort_order_; }
+  bool requires_restart() const { return requires_restart_; }
+
+  virtual const String& get_config_path() const = 0;
+  virtual bool to_json(JsonObject& obj) = 0;
+  virtual bool from_json(const JsonObject& obj) = 0;
+  virtual String get_config_schema() const = 0;
+  virtual bool save() = 0;
+  virtual bool load() = 0;
+
+  static std::shared_ptr<ConfigItemBase> get_config_item(const String& path) {
+    auto it = registry().find(path);
+    return it == registry().end() ? nullptr : it->second;
+  }
+
+  /// All items, by sort order
+  static std::unique_ptr<std::vector<std::shared_ptr<ConfigItemBase>>>
+  get_config_items() {
+    auto items =
+        std::make_unique<std::vector<std::shared_ptr<ConfigItemBase>>>();
+    for (auto& entry : registry()) {
+      items->push_back(entry.second);
+    }
+    std::stable_sort(items->begin(), items->end(),
+                     [](const std::shared_ptr<ConfigItemBase>& a,
+                        const std::shared_ptr<ConfigItemBase>& b) {
+                       return a->get_sort_order() < b->get_sort_order();
+                     });
+    return items;
+  }
+
+  static void add_config_item(std::shared_ptr<ConfigItemBase> item) {
+    registry()[item->get_config_path()] = item;
+  }
+  static void clear_config_items() { registry().clear(); }
+
+ protected:
+  static std::map<std::string, std::shared_ptr<ConfigItemBase>>& registry() {
+    static std::map<std::string, std::shared_ptr<ConfigItemBase>> items;
+    return items;
+  }
+
+  String title_;
+  String description_;
+  int sort_order_ = 1000;
+  bool requires_restart_ = false;
+};
+
+template <typename T>
+class ConfigItemT : public ConfigItemBase {
+ public:
+  ConfigItemT(T* config_object) : config_object_{config_object} {
+    requires_restart_ = ConfigRequiresRestart(*config_object_);
+  }
+
+  std::shared_ptr<ConfigItemT<T>> set_title(const String& title) {
+    title_ = title;
+    return self();
+  }
+  std::shared_ptr<ConfigItemT<T>> set_description(const String& description) {
+    description_ = description;
+    return self();
+  }
+  std::shared_ptr<ConfigItemT<T>> set_sort_order(int sort_order) {
+    sort_order_ = sort_order;
+    return self();
+  }
+  std::shared_ptr<ConfigItemT<T>> set_requires_restart(bool requires_restart) {
+    requires_restart_ = requires_restart;
+    return self();
+  }
+
+  const String& get_config_path() const override {
+    return config_object_->get_config_path();
+  }
+  bool to_json(JsonObject& obj) override {
+    return config_object_->to_json(obj);
+  }
+  bool from_json(const JsonObject& obj) override {
+    return config_object_->from_json(obj);
+  }
+  String get_config_schema() const override {
+    return ConfigSchema(*config_object_);
+  }
+  bool save() override { return config_object_->save(); }
+  bool load() override { return config_object_->load(); }
+
+  T* get_config_object() { return config_object_; }
+
+ protected:
+  std::shared_ptr<ConfigItemT<T>> self() {
+    return std::static_pointer_cast<ConfigItemT<T>>(shared_from_this());
+  }
+
+  T* config_object_;
+};
+
+/// Register an object for the web UI. Objects without a config path are
+/// not listed.
+template <typename T>
+std::shared_ptr<ConfigItemT<T>> ConfigItem(T* config_object) {
+  auto item = std::make_shared<ConfigItemT<T>>(config_object);
+  if (!config_object->get_config_path().isEmpty()) {
+    ConfigItemBase::add_config_item(item);
+  }
+  return item;
+}
+
+template <typename T>
+std::shared_ptr<ConfigItemT<T>> ConfigItem(std::shared_ptr<T> config_object) {
+  return ConfigItem(config_object.get());
+}
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_UI_CONFIG_ITEM_H_
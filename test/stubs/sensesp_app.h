@@ -0,0 +1,40 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_APP_H_
+#define HALMET_TEST_STUBS_SENSESP_APP_H_
+
+// The application object with the parts of SensESPApp that HALMET uses:
+// the HTTP server and the count of deltas sent to the Signal K server.
+
+#include <memory>
+
+#include "sensesp/net/http_server.h"
+#include "sensesp/system/observablevalue.h"
+#include "sensesp_base_app.h"
+
+namespace sensesp {
+
+class WSClient {
+ public:
+  ValueProducer<int>& get_delta_tx_count_producer() {
+    return delta_tx_count_producer_;
+  }
+
+ protected:
+  ObservableValue<int> delta_tx_count_producer_;
+};
+
+class SensESPApp : public SensESPBaseApp {
+ public:
+  std::shared_ptr<HTTPServer> get_http_server() { return http_server_; }
+  std::shared_ptr<WSClient> get_ws_client() { return ws_client_; }
+
+ protected:
+  std::shared_ptr<HTTPServer> http_server_ = std::make_shared<HTTPServer>();
+  std::shared_ptr<WSClient> ws_client_ = std::make_shared<WSClient>();
+};
+
+inline std::shared_ptr<SensESPApp> sensesp_app =
+    std::make_shared<SensESPApp>();
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_APP_H_
@@ -0,0 +1,25 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_BASE_APP_H_
+#define HALMET_TEST_STUBS_SENSESP_BASE_APP_H_
+
+#include <Arduino.h>
+
+#include <memory>
+
+#include "sensesp.h"
+
+namespace sensesp {
+
+class SensESPBaseApp {
+ public:
+  virtual ~SensESPBaseApp() = default;
+
+  virtual const String get_hostname() { return hostname_; }
+  void set_hostname(const String& hostname) { hostname_ = hostname; }
+
+ protected:
+  String hostname_ = "halmet";
+};
+
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_BASE_APP_H_
@@ -0,0 +1,86 @@
+#ifndef HALMET_TEST_STUBS_SENSESP_ONEWIRE_ONEWIRE_TEMPERATURE_H_
+#define HALMET_TEST_STUBS_SENSESP_ONEWIRE_ONEWIRE_TEMPERATURE_H_
+
+// SensESP's 1-Wire temperature sensors, as in the sensesp_onewire library
+// for SensESP 3.x: a Dallas bus on a pin, and a sensor per device that
+// emits the temperature in kelvin every read_delay ms. Instead of
+// discovering devices, the bus hands them to the sensors in the order the
+// sensors are created; set_celsius() sets the temperature of a device, and
+// a device set to DEVICE_DISCONNECTED_C reads nothing, as a missing device.
+
+#include <Arduino.h>
+
+#include <vector>
+
+#include "sensesp.h"
+#include "sensesp/sensors/sensor.h"
+
+#define DEVICE_DISCONNECTED_C -127
+
+namespace sensesp {
+namespace onewire {
+
+class DallasTemperatureSensors {
+ public:
+  DallasTemperatureSensors(int pin) : pin_{pin} {}
+
+  /// Claim the next device, and return its index
+  int claim() {
+    celsius_.push_back(DEVICE_DISCONNECTED_C);
+    return celsius_.size() - 1;
+  }
+  float get_celsius(int device) const { return celsius_[device]; }
+
+  // Test hooks
+
+  void set_celsius(int device, float celsius) { celsius_[device] = celsius; }
+  int get_device_count() const { return celsius_.size(); }
+
+ protected:
+  int pin_;
+  std::vector<float> celsius_;
+};
+
+class OneWireTemperature : public FloatSensor {
+ public:
+  OneWireTemperature(DallasTemperatureSensors* dts, uint read_delay = 1000,
+                     String config_path = "")
+      : FloatSensor(config_path), dts_{dts}, read_delay_{read_delay} {
+    device_ = dts_->claim();
+    load();
+    event_loop()->onRepeat(read_delay_, [this]() {
+      float celsius = dts_->get_celsius(device_);
+      if (celsius != DEVICE_DISCONNECTED_C) {
+        this->emit(celsius + 273.15f);
+      }
+    });
+  }
+
+  virtual bool to_json(JsonObject& root) override {
+    root["address"] = address_;
+    return true;
+  }
+  virtual bool from_json(const JsonObject& config) override {
+    address_ = config["address"] | "";
+    return true;
+  }
+
+ protected:
+  DallasTemperatureSensors* dts_;
+  uint read_delay_;
+  int device_;
+  String address_;
+};
+
+inline const String ConfigSchema(const OneWireTemperature& obj) {
+  return R"({"type":"object","properties":{"address":{"title":"OneWire address","type":"string"}}})";
+}
+
+inline bool ConfigRequiresRestart(const OneWireTemperature& obj) {
+  return true;
+}
+
+}  // namespace onewire
+}  // namespace sensesp
+
+#endif  // HALMET_TEST_STUBS_SENSESP_ONEWIRE_ONEWIRE_TEMPERATURE_H_
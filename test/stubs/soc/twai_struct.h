@@ -0,0 +1,29 @@
+#ifndef HALMET_TEST_STUBS_SOC_TWAI_STRUCT_H_
+#define HALMET_TEST_STUBS_SOC_TWAI_STRUCT_H_
+
+// The TWAI (CAN) controller registers that HALMET reads and writes, as
+// plain memory that the tests can set
+
+#include <cstdint>
+
+typedef struct {
+  union {
+    uint32_t val;
+  } mode_reg;
+  union {
+    uint32_t val;
+  } cmd_reg;
+  union {
+    uint32_t val;
+  } status_reg;
+  union {
+    uint32_t val;
+  } rx_error_counter_reg;
+  union {
+    uint32_t val;
+  } tx_error_counter_reg;
+} twai_dev_t;
+
+inline twai_dev_t TWAI = {};
+
+#endif  // HALMET_TEST_STUBS_SOC_TWAI_STRUCT_H_
@@ -0,0 +1,177 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+
+#include "alarm_rules.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp/system/observablevalue.h"
+
+using namespace halmet;
+
+// AlarmRule::set() on the simulated clock: hysteresis, delay-on, the RPM
+// breakpoint and hold-off, and its cost per sample.
+
+sensesp::ObservableValue<float>* revolutions;
+
+void SetRpm(float rpm) { revolutions->set(rpm / 60); }
+
+void setUp() {
+  fake::Clock::get()->set_us(1000000);
+  revolutions = new sensesp::ObservableValue<float>(0);
+}
+
+void tearDown() {}
+
+void test_hysteresis() {
+  AlarmRule rule(AlarmRule::Direction::kHigh, 100, 5, 0);
+  rule.set(99);
+  TEST_ASSERT_FALSE(rule.is_active());
+  rule.set(101);
+  TEST_ASSERT_TRUE(rule.is_active());
+  // Back below the threshold, but not by the hysteresis
+  rule.set(97);
+  TEST_ASSERT_TRUE(rule.is_active());
+  rule.set(94);
+  TEST_ASSERT_FALSE(rule.is_active());
+  rule.set(97);
+  TEST_ASSERT_FALSE(rule.is_active());
+}
+
+void test_delay_on() {
+  AlarmRule rule(AlarmRule::Direction::kLow, 100000, 20000, 5);
+  rule.set(50000);
+  TEST_ASSERT_FALSE(rule.is_active());
+  fake::Clock::get()->advance_ms(4900);
+  rule.set(50000);
+  TEST_ASSERT_FALSE(rule.is_active());
+  fake::Clock::get()->advance_ms(100);
+  rule.set(50000);
+  TEST_ASSERT_TRUE(rule.is_active());
+}
+
+// A value that comes back within the delay starts the delay over
+void test_delay_restarts() {
+  AlarmRule rule(AlarmRule::Direction::kLow, 100000, 20000, 5);
+  rule.set(50000);
+  fake::Clock::get()->advance_ms(4000);
+  rule.set(150000);
+  fake::Clock::get()->advance_ms(500);
+  rule.set(50000);
+  fake::Clock::get()->advance_ms(4900);
+  rule.set(50000);
+  TEST_ASSERT_FALSE(rule.is_active());
+  fake::Clock::get()->advance_ms(100);
+  rule.set(50000);
+  TEST_ASSERT_TRUE(rule.is_active());
+}
+
+// Oil pressure: 1 bar minimum at idle, 2 bar from 1500 rpm, off below
+// 400 rpm
+void test_rpm_breakpoint() {
+  AlarmRule rule(AlarmRule::Direction::kLow, 100000, 20000, 0);
+  rule.set_rpm_condition(revolutions, 400, 1500, 200000);
+
+  SetRpm(1000);
+  rule.set(150000);
+  TEST_ASSERT_FALSE(rule.is_active());
+  SetRpm(1500);
+  rule.set(150000);
+  TEST_ASSERT_TRUE(rule.is_active());
+  // Clears with the hysteresis of the threshold at the breakpoint
+  rule.set(210000);
+  TEST_ASSERT_TRUE(rule.is_active());
+  rule.set(225000);
+  TEST_ASSERT_FALSE(rule.is_active());
+}
+
+void test_hold_off() {
+  AlarmRule rule(AlarmRule::Direction::kLow, 100000, 20000, 2);
+  rule.set_rpm_condition(revolutions, 400, 1500, 200000);
+
+  // Engine stopped, no pressure
+  SetRpm(0);
+  for (int i = 0; i < 10; i++) {
+    rule.set(0);
+    fake::Clock::get()->advance_ms(1000);
+  }
+  TEST_ASSERT_FALSE(rule.is_active());
+
+  // The delay starts with the engine
+  SetRpm(800);
+  rule.set(0);
+  TEST_ASSERT_FALSE(rule.is_active());
+  fake::Clock::get()->advance_ms(2000);
+  rule.set(0);
+  TEST_ASSERT_TRUE(rule.is_active());
+
+  // And the alarm clears when it stops
+  SetRpm(300);
+  rule.set(0);
+  TEST_ASSERT_FALSE(rule.is_active());
+}
+
+// Every sample is passed on, to keep expiring outputs alive
+void test_emits_every_sample() {
+  AlarmRule rule(AlarmRule::Direction::kHigh, 100, 5, 0);
+  int emitted = 0;
+  rule.connect_to(
+      new sensesp::LambdaConsumer<bool>([&emitted](bool) { emitted++; }));
+  for (int i = 0; i < 10; i++) {
+    rule.set(90);
+  }
+  rule.set(NAN);
+  TEST_ASSERT_EQUAL(10, emitted);
+}
+
+void test_config_recompiles() {
+  AlarmRule rule(AlarmRule::Direction::kHigh, 100, 5, 0);
+  JsonDocument doc;
+  JsonObject config = doc.to<JsonObject>();
+  config["threshold"] = 80.0f;
+  config["hysteresis"] = 2.0f;
+  config["delay_on"] = 0.0f;
+  TEST_ASSERT_TRUE(rule.from_json(config));
+  rule.set(81);
+  TEST_ASSERT_TRUE(rule.is_active());
+  rule.set(79);
+  TEST_ASSERT_TRUE(rule.is_active());
+  rule.set(77);
+  TEST_ASSERT_FALSE(rule.is_active());
+}
+
+// Nanoseconds per sample of a rule with an RPM condition, alternating
+// between the speed ranges and both sides of the thresholds
+void benchmark_set() {
+  AlarmRule rule(AlarmRule::Direction::kLow, 100000, 20000, 1);
+  rule.set_rpm_condition(revolutions, 400, 1500, 200000);
+  const int kSamples = 1000000;
+  const float kValues[] = {50000, 150000, 250000, 90000};
+  const float kRpms[] = {300, 1000, 2000, 1600};
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kSamples; i++) {
+    if (i % 64 == 0) {
+      SetRpm(kRpms[(i / 64) % 4]);
+    }
+    rule.set(kValues[i % 4]);
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  char message[64];
+  snprintf(message, sizeof(message), "%.1f ns per sample",
+           elapsed.count() / kSamples);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_hysteresis);
+  RUN_TEST(test_delay_on);
+  RUN_TEST(test_delay_restarts);
+  RUN_TEST(test_rpm_breakpoint);
+  RUN_TEST(test_hold_off);
+  RUN_TEST(test_emits_every_sample);
+  RUN_TEST(test_config_recompiles);
+  RUN_TEST(benchmark_set);
+  return UNITY_END();
+}
@@ -0,0 +1,308 @@
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unity.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "can_gateway.h"
+#include "power_manager.h"
+
+using namespace halmet;
+
+// Frames replayed through the gateway's filter, ring and formats, and read
+// back from the other end of its TCP client's socket or from its UDP
+// datagrams. The ring is drained by calling drain() directly, as the
+// power manager's repeat would every 5 ms.
+
+class TestCanGateway : public CanGateway {
+ public:
+  using CanGateway::CanGateway;
+  using CanGateway::Frame;
+  using CanGateway::accept;
+  using CanGateway::drain;
+  using CanGateway::format;
+  using CanGateway::kRingSize;
+
+  WiFiServer* server() { return server_; }
+  WiFiUDP* udp_socket() { return udp_socket_; }
+  uint32_t frames() const { return frames_; }
+  uint32_t filtered() const { return filtered_; }
+  uint32_t sent() const { return sent_; }
+  uint32_t dropped() const { return dropped_; }
+};
+
+PowerManager* power_manager;
+
+TestCanGateway* StartGateway(const String& path, const char* config) {
+  fake::ConfigFiles::get()->write(path, config);
+  auto gateway = new TestCanGateway(path);
+  gateway->start(power_manager);
+  return gateway;
+}
+
+// A frame of PGN 127488 from source 0x23, numbered in its first two bytes
+void SendNumbered(TestCanGateway* gateway, uint16_t number) {
+  uint8_t data[8] = {static_cast<uint8_t>(number & 0xff),
+                     static_cast<uint8_t>(number >> 8), 3, 4, 5, 6, 7, 8};
+  gateway->frame(0x09F20023, 8, data, false);
+}
+
+// Everything the gateway has written to the test's end of the socket
+std::string ReadAvailable(int fd) {
+  std::string received;
+  char chunk[4096];
+  ssize_t length;
+  while ((length = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT)) > 0) {
+    received.append(chunk, length);
+  }
+  return received;
+}
+
+// The CRLF terminated lines of text, and any unterminated rest
+std::vector<std::string> SplitLines(const std::string& text) {
+  std::vector<std::string> lines;
+  size_t start = 0;
+  size_t end;
+  while ((end = text.find("\r\n", start)) != std::string::npos) {
+    lines.push_back(text.substr(start, end - start));
+    start = end + 2;
+  }
+  if (start < text.length()) {
+    lines.push_back(text.substr(start));
+  }
+  return lines;
+}
+
+uint32_t HostTimeOfDayMs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (tv.tv_sec % 86400) * 1000 + tv.tv_usec / 1000;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_ydraw_format() {
+  auto gateway = StartGateway("/Gateway/ydraw", R"({"enabled":true})");
+  TestCanGateway::Frame frame = {
+      13 * 3600000 + 5 * 60000 + 7 * 1000 + 89, 0x19F51323, 3, false,
+      {0x01, 0xAB, 0xFF}};
+  char buffer[64];
+  size_t length = gateway->format(frame, buffer);
+  TEST_ASSERT_EQUAL_STRING("13:05:07.089 R 19F51323 01 AB FF\r\n",
+                           std::string(buffer, length).c_str());
+
+  frame = {0, 0x0DF01000, 8, true, {0, 1, 2, 3, 4, 5, 6, 7}};
+  length = gateway->format(frame, buffer);
+  TEST_ASSERT_EQUAL_STRING(
+      "00:00:00.000 T 0DF01000 00 01 02 03 04 05 06 07\r\n",
+      std::string(buffer, length).c_str());
+}
+
+// struct can_frame: the id with CAN_EFF_FLAG, the length, three bytes of
+// padding and the data padded to eight bytes
+void test_binary_format() {
+  auto gateway =
+      StartGateway("/Gateway/binary", R"({"enabled":true,"format":"binary"})");
+  TestCanGateway::Frame frame = {1000, 0x19F51323, 3, false, {1, 2, 3}};
+  uint8_t buffer[16];
+  memset(buffer, 0xee, sizeof(buffer));
+  TEST_ASSERT_EQUAL(16,
+                    gateway->format(frame, reinterpret_cast<char*>(buffer)));
+  uint32_t can_id;
+  memcpy(&can_id, buffer, 4);
+  TEST_ASSERT_EQUAL_UINT32(0x99F51323, can_id);
+  const uint8_t expected[12] = {3, 0, 0, 0, 1, 2, 3, 0, 0, 0, 0, 0};
+  for (int i = 0; i < 12; i++) {
+    TEST_ASSERT_EQUAL_UINT8(expected[i], buffer[4 + i]);
+  }
+}
+
+// PDU1 PGNs match whatever their destination, and filtered frames are
+// counted and not queued
+void test_filters() {
+  auto gateway = StartGateway(
+      "/Gateway/filters",
+      R"({"enabled":true,"pgns":[127488,59904],"sources":[35]})");
+  TEST_ASSERT_TRUE(gateway->accept(0x09F20023));   // 127488 from 0x23
+  TEST_ASSERT_TRUE(gateway->accept(0x18EAFF23));   // 59904 to all
+  TEST_ASSERT_TRUE(gateway->accept(0x18EA1523));   // 59904 to 0x15
+  TEST_ASSERT_FALSE(gateway->accept(0x09F20024));  // Another source
+  TEST_ASSERT_FALSE(gateway->accept(0x09F20123));  // 127489
+
+  uint8_t data[8] = {};
+  gateway->frame(0x09F20023, 8, data, false);
+  gateway->frame(0x09F20024, 8, data, false);
+  gateway->frame(0x09F20123, 8, data, false);
+  gateway->frame(0x18EA1523, 3, data, true);
+  TEST_ASSERT_EQUAL(4, gateway->frames());
+  TEST_ASSERT_EQUAL(2, gateway->filtered());
+  TEST_ASSERT_EQUAL(0, gateway->dropped());
+}
+
+// Frames come out of the client's socket in order, stamped with the time of
+// day of the host clock
+void test_tcp_stream() {
+  auto gateway = StartGateway("/Gateway/tcp", R"({"enabled":true})");
+  int fd = gateway->server()->connect();
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  gateway->drain();
+
+  const int kFrames = 100;
+  uint32_t before_ms = HostTimeOfDayMs();
+  for (int i = 0; i < kFrames; i++) {
+    SendNumbered(gateway, i);
+    if (i % 10 == 9) {
+      gateway->drain();
+    }
+  }
+  std::vector<std::string> lines = SplitLines(ReadAvailable(fd));
+  TEST_ASSERT_EQUAL(kFrames, lines.size());
+  TEST_ASSERT_EQUAL(kFrames, gateway->sent());
+
+  for (int i = 0; i < kFrames; i++) {
+    unsigned int hours, minutes, seconds, ms, id, byte0, byte1;
+    char direction;
+    TEST_ASSERT_EQUAL(8, sscanf(lines[i].c_str(),
+                                "%2u:%2u:%2u.%3u %c %8x %2x %2x", &hours,
+                                &minutes, &seconds, &ms, &direction, &id,
+                                &byte0, &byte1));
+    TEST_ASSERT_EQUAL('R', direction);
+    TEST_ASSERT_EQUAL_UINT32(0x09F20023, id);
+    TEST_ASSERT_EQUAL(i, byte0 | byte1 << 8);
+    uint32_t line_ms = ((hours * 60 + minutes) * 60 + seconds) * 1000 + ms;
+    // Within a second, across midnight
+    TEST_ASSERT_LESS_THAN(1000,
+                          (line_ms - before_ms + 86400000) % 86400000);
+  }
+  close(fd);
+}
+
+// The frame numbers of the received YDRAW lines
+std::vector<int> FrameNumbers(const std::string& received) {
+  std::vector<int> numbers;
+  for (const std::string& line : SplitLines(received)) {
+    unsigned int byte0 = 0, byte1 = 0;
+    sscanf(line.c_str() + 24, "%2x %2x", &byte0, &byte1);
+    numbers.push_back(byte0 | byte1 << 8);
+  }
+  return numbers;
+}
+
+// A client that doesn't read fills its socket, then the ring; the newer
+// frames that don't fit are dropped and counted. Once the client reads
+// again, it gets the older frames without a gap, then the new ones.
+void test_slow_client_drops() {
+  auto gateway = StartGateway("/Gateway/slow", R"({"enabled":true})");
+  int fd = gateway->server()->connect(4096);
+  gateway->drain();
+
+  const int kFrames = 2000;
+  for (int i = 0; i < kFrames; i++) {
+    SendNumbered(gateway, i);
+    if (i % 50 == 49) {
+      gateway->drain();
+    }
+  }
+  TEST_ASSERT_EQUAL(kFrames, gateway->frames());
+  TEST_ASSERT_GREATER_THAN(0, gateway->dropped());
+  TEST_ASSERT_LESS_THAN(kFrames, gateway->dropped());
+  uint32_t kept = kFrames - gateway->dropped();
+
+  std::string received;
+  for (int i = 0; i < 100; i++) {
+    received += ReadAvailable(fd);
+    gateway->drain();
+  }
+  std::vector<int> numbers = FrameNumbers(received);
+  TEST_ASSERT_EQUAL(kept, numbers.size());
+  TEST_ASSERT_EQUAL(kept, gateway->sent());
+  for (size_t i = 0; i < numbers.size(); i++) {
+    TEST_ASSERT_EQUAL(static_cast<int>(i), numbers[i]);
+  }
+
+  // Streaming again
+  for (int i = kFrames; i < kFrames + 10; i++) {
+    SendNumbered(gateway, i);
+  }
+  gateway->drain();
+  numbers = FrameNumbers(ReadAvailable(fd));
+  TEST_ASSERT_EQUAL(10, numbers.size());
+  TEST_ASSERT_EQUAL(kFrames, numbers[0]);
+  TEST_ASSERT_EQUAL(kFrames - kept, gateway->dropped());
+
+  char message[80];
+  snprintf(message, sizeof(message),
+           "%u of %d frames dropped behind a full 4 KiB socket",
+           gateway->dropped(), kFrames);
+  TEST_MESSAGE(message);
+  close(fd);
+}
+
+// Without a client the ring is discarded instead of filling up
+void test_no_client_no_drops() {
+  auto gateway = StartGateway("/Gateway/idle", R"({"enabled":true})");
+  for (int i = 0; i < 4 * TestCanGateway::kRingSize; i++) {
+    SendNumbered(gateway, i);
+    if (i % 50 == 49) {
+      gateway->drain();
+    }
+  }
+  TEST_ASSERT_EQUAL(0, gateway->dropped());
+  TEST_ASSERT_EQUAL(0, gateway->sent());
+}
+
+// Datagrams of whole frames to the configured host, up to the buffer size
+void test_udp_binary() {
+  auto gateway = StartGateway(
+      "/Gateway/udp",
+      R"({"enabled":true,"protocol":"udp","udp_host":"192.168.1.255",)"
+      R"("port":2000,"format":"binary"})");
+  const int kFrames = 200;
+  for (int i = 0; i < kFrames; i++) {
+    SendNumbered(gateway, i);
+  }
+  gateway->drain();
+
+  const std::vector<WiFiUDP::Packet>& packets =
+      gateway->udp_socket()->get_packets();
+  TEST_ASSERT_GREATER_THAN(1, packets.size());
+  std::string stream;
+  for (const WiFiUDP::Packet& packet : packets) {
+    TEST_ASSERT_TRUE(packet.host == "192.168.1.255");
+    TEST_ASSERT_EQUAL(2000, packet.port);
+    TEST_ASSERT_EQUAL(0, packet.data.length() % 16);
+    TEST_ASSERT_LESS_OR_EQUAL(1400, packet.data.length());
+    stream += packet.data;
+  }
+  TEST_ASSERT_EQUAL(kFrames * 16, stream.length());
+  for (int i = 0; i < kFrames; i++) {
+    const uint8_t* frame =
+        reinterpret_cast<const uint8_t*>(stream.data()) + i * 16;
+    uint32_t can_id;
+    memcpy(&can_id, frame, 4);
+    TEST_ASSERT_EQUAL_UINT32(0x89F20023, can_id);
+    TEST_ASSERT_EQUAL(8, frame[4]);
+    TEST_ASSERT_EQUAL(i, frame[8] | frame[9] << 8);
+  }
+  TEST_ASSERT_EQUAL(kFrames, gateway->sent());
+}
+
+int main(int argc, char** argv) {
+  fake::Clock::get()->set_us(1000000);
+  power_manager = new PowerManager("/Power");
+
+  UNITY_BEGIN();
+  RUN_TEST(test_ydraw_format);
+  RUN_TEST(test_binary_format);
+  RUN_TEST(test_filters);
+  RUN_TEST(test_tcp_stream);
+  RUN_TEST(test_slow_client_drops);
+  RUN_TEST(test_no_client_no_drops);
+  RUN_TEST(test_udp_binary);
+  return UNITY_END();
+}
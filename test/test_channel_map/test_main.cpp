@@ -0,0 +1,114 @@
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "channel_map.h"
+#include "halmet_const.h"
+
+using namespace halmet;
+using namespace sensesp;
+
+// Channel maps that check() must reject, each a change of the default map,
+// which it accepts.
+
+ChannelMap* channel_map;
+JsonDocument doc;
+
+// The default map, to change before applying it
+JsonObject DefaultConfig() {
+  ChannelMap defaults("");
+  JsonObject config = doc.to<JsonObject>();
+  defaults.to_json(config);
+  return config;
+}
+
+JsonObject FirstEngine(JsonObject config) {
+  for (JsonObject engine : config["engines"].as<JsonArray>()) {
+    return engine;
+  }
+  return JsonObject();
+}
+
+JsonObject AddEngine(JsonObject config, const char* id, int tacho_pin) {
+  JsonObject engine = config["engines"].add<JsonObject>();
+  engine["id"] = id;
+  engine["tacho_pin"] = tacho_pin;
+  return engine;
+}
+
+JsonObject AddTank(JsonObject config, const char* name, const char* sk_id,
+                   int input) {
+  JsonObject tank = config["tanks"].add<JsonObject>();
+  tank["name"] = name;
+  tank["sk_id"] = sk_id;
+  tank["input"] = input;
+  return tank;
+}
+
+void setUp() { channel_map = new ChannelMap(""); }
+
+void tearDown() { delete channel_map; }
+
+void test_default_accepted() {
+  JsonObject config = DefaultConfig();
+  TEST_ASSERT_TRUE(channel_map->from_json(config));
+  AddEngine(config, "2", kDigitalInputPin4);
+  AddTank(config, "Water", "freshWater.main", -1);
+  TEST_ASSERT_TRUE(channel_map->from_json(config));
+  TEST_ASSERT_EQUAL(2, channel_map->engines.size());
+  TEST_ASSERT_EQUAL(2, channel_map->tanks.size());
+}
+
+void test_engine_id_required() {
+  JsonObject config = DefaultConfig();
+  FirstEngine(config).remove("id");
+  TEST_ASSERT_FALSE(channel_map->from_json(config));
+
+  config = DefaultConfig();
+  FirstEngine(config)["id"] = "";
+  TEST_ASSERT_FALSE(channel_map->from_json(config));
+}
+
+void test_duplicate_engine_id_rejected() {
+  JsonObject config = DefaultConfig();
+  AddEngine(config, "1", kDigitalInputPin4);
+  TEST_ASSERT_FALSE(channel_map->from_json(config));
+  // The current map stays
+  TEST_ASSERT_EQUAL(1, channel_map->engines.size());
+}
+
+void test_duplicate_tank_rejected() {
+  JsonObject config = DefaultConfig();
+  AddTank(config, "Fuel", "fuel.reserve", -1);
+  TEST_ASSERT_FALSE(channel_map->from_json(config));
+
+  config = DefaultConfig();
+  AddTank(config, "Reserve", "fuel.main", -1);
+  TEST_ASSERT_FALSE(channel_map->from_json(config));
+}
+
+void test_reserved_tacho_pins_rejected() {
+  const int kReserved[] = {kDigitalInputPin2, kDigitalInputPin3, kSDAPin,
+                           kSCLPin, kCANRxPin, kCANTxPin};
+  for (int pin : kReserved) {
+    JsonObject config = DefaultConfig();
+    AddEngine(config, "2", pin);
+    TEST_ASSERT_FALSE(channel_map->from_json(config));
+  }
+}
+
+void test_shared_tacho_pin_rejected() {
+  JsonObject config = DefaultConfig();
+  AddEngine(config, "2", kDigitalInputPin1);
+  TEST_ASSERT_FALSE(channel_map->from_json(config));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_default_accepted);
+  RUN_TEST(test_engine_id_required);
+  RUN_TEST(test_duplicate_engine_id_rejected);
+  RUN_TEST(test_duplicate_tank_rejected);
+  RUN_TEST(test_reserved_tacho_pins_rejected);
+  RUN_TEST(test_shared_tacho_pin_rejected);
+  return UNITY_END();
+}
@@ -0,0 +1,82 @@
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <cstring>
+
+#include "config_cache.h"
+#include "halmet_analog.h"
+#include "sensesp/transforms/linear.h"
+#include "sensesp/ui/config_item.h"
+
+using namespace halmet;
+
+// The config document follows every configuration change, whether or not
+// the change was saved through the config store: an edit of a LiveTransform
+// and of a SensESP transform that HALMET doesn't wrap.
+
+class TestConfigCache : public ConfigCache {
+ public:
+  using ConfigCache::update;
+  const String& document() const { return document_; }
+  String etag() const { return etag_; }
+};
+
+TestConfigCache* cache;
+LiveLinear* live_linear;
+sensesp::Linear* linear;
+
+bool SetConfig(sensesp::ConfigItemBase* item, float multiplier) {
+  JsonDocument doc;
+  JsonObject config = doc.to<JsonObject>();
+  config["multiplier"] = multiplier;
+  config["offset"] = 0.0f;
+  // As the web UI does
+  return item->from_json(config) && item->save();
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_unchanged_keeps_etag() {
+  TEST_ASSERT_TRUE(cache->update());
+  String etag = cache->etag();
+  TEST_ASSERT_FALSE(cache->update());
+  TEST_ASSERT_TRUE(etag == cache->etag());
+}
+
+void test_live_transform_change() {
+  cache->update();
+  String etag = cache->etag();
+  auto item = sensesp::ConfigItemBase::get_config_item("/Live/linear");
+  TEST_ASSERT_TRUE(SetConfig(item.get(), 2.5));
+
+  TEST_ASSERT_TRUE(cache->update());
+  TEST_ASSERT_FALSE(etag == cache->etag());
+  TEST_ASSERT_TRUE(cache->document().indexOf("\"multiplier\":2.5") >= 0);
+}
+
+void test_sensesp_transform_change() {
+  cache->update();
+  String etag = cache->etag();
+  auto item = sensesp::ConfigItemBase::get_config_item("/Plain/linear");
+  TEST_ASSERT_TRUE(SetConfig(item.get(), 4));
+
+  TEST_ASSERT_TRUE(cache->update());
+  TEST_ASSERT_FALSE(etag == cache->etag());
+  TEST_ASSERT_TRUE(cache->document().indexOf("\"multiplier\":4") >= 0);
+}
+
+int main(int argc, char** argv) {
+  live_linear = new LiveLinear(1.0, 0.0, ConfigPath("/Live/linear"));
+  ConfigItem(live_linear)->set_title("Live");
+  linear = new sensesp::Linear(1.0, 0.0, "/Plain/linear");
+  ConfigItem(linear)->set_title("Plain");
+  cache = new TestConfigCache();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_unchanged_keeps_etag);
+  RUN_TEST(test_live_transform_change);
+  RUN_TEST(test_sensesp_transform_change);
+  return UNITY_END();
+}
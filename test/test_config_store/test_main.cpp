@@ -0,0 +1,184 @@
+#include <esp_partition.h>
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+
+#include "config_store.h"
+#include "sensesp/transforms/linear.h"
+
+using namespace halmet;
+
+// Stored<T> nodes load their configuration once, and the config store
+// indexes its journal as it writes it. Runs with and without
+// HALMET_CONFIG_STORE.
+
+const char kPartition[] = "halmetcfg";
+
+void WriteConfig(const String& path, float multiplier) {
+  char json[64];
+  snprintf(json, sizeof(json), "{\"multiplier\":%g,\"offset\":1}", multiplier);
+  fake::ConfigFiles::get()->write(path, json);
+}
+
+// The output of a Linear node for an input of 1
+float Output(sensesp::Linear* linear) {
+  linear->set(1);
+  return linear->get();
+}
+
+String StoredJson(const String& path) {
+  const char* json;
+  size_t length;
+  if (!ConfigStore::get()->find(path, &json, &length)) {
+    return "";
+  }
+  return String(std::string(json, length));
+}
+
+void setUp() {
+  fake::ConfigFiles::get()->clear();
+  fake::Partitions::get()->add(kPartition, 64 * 1024);
+  ConfigStore::get()->begin(kPartition);
+}
+
+void tearDown() {}
+
+// One file read per node, and none once the node is in the store
+void test_single_load() {
+  WriteConfig("/Node/linear", 3);
+  fake::ConfigFiles::get()->reset_counts();
+  auto first =
+      new Stored<sensesp::Linear>(1.0, 0.0, ConfigPath("/Node/linear"));
+  TEST_ASSERT_EQUAL(1, fake::ConfigFiles::get()->get_reads());
+  TEST_ASSERT_EQUAL_FLOAT(4, Output(first));
+  TEST_ASSERT_TRUE(first->get_config_path() == "/Node/linear");
+
+  // After a reboot
+  ConfigStore::get()->begin(kPartition);
+  fake::ConfigFiles::get()->reset_counts();
+  auto second =
+      new Stored<sensesp::Linear>(1.0, 0.0, ConfigPath("/Node/linear"));
+  TEST_ASSERT_EQUAL_FLOAT(4, Output(second));
+#ifdef HALMET_CONFIG_STORE
+  TEST_ASSERT_EQUAL(0, fake::ConfigFiles::get()->get_reads());
+#else
+  TEST_ASSERT_EQUAL(1, fake::ConfigFiles::get()->get_reads());
+#endif
+}
+
+// A node whose path is passed directly loads in its own constructor
+void test_direct_path() {
+  WriteConfig("/Direct/linear", 2);
+  fake::ConfigFiles::get()->reset_counts();
+  auto node = new Stored<sensesp::Linear>(1.0, 0.0, "/Direct/linear");
+  TEST_ASSERT_EQUAL_FLOAT(3, Output(node));
+#ifdef HALMET_CONFIG_STORE
+  // The file in the constructor, and again to migrate it
+  TEST_ASSERT_EQUAL(2, fake::ConfigFiles::get()->get_reads());
+#else
+  TEST_ASSERT_EQUAL(1, fake::ConfigFiles::get()->get_reads());
+#endif
+}
+
+void test_load_stats() {
+  ConfigStore::LoadStats before = ConfigStore::get()->get_load_stats();
+  WriteConfig("/Stats/linear", 5);
+  new Stored<sensesp::Linear>(1.0, 0.0, ConfigPath("/Stats/linear"));
+  new Stored<sensesp::Linear>(1.0, 0.0, ConfigPath("/Stats/linear"));
+  const ConfigStore::LoadStats& after = ConfigStore::get()->get_load_stats();
+  TEST_ASSERT_EQUAL(before.loads + 2, after.loads);
+#ifdef HALMET_CONFIG_STORE
+  TEST_ASSERT_EQUAL(before.migrations + 1, after.migrations);
+  TEST_ASSERT_EQUAL(before.store_hits + 1, after.store_hits);
+  TEST_ASSERT_EQUAL(before.file_reads + 1, after.file_reads);
+#else
+  TEST_ASSERT_EQUAL(before.file_reads + 2, after.file_reads);
+#endif
+}
+
+// The index put() keeps matches a full scan of the journal at boot
+void test_put_indexes_incrementally() {
+  const int kPaths = 20;
+  char path[32];
+  char json[32];
+  for (int round = 0; round < 10; round++) {
+    for (int i = 0; i < kPaths; i++) {
+      snprintf(path, sizeof(path), "/Path %d", i);
+      snprintf(json, sizeof(json), "{\"round\":%d,\"i\":%d}", round, i);
+      TEST_ASSERT_TRUE(ConfigStore::get()->put(path, json, strlen(json)));
+      TEST_ASSERT_TRUE(StoredJson(path) == json);
+    }
+  }
+  size_t entries = ConfigStore::get()->get_entry_count();
+  size_t journal_used = ConfigStore::get()->get_journal_used();
+
+  ConfigStore::get()->begin(kPartition);
+  TEST_ASSERT_EQUAL(entries, ConfigStore::get()->get_entry_count());
+  TEST_ASSERT_EQUAL(journal_used, ConfigStore::get()->get_journal_used());
+  for (int i = 0; i < kPaths; i++) {
+    snprintf(path, sizeof(path), "/Path %d", i);
+    snprintf(json, sizeof(json), "{\"round\":9,\"i\":%d}", i);
+    TEST_ASSERT_TRUE(StoredJson(path) == json);
+  }
+}
+
+// Time to put a record into a journal of a few hundred records
+void benchmark_put() {
+  const int kPuts = 400;
+  char path[32];
+  char json[32];
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kPuts; i++) {
+    snprintf(path, sizeof(path), "/Bench %d", i % 50);
+    snprintf(json, sizeof(json), "{\"i\":%d}", i);
+    ConfigStore::get()->put(path, json, strlen(json));
+  }
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  char message[80];
+  snprintf(message, sizeof(message), "%.2f us per put, %u compactions",
+           elapsed.count() / kPuts, fake::Partitions::get()->erases);
+  TEST_MESSAGE(message);
+}
+
+// Boot time of 50 nodes, loaded from their files and then from the store
+void benchmark_boot_loads() {
+  const int kNodes = 50;
+  char path[32];
+  for (int i = 0; i < kNodes; i++) {
+    snprintf(path, sizeof(path), "/Boot %d/linear", i);
+    WriteConfig(path, i);
+  }
+  for (int boot = 0; boot < 2; boot++) {
+    ConfigStore::get()->begin(kPartition);
+    ConfigStore::LoadStats before = ConfigStore::get()->get_load_stats();
+    fake::ConfigFiles::get()->reset_counts();
+    for (int i = 0; i < kNodes; i++) {
+      snprintf(path, sizeof(path), "/Boot %d/linear", i);
+      new Stored<sensesp::Linear>(1.0, 0.0, ConfigPath(path));
+    }
+    const ConfigStore::LoadStats& after =
+        ConfigStore::get()->get_load_stats();
+    char message[120];
+    snprintf(message, sizeof(message),
+             "Boot %d: %u loads, %u from the store, %u file reads, %u us",
+             boot + 1, after.loads - before.loads,
+             after.store_hits - before.store_hits,
+             fake::ConfigFiles::get()->get_reads(),
+             after.load_us - before.load_us);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL(kNodes, after.loads - before.loads);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_single_load);
+  RUN_TEST(test_direct_path);
+  RUN_TEST(test_load_stats);
+  RUN_TEST(test_put_indexes_incrementally);
+  RUN_TEST(benchmark_put);
+  RUN_TEST(benchmark_boot_loads);
+  return UNITY_END();
+}
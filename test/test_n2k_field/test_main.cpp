@@ -0,0 +1,117 @@
+#include <N2kMessages.h>
+#include <unity.h>
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "n2k_senders.h"
+
+using namespace halmet;
+
+// The fields of PGNs 127488, 127489 and 127505 encoded from the float
+// signal path through N2kField(), byte for byte against the double path
+// they replaced: the chain output widened to double and scaled in double.
+
+const int kSamples = 200000;
+
+std::mt19937 generator(127488);
+
+// Uniform floats in [min, max), with exact decimal steps mixed in
+float Input(int i, float min, float max, float step) {
+  if (i % 2 == 0) {
+    return min + (i / 2) * step;
+  }
+  return std::uniform_real_distribution<float>(min, max)(generator);
+}
+
+bool SameData(const tN2kMsg& a, const tN2kMsg& b) {
+  return a.PGN == b.PGN && a.DataLen == b.DataLen &&
+         memcmp(a.Data, b.Data, a.DataLen) == 0;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+// Engine speed in Hz to rpm, and boost pressure
+void test_127488_bit_exact() {
+  int mismatches = 0;
+  for (int i = 0; i < kSamples; i++) {
+    float hz = Input(i, 0, 100, 0.001);
+    float boost = Input(i, 0, 300000, 1.5);
+    tN2kMsg single;
+    SetN2kEngineParamRapid(single, 0, N2kField(hz, 60), N2kField(boost));
+    tN2kMsg double_path;
+    SetN2kEngineParamRapid(double_path, 0, 60 * static_cast<double>(hz),
+                           static_cast<double>(boost));
+    mismatches += !SameData(single, double_path);
+  }
+  TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+void test_127489_bit_exact() {
+  int mismatches = 0;
+  for (int i = 0; i < kSamples; i++) {
+    float oil_pressure = Input(i, 0, 1000000, 10);
+    float oil_temperature = Input(i, 250, 420, 0.01);
+    float temperature = Input(i, 250, 420, 0.001);
+    float voltage = Input(i, 0, 32, 0.0001);
+    float fuel_rate = Input(i, 0, 200, 0.001);
+    float coolant_pressure = Input(i, 0, 300000, 1);
+    float fuel_pressure = Input(i, 0, 1000000, 10);
+    tN2kMsg single;
+    SetN2kEngineDynamicParam(
+        single, 0, N2kField(oil_pressure), N2kField(oil_temperature),
+        N2kField(temperature), N2kField(voltage), N2kField(fuel_rate), 1234,
+        N2kField(coolant_pressure), N2kField(fuel_pressure));
+    tN2kMsg double_path;
+    SetN2kEngineDynamicParam(
+        double_path, 0, static_cast<double>(oil_pressure),
+        static_cast<double>(oil_temperature), static_cast<double>(temperature),
+        static_cast<double>(voltage), static_cast<double>(fuel_rate), 1234,
+        static_cast<double>(coolant_pressure),
+        static_cast<double>(fuel_pressure));
+    mismatches += !SameData(single, double_path);
+  }
+  TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+// Tank ratio to percent, and the capacity, which is now a float, over
+// capacities in 0.1 l steps
+void test_127505_bit_exact() {
+  int mismatches = 0;
+  for (int i = 0; i < kSamples; i++) {
+    float ratio = Input(i, 0, 1, 0.00001);
+    double capacity = (i % 100000) / 10.0;
+    tN2kMsg single;
+    SetN2kFluidLevel(single, 0, N2kft_Fuel, N2kField(ratio, 100),
+                     static_cast<float>(capacity));
+    tN2kMsg double_path;
+    SetN2kFluidLevel(double_path, 0, N2kft_Fuel,
+                     100 * static_cast<double>(ratio), capacity);
+    mismatches += !SameData(single, double_path);
+  }
+  TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+// NaN, which the double path encoded as out of range, and expired values
+// are not available
+void test_not_available() {
+  TEST_ASSERT_TRUE(N2kField(NAN) == N2kDoubleNA);
+  TEST_ASSERT_TRUE(N2kField(N2kFloatNA, 60) == N2kDoubleNA);
+  tN2kMsg msg;
+  SetN2kEngineParamRapid(msg, 0, N2kField(NAN, 60), N2kField(N2kFloatNA));
+  int index = 1;
+  TEST_ASSERT_EQUAL(N2kUInt16NA, msg.Get2ByteUInt(index));
+  TEST_ASSERT_EQUAL(N2kUInt16NA, msg.Get2ByteUInt(index));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_127488_bit_exact);
+  RUN_TEST(test_127489_bit_exact);
+  RUN_TEST(test_127505_bit_exact);
+  RUN_TEST(test_not_available);
+  return UNITY_END();
+}
@@ -0,0 +1,188 @@
+#include <unity.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "live_config.h"
+#include "pipeline.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp/system/observablevalue.h"
+#include "sensesp/transforms/curveinterpolator.h"
+#include "sensesp/transforms/linear.h"
+
+using namespace halmet;
+using sensesp::CurveInterpolator;
+
+// As the engine and tank senders build their curves
+using LiveCurve = LiveTransform<CurveInterpolator>;
+
+// The default curves of the tank, engine temperature and oil pressure
+// senders in halmet_analog.cpp
+void AddTankSamples(CurveInterpolator* curve) {
+  curve->add_sample(CurveInterpolator::Sample(0, 0));
+  curve->add_sample(CurveInterpolator::Sample(180., 1));
+  curve->add_sample(CurveInterpolator::Sample(1000., 1));
+}
+
+void AddTemperatureSamples(CurveInterpolator* curve) {
+  const float kSamples[][2] = {{23, 393.15},  {26, 383.15},  {31, 373.15},
+                               {45, 363.15},  {65, 353.15},  {100, 343.15},
+                               {150, 333.15}, {220, 323.15}, {300, 313.15}};
+  for (const auto& sample : kSamples) {
+    curve->add_sample(CurveInterpolator::Sample(sample[0], sample[1]));
+  }
+}
+
+void AddOilPressureSamples(CurveInterpolator* curve) {
+  for (int i = 0; i <= 10; i++) {
+    float ohms = i == 0 ? 10 : 31 + 17 * (i - 1);
+    curve->add_sample(CurveInterpolator::Sample(ohms, 1000000 - 100000 * i));
+  }
+}
+
+const float kTankVolume = 0.15;  // m3
+
+// Sender resistances over the range of all three curves. A curve that
+// starts at 0 ohms divides by zero there, in SensESP as well.
+float Resistance(int i) { return 0.0625f + (i % 2000) * 0.125f; }
+
+void setUp() {}
+
+void tearDown() {}
+
+// The graph as built before: source -> curve [-> linear] -> sink
+struct Graph {
+  sensesp::ObservableValue<float> source;
+  LiveCurve curve;
+  sensesp::Linear volume{kTankVolume, 0};
+  float output = 0;
+
+  explicit Graph(bool with_volume) {
+    auto sink = new sensesp::LambdaConsumer<float>(
+        [this](float value) { output = value; });
+    if (with_volume) {
+      source.connect_to(&curve)->connect_to(&volume)->connect_to(sink);
+    } else {
+      source.connect_to(&curve)->connect_to(sink);
+    }
+  }
+};
+
+// The same chain as a pipeline: the curve and linear run inline
+struct Pipeline {
+  sensesp::ObservableValue<float> source;
+  LiveCurve curve;
+  sensesp::Linear volume{kTankVolume, 0};
+  float output = 0;
+
+  explicit Pipeline(bool with_volume) {
+    auto sink = pipeline::ToCallable([this](float value) { output = value; });
+    if (with_volume) {
+      pipeline::From(&source) | pipeline::Curve(&curve) |
+          pipeline::Node(&volume) | sink;
+    } else {
+      pipeline::From(&source) | pipeline::Curve(&curve) | sink;
+    }
+  }
+};
+
+void CheckSame(void (*add_samples)(CurveInterpolator*), bool with_volume) {
+  Graph graph(with_volume);
+  Pipeline chain(with_volume);
+  add_samples(&graph.curve);
+  add_samples(&chain.curve);
+  for (int i = 0; i < 2000; i++) {
+    graph.source.set(Resistance(i));
+    chain.source.set(Resistance(i));
+    TEST_ASSERT_EQUAL_FLOAT(graph.output, chain.output);
+  }
+}
+
+void test_tank_chain_matches_graph() {
+  CheckSame(AddTankSamples, true);
+}
+
+void test_temperature_chain_matches_graph() {
+  CheckSame(AddTemperatureSamples, false);
+}
+
+void test_oil_pressure_chain_matches_graph() {
+  CheckSame(AddOilPressureSamples, false);
+}
+
+// A curve changed after the chain was built is used by the next sample
+void test_curve_changes_apply() {
+  Pipeline chain(false);
+  AddTemperatureSamples(&chain.curve);
+  chain.source.set(100);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 343.15, chain.output);
+  chain.curve.clear_samples();
+  chain.curve.add_sample(CurveInterpolator::Sample(200, 400));
+  chain.source.set(100);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 200, chain.output);
+}
+
+// As is a curve changed from the web UI, staged until the next sample
+void test_staged_curve_applies() {
+  Pipeline chain(false);
+  AddTemperatureSamples(&chain.curve);
+  JsonDocument doc;
+  JsonObject config = doc.to<JsonObject>();
+  JsonArray samples = config["samples"].to<JsonArray>();
+  JsonObject sample = samples.add<JsonObject>();
+  sample["input"] = 200.0f;
+  sample["output"] = 400.0f;
+  TEST_ASSERT_TRUE(chain.curve.from_json(config));
+  chain.source.set(100);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 200, chain.output);
+}
+
+// Nanoseconds per sample, the best of a few runs
+template <typename Chain>
+double TimeChain(Chain* chain) {
+  const int kRuns = 5;
+  const int kSamples = 1000000;
+  double best = 1e9;
+  volatile float sink = 0;
+  for (int run = 0; run < kRuns; run++) {
+    unsigned long start = micros();
+    for (int i = 0; i < kSamples; i++) {
+      chain->source.set(Resistance(i));
+      sink = sink + chain->output;
+    }
+    best = std::min(best, (micros() - start) * 1000.0 / kSamples);
+  }
+  return best;
+}
+
+void Benchmark(const char* name, void (*add_samples)(CurveInterpolator*),
+               bool with_volume) {
+  Graph graph(with_volume);
+  Pipeline chain(with_volume);
+  add_samples(&graph.curve);
+  add_samples(&chain.curve);
+  double graph_ns = TimeChain(&graph);
+  double pipeline_ns = TimeChain(&chain);
+  char message[120];
+  snprintf(message, sizeof(message),
+           "%s: graph %.1f ns, pipeline %.1f ns per sample", name, graph_ns,
+           pipeline_ns);
+  TEST_MESSAGE(message);
+}
+
+void benchmark_chains() {
+  Benchmark("Tank (curve, volume)", AddTankSamples, true);
+  Benchmark("Engine temperature (curve)", AddTemperatureSamples, false);
+  Benchmark("Oil pressure (curve)", AddOilPressureSamples, false);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_tank_chain_matches_graph);
+  RUN_TEST(test_temperature_chain_matches_graph);
+  RUN_TEST(test_oil_pressure_chain_matches_graph);
+  RUN_TEST(test_curve_changes_apply);
+  RUN_TEST(test_staged_curve_applies);
+  RUN_TEST(benchmark_chains);
+  return UNITY_END();
+}
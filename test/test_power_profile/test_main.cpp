@@ -0,0 +1,216 @@
+#include <Adafruit_ADS1X15.h>
+#include <NMEA2000.h>
+#include <ReactESP.h>
+#include <Wire.h>
+#include <esp_wifi.h>
+#include <unity.h>
+
+#include <cstdio>
+
+#include "adc_scheduler.h"
+#include "can_gateway.h"
+#include "can_metrics.h"
+#include "halmet_analog.h"
+#include "halmet_const.h"
+#include "halmet_digital.h"
+#include "halmet_engine.h"
+#include "power_manager.h"
+#include "sample_scheduler.h"
+#include "sender_resistance.h"
+#include "sensesp.h"
+#include "sensesp/system/lambda_consumer.h"
+
+using namespace halmet;
+
+// Wakeups and average current per engine state, with the periodic work of
+// setup() in main.cpp: N2K parsing and senders, the on-demand ADC, the CAN
+// gateway drain, the CAN metrics poll and the display. A wakeup is an event
+// loop tick in which a timed event ran; the CPU is assumed to light sleep
+// between them in the off profile, and to idle at its clock otherwise.
+//
+// Current model, from the ESP32 datasheet: the CPU draws kActiveMa at its
+// clock while awake, for kAwakeUsAt240 us per wakeup scaled with the clock,
+// kIdleMa between wakeups, or kLightSleepMa in light sleep. The radio adds
+// kRadioMa, less in modem sleep.
+
+const float kActiveMa[] = {31, 44, 68};  // 80, 160, 240 MHz
+const float kIdleMa[] = {20, 27, 30};
+const float kLightSleepMa = 0.8;
+const float kAwakeUsAt240 = 150;
+const float kRadioMa = 70;            // Associated, no power save
+const float kRadioModemSleepMa = 15;  // Associated, DTIM modem sleep
+
+int ClockIndex(uint32_t mhz) { return mhz >= 240 ? 2 : mhz >= 160 ? 1 : 0; }
+
+float AverageMa(float wakeups_per_s, uint32_t mhz, bool modem_sleep,
+                bool light_sleep) {
+  float awake = wakeups_per_s * kAwakeUsAt240 * 240 / mhz / 1e6;
+  float between = light_sleep ? kLightSleepMa : kIdleMa[ClockIndex(mhz)];
+  return (modem_sleep ? kRadioModemSleepMa : kRadioMa) +
+         awake * kActiveMa[ClockIndex(mhz)] + (1 - awake) * between;
+}
+
+tNMEA2000 nmea2000;
+PowerManager* power_manager;
+EngineChannels engine;
+uint32_t tacho_period_us = 0;  // 0 when the engine is stopped
+
+int16_t CountsForOhms(Adafruit_ADS1115* ads, float ohms) {
+  return static_cast<int16_t>(
+      roundf(ohms / SenderResistance(1, ads->computeVolts(1))));
+}
+
+// Run the event loop for ms, with the tacho pulses between events, as
+// interrupts that don't count as wakeups
+void Simulate(uint64_t ms) {
+  fake::Clock* clock = fake::Clock::get();
+  uint64_t end_us = clock->micros64() + ms * 1000;
+  if (tacho_period_us == 0) {
+    sensesp::event_loop()->run_until(end_us);
+    return;
+  }
+  while (clock->micros64() + tacho_period_us <= end_us) {
+    sensesp::event_loop()->run_until(clock->micros64() + tacho_period_us);
+    fake::Pins::get()->pulse(kDigitalInputPin1);
+  }
+  sensesp::event_loop()->run_until(end_us);
+}
+
+// As in setup() of main.cpp, for one ADS1115, one tank and one engine
+void BuildGraph() {
+  fake::ConfigFiles::get()->write(
+      "/Power",
+      R"({"idle_scale":10,"cooldown_scale":2,"light_sleep":true})");
+  fake::ConfigFiles::get()->write("/CAN Gateway", R"({"enabled":true})");
+
+  power_manager = new PowerManager("/Power");
+  auto can_gateway = new CanGateway("/CAN Gateway");
+  can_gateway->start(power_manager);
+  CanMetrics::get()->start(&nmea2000, power_manager);
+  power_manager->repeat(1, []() {
+    nmea2000.ParseMessages();
+    CanMetrics::get()->messages_parsed();
+  });
+  // The display updates
+  power_manager->repeat(1000, []() {});
+  power_manager->repeat(1000, []() {});
+
+  auto adc_scheduler = new AdcScheduler(&Wire, GAIN_ONE);
+  adc_scheduler->add_device(0x48);
+  Adafruit_ADS1115* ads = adc_scheduler->get_device(0);
+  ads->set_counts(0, CountsForOhms(ads, 90));
+  ads->set_counts(1, CountsForOhms(ads, 65));
+  ads->set_counts(2, CountsForOhms(ads, 99));
+
+  auto tank_resistance = adc_scheduler->add_resistance_channel(0, 0);
+  auto tank_level =
+      ConnectTankSender(tank_resistance, "A1", "fuel.main", 3000, true);
+  auto tank_sender = new N2kFluidLevelSender("/Tanks/A1/NMEA 2000", 0,
+                                             N2kft_Fuel, 200, &nmea2000);
+  tank_level->connect_to(&(tank_sender->tank_level_));
+  tank_sender->sample_before_send(tank_resistance);
+
+  ChannelMap::Engine engine_map = {"1", 0, kDigitalInputPin1, 1, 2, -1};
+  engine = ConnectEngine(engine_map,
+                         adc_scheduler->add_resistance_channel(0, 1),
+                         adc_scheduler->add_resistance_channel(0, 2),
+                         ConnectTachoSender(kDigitalInputPin1, "1"),
+                         &nmea2000, 1000);
+
+  adc_scheduler->start_on_demand(500);
+  power_manager->connect_to(new sensesp::LambdaConsumer<float>(
+      [](float scale) { SampleScheduler::get()->set_scale(scale); }));
+  power_manager->add_engine(engine.state);
+  power_manager->start();
+}
+
+// Wakeups per second and average current in the state reached at rpm
+void MeasureState(const char* name, float rpm, EngineState expected) {
+  tacho_period_us = rpm > 0 ? 1e6f / (rpm / 60 * 100) : 0;
+  // Settle into the state and its profile
+  Simulate(5000);
+  TEST_ASSERT_EQUAL(static_cast<int>(expected),
+                    static_cast<int>(engine.state->get_state()));
+
+  uint64_t wakeups = sensesp::event_loop()->get_wakeups();
+  Simulate(60000);
+  float wakeups_per_s = (sensesp::event_loop()->get_wakeups() - wakeups) / 60.0f;
+
+  uint32_t mhz = getCpuFrequencyMhz();
+  bool modem_sleep = fake::wifi_ps() != WIFI_PS_NONE;
+  bool light_sleep = expected == EngineState::kOff;
+  char message[120];
+  snprintf(message, sizeof(message),
+           "%s: %.1f wakeups/s, %u MHz, modem sleep %d, %.1f mA", name,
+           wakeups_per_s, static_cast<unsigned>(mhz), modem_sleep,
+           AverageMa(wakeups_per_s, mhz, modem_sleep, light_sleep));
+  TEST_MESSAGE(message);
+}
+
+float WakeupsPerSecond(uint64_t ms) {
+  uint64_t wakeups = sensesp::event_loop()->get_wakeups();
+  Simulate(ms);
+  return (sensesp::event_loop()->get_wakeups() - wakeups) * 1000.0f / ms;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+// Each conversion is collected one conversion time after its start, and no
+// collect event is left between rounds
+void test_adc_collect() {
+  // Outlives the test, as its report event does
+  auto adc = new AdcScheduler(&Wire, GAIN_ONE);
+  adc->add_device(0x49);
+  Adafruit_ADS1115* ads = adc->get_device(0);
+  ads->set_i2c_transaction_us(400);
+  static int samples = 0;
+  auto counter = new sensesp::LambdaConsumer<float>([](float) { samples++; });
+  for (int channel = 0; channel < 3; channel++) {
+    adc->add_resistance_channel(0, channel)->connect_to(counter);
+  }
+
+  size_t events = sensesp::event_loop()->get_timed_event_count();
+  adc->start(500);
+  // The round and report events
+  TEST_ASSERT_EQUAL(events + 2, sensesp::event_loop()->get_timed_event_count());
+
+  // Three conversions of 9 ms each, plus the I2C reads and writes
+  Simulate(500 + 30);
+  TEST_ASSERT_EQUAL(3, samples);
+  TEST_ASSERT_EQUAL(0, ads->get_early_reads());
+  TEST_ASSERT_EQUAL(events + 2, sensesp::event_loop()->get_timed_event_count());
+
+  Simulate(500);
+  TEST_ASSERT_EQUAL(6, samples);
+  TEST_ASSERT_EQUAL(0, ads->get_early_reads());
+  TEST_ASSERT_EQUAL(events + 2, sensesp::event_loop()->get_timed_event_count());
+
+  // Out of the way of the power profiles
+  adc->set_read_interval(1000000);
+}
+
+void test_power_profiles() {
+  BuildGraph();
+
+  MeasureState("off", 0, EngineState::kOff);
+  float off_wakeups = WakeupsPerSecond(10000);
+  MeasureState("cranking", 200, EngineState::kCranking);
+  MeasureState("running", 1500, EngineState::kRunning);
+  float running_wakeups = WakeupsPerSecond(10000);
+  MeasureState("cooldown", 0, EngineState::kCooldown);
+
+  // The 1 ms N2K parse, 5 ms gateway drain and 100 ms CAN metrics poll are
+  // stretched with the engines off
+  TEST_ASSERT_LESS_THAN(running_wakeups / 5, off_wakeups);
+}
+
+int main(int argc, char** argv) {
+  fake::Clock::get()->set_us(1000000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_adc_collect);
+  RUN_TEST(test_power_profiles);
+  return UNITY_END();
+}
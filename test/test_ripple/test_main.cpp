@@ -0,0 +1,129 @@
+#include <unity.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "ripple_spectrum.h"
+
+using namespace halmet;
+
+// The burst of RippleAnalyzer at the AdcScheduler's burst rate
+const int kSize = 256;
+const float kSampleRate = 400;
+const float kVolts = 14.2;
+
+struct Tone {
+  float hz;
+  float amplitude;  // V
+};
+
+// kVolts with the tones and uniform noise of +-noise V from a linear
+// congruential generator, so that every run sees the same burst
+std::vector<float> Burst(const std::vector<Tone>& tones, float noise = 0) {
+  std::vector<float> volts(kSize);
+  uint32_t state = 12345;
+  for (int i = 0; i < kSize; i++) {
+    state = state * 1664525 + 1013904223;
+    float n = noise * (static_cast<int32_t>(state) / 2147483648.0f);
+    volts[i] = kVolts + n;
+    for (const Tone& tone : tones) {
+      volts[i] +=
+          tone.amplitude * sinf(2 * PI * tone.hz * i / kSampleRate + 0.3f);
+    }
+  }
+  return volts;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_mean_and_rms() {
+  std::vector<float> volts = Burst({{60, 0.2}});
+  std::vector<float> work(kSize);
+  RippleSpectrum spectrum =
+      AnalyzeRipple(volts.data(), kSize, kSampleRate, work.data());
+  TEST_ASSERT_FLOAT_WITHIN(0.005, kVolts, spectrum.mean);
+  TEST_ASSERT_FLOAT_WITHIN(0.005, 0.2 / sqrtf(2), spectrum.ripple);
+}
+
+// Frequencies between bins, up to near the 200 Hz Nyquist frequency
+void test_dominant_frequency_and_amplitude() {
+  const Tone kTones[] = {{12, 0.05}, {60, 0.2}, {121.3, 0.5}, {175, 1.0}};
+  std::vector<float> work(kSize);
+  for (const Tone& tone : kTones) {
+    std::vector<float> volts = Burst({tone}, 0.01);
+    RippleSpectrum spectrum =
+        AnalyzeRipple(volts.data(), kSize, kSampleRate, work.data());
+    // A bin is 1.56 Hz wide
+    TEST_ASSERT_FLOAT_WITHIN(0.3, tone.hz, spectrum.peak_hz);
+    TEST_ASSERT_FLOAT_WITHIN(0.05 * tone.amplitude, tone.amplitude,
+                             spectrum.peak_amplitude);
+  }
+}
+
+// The weaker diode ripple at the electrical frequency next to the
+// dominant six-pulse ripple
+void test_amplitude_of_second_tone() {
+  std::vector<float> volts = Burst({{150, 0.5}, {25, 0.1}});
+  std::vector<float> work(kSize);
+  RippleSpectrum spectrum =
+      AnalyzeRipple(volts.data(), kSize, kSampleRate, work.data());
+  TEST_ASSERT_FLOAT_WITHIN(0.3, 150, spectrum.peak_hz);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 0.1,
+                           GoertzelAmplitude(work.data(), kSize, kSampleRate,
+                                             spectrum.window_sum, 25));
+}
+
+void test_above_nyquist_is_not_available() {
+  std::vector<float> volts = Burst({{60, 0.2}});
+  std::vector<float> work(kSize);
+  RippleSpectrum spectrum =
+      AnalyzeRipple(volts.data(), kSize, kSampleRate, work.data());
+  TEST_ASSERT_TRUE(std::isnan(GoertzelAmplitude(
+      work.data(), kSize, kSampleRate, spectrum.window_sum, 200)));
+}
+
+void test_failed_burst() {
+  std::vector<float> volts = Burst({{60, 0.2}});
+  std::vector<float> work(kSize);
+  RippleSpectrum spectrum = AnalyzeRipple(volts.data(), kSize, 0, work.data());
+  TEST_ASSERT_TRUE(std::isnan(spectrum.mean));
+}
+
+// Microseconds per burst on the host, the best of a few runs. On the
+// ESP32, RippleAnalyzer logs its own analysis time every minute.
+void benchmark_analysis() {
+  std::vector<float> volts = Burst({{121.3, 0.5}}, 0.01);
+  std::vector<float> work(kSize);
+  const int kRuns = 5;
+  const int kBursts = 1000;
+  double best_us = 1e9;
+  volatile float sink = 0;
+  for (int run = 0; run < kRuns; run++) {
+    unsigned long start = micros();
+    for (int i = 0; i < kBursts; i++) {
+      RippleSpectrum spectrum =
+          AnalyzeRipple(volts.data(), kSize, kSampleRate, work.data());
+      sink = sink + spectrum.peak_hz;
+    }
+    best_us = std::min(best_us, (micros() - start) / double(kBursts));
+  }
+  char message[80];
+  snprintf(message, sizeof(message), "AnalyzeRipple: %.1f us per %d samples",
+           best_us, kSize);
+  TEST_MESSAGE(message);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_mean_and_rms);
+  RUN_TEST(test_dominant_frequency_and_amplitude);
+  RUN_TEST(test_amplitude_of_second_tone);
+  RUN_TEST(test_above_nyquist_is_not_available);
+  RUN_TEST(test_failed_burst);
+  RUN_TEST(benchmark_analysis);
+  return UNITY_END();
+}
@@ -0,0 +1,159 @@
+#include <Adafruit_ADS1X15.h>
+#include <FS.h>
+#include <ReactESP.h>
+#include <unity.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "halmet_analog.h"
+#include "halmet_digital.h"
+#include "sample_log.h"
+#include "sender_resistance.h"
+#include "sensesp.h"
+#include "sensesp/system/lambda_consumer.h"
+
+using namespace halmet;
+
+// A synthetic recording replayed through the tank, tacho and alarm chains
+// on the simulated clock, with the chain outputs compared against a golden
+// file. Set HALMET_UPDATE_GOLDEN=1 to rewrite the golden file after an
+// intended change of the chains' outputs.
+
+const char kLogPath[] = "/samples.bin";
+const char kOutputPath[] = "/replay.txt";
+const char kGoldenPath[] = "test/test_sample_replay/golden_output.txt";
+const uint32_t kRecordingMs = 60000;
+
+fs::FS fs_;
+float volts_per_count;
+
+int16_t CountsForOhms(float ohms) {
+  return static_cast<int16_t>(
+      roundf(ohms / SenderResistance(1, volts_per_count)));
+}
+
+// Tank sloshing around half full every 100 ms, 100 Hz tacho pulses counted
+// every 500 ms with the engine speeding up, and a bilge alarm raised for
+// 10 s
+void Record() {
+  fake::Clock* clock = fake::Clock::get();
+  SampleRecorder* recorder = SampleRecorder::get();
+  TEST_ASSERT_TRUE(recorder->begin(fs_, kLogPath));
+  uint64_t start_us = clock->micros64();
+  for (uint32_t ms = 0; ms < kRecordingMs; ms += 100) {
+    clock->set_us(start_us + ms * 1000);
+    float slosh = 8 * sinf(2 * PI * ms / 1700.0f);
+    recorder->record(SampleSource::kA1Counts, CountsForOhms(90 + slosh));
+    if (ms % 500 == 0) {
+      recorder->record(SampleSource::kD1Count,
+                       static_cast<int>(50 + ms / 2000));
+    }
+    if (ms % 1000 == 0) {
+      recorder->record(SampleSource::kD2State, ms >= 20000 && ms < 30000);
+    }
+  }
+  recorder->end();
+}
+
+std::string ReadFile(const char* path) {
+  std::ifstream file(path);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+// Run the event loop until the replay is done, ticking every ms as the
+// device's loop would
+void RunReplay(SampleReplay* replay) {
+  auto ticker = sensesp::event_loop()->onRepeat(1, []() {});
+  while (!replay->is_finished()) {
+    sensesp::event_loop()->run_for_ms(1000);
+  }
+  ticker->remove(sensesp::event_loop());
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_golden_output() {
+  auto replay = new SampleReplay(fs_, kLogPath, 1, volts_per_count,
+                                 kOutputPath);
+  auto tank_level = ConnectTankSender(replay->sender_resistance(0), "A1",
+                                      "fuel.main", 3000, false);
+  tank_level->connect_to(new sensesp::LambdaConsumer<float>(
+      [replay](float value) { replay->record_output("tank_a1", value); }));
+  auto tacho = ConnectTachoSender(replay->counter(0), "1");
+  tacho->connect_to(new sensesp::LambdaConsumer<float>(
+      [replay](float value) { replay->record_output("tacho_d1", value); }));
+  auto alarm = ConnectAlarmSender(replay->state(1), "engineBilge");
+  alarm->connect_to(new sensesp::LambdaConsumer<bool>(
+      [replay](bool value) { replay->record_output("alarm_d2", value); }));
+
+  RunReplay(replay);
+  std::string output = fs_.get_content(kOutputPath);
+  TEST_ASSERT_GREATER_THAN(100, output.length());
+
+  const char* update = getenv("HALMET_UPDATE_GOLDEN");
+  if (update != nullptr && strcmp(update, "1") == 0) {
+    std::ofstream(kGoldenPath) << output;
+    TEST_MESSAGE("Golden file updated");
+  }
+  std::string golden = ReadFile(kGoldenPath);
+  TEST_ASSERT_TRUE_MESSAGE(!golden.empty(), "No golden file");
+  TEST_ASSERT_TRUE_MESSAGE(output == golden, "Output differs from golden");
+}
+
+// At 4x, on a clock of the test's own, the same inputs come out in the same
+// order with the same virtual times, in a quarter of the clock time
+void test_accelerated_replay() {
+  struct Input {
+    uint32_t virtual_ms;
+    float value;
+  };
+  std::vector<Input> inputs[2];
+  const float kSpeeds[] = {1, 4};
+  uint32_t clock_ms[2];
+
+  for (int run = 0; run < 2; run++) {
+    static uint32_t test_clock_ms;
+    test_clock_ms = 0;
+    auto replay = new SampleReplay(fs_, kLogPath, kSpeeds[run],
+                                   volts_per_count, nullptr,
+                                   []() { return test_clock_ms; });
+    std::vector<Input>* run_inputs = &inputs[run];
+    replay->sender_resistance(0)->connect_to(
+        new sensesp::LambdaConsumer<float>([replay, run_inputs](float value) {
+          run_inputs->push_back({replay->get_virtual_ms(), value});
+        }));
+    while (!replay->is_finished()) {
+      test_clock_ms++;
+      sensesp::event_loop()->tick();
+    }
+    clock_ms[run] = test_clock_ms;
+  }
+
+  TEST_ASSERT_EQUAL(kRecordingMs / 100, inputs[0].size());
+  TEST_ASSERT_EQUAL(inputs[0].size(), inputs[1].size());
+  for (size_t i = 0; i < inputs[0].size(); i++) {
+    TEST_ASSERT_EQUAL(inputs[0][i].virtual_ms, inputs[1][i].virtual_ms);
+    TEST_ASSERT_EQUAL_FLOAT(inputs[0][i].value, inputs[1][i].value);
+  }
+  TEST_ASSERT_UINT32_WITHIN(2, clock_ms[0] / 4, clock_ms[1]);
+}
+
+int main(int argc, char** argv) {
+  fake::Clock::get()->set_us(1000000);
+  Adafruit_ADS1115 ads;
+  ads.setGain(GAIN_ONE);
+  volts_per_count = ads.computeVolts(1);
+  Record();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_golden_output);
+  RUN_TEST(test_accelerated_replay);
+  return UNITY_END();
+}
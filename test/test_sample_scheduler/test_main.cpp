@@ -0,0 +1,102 @@
+#include <Adafruit_ADS1X15.h>
+#include <ReactESP.h>
+#include <Wire.h>
+#include <unity.h>
+
+#include "adc_scheduler.h"
+#include "sample_scheduler.h"
+#include "sensesp.h"
+#include "sensesp/system/lambda_consumer.h"
+
+using namespace halmet;
+
+// The order of the just-in-time sampling on a fake ADS1115: a deadline's
+// acquisitions are requested at prepare, every sample is emitted, and only
+// then the deadline sends. A slow I2C bus makes a round of four channels
+// take longer than four conversions, as the lead first assumes.
+
+const int kChannels = 4;
+const unsigned int kPeriodMs = 100;
+const unsigned int kFreshnessMs = 50;
+
+AdcScheduler* adc_scheduler;
+sensesp::FloatProducer* inputs[kChannels];
+uint32_t emitted_ms[kChannels];  // Time of each input's latest sample
+uint32_t sent = 0;
+uint32_t stale_sends = 0;     // Sends with an input from a previous period
+uint32_t max_age_ms = 0;      // Oldest input at a send
+
+void BuildGraph() {
+  adc_scheduler = new AdcScheduler(&Wire, GAIN_ONE);
+  adc_scheduler->add_device(0x48);
+  Adafruit_ADS1115* ads = adc_scheduler->get_device(0);
+  // Each write or read takes 2 ms, making a conversion 13 ms
+  ads->set_i2c_transaction_us(2000);
+  for (int channel = 0; channel < kChannels; channel++) {
+    inputs[channel] = adc_scheduler->add_voltage_channel(0, channel);
+    inputs[channel]->connect_to(new sensesp::LambdaConsumer<float>(
+        [channel](float) { emitted_ms[channel] = millis(); }));
+  }
+  adc_scheduler->start_on_demand(500);
+
+  SampleScheduler* scheduler = SampleScheduler::get();
+  int deadline =
+      scheduler->add_deadline("Test", kPeriodMs, kFreshnessMs, []() {
+        uint32_t now = millis();
+        sent++;
+        bool stale = false;
+        for (int channel = 0; channel < kChannels; channel++) {
+          uint32_t age_ms = now - emitted_ms[channel];
+          max_age_ms = std::max(max_age_ms, age_ms);
+          stale = stale || age_ms > kFreshnessMs;
+        }
+        if (stale) {
+          stale_sends++;
+        }
+      });
+  for (int channel = 0; channel < kChannels; channel++) {
+    scheduler->add_input(deadline, inputs[channel]);
+  }
+}
+
+void setUp() {
+  sent = 0;
+  stale_sends = 0;
+  max_age_ms = 0;
+}
+
+void tearDown() {}
+
+// After the first measured round, every send has all its inputs sampled
+// within the freshness, after its prepare
+void test_send_after_samples() {
+  // The first rounds measure the bus
+  sensesp::event_loop()->run_for_ms(1000);
+  setUp();
+
+  sensesp::event_loop()->run_for_ms(10000);
+  TEST_ASSERT_UINT32_WITHIN(1, 10000 / kPeriodMs, sent);
+  TEST_ASSERT_EQUAL(0, stale_sends);
+  TEST_ASSERT_LESS_OR_EQUAL(kFreshnessMs, max_age_ms);
+}
+
+// Samples are taken for the sends only: one conversion per channel and
+// period, no more
+void test_acquisitions_per_send() {
+  Adafruit_ADS1115* ads = adc_scheduler->get_device(0);
+  uint32_t conversions = ads->get_conversions();
+  sensesp::event_loop()->run_for_ms(10000);
+  TEST_ASSERT_UINT32_WITHIN(kChannels, kChannels * 10000 / kPeriodMs,
+                            ads->get_conversions() - conversions);
+  TEST_ASSERT_EQUAL(0, ads->get_early_reads());
+}
+
+int main(int argc, char** argv) {
+  fake::Clock::get()->set_us(1000000);
+  BuildGraph();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_send_after_samples);
+  RUN_TEST(test_acquisitions_per_send);
+  return UNITY_END();
+}
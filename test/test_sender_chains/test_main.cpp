@@ -0,0 +1,252 @@
+#include <N2kMessages.h>
+#include <NMEA2000.h>
+#include <ReactESP.h>
+#include <Wire.h>
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "adc_scheduler.h"
+#include "halmet_analog.h"
+#include "halmet_const.h"
+#include "halmet_digital.h"
+#include "halmet_display.h"
+#include "halmet_engine.h"
+#include "n2k_senders.h"
+#include "sender_resistance.h"
+#include "sensesp.h"
+#include "sensesp/system/lambda_consumer.h"
+#include "sensesp_onewire/onewire_temperature.h"
+
+using namespace halmet;
+using sensesp::onewire::DallasTemperatureSensors;
+using sensesp::onewire::OneWireTemperature;
+
+// The real tank, engine, alarm, 1-Wire and display chains of main.cpp, on
+// the host fakes of the ADS1115, the NMEA 2000 bus, the GPIOs, the Dallas
+// bus and the SSD1306, with the ADC sampled on demand for the N2K senders as
+// with ENABLE_JIT_SAMPLING.
+
+// Every allocation of the process, for the allocations per sample. The
+// library's operator delete frees it.
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  void* ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+const float kTankOhms = 90;           // Half full
+const float kTemperatureOhms = 65;    // 353.15 K
+const float kOilPressureOhms = 99;    // 500 kPa
+const int kTachoPulsePeriodMs = 10;   // 100 Hz, 60 rpm at 100 pulses/rev
+
+tNMEA2000 nmea2000;
+AdcScheduler* adc_scheduler;
+sensesp::FloatProducer* tank_level;
+EngineChannels engine;
+sensesp::BoolProducer* alarm;
+DallasTemperatureSensors* dts;
+sensesp::FloatProducer* exhaust_temperature;
+Adafruit_SSD1306* display;
+
+int16_t CountsForOhms(Adafruit_ADS1115* ads, float ohms) {
+  return static_cast<int16_t>(
+      roundf(ohms / SenderResistance(1, ads->computeVolts(1))));
+}
+
+// As in setup() of main.cpp, for one ADS1115, one tank and one engine
+void BuildChains() {
+  fake::Clock::get()->set_us(1000000);
+
+  adc_scheduler = new AdcScheduler(&Wire, GAIN_ONE);
+  adc_scheduler->add_device(0x48);
+  Adafruit_ADS1115* ads = adc_scheduler->get_device(0);
+  ads->set_i2c_transaction_us(200);
+
+  auto tank_resistance = adc_scheduler->add_resistance_channel(0, 0);
+  tank_level =
+      ConnectTankSender(tank_resistance, "A1", "fuel.main", 3000, true);
+  auto tank_sender = new N2kFluidLevelSender(
+      "/Tanks/A1/NMEA 2000", 0, N2kft_Fuel, 200, &nmea2000);
+  tank_level->connect_to(&(tank_sender->tank_level_));
+  tank_sender->sample_before_send(tank_resistance);
+
+  ChannelMap::Engine engine_map = {"1", 0, kDigitalInputPin1, 1, 2, -1};
+  engine = ConnectEngine(engine_map, adc_scheduler->add_resistance_channel(0, 1),
+                         adc_scheduler->add_resistance_channel(0, 2),
+                         ConnectTachoSender(kDigitalInputPin1, "1"), &nmea2000,
+                         1000);
+
+  alarm = ConnectAlarmSender(kDigitalInputPin2, "engineBilge");
+
+  dts = new DallasTemperatureSensors(4);
+  auto exhaust_temp = new Stored<OneWireTemperature>(
+      dts, 1000, "/Exhaust Temperature/oneWire");
+  exhaust_temperature = exhaust_temp->connect_to(
+      new LiveLinear(1.0, 0.0, ConfigPath("/Exhaust_Temperature/linear")));
+
+  auto hostname = std::make_shared<sensesp::SensESPBaseApp>();
+  TEST_ASSERT_TRUE(InitializeSSD1306(hostname, &display, &Wire));
+  tank_level->connect_to(new sensesp::LambdaConsumer<float>(
+      [](float value) { PrintValue(display, 2, "Tank A1", 100 * value); }));
+
+  adc_scheduler->start_on_demand(500);
+
+  ads->set_counts(0, CountsForOhms(ads, kTankOhms));
+  ads->set_counts(1, CountsForOhms(ads, kTemperatureOhms));
+  ads->set_counts(2, CountsForOhms(ads, kOilPressureOhms));
+
+  sensesp::event_loop()->onRepeat(kTachoPulsePeriodMs, []() {
+    fake::Pins::get()->pulse(kDigitalInputPin1);
+  });
+
+  // Settle the filters and the tacho
+  sensesp::event_loop()->run_for_ms(10000);
+}
+
+const tN2kMsg* LastSent(unsigned long pgn) {
+  const auto& sent = nmea2000.get_sent();
+  for (auto it = sent.rbegin(); it != sent.rend(); ++it) {
+    if (it->PGN == pgn) {
+      return &*it;
+    }
+  }
+  return nullptr;
+}
+
+void setUp() {
+  nmea2000.set_record(true);
+  nmea2000.clear_sent();
+}
+
+void tearDown() {}
+
+void test_n2k_rates() {
+  sensesp::event_loop()->run_for_ms(10000);
+  TEST_ASSERT_UINT32_WITHIN(1, 100, nmea2000.get_sent_count(127488));
+  TEST_ASSERT_UINT32_WITHIN(1, 20, nmea2000.get_sent_count(127489));
+  TEST_ASSERT_UINT32_WITHIN(1, 4, nmea2000.get_sent_count(127505));
+}
+
+void test_engine_values() {
+  sensesp::event_loop()->run_for_ms(1000);
+
+  const tN2kMsg* rapid = LastSent(127488);
+  TEST_ASSERT_NOT_NULL(rapid);
+  unsigned char instance;
+  double speed, boost;
+  int8_t trim;
+  TEST_ASSERT_TRUE(
+      ParseN2kEngineParamRapid(*rapid, instance, speed, boost, trim));
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 60, speed);
+
+  const tN2kMsg* dynamic = LastSent(127489);
+  TEST_ASSERT_NOT_NULL(dynamic);
+  double oil_pressure, oil_temperature, temperature, voltage, fuel_rate, hours,
+      coolant_pressure, fuel_pressure;
+  int8_t load, torque;
+  tN2kEngineDiscreteStatus1 status1;
+  tN2kEngineDiscreteStatus2 status2;
+  TEST_ASSERT_TRUE(ParseN2kEngineDynamicParam(
+      *dynamic, instance, oil_pressure, oil_temperature, temperature, voltage,
+      fuel_rate, hours, coolant_pressure, fuel_pressure, load, torque, status1,
+      status2));
+  // Within a count of the ADC and the N2K resolution
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 353.15, temperature);
+  TEST_ASSERT_FLOAT_WITHIN(1000, 500000, oil_pressure);
+  TEST_ASSERT_EQUAL(N2kDoubleNA, voltage);
+}
+
+void test_tank_level() {
+  sensesp::event_loop()->run_for_ms(2500);
+
+  const tN2kMsg* fluid_level = LastSent(127505);
+  TEST_ASSERT_NOT_NULL(fluid_level);
+  unsigned char instance;
+  tN2kFluidType type;
+  double level, capacity;
+  TEST_ASSERT_TRUE(
+      ParseN2kFluidLevel(*fluid_level, instance, type, level, capacity));
+  TEST_ASSERT_EQUAL(N2kft_Fuel, type);
+  TEST_ASSERT_FLOAT_WITHIN(0.2, 50, level);
+  TEST_ASSERT_FLOAT_WITHIN(0.1, 200, capacity);
+}
+
+void test_alarm_input() {
+  fake::Pins::get()->write(kDigitalInputPin2, HIGH);
+  sensesp::event_loop()->run_for_ms(200);
+  TEST_ASSERT_TRUE(alarm->get());
+  fake::Pins::get()->write(kDigitalInputPin2, LOW);
+  sensesp::event_loop()->run_for_ms(200);
+  TEST_ASSERT_FALSE(alarm->get());
+}
+
+void test_onewire_temperature() {
+  dts->set_celsius(0, 400);
+  sensesp::event_loop()->run_for_ms(1000);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 673.15, exhaust_temperature->get());
+}
+
+void test_display() {
+  sensesp::event_loop()->run_for_ms(1000);
+  TEST_ASSERT_TRUE(display->get_row(2) == "Tank A1: 50.0");
+}
+
+// Allocations on the event loop per ADC sample, once the chains run
+void benchmark_allocations_per_sample() {
+  Adafruit_ADS1115* ads = adc_scheduler->get_device(0);
+  uint32_t conversions = ads->get_conversions();
+  size_t start = allocations;
+  sensesp::event_loop()->run_for_ms(60000);
+  uint32_t samples = ads->get_conversions() - conversions;
+  char message[120];
+  snprintf(message, sizeof(message),
+           "%u ADC samples in 60 s, %.2f allocations per sample",
+           static_cast<unsigned>(samples),
+           static_cast<double>(allocations - start) / samples);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_GREATER_THAN(0, samples);
+}
+
+// N2K messages the chains produce per second of host time, best of 5
+void benchmark_messages_per_second() {
+  nmea2000.set_record(false);
+  double best = 0;
+  for (int run = 0; run < 5; run++) {
+    nmea2000.clear_sent();
+    auto start = std::chrono::steady_clock::now();
+    sensesp::event_loop()->run_for_ms(60000);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    size_t messages = nmea2000.get_sent_count(127488) +
+                      nmea2000.get_sent_count(127489) +
+                      nmea2000.get_sent_count(127505);
+    best = std::max(best, messages / elapsed.count());
+  }
+  char message[80];
+  snprintf(message, sizeof(message), "%.0f N2K messages/s", best);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv) {
+  BuildChains();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_n2k_rates);
+  RUN_TEST(test_engine_values);
+  RUN_TEST(test_tank_level);
+  RUN_TEST(test_alarm_input);
+  RUN_TEST(test_onewire_temperature);
+  RUN_TEST(test_display);
+  RUN_TEST(benchmark_allocations_per_sample);
+  RUN_TEST(benchmark_messages_per_second);
+  return UNITY_END();
+}
@@ -0,0 +1,78 @@
+#include <Adafruit_ADS1X15.h>
+#include <unity.h>
+
+#include <cstdio>
+
+#include "sender_resistance.h"
+
+using namespace halmet;
+
+// At GAIN_ONE, one count is 125 uV at the ADC, or 10.09 x 125 uV at the
+// input, which is 0.126 ohms at the 10 mA measurement current.
+const float kOhmsPerCountGainOne = 0.0001250f * (33.3f / 3.3f) / 0.01f;
+
+Adafruit_ADS1115 ads;
+
+void setUp() { ads.setGain(GAIN_ONE); }
+
+void tearDown() {}
+
+void test_zero_counts_is_zero_ohms() {
+  TEST_ASSERT_EQUAL_FLOAT(0, SenderResistance(0, ads.computeVolts(1)));
+}
+
+void test_one_count() {
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, kOhmsPerCountGainOne,
+                           SenderResistance(1, ads.computeVolts(1)));
+}
+
+// A 240-33 ohm fuel sender, empty and full
+void test_fuel_sender_range() {
+  ads.set_counts(0, 1903);
+  ads.set_counts(1, 262);
+  TEST_ASSERT_FLOAT_WITHIN(
+      0.1, 240.0,
+      SenderResistance(ads.readADC_SingleEnded(0), ads.computeVolts(1)));
+  TEST_ASSERT_FLOAT_WITHIN(
+      0.1, 33.0,
+      SenderResistance(ads.readADC_SingleEnded(1), ads.computeVolts(1)));
+}
+
+// Full scale at GAIN_ONE is 4.096 V at the ADC, 4.13 kohm at the input
+void test_full_scale() {
+  TEST_ASSERT_FLOAT_WITHIN(1, 4133.1,
+                           SenderResistance(32767, ads.computeVolts(1)));
+}
+
+void test_follows_gain() {
+  float gain_one = SenderResistance(1000, ads.computeVolts(1));
+  ads.setGain(GAIN_TWO);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, gain_one / 2,
+                           SenderResistance(1000, ads.computeVolts(1)));
+}
+
+void benchmark_conversion() {
+  const int kRuns = 1000000;
+  float volts_per_count = ads.computeVolts(1);
+  volatile float sink = 0;
+  unsigned long start = micros();
+  for (int i = 0; i < kRuns; i++) {
+    sink = sink + SenderResistance(static_cast<int16_t>(i), volts_per_count);
+  }
+  unsigned long elapsed = micros() - start;
+  char message[80];
+  snprintf(message, sizeof(message), "SenderResistance: %.2f ns per call",
+           elapsed * 1000.0 / kRuns);
+  TEST_MESSAGE(message);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_zero_counts_is_zero_ohms);
+  RUN_TEST(test_one_count);
+  RUN_TEST(test_fuel_sender_range);
+  RUN_TEST(test_full_scale);
+  RUN_TEST(test_follows_gain);
+  RUN_TEST(benchmark_conversion);
+  return UNITY_END();
+}
@@ -0,0 +1,161 @@
+#include <ReactESP.h>
+#include <unity.h>
+
+#include "sensesp.h"
+#include "sensesp/system/observablevalue.h"
+#include "sensesp_app.h"
+#include "snapshot_server.h"
+
+using namespace halmet;
+
+// The snapshot's ETag follows the values and their validity, and a request
+// waiting for a change is answered by the event loop without holding the
+// HTTP server.
+
+const uint32_t kMaxAgeMs = 1000;
+
+sensesp::ObservableValue<float>* temperature;
+sensesp::ObservableValue<float>* pressure;
+
+std::shared_ptr<fake::HttpResponse> Get(const String& uri,
+                                        const String& etag = "") {
+  std::map<std::string, String> headers;
+  if (!etag.isEmpty()) {
+    headers["If-None-Match"] = etag;
+  }
+  return sensesp::sensesp_app->get_http_server()->request(HTTP_GET, uri,
+                                                          headers);
+}
+
+void setUp() {
+  temperature->set(350);
+  pressure->set(200000);
+  sensesp::event_loop()->run_for_ms(10);
+}
+
+void tearDown() {}
+
+void test_etag_follows_values() {
+  auto first = Get("/api/snapshot");
+  TEST_ASSERT_EQUAL(200, first->status_code());
+  String etag = first->headers["ETag"];
+  TEST_ASSERT_EQUAL(304, Get("/api/snapshot", etag)->status_code());
+
+  temperature->set(351);
+  auto second = Get("/api/snapshot", etag);
+  TEST_ASSERT_EQUAL(200, second->status_code());
+  TEST_ASSERT_FALSE(etag == second->headers["ETag"]);
+  TEST_ASSERT_TRUE(second->body.indexOf("351") >= 0);
+}
+
+// A channel aging past max_age_ms changes the ETag, so a client holding
+// the previous one learns that the value is no longer valid
+void test_etag_follows_validity() {
+  auto first = Get("/api/snapshot");
+  String etag = first->headers["ETag"];
+  TEST_ASSERT_TRUE(first->body.indexOf("\"valid\":false") < 0);
+
+  // Only the pressure keeps updating
+  for (int i = 0; i < 3; i++) {
+    sensesp::event_loop()->run_for_ms(500);
+    pressure->set(200000);
+  }
+  auto second = Get("/api/snapshot", etag);
+  TEST_ASSERT_EQUAL(200, second->status_code());
+  TEST_ASSERT_TRUE(second->body.indexOf("\"valid\":false") >= 0);
+  String invalid_etag = second->headers["ETag"];
+
+  // And valid again
+  temperature->set(351);
+  auto third = Get("/api/snapshot", invalid_etag);
+  TEST_ASSERT_EQUAL(200, third->status_code());
+  TEST_ASSERT_TRUE(third->body.indexOf("\"valid\":false") < 0);
+}
+
+void test_wait_answered_on_change() {
+  String etag = Get("/api/snapshot")->headers["ETag"];
+
+  auto response = Get("/api/snapshot?wait=10", etag);
+  // The handler returned without answering
+  TEST_ASSERT_FALSE(response->sent);
+  sensesp::event_loop()->run_for_ms(100);
+  TEST_ASSERT_FALSE(response->sent);
+
+  // Other requests are served in the meantime
+  TEST_ASSERT_EQUAL(304, Get("/api/snapshot", etag)->status_code());
+
+  temperature->set(352);
+  sensesp::event_loop()->run_for_ms(1);
+  TEST_ASSERT_TRUE(response->sent);
+  TEST_ASSERT_EQUAL(200, response->status_code());
+  TEST_ASSERT_TRUE(response->body.indexOf("352") >= 0);
+  TEST_ASSERT_FALSE(etag == response->headers["ETag"]);
+}
+
+void test_wait_expires() {
+  String etag = Get("/api/snapshot")->headers["ETag"];
+  auto response = Get("/api/snapshot?wait=1&format=binary", etag);
+  TEST_ASSERT_FALSE(response->sent);
+
+  // Keep the channels valid, without changing them
+  for (int i = 0; i < 4; i++) {
+    sensesp::event_loop()->run_for_ms(300);
+    temperature->set(350);
+    pressure->set(200000);
+  }
+  TEST_ASSERT_TRUE(response->sent);
+  TEST_ASSERT_EQUAL(304, response->status_code());
+  TEST_ASSERT_TRUE(etag == response->headers["ETag"]);
+}
+
+void test_binary_waiter() {
+  String etag = Get("/api/snapshot")->headers["ETag"];
+  auto response = Get("/api/snapshot?wait=10&format=binary", etag);
+  pressure->set(210000);
+  sensesp::event_loop()->run_for_ms(1);
+  TEST_ASSERT_TRUE(response->sent);
+  TEST_ASSERT_EQUAL(sizeof(SnapshotServer::BinaryHeader) +
+                        2 * sizeof(SnapshotServer::BinaryValue),
+                    response->body.length());
+  auto values = reinterpret_cast<const SnapshotServer::BinaryValue*>(
+      response->body.c_str() + sizeof(SnapshotServer::BinaryHeader));
+  TEST_ASSERT_EQUAL_FLOAT(210000, values[1].value);
+}
+
+// Waiters beyond kMaxWaiters get 304 at once
+void test_waiters_limited() {
+  String etag = Get("/api/snapshot")->headers["ETag"];
+  std::shared_ptr<fake::HttpResponse> responses[SnapshotServer::kMaxWaiters];
+  for (int i = 0; i < SnapshotServer::kMaxWaiters; i++) {
+    responses[i] = Get("/api/snapshot?wait=10", etag);
+    TEST_ASSERT_FALSE(responses[i]->sent);
+  }
+  auto extra = Get("/api/snapshot?wait=10", etag);
+  TEST_ASSERT_TRUE(extra->sent);
+  TEST_ASSERT_EQUAL(304, extra->status_code());
+
+  temperature->set(353);
+  sensesp::event_loop()->run_for_ms(1);
+  for (int i = 0; i < SnapshotServer::kMaxWaiters; i++) {
+    TEST_ASSERT_EQUAL(200, responses[i]->status_code());
+  }
+}
+
+int main(int argc, char** argv) {
+  fake::Clock::get()->set_us(1000000);
+  temperature = new sensesp::ObservableValue<float>();
+  pressure = new sensesp::ObservableValue<float>();
+  auto snapshot = new SnapshotServer(kMaxAgeMs);
+  snapshot->add_channel("temperature", temperature);
+  snapshot->add_channel("pressure", pressure);
+  snapshot->start();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_etag_follows_values);
+  RUN_TEST(test_etag_follows_validity);
+  RUN_TEST(test_wait_answered_on_change);
+  RUN_TEST(test_wait_expires);
+  RUN_TEST(test_binary_waiter);
+  RUN_TEST(test_waiters_limited);
+  return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include <unity.h>
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "staged_value.h"
+
+using namespace halmet;
+
+// A calibration whose two fields must change together: offset is always
+// -scale, so that a half-applied change shows as a non-zero output for a
+// sample of 1.
+struct Calibration {
+  float scale;
+  float offset;
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_apply_without_stage() {
+  StagedValue<Calibration> staged;
+  Calibration config = {1, -1};
+  TEST_ASSERT_FALSE(staged.apply(config));
+  TEST_ASSERT_EQUAL_FLOAT(1, config.scale);
+}
+
+void test_peek_keeps_the_staged_value() {
+  StagedValue<Calibration> staged;
+  Calibration config = {1, -1};
+  staged.stage({2, -2});
+  Calibration peeked = {0, 0};
+  TEST_ASSERT_TRUE(staged.peek(peeked));
+  TEST_ASSERT_EQUAL_FLOAT(2, peeked.scale);
+  TEST_ASSERT_TRUE(staged.apply(config));
+  TEST_ASSERT_EQUAL_FLOAT(2, config.scale);
+  TEST_ASSERT_FALSE(staged.apply(config));
+}
+
+void test_latest_stage_wins() {
+  StagedValue<Calibration> staged;
+  Calibration config = {1, -1};
+  staged.stage({2, -2});
+  staged.stage({3, -3});
+  TEST_ASSERT_TRUE(staged.apply(config));
+  TEST_ASSERT_EQUAL_FLOAT(3, config.scale);
+  TEST_ASSERT_EQUAL_FLOAT(-3, config.offset);
+}
+
+// A simulated stream runs on one thread, as on the event loop, while
+// another thread, standing in for the HTTP server task, reconfigures it.
+// Every sample must produce an output (no gap), computed with one complete
+// configuration (no torn change), and the configurations must take effect
+// in the order they were staged, ending with the last.
+void test_reconfigure_while_streaming() {
+  const int kChanges = 2000;
+
+  StagedValue<Calibration> staged;
+  Calibration config = {1, -1};
+  std::atomic<bool> reconfiguring{true};
+  std::atomic<long long> produced{0};
+  long long samples = 0;
+  long long outputs = 0;
+  int torn = 0;
+  int reordered = 0;
+  int changes_seen = 0;
+  float last_scale = 1;
+
+  std::thread stream([&]() {
+    // Keep streaming for a while after the last change
+    int tail = 1000;
+    while (reconfiguring || tail-- > 0) {
+      samples++;
+      if (staged.apply(config)) {
+        changes_seen++;
+        if (config.scale < last_scale) {
+          reordered++;
+        }
+        last_scale = config.scale;
+      }
+      float output = config.scale * 1 + config.offset;
+      produced++;
+      outputs++;
+      if (output != 0) {
+        torn++;
+      }
+    }
+  });
+
+  for (int k = 2; k < 2 + kChanges; k++) {
+    staged.stage({static_cast<float>(k), -static_cast<float>(k)});
+    // Let a few samples through between changes
+    long long until = produced + 10;
+    while (produced < until) {
+      std::this_thread::yield();
+    }
+  }
+  reconfiguring = false;
+  stream.join();
+
+  char message[120];
+  snprintf(message, sizeof(message),
+           "%lld samples, %d changes staged, %d applied between samples",
+           samples, kChanges, changes_seen);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL(samples, outputs);
+  TEST_ASSERT_EQUAL(0, torn);
+  TEST_ASSERT_EQUAL(0, reordered);
+  TEST_ASSERT_GREATER_THAN(kChanges / 2, changes_seen);
+  // The last change was applied while the stream was running
+  TEST_ASSERT_EQUAL_FLOAT(1 + kChanges, config.scale);
+  TEST_ASSERT_EQUAL_FLOAT(-1 - kChanges, config.offset);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_apply_without_stage);
+  RUN_TEST(test_peek_keeps_the_staged_value);
+  RUN_TEST(test_latest_stage_wins);
+  RUN_TEST(test_reconfigure_while_streaming);
+  return UNITY_END();
+}
@@ -0,0 +1,100 @@
+#include <ReactESP.h>
+#include <unity.h>
+
+#include <cmath>
+
+#include "halmet_digital.h"
+#include "sensesp.h"
+#include "tacho_self_test.h"
+
+using namespace halmet;
+
+// The tacho self-test sweep: the LEDC settings for each of its rates, and a
+// full sweep of a tacho chain driven by the simulated pulse source.
+
+const int kPin = 33;
+const float kMinHz = 2;
+const float kMaxHz = 10000;
+const int kSteps = 16;
+const uint32_t kStepMs = 5000;
+
+float SweepHz(int step) {
+  return kMinHz *
+         powf(kMaxHz / kMinHz, static_cast<float>(step) / (kSteps - 1));
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+// At a fixed 8 bits, the LEDC can't run the low end of the sweep
+void test_fixed_resolution_falls_short() {
+  TEST_ASSERT_EQUAL(0, fake::Ledc::get()->set_frequency(kPin, 2, 8));
+  TEST_ASSERT_EQUAL(0, fake::Ledc::get()->set_frequency(kPin, 3, 8));
+  TEST_ASSERT_EQUAL(4, fake::Ledc::get()->set_frequency(kPin, 4, 8));
+}
+
+// Every rate of the sweep runs, at 50% duty
+void test_every_step_reachable() {
+  LedcPulseSource source(kPin);
+  for (int step = 0; step < kSteps; step++) {
+    float hz = roundf(SweepHz(step));
+    float actual = source.set_frequency(SweepHz(step));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001 * hz, hz, actual);
+    const fake::Ledc::Channel& channel = fake::Ledc::get()->channel(kPin);
+    TEST_ASSERT_EQUAL(1UL << (channel.resolution - 1), channel.duty);
+  }
+  source.stop();
+  TEST_ASSERT_EQUAL(0, fake::Ledc::get()->channel(kPin).duty);
+}
+
+void test_resolution_for() {
+  TEST_ASSERT_EQUAL(16, LedcPulseSource::resolution_for(2));
+  TEST_ASSERT_EQUAL(3, LedcPulseSource::resolution_for(10000));
+  TEST_ASSERT_EQUAL(1, LedcPulseSource::resolution_for(312500));
+  TEST_ASSERT_EQUAL(20, LedcPulseSource::resolution_for(0.05));
+}
+
+// A full sweep of a tacho chain at 100 pulses per revolution: each step
+// settles to its rate over 100, but for the count resolution of the low
+// rates, of one pulse per 500 ms read over the three settled outputs
+void test_simulated_sweep() {
+  auto source = new SimulatedPulseSource();
+  auto self_test = new TachoSelfTest(source, ConnectTachoSender(source, "1"),
+                                     kMinHz, kMaxHz, kSteps, kStepMs);
+  self_test->start(1000);
+  sensesp::event_loop()->run_for_ms(2000);
+  TEST_ASSERT_TRUE(self_test->is_running());
+  sensesp::event_loop()->run_for_ms(kSteps * kStepMs);
+  TEST_ASSERT_FALSE(self_test->is_running());
+
+  const std::vector<TachoSelfTest::Step>& steps = self_test->get_steps();
+  TEST_ASSERT_EQUAL(kSteps, steps.size());
+  char message[100];
+  for (const TachoSelfTest::Step& step : steps) {
+    snprintf(message, sizeof(message),
+             "%8.1f Hz %10.4f %8.2f%% %7u ms", step.set_hz, step.output,
+             step.error * 100, step.settling_ms);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_FALSE(std::isnan(step.ratio));
+    float resolution_hz = 1 / (3 * 0.5);
+    TEST_ASSERT_FLOAT_WITHIN((resolution_hz + 0.001 * step.set_hz) / 100,
+                             step.set_hz / 100, step.output);
+    if (step.set_hz > 100) {
+      TEST_ASSERT_FLOAT_WITHIN(0.01, 0, step.error);
+      TEST_ASSERT_LESS_THAN(kStepMs / 2, step.settling_ms);
+    }
+  }
+  TEST_ASSERT_TRUE(self_test->to_json().indexOf("null") < 0);
+}
+
+int main(int argc, char** argv) {
+  fake::Clock::get()->set_us(1000000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_fixed_resolution_falls_short);
+  RUN_TEST(test_every_step_reachable);
+  RUN_TEST(test_resolution_for);
+  RUN_TEST(test_simulated_sweep);
+  return UNITY_END();
+}
@@ -0,0 +1,131 @@
+#include <unity.h>
+
+#include <cmath>
+
+#include "sensesp/system/lambda_consumer.h"
+#include "tank_filter.h"
+
+using namespace halmet;
+
+// The tank level filter on a synthetic trace of a sloshing tank in a
+// seaway, and the consumption rate and time to empty fitted to a tank
+// that empties at a known rate.
+
+const float kLevel = 0.5;
+const uint32_t kSampleMs = 100;
+
+// Sloshing of 1.7 s, swell of 40 s, and a heel of 30 s that raises the
+// sender by 0.2 from 400 s on
+float SloshTrace(uint32_t ms) {
+  float t = ms / 1000.0f;
+  float level = kLevel + 0.1f * sinf(2 * PI * t / 1.7f) +
+                0.03f * sinf(2 * PI * t / 40);
+  if (t >= 400 && t < 430) {
+    level += 0.2f;
+  }
+  return level;
+}
+
+void setUp() { fake::Clock::get()->set_us(1000000); }
+
+void tearDown() {}
+
+// With the default 4 s buckets and a median of 45, the output stays near
+// the mean level through the sloshing, the swell and the heel, where a
+// mean of the same buckets moves with the heel
+void test_median_rejects_slosh() {
+  auto filter = new TankLevelFilter();
+  int outputs = 0;
+  float max_error = 0;
+  filter->connect_to(new sensesp::LambdaConsumer<float>([&](float value) {
+    outputs++;
+    // After the window has filled
+    if (millis() > 1000 + 180000) {
+      max_error = std::max(max_error, fabsf(value - kLevel));
+    }
+  }));
+
+  // The mean of the last 45 bucket means, over the same trace
+  const int kBuckets = 45;
+  float means[kBuckets] = {};
+  int num_means = 0;
+  float bucket_sum = 0;
+  int bucket_count = 0;
+  float max_mean_error = 0;
+
+  const uint32_t kDurationMs = 600000;
+  for (uint32_t ms = 0; ms < kDurationMs; ms += kSampleMs) {
+    fake::Clock::get()->set_us(1000000 + ms * 1000ULL);
+    float level = SloshTrace(ms);
+    filter->set(level);
+
+    bucket_sum += level;
+    bucket_count++;
+    if (ms % 4000 == 0 && ms > 0) {
+      means[num_means++ % kBuckets] = bucket_sum / bucket_count;
+      bucket_sum = 0;
+      bucket_count = 0;
+      if (num_means >= kBuckets) {
+        float sum = 0;
+        for (float mean : means) {
+          sum += mean;
+        }
+        max_mean_error =
+            std::max(max_mean_error, fabsf(sum / kBuckets - kLevel));
+      }
+    }
+  }
+
+  char message[80];
+  snprintf(message, sizeof(message), "Largest error: median %.4f, mean %.4f",
+           max_error, max_mean_error);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_INT_WITHIN(1, kDurationMs / 4000, outputs);
+  TEST_ASSERT_LESS_THAN(0.02, max_error);
+  TEST_ASSERT_GREATER_THAN(0.03, max_mean_error);
+}
+
+// A tank emptying at 5 l/h, sampled every second with a little noise
+void test_consumption_slope() {
+  const float kRate = 5e-3 / 3600;  // m3/s
+  const float kStartVolume = 0.1;   // m3
+  auto consumption = new TankConsumption("Test");
+
+  uint32_t start_ms = millis();
+  float volume = kStartVolume;
+  for (uint32_t s = 0; s < 3600; s++) {
+    fake::Clock::get()->set_us((start_ms + s * 1000ULL) * 1000);
+    volume = kStartVolume - kRate * s;
+    float noise = 0.0002f * sinf(s * 0.7f);
+    consumption->set(volume + noise);
+    // Not before a quarter of the 30 min window
+    if (s < 7 * 60) {
+      TEST_ASSERT_TRUE(isnan(consumption->rate.get()) ||
+                       consumption->rate.get() == 0);
+    }
+  }
+
+  TEST_ASSERT_FLOAT_WITHIN(0.02 * kRate, kRate, consumption->rate.get());
+  TEST_ASSERT_FLOAT_WITHIN(0.03 * volume / kRate, volume / kRate,
+                           consumption->time_to_empty.get());
+}
+
+// No time to empty while the tank is filled
+void test_filling_has_no_time_to_empty() {
+  auto consumption = new TankConsumption("Filling");
+  uint32_t start_ms = millis();
+  for (uint32_t s = 0; s < 1800; s++) {
+    fake::Clock::get()->set_us((start_ms + s * 1000ULL) * 1000);
+    consumption->set(0.01f + 1e-5f * s);
+  }
+  TEST_ASSERT_LESS_THAN(0, consumption->rate.get());
+  TEST_ASSERT_TRUE(isnan(consumption->time_to_empty.get()));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_median_rejects_slosh);
+  RUN_TEST(test_consumption_slope);
+  RUN_TEST(test_filling_has_no_time_to_empty);
+  return UNITY_END();
+}
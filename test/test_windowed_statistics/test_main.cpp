@@ -0,0 +1,194 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "windowed_statistics.h"
+
+using namespace halmet;
+
+// RunningStatistics in single precision on the case it is meant for, a
+// large mean with a small spread, against a double two-pass reference, and
+// merged from buckets as the sliding windows do. With its cost per sample.
+
+// A coolant temperature of 360 K, with 0.1 K of noise
+std::vector<float> Samples(int count, uint32_t seed) {
+  std::mt19937 generator(seed);
+  std::normal_distribution<double> noise(0, 0.1);
+  std::vector<float> samples;
+  for (int i = 0; i < count; i++) {
+    samples.push_back(360 + noise(generator));
+  }
+  return samples;
+}
+
+struct Reference {
+  double mean;
+  double stddev;
+};
+
+Reference TwoPass(const std::vector<float>& samples, size_t begin,
+                  size_t end) {
+  double sum = 0;
+  for (size_t i = begin; i < end; i++) {
+    sum += samples[i];
+  }
+  double mean = sum / (end - begin);
+  double squares = 0;
+  for (size_t i = begin; i < end; i++) {
+    squares += (samples[i] - mean) * (samples[i] - mean);
+  }
+  return {mean, sqrt(squares / (end - begin - 1))};
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+// An hour at 10 Hz in one accumulator, more than any window bucket holds.
+// The naive float sum of squares loses the variance entirely. The mean's
+// rounding drifts by about a mK, well below the 0.01 K of the outputs.
+void test_stable_with_large_mean() {
+  const int kCount = 36000;
+  std::vector<float> samples = Samples(kCount, 1);
+  RunningStatistics stats;
+  float sum = 0;
+  float sum_squares = 0;
+  for (float value : samples) {
+    stats.add(value);
+    sum += value;
+    sum_squares += value * value;
+  }
+  Reference reference = TwoPass(samples, 0, kCount);
+  float naive_mean = sum / kCount;
+  float naive_variance =
+      (sum_squares - kCount * naive_mean * naive_mean) / (kCount - 1);
+
+  char message[120];
+  snprintf(message, sizeof(message),
+           "Stddev %.6f, Welford %.6f, naive variance %.3g",
+           reference.stddev, stats.stddev(), naive_variance);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL(kCount, stats.count());
+  TEST_ASSERT_FLOAT_WITHIN(2e-3, reference.mean, stats.mean());
+  TEST_ASSERT_FLOAT_WITHIN(1e-3 * reference.stddev, reference.stddev,
+                           stats.stddev());
+  TEST_ASSERT_GREATER_THAN(1,
+                           fabs(naive_variance - reference.stddev *
+                                                     reference.stddev) /
+                               (reference.stddev * reference.stddev));
+}
+
+// Buckets of uneven sizes, some empty, merged in order
+void test_merge_matches_single() {
+  const int kCount = 10000;
+  std::vector<float> samples = Samples(kCount, 2);
+  RunningStatistics single;
+  for (float value : samples) {
+    single.add(value);
+  }
+
+  const int kBucketEnds[] = {0, 1, 1, 700, 2500, 2500, 6100, 9999, kCount};
+  RunningStatistics merged;
+  size_t begin = 0;
+  for (int end : kBucketEnds) {
+    RunningStatistics bucket;
+    for (int i = begin; i < end; i++) {
+      bucket.add(samples[i]);
+    }
+    merged.merge(bucket);
+    begin = end;
+  }
+
+  Reference reference = TwoPass(samples, 0, kCount);
+  TEST_ASSERT_EQUAL(single.count(), merged.count());
+  TEST_ASSERT_EQUAL_FLOAT(single.min(), merged.min());
+  TEST_ASSERT_EQUAL_FLOAT(single.max(), merged.max());
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, reference.mean, merged.mean());
+  TEST_ASSERT_FLOAT_WITHIN(1e-3 * reference.stddev, reference.stddev,
+                           merged.stddev());
+}
+
+// As the 1 h window: 12 buckets of 5 min at 10 Hz
+void test_hour_window_merge() {
+  const int kBuckets = 12;
+  const int kPerBucket = 3000;
+  std::vector<float> samples = Samples(kBuckets * kPerBucket, 3);
+  RunningStatistics window;
+  for (int bucket = 0; bucket < kBuckets; bucket++) {
+    RunningStatistics stats;
+    for (int i = 0; i < kPerBucket; i++) {
+      stats.add(samples[bucket * kPerBucket + i]);
+    }
+    window.merge(stats);
+  }
+  Reference reference = TwoPass(samples, 0, samples.size());
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, reference.mean, window.mean());
+  TEST_ASSERT_FLOAT_WITHIN(1e-4 * reference.stddev, reference.stddev,
+                           window.stddev());
+}
+
+void test_merge_empty() {
+  RunningStatistics empty;
+  RunningStatistics stats;
+  stats.add(1);
+  stats.add(3);
+  stats.merge(empty);
+  TEST_ASSERT_EQUAL(2, stats.count());
+  TEST_ASSERT_EQUAL_FLOAT(2, stats.mean());
+
+  empty.merge(stats);
+  TEST_ASSERT_EQUAL(2, empty.count());
+  TEST_ASSERT_EQUAL_FLOAT(1, empty.min());
+  TEST_ASSERT_EQUAL_FLOAT(3, empty.max());
+  TEST_ASSERT_EQUAL_FLOAT(2, empty.variance());
+}
+
+// Nanoseconds per add() and per merge() of a 1 h window's 12 buckets
+void benchmark_add_and_merge() {
+  const int kCount = 1000000;
+  std::vector<float> samples = Samples(4096, 4);
+  RunningStatistics stats;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kCount; i++) {
+    stats.add(samples[i % 4096]);
+  }
+  std::chrono::duration<double, std::nano> add_ns =
+      std::chrono::steady_clock::now() - start;
+
+  RunningStatistics buckets[12];
+  for (int i = 0; i < 12 * 100; i++) {
+    buckets[i % 12].add(samples[i]);
+  }
+  const int kMerges = 100000;
+  volatile float sink = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kMerges; i++) {
+    RunningStatistics window;
+    for (const RunningStatistics& bucket : buckets) {
+      window.merge(bucket);
+    }
+    sink = sink + window.stddev();
+  }
+  std::chrono::duration<double, std::nano> merge_ns =
+      std::chrono::steady_clock::now() - start;
+
+  char message[100];
+  snprintf(message, sizeof(message),
+           "%.1f ns per add, %.1f ns per 12-bucket window",
+           add_ns.count() / kCount, merge_ns.count() / kMerges);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_stable_with_large_mean);
+  RUN_TEST(test_merge_matches_single);
+  RUN_TEST(test_hour_window_merge);
+  RUN_TEST(test_merge_empty);
+  RUN_TEST(benchmark_add_and_merge);
+  return UNITY_END();
+}